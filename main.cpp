@@ -1,7 +1,13 @@
+#include "authapiclient.h"
+#include "conversationstatestore.h"
 #include "loginwindow.h"
 #include "logwindow.h"
+#include "messageoutbox.h"
+#include "messagestore.h"
 #include "profileapiclient.h"
+#include "stringpool.h"
 #include "usersession.h"
+#include "websocketclient.h"
 #include "widget.h"
 
 #include <QApplication>
@@ -75,11 +81,18 @@ int main(int argc, char *argv[])
     g_logWindow = &logWindow;
     g_previousHandler = qInstallMessageHandler(appMessageHandler);
     logWindow.show();
+
+    // 网络线程模式：QWebSocket、帧解析、心跳与重连运行在独立线程，
+    // 避免界面繁忙时阻塞收包；设置 QT_CLIENT_NETWORK_THREAD=0 可回退到主线程
+    if (qEnvironmentVariable("QT_CLIENT_NETWORK_THREAD") != QStringLiteral("0")) {
+      websocketclient::instance()->startNetworkThread();
+    }
     
     // 创建登录窗口
     LoginWindow loginWindow;
     Widget mainWidget;
     ProfileApiClient profileApiClient;
+    AuthApiClient authApiClient;
     QString currentUserId;
     mainWidget.setProfileApiClient(&profileApiClient);
 
@@ -112,7 +125,44 @@ int main(int argc, char *argv[])
                  << "request_id:" << requestId << "error:" << error;
     });
 
+    // 断线重连：重连成功后恢复会话，再重发断线期间挂起的请求
+    websocketclient *ws = websocketclient::instance();
+    // reconnected 在网络线程发出，以 authApiClient 为上下文排队回到 GUI 线程
+    QObject::connect(ws, &websocketclient::reconnected, &authApiClient,
+                     [&]() { authApiClient.resumeSession(); });
+
+    QObject::connect(&authApiClient, &AuthApiClient::sessionResumed,
+                     [&](const QString &requestId) {
+      qInfo() << "Session resumed, request_id:" << requestId;
+      ws->releaseOutboundQueue();
+      // 断线前已写出但未确认的聊天消息重新发送，仍在队列中的不重复入队
+      MessageOutbox::instance()->replayPending();
+      profileApiClient.resumePendingRequests();
+    });
+
+    QObject::connect(&authApiClient, &AuthApiClient::authRequestFailed,
+                     [&](const QString &requestId, const QString &action,
+                         const QString &error) {
+      if (action != QStringLiteral("RESUME")) {
+        return;
+      }
+      qWarning() << "Session resume failed, request_id:" << requestId
+                 << "error:" << error;
+      profileApiClient.abandonPendingRequests(error);
+      // 会话已失效：队列保持挂起并随连接一起丢弃，未确认的聊天消息留在
+      // 发件箱文件中，重新登录后由 replayPending() 发出
+      ws->setAutoReconnectEnabled(false);
+      ws->close();
+      mainWidget.endSession();
+    });
+
     QObject::connect(&mainWidget, &Widget::logoutRequested, [&]() {
+      ws->setAutoReconnectEnabled(false);
+      MessageOutbox::instance()->clear();
+      MessageStore::instance()->close();
+      ConversationStateStore::instance()->close();
+      profileApiClient.clearProfileCache();
+      StringPool::instance()->releaseUnused();
       UserSession::instance().clear();
       currentUserId.clear();
       loginWindow.resetLoginForm();
@@ -126,6 +176,7 @@ int main(int argc, char *argv[])
                      [&](const QString &username, const QString &userId) {
         static const QRegularExpression kUnsignedIntRe(QStringLiteral("^\\d+$"));
         currentUserId.clear();
+        ws->setAutoReconnectEnabled(true);
         loginWindow.close();
         mainWidget.setUserInfo(username); // 设置用户信息
         mainWidget.setWindowTitle("IM聊天 - " + username);
@@ -136,6 +187,23 @@ int main(int argc, char *argv[])
           currentUserId = normalizedUserId;
         }
         mainWidget.setCurrentUserId(currentUserId);
+        QString storeError;
+        if (!MessageStore::instance()->openForUser(UserSession::instance().userId(),
+                                                   &storeError)) {
+          qWarning() << "Open message store failed:" << storeError;
+        }
+        QString stateError;
+        if (!ConversationStateStore::instance()->openForUser(
+                UserSession::instance().userId(), &stateError)) {
+          qWarning() << "Open conversation state store failed:" << stateError;
+        }
+        QString outboxError;
+        if (MessageOutbox::instance()->loadForUser(UserSession::instance().userId(),
+                                                   &outboxError)) {
+          MessageOutbox::instance()->replayPending();
+        } else {
+          qWarning() << "Load message outbox failed:" << outboxError;
+        }
         if (!currentUserId.isEmpty()) {
           profileApiClient.requestProfileInfo(currentUserId);
         } else {
@@ -145,6 +213,7 @@ int main(int argc, char *argv[])
     
     loginWindow.show();
     const int exitCode = a.exec();
+    websocketclient::instance()->stopNetworkThread();
     qInstallMessageHandler(g_previousHandler);
     g_logWindow = nullptr;
     return exitCode;
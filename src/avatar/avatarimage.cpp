@@ -0,0 +1,167 @@
+#include "avatarimage.h"
+
+#include <QBuffer>
+#include <QFile>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QPainter>
+#include <QPainterPath>
+#include <QThread>
+#include <QtGlobal>
+
+namespace avatarimage {
+
+namespace {
+constexpr int kMaxDecodeThreads = 2;
+} // namespace
+
+QImage decodeCovering(QIODevice *device, const QSize &target, QString *error) {
+  QImageReader reader(device);
+  reader.setAutoTransform(true);
+
+  const QSize original = reader.size();
+  QSize covering;
+  if (original.isValid() && !target.isEmpty()) {
+    covering = original.scaled(target, Qt::KeepAspectRatioByExpanding);
+    if (covering.width() < original.width()) {
+      reader.setScaledSize(covering);
+    } else {
+      covering = QSize();
+    }
+  }
+
+  QImage image = reader.read();
+  if (image.isNull()) {
+    if (error) {
+      *error = reader.errorString();
+    }
+    return QImage();
+  }
+
+  // Formats without scaled decoding hand back the full image.
+  if (covering.isValid() && image.width() > covering.width() &&
+      image.height() > covering.height()) {
+    image = image.scaled(covering, Qt::IgnoreAspectRatio,
+                         Qt::SmoothTransformation);
+  }
+  return image;
+}
+
+QImage decodeCovering(const QByteArray &bytes, const QSize &target,
+                      QString *error) {
+  QBuffer buffer;
+  buffer.setData(bytes);
+  if (!buffer.open(QIODevice::ReadOnly)) {
+    if (error) {
+      *error = buffer.errorString();
+    }
+    return QImage();
+  }
+  return decodeCovering(&buffer, target, error);
+}
+
+QImage decodeFileCovering(const QString &filePath, const QSize &target,
+                          QString *error) {
+  QFile file(filePath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    if (error) {
+      *error = file.errorString();
+    }
+    return QImage();
+  }
+  return decodeCovering(&file, target, error);
+}
+
+EncodedUpload encodeForUpload(const QString &filePath,
+                              const UploadEncodeOptions &options) {
+  EncodedUpload result;
+  QFile file(filePath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    result.error = file.errorString();
+    return result;
+  }
+  result.originalBytes = file.size();
+
+  QImageReader reader(&file);
+  reader.setAutoTransform(true);
+  const QSize original = reader.size();
+  const int maxDimension = qMax(1, options.maxDimension);
+  const QSize bounds(maxDimension, maxDimension);
+  if (original.isValid() && (original.width() > maxDimension ||
+                             original.height() > maxDimension)) {
+    reader.setScaledSize(original.scaled(bounds, Qt::KeepAspectRatio));
+  }
+  QImage decoded = reader.read();
+  if (decoded.isNull()) {
+    result.error = reader.errorString();
+    return result;
+  }
+  if (decoded.width() > maxDimension || decoded.height() > maxDimension) {
+    decoded = decoded.scaled(bounds, Qt::KeepAspectRatio,
+                             Qt::SmoothTransformation);
+  }
+
+  const bool keepsAlpha =
+      options.format.toLower() == "webp" &&
+      QImageWriter::supportedImageFormats().contains("webp");
+  const QByteArray format = keepsAlpha ? "webp" : "jpeg";
+
+  // Painting into a new image leaves every piece of source metadata behind.
+  QImage clean(decoded.size(), keepsAlpha ? QImage::Format_ARGB32
+                                          : QImage::Format_RGB32);
+  clean.fill(keepsAlpha ? Qt::transparent : Qt::white);
+  QPainter painter(&clean);
+  painter.drawImage(0, 0, decoded);
+  painter.end();
+
+  QBuffer buffer(&result.bytes);
+  buffer.open(QIODevice::WriteOnly);
+  QImageWriter writer(&buffer, format);
+  writer.setQuality(qBound(1, options.quality, 100));
+  writer.setOptimizedWrite(true);
+  if (!writer.write(clean)) {
+    result.bytes.clear();
+    result.error = writer.errorString();
+    return result;
+  }
+
+  result.suffix = keepsAlpha ? QStringLiteral("webp") : QStringLiteral("jpg");
+  result.contentType =
+      keepsAlpha ? QStringLiteral("image/webp") : QStringLiteral("image/jpeg");
+  result.size = clean.size();
+  return result;
+}
+
+QImage circular(const QImage &image, int side) {
+  if (image.isNull() || side <= 0) {
+    return QImage();
+  }
+
+  const QImage scaled =
+      image.scaled(side, side, Qt::KeepAspectRatioByExpanding,
+                   Qt::SmoothTransformation);
+  QImage result(side, side, QImage::Format_ARGB32_Premultiplied);
+  result.fill(Qt::transparent);
+  QPainter painter(&result);
+  painter.setRenderHint(QPainter::Antialiasing, true);
+  QPainterPath clipPath;
+  clipPath.addEllipse(0, 0, side, side);
+  painter.setClipPath(clipPath);
+  painter.drawImage((side - scaled.width()) / 2, (side - scaled.height()) / 2,
+                    scaled);
+  painter.end();
+  return result;
+}
+
+QThreadPool *decodePool() {
+  static QThreadPool *pool = [] {
+    auto *created = new QThreadPool(QCoreApplication::instance());
+    created->setObjectName(QStringLiteral("AvatarDecodePool"));
+    created->setMaxThreadCount(
+        qBound(1, QThread::idealThreadCount() / 2, kMaxDecodeThreads));
+    return created;
+  }();
+  return pool;
+}
+
+} // namespace avatarimage
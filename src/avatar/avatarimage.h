@@ -0,0 +1,88 @@
+#ifndef AVATARIMAGE_H
+#define AVATARIMAGE_H
+
+#include <QCoreApplication>
+#include <QImage>
+#include <QMetaObject>
+#include <QObject>
+#include <QPointer>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+
+class QIODevice;
+
+// Avatar decoding that is safe to run off the GUI thread. Everything here
+// works on QImage; callers convert to QPixmap once the result is back on the
+// GUI thread.
+namespace avatarimage {
+
+// Decodes just large enough to cover target. QImageReader::setScaledSize lets
+// the JPEG decoder skip most of the work for large sources, so a 4000x4000
+// upload never exists at full resolution. Returns a null image on failure.
+QImage decodeCovering(QIODevice *device, const QSize &target,
+                      QString *error = nullptr);
+QImage decodeCovering(const QByteArray &bytes, const QSize &target,
+                      QString *error = nullptr);
+QImage decodeFileCovering(const QString &filePath, const QSize &target,
+                          QString *error = nullptr);
+
+// How a picked file is re-encoded before upload.
+struct UploadEncodeOptions {
+  // Longest edge of the uploaded image; larger sources are scaled down.
+  int maxDimension = 512;
+  // "jpeg" or "webp"; webp falls back to jpeg without a writer plugin.
+  QByteArray format = "jpeg";
+  int quality = 85;
+};
+
+struct EncodedUpload {
+  QByteArray bytes;
+  // File suffix and MIME type of bytes, e.g. "jpg" and "image/jpeg".
+  QString suffix;
+  QString contentType;
+  QSize size;
+  qint64 originalBytes = 0;
+  QString error;
+
+  bool isValid() const { return !bytes.isEmpty(); }
+  qint64 bytesSaved() const { return originalBytes - bytes.size(); }
+};
+
+// Decodes filePath (honouring EXIF orientation), fits it into
+// options.maxDimension and re-encodes it. The output is drawn into a fresh
+// image, so EXIF, text chunks and colour-profile comments are not carried
+// over and transparency is flattened onto white for JPEG. Only the first
+// frame of an animation is kept. Sets error and returns no bytes on failure.
+EncodedUpload encodeForUpload(const QString &filePath,
+                              const UploadEncodeOptions &options);
+
+// Scales image to cover a side x side square, crops the centre and clips it
+// to a circle.
+QImage circular(const QImage &image, int side);
+
+// Pool shared by every avatar decode, kept small so thumbnails never compete
+// with the rest of the application for cores.
+QThreadPool *decodePool();
+
+// Runs job on the decode pool and hands its result to onDone on the GUI
+// thread. onDone is dropped if context has been destroyed meanwhile.
+template <typename Job, typename Done>
+void runInPool(QObject *context, Job job, Done onDone) {
+  const QPointer<QObject> guard(context);
+  decodePool()->start([guard, job, onDone]() {
+    const auto result = job();
+    QMetaObject::invokeMethod(
+        QCoreApplication::instance(),
+        [guard, onDone, result]() {
+          if (guard) {
+            onDone(result);
+          }
+        },
+        Qt::QueuedConnection);
+  });
+}
+
+} // namespace avatarimage
+
+#endif // AVATARIMAGE_H
@@ -0,0 +1,202 @@
+#include "avatarservice.h"
+#include "avatarimage.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QNetworkAccessManager>
+#include <QNetworkDiskCache>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QStandardPaths>
+#include <QtGlobal>
+
+#include <algorithm>
+
+AvatarService *AvatarService::instance() {
+  static AvatarService instance;
+  return &instance;
+}
+
+AvatarService::AvatarService(QObject *parent)
+    : AvatarService(QStandardPaths::writableLocation(
+                        QStandardPaths::AppDataLocation) +
+                        "/http_cache/avatar",
+                    parent) {}
+
+AvatarService::AvatarService(const QString &cacheDirectory, QObject *parent)
+    : QObject(parent), m_cache(kMemoryCacheCostKb) {
+  m_clock.start();
+  m_networkManager = new QNetworkAccessManager(this);
+  m_diskCache = new QNetworkDiskCache(this);
+  QDir().mkpath(cacheDirectory);
+  m_diskCache->setCacheDirectory(cacheDirectory);
+  m_diskCache->setMaximumCacheSize(kDiskCacheBytes);
+  m_networkManager->setCache(m_diskCache);
+
+  connect(m_networkManager, &QNetworkAccessManager::finished, this,
+          &AvatarService::onReplyFinished);
+}
+
+QPixmap AvatarService::avatar(const QUrl &url, int side) {
+  if (!url.isValid() || side <= 0) {
+    return QPixmap();
+  }
+
+  const CachedAvatar *cached = m_cache.object(cacheKey(url, side));
+  if (cached) {
+    ++m_stats.hits;
+    if (m_clock.elapsed() - cached->cachedAtMs >= m_revalidateAfterMs) {
+      download(url, side);
+    }
+  } else {
+    ++m_stats.misses;
+    download(url, side);
+  }
+  if ((m_stats.hits + m_stats.misses) % kStatsLogEvery == 0) {
+    logStats();
+  }
+  return cached ? cached->pixmap : QPixmap();
+}
+
+bool AvatarService::contains(const QUrl &url, int side) const {
+  return m_cache.contains(cacheKey(url, side));
+}
+
+AvatarCacheStats AvatarService::stats() const {
+  AvatarCacheStats stats = m_stats;
+  stats.size = static_cast<int>(m_cache.count());
+  return stats;
+}
+
+void AvatarService::clear() { m_cache.clear(); }
+
+void AvatarService::setRevalidateAfterMs(int ms) { m_revalidateAfterMs = ms; }
+
+void AvatarService::onReplyFinished(QNetworkReply *reply) {
+  if (!reply) {
+    return;
+  }
+  reply->deleteLater();
+
+  const QUrl url = reply->request().url();
+  const QVariant statusCode =
+      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+  const int httpCode = statusCode.isValid() ? statusCode.toInt() : 0;
+  if (reply->error() != QNetworkReply::NoError || httpCode != 200) {
+    ++m_stats.failures;
+    qWarning() << "[AVATAR] download failed, url=" << url.toString()
+               << "http_code=" << httpCode << "error=" << reply->errorString();
+    failPendingSides(url, m_pendingSidesByUrl.take(url), reply->errorString());
+    return;
+  }
+  if (reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool()) {
+    ++m_stats.diskCacheHits;
+  }
+
+  // One decode, at the largest side, serves every side that was waiting on
+  // this URL. The sides stay pending until the decode is back so requests
+  // arriving meanwhile join it instead of downloading again.
+  const QSet<int> sides = m_pendingSidesByUrl.value(url);
+  const int largestSide =
+      sides.isEmpty() ? 0 : *std::max_element(sides.cbegin(), sides.cend());
+  const QByteArray bytes = reply->readAll();
+  avatarimage::runInPool(
+      this,
+      [bytes, sides, largestSide]() {
+        QHash<int, QImage> images;
+        const QImage decoded = avatarimage::decodeCovering(
+            bytes, QSize(largestSide, largestSide));
+        if (decoded.isNull()) {
+          return images;
+        }
+        for (const int side : sides) {
+          images.insert(side, avatarimage::circular(decoded, side));
+        }
+        return images;
+      },
+      [this, url](const QHash<int, QImage> &images) {
+        onDecodeFinished(url, images);
+      });
+}
+
+void AvatarService::onDecodeFinished(const QUrl &url,
+                                     const QHash<int, QImage> &images) {
+  const QSet<int> sides = m_pendingSidesByUrl.take(url);
+  if (images.isEmpty()) {
+    ++m_stats.failures;
+    qWarning() << "[AVATAR] decode failed, url=" << url.toString();
+    failPendingSides(url, sides, QStringLiteral("decode failed"));
+    return;
+  }
+
+  for (const int side : sides) {
+    QImage image = images.value(side);
+    if (image.isNull()) {
+      // Joined while the decode was running; derive it from the largest
+      // circle, which is small enough to rescale here.
+      const int largestSide =
+          *std::max_element(images.keyBegin(), images.keyEnd());
+      image = avatarimage::circular(images.value(largestSide), side);
+    }
+    const QPixmap circular = QPixmap::fromImage(image);
+    auto *cached = new CachedAvatar;
+    cached->pixmap = circular;
+    cached->cachedAtMs = m_clock.elapsed();
+    const int costKb = qMax(1, side * side * 4 / 1024);
+    m_cache.insert(cacheKey(url, side), cached, costKb);
+    emit avatarReady(url, side, circular);
+  }
+}
+
+void AvatarService::failPendingSides(const QUrl &url, const QSet<int> &sides,
+                                     const QString &error) {
+  // A background revalidation that fails leaves the cached pixmap in use and
+  // is retried after another revalidation period, not on the next paint.
+  bool anyUncached = false;
+  for (const int side : sides) {
+    CachedAvatar *cached = m_cache.object(cacheKey(url, side));
+    if (cached) {
+      cached->cachedAtMs = m_clock.elapsed();
+    } else {
+      anyUncached = true;
+    }
+  }
+  if (anyUncached) {
+    emit avatarFailed(url, error);
+  }
+}
+
+QString AvatarService::cacheKey(const QUrl &url, int side) {
+  return QString::number(side) + QLatin1Char('@') + url.toString();
+}
+
+void AvatarService::download(const QUrl &url, int side) {
+  auto it = m_pendingSidesByUrl.find(url);
+  if (it != m_pendingSidesByUrl.end()) {
+    ++m_stats.joined;
+    it->insert(side);
+    return;
+  }
+  m_pendingSidesByUrl.insert(url, QSet<int>{side});
+  ++m_stats.downloads;
+
+  QNetworkRequest request(url);
+  // PreferNetwork lets the disk cache serve fresh files and send a
+  // conditional request for stale ones.
+  request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
+                       QNetworkRequest::PreferNetwork);
+  request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, true);
+  request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
+                       QNetworkRequest::NoLessSafeRedirectPolicy);
+  request.setTransferTimeout(kTransferTimeoutMs);
+  m_networkManager->get(request);
+}
+
+void AvatarService::logStats() const {
+  qInfo().noquote() << "[AVATAR] cache hits=" << m_stats.hits
+                    << "misses=" << m_stats.misses << "joined=" << m_stats.joined
+                    << "downloads=" << m_stats.downloads
+                    << "disk_cache_hits=" << m_stats.diskCacheHits
+                    << "failures=" << m_stats.failures
+                    << "size=" << m_cache.count();
+}
@@ -0,0 +1,95 @@
+#ifndef AVATARSERVICE_H
+#define AVATARSERVICE_H
+
+#include <QCache>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QSet>
+#include <QString>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QNetworkDiskCache;
+class QNetworkReply;
+
+struct AvatarCacheStats {
+  quint64 hits = 0;
+  quint64 misses = 0;
+  // Misses that joined a download already in flight for the same URL.
+  quint64 joined = 0;
+  quint64 downloads = 0;
+  // Downloads answered by the disk cache, either fresh or after a 304.
+  quint64 diskCacheHits = 0;
+  quint64 failures = 0;
+  int size = 0;
+};
+
+// Shared avatar loader for every widget that shows one. Keeps decoded,
+// pre-scaled circular pixmaps in an LRU keyed by URL and side, runs at most
+// one download per URL however many rows ask for it, and lets the
+// QNetworkDiskCache revalidate stale files with ETag/If-Modified-Since.
+// Decoding, scaling and masking run on the avatar decode pool; only the
+// QPixmap conversion happens on the GUI thread.
+class AvatarService : public QObject {
+  Q_OBJECT
+
+public:
+  static AvatarService *instance();
+  explicit AvatarService(QObject *parent = nullptr);
+  // Keeps the HTTP disk cache in cacheDirectory instead of the shared
+  // AppDataLocation one.
+  explicit AvatarService(const QString &cacheDirectory, QObject *parent = nullptr);
+  ~AvatarService() override = default;
+
+  // Returns the cached pixmap, or a null pixmap and starts (or joins) a
+  // download; avatarReady or avatarFailed follows. Entries older than the
+  // revalidation age are still returned but refreshed in the background; a
+  // failed refresh keeps them and is not reported as avatarFailed.
+  QPixmap avatar(const QUrl &url, int side);
+  bool contains(const QUrl &url, int side) const;
+  AvatarCacheStats stats() const;
+  void clear();
+  void setRevalidateAfterMs(int ms);
+
+signals:
+  void avatarReady(const QUrl &url, int side, const QPixmap &pixmap);
+  void avatarFailed(const QUrl &url, const QString &error);
+
+private slots:
+  void onReplyFinished(QNetworkReply *reply);
+
+private:
+  struct CachedAvatar {
+    QPixmap pixmap;
+    qint64 cachedAtMs = 0;
+  };
+
+  static QString cacheKey(const QUrl &url, int side);
+  void download(const QUrl &url, int side);
+  // Reports a failed download or decode to the sides that have nothing
+  // cached to fall back on.
+  void failPendingSides(const QUrl &url, const QSet<int> &sides,
+                        const QString &error);
+  void onDecodeFinished(const QUrl &url, const QHash<int, QImage> &images);
+  void logStats() const;
+
+  static constexpr int kMemoryCacheCostKb = 16 * 1024;
+  static constexpr qint64 kDiskCacheBytes = 50 * 1024 * 1024;
+  static constexpr int kRevalidateAfterMs = 5 * 60 * 1000;
+  static constexpr int kTransferTimeoutMs = 8000;
+  static constexpr int kStatsLogEvery = 100;
+
+  QNetworkAccessManager *m_networkManager = nullptr;
+  QNetworkDiskCache *m_diskCache = nullptr;
+  QCache<QString, CachedAvatar> m_cache;
+  // Sides waiting on each in-flight download or decode.
+  QHash<QUrl, QSet<int>> m_pendingSidesByUrl;
+  QElapsedTimer m_clock;
+  int m_revalidateAfterMs = kRevalidateAfterMs;
+  AvatarCacheStats m_stats;
+};
+
+#endif // AVATARSERVICE_H
@@ -1,9 +1,12 @@
 #include "conversationlistmanager.h"
 
+#include "stringpool.h"
+
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonParseError>
 #include <QJsonValue>
+#include <QSet>
 #include <QTimeZone>
 
 namespace {
@@ -17,6 +20,11 @@ QString valueToString(const QJsonValue &value) {
   return QString();
 }
 
+// Ids and URLs repeat across conversations and across every refresh.
+QString internedString(const QJsonValue &value) {
+  return StringPool::instance()->intern(valueToString(value));
+}
+
 int valueToInt(const QJsonValue &value, int defaultValue = 0) {
   if (value.isDouble()) {
     return value.toInt(defaultValue);
@@ -29,6 +37,18 @@ int valueToInt(const QJsonValue &value, int defaultValue = 0) {
   return defaultValue;
 }
 
+qint64 valueToInt64(const QJsonValue &value, qint64 defaultValue = 0) {
+  if (value.isDouble()) {
+    return value.toInteger(defaultValue);
+  }
+  if (value.isString()) {
+    bool ok = false;
+    const qint64 parsed = value.toString().trimmed().toLongLong(&ok);
+    return ok ? parsed : defaultValue;
+  }
+  return defaultValue;
+}
+
 bool valueToBool(const QJsonValue &value, bool defaultValue = false) {
   if (value.isBool()) {
     return value.toBool();
@@ -74,17 +94,78 @@ namespace conversationlist {
 namespace {
 
 QString readGroupNumericId(const QJsonObject &obj) {
-  const QString groupNumericId = valueToString(obj.value("group_numeric_id"));
+  const QString groupNumericId = internedString(obj.value("group_numeric_id"));
   if (!groupNumericId.isEmpty()) {
     return groupNumericId;
   }
 
-  const QString numericId = valueToString(obj.value("numeric_id"));
+  const QString numericId = internedString(obj.value("numeric_id"));
   if (!numericId.isEmpty()) {
     return numericId;
   }
 
-  return valueToString(obj.value("group_id"));
+  return internedString(obj.value("group_id"));
+}
+
+bool parseConversationItem(const QJsonObject &obj, ConversationItem *outItem) {
+  ConversationItem item;
+  item.conversationId = internedString(obj.value("conversation_id"));
+  item.conversationUuid = internedString(obj.value("conversation_uuid"));
+  item.groupNumericId = readGroupNumericId(obj);
+  item.conversationType = valueToInt(obj.value("conversation_type"), 0);
+  item.name = valueToString(obj.value("name"));
+  item.avatarUrl = internedString(obj.value("avatar_url"));
+  item.memberCount = valueToInt(obj.value("member_count"), 0);
+  item.peerUserId = internedString(obj.value("peer_user_id"));
+  item.peerNumericId = internedString(obj.value("peer_numeric_id"));
+  item.peerUsername = valueToString(obj.value("peer_username"));
+  item.peerNickname = valueToString(obj.value("peer_nickname"));
+  item.peerAvatarUrl = internedString(obj.value("peer_avatar_url"));
+  item.peerBio = valueToString(obj.value("peer_bio"));
+  item.peerStatus = valueToInt(obj.value("peer_status"), 0);
+  item.peerIsOnline = valueToBool(obj.value("peer_is_online"), false);
+  item.peerLastSeenAt = valueToString(obj.value("peer_last_seen_at"));
+  item.peerLastSeenAtUtc = parseUtcIsoTime(item.peerLastSeenAt);
+  item.lastSeq = valueToInt64(obj.value("last_seq"), 0);
+  item.lastReadSeq = valueToInt64(obj.value("last_read_seq"), 0);
+  item.unreadCount = valueToInt(obj.value("unread_count"), -1);
+  item.lastMessagePreview = valueToString(obj.value("last_message_preview"));
+  item.lastActivityAtUtc =
+      parseUtcIsoTime(valueToString(obj.value("last_message_at")));
+  item.pinned = valueToBool(obj.value("is_pinned"), false);
+
+  if (item.conversationId.isEmpty()) {
+    return false;
+  }
+
+  if (item.conversationUuid.isEmpty()) {
+    item.conversationUuid = item.conversationId;
+  }
+  if (item.name.isEmpty()) {
+    item.name = resolveDisplayName(item);
+  }
+  if (item.avatarUrl.isEmpty()) {
+    item.avatarUrl = item.peerAvatarUrl;
+  }
+
+  *outItem = item;
+  return true;
+}
+
+bool sameConversation(const ConversationItem &a, const ConversationItem &b) {
+  return a.conversationId == b.conversationId &&
+         a.conversationUuid == b.conversationUuid &&
+         a.groupNumericId == b.groupNumericId &&
+         a.conversationType == b.conversationType && a.name == b.name &&
+         a.avatarUrl == b.avatarUrl && a.memberCount == b.memberCount &&
+         a.peerUserId == b.peerUserId && a.peerNumericId == b.peerNumericId &&
+         a.peerUsername == b.peerUsername && a.peerNickname == b.peerNickname &&
+         a.peerAvatarUrl == b.peerAvatarUrl && a.peerBio == b.peerBio &&
+         a.peerStatus == b.peerStatus && a.peerIsOnline == b.peerIsOnline &&
+         a.peerLastSeenAt == b.peerLastSeenAt && a.lastSeq == b.lastSeq &&
+         a.lastReadSeq == b.lastReadSeq && a.unreadCount == b.unreadCount &&
+         a.lastMessagePreview == b.lastMessagePreview &&
+         a.lastActivityAtUtc == b.lastActivityAtUtc && a.pinned == b.pinned;
 }
 
 } // namespace
@@ -101,6 +182,11 @@ bool ConversationListManager::updateFromJson(const QByteArray &jsonBytes) {
 }
 
 bool ConversationListManager::updateFromResponse(const QJsonObject &data) {
+  return applySyncResponse(data, nullptr);
+}
+
+bool ConversationListManager::applySyncResponse(const QJsonObject &data,
+                                                ConversationListDiff *diff) {
   const QJsonValue conversationsValue = data.value("conversations");
   if (!conversationsValue.isArray()) {
     qWarning() << "[ConversationList] invalid response: conversations is not array";
@@ -118,87 +204,241 @@ bool ConversationListManager::updateFromResponse(const QJsonObject &data) {
       continue;
     }
 
-    const QJsonObject obj = itemValue.toObject();
     ConversationItem item;
-    item.conversationId = valueToString(obj.value("conversation_id"));
-    item.conversationUuid = valueToString(obj.value("conversation_uuid"));
-    item.groupNumericId = readGroupNumericId(obj);
-    item.conversationType = valueToInt(obj.value("conversation_type"), 0);
-    item.name = valueToString(obj.value("name"));
-    item.avatarUrl = valueToString(obj.value("avatar_url"));
-    item.memberCount = valueToInt(obj.value("member_count"), 0);
-    item.peerUserId = valueToString(obj.value("peer_user_id"));
-    item.peerNumericId = valueToString(obj.value("peer_numeric_id"));
-    item.peerUsername = valueToString(obj.value("peer_username"));
-    item.peerNickname = valueToString(obj.value("peer_nickname"));
-    item.peerAvatarUrl = valueToString(obj.value("peer_avatar_url"));
-    item.peerBio = valueToString(obj.value("peer_bio"));
-    item.peerStatus = valueToInt(obj.value("peer_status"), 0);
-    item.peerIsOnline = valueToBool(obj.value("peer_is_online"), false);
-    item.peerLastSeenAt = valueToString(obj.value("peer_last_seen_at"));
-    item.peerLastSeenAtUtc = parseUtcIsoTime(item.peerLastSeenAt);
-
-    if (item.conversationId.isEmpty()) {
+    if (!parseConversationItem(itemValue.toObject(), &item)) {
       qWarning() << "[ConversationList] skip invalid item at index" << i
                  << "missing conversation_id";
       continue;
     }
+    parsed.push_back(std::move(item));
+  }
 
-    if (item.conversationUuid.isEmpty()) {
-      item.conversationUuid = item.conversationId;
-    }
-    if (item.name.isEmpty()) {
-      item.name = resolveDisplayName(item);
+  const bool isDelta =
+      valueToString(data.value("sync_mode")) == QLatin1String("delta");
+  ConversationListDiff result;
+  if (isDelta) {
+    QSet<QString> removedIds;
+    const QJsonArray removedArray = data.value("removed_conversation_ids").toArray();
+    for (const QJsonValue &value : removedArray) {
+      const QString conversationId = valueToString(value);
+      if (m_indexByConversationId.contains(conversationId) &&
+          !removedIds.contains(conversationId)) {
+        removedIds.insert(conversationId);
+        result.removedConversationIds.push_back(conversationId);
+      }
     }
-    if (item.avatarUrl.isEmpty()) {
-      item.avatarUrl = item.peerAvatarUrl;
+
+    for (ConversationItem &item : parsed) {
+      const auto it = m_indexByConversationId.constFind(item.conversationId);
+      if (it == m_indexByConversationId.cend()) {
+        const int row = m_conversations.size();
+        m_indexByConversationId.insert(item.conversationId, row);
+        indexPeers(item, row);
+        result.addedConversationIds.push_back(item.conversationId);
+        m_conversations.push_back(ConversationRecord(std::move(item)));
+        continue;
+      }
+      const int row = it.value();
+      ConversationRecord &existing = m_conversations[row];
+      if (!sameConversation(*existing, item)) {
+        result.changedConversationIds.push_back(item.conversationId);
+        const bool peerChanged = existing->peerUserId != item.peerUserId ||
+                                 existing->peerNumericId != item.peerNumericId;
+        if (peerChanged) {
+          unindexPeers(*existing, row);
+        }
+        existing = ConversationRecord(std::move(item));
+        if (peerChanged) {
+          indexPeers(*existing, row);
+        }
+      }
     }
 
-    parsed.push_back(item);
+    if (!removedIds.isEmpty()) {
+      // Rows before the first removed one keep their index; only the tail
+      // shifts and is re-indexed.
+      int firstRemovedRow = m_conversations.size();
+      for (const QString &conversationId : std::as_const(removedIds)) {
+        firstRemovedRow =
+            qMin(firstRemovedRow, m_indexByConversationId.value(conversationId));
+        m_indexByConversationId.remove(conversationId);
+      }
+      for (int row = firstRemovedRow; row < m_conversations.size(); ++row) {
+        dropPeerEntries(*m_conversations.at(row), row);
+      }
+      m_conversations.removeIf([&removedIds](const ConversationRecord &record) {
+        return removedIds.contains(record->conversationId);
+      });
+      for (int row = firstRemovedRow; row < m_conversations.size(); ++row) {
+        const ConversationItem &item = *m_conversations.at(row);
+        m_indexByConversationId.insert(item.conversationId, row);
+        indexPeers(item, row);
+      }
+    }
+  } else {
+    QSet<QString> seenIds;
+    QList<ConversationRecord> records;
+    records.reserve(parsed.size());
+    for (ConversationItem &item : parsed) {
+      seenIds.insert(item.conversationId);
+      const auto it = m_indexByConversationId.constFind(item.conversationId);
+      if (it == m_indexByConversationId.cend()) {
+        result.addedConversationIds.push_back(item.conversationId);
+      } else if (sameConversation(*m_conversations.at(it.value()), item)) {
+        records.push_back(m_conversations.at(it.value()));
+        continue;
+      } else {
+        result.changedConversationIds.push_back(item.conversationId);
+      }
+      records.push_back(ConversationRecord(std::move(item)));
+    }
+    for (const ConversationRecord &record : std::as_const(m_conversations)) {
+      if (!seenIds.contains(record->conversationId)) {
+        result.removedConversationIds.push_back(record->conversationId);
+      }
+    }
+    m_conversations = std::move(records);
+    rebuildIndex();
   }
 
-  m_conversations = parsed;
-  qInfo() << "[ConversationList] sync completed, size=" << m_conversations.size();
+  m_syncCursor = valueToString(data.value("cursor"));
+  qInfo() << "[ConversationList] sync completed, mode="
+          << (isDelta ? "delta" : "full")
+          << "added=" << result.addedConversationIds.size()
+          << "changed=" << result.changedConversationIds.size()
+          << "removed=" << result.removedConversationIds.size()
+          << "size=" << m_conversations.size();
+  if (diff) {
+    *diff = std::move(result);
+  }
   return true;
 }
 
+QString ConversationListManager::syncCursor() const { return m_syncCursor; }
+
+const ConversationItem *
+ConversationListManager::findConversation(const QString &conversationId) const {
+  const auto it = m_indexByConversationId.constFind(conversationId.trimmed());
+  if (it == m_indexByConversationId.cend()) {
+    return nullptr;
+  }
+  return &m_conversations.at(it.value()).item();
+}
+
+void ConversationListManager::rebuildIndex() {
+  m_indexByConversationId.clear();
+  m_indexByPeerUserId.clear();
+  m_indexByPeerNumericId.clear();
+  m_indexByConversationId.reserve(m_conversations.size());
+  for (int i = 0; i < m_conversations.size(); ++i) {
+    const ConversationItem &item = *m_conversations.at(i);
+    m_indexByConversationId.insert(item.conversationId, i);
+    if (!item.peerUserId.isEmpty() && !m_indexByPeerUserId.contains(item.peerUserId)) {
+      m_indexByPeerUserId.insert(item.peerUserId, i);
+    }
+    if (!item.peerNumericId.isEmpty() &&
+        !m_indexByPeerNumericId.contains(item.peerNumericId)) {
+      m_indexByPeerNumericId.insert(item.peerNumericId, i);
+    }
+  }
+}
+
+void ConversationListManager::indexPeers(const ConversationItem &item, int row) {
+  const auto indexPeer = [row](QHash<QString, int> &index, const QString &key) {
+    if (key.isEmpty()) {
+      return;
+    }
+    auto it = index.find(key);
+    if (it == index.end()) {
+      index.insert(key, row);
+    } else if (it.value() > row) {
+      it.value() = row;
+    }
+  };
+  indexPeer(m_indexByPeerUserId, item.peerUserId);
+  indexPeer(m_indexByPeerNumericId, item.peerNumericId);
+}
+
+void ConversationListManager::dropPeerEntries(const ConversationItem &item,
+                                              int row) {
+  if (m_indexByPeerUserId.value(item.peerUserId, -1) == row) {
+    m_indexByPeerUserId.remove(item.peerUserId);
+  }
+  if (m_indexByPeerNumericId.value(item.peerNumericId, -1) == row) {
+    m_indexByPeerNumericId.remove(item.peerNumericId);
+  }
+}
+
+void ConversationListManager::unindexPeers(const ConversationItem &item, int row) {
+  bool ownedUserId = m_indexByPeerUserId.value(item.peerUserId, -1) == row;
+  bool ownedNumericId =
+      m_indexByPeerNumericId.value(item.peerNumericId, -1) == row;
+  dropPeerEntries(item, row);
+  if (!ownedUserId && !ownedNumericId) {
+    return;
+  }
+  // Another conversation with the same peer further down takes over. Peers
+  // are normally unique, so this scan only runs when a row changes peer.
+  for (int i = row + 1; i < m_conversations.size(); ++i) {
+    const ConversationItem &other = *m_conversations.at(i);
+    if (ownedUserId && other.peerUserId == item.peerUserId) {
+      m_indexByPeerUserId.insert(item.peerUserId, i);
+      ownedUserId = false;
+    }
+    if (ownedNumericId && other.peerNumericId == item.peerNumericId) {
+      m_indexByPeerNumericId.insert(item.peerNumericId, i);
+      ownedNumericId = false;
+    }
+    if (!ownedUserId && !ownedNumericId) {
+      break;
+    }
+  }
+}
+
 bool ConversationListManager::applyPeerPresenceUpdate(
     const QString &userId, const QString &numericId, bool isOnline,
-    const QString &lastSeenAtUtc, ConversationItem *updatedConversation) {
+    const QString &lastSeenAtUtc, ConversationRecord *updatedConversation) {
   const QString trimmedUserId = userId.trimmed();
   const QString trimmedNumericId = numericId.trimmed();
 
-  for (ConversationItem &item : m_conversations) {
-    const bool userIdMatched =
-        !trimmedUserId.isEmpty() && item.peerUserId == trimmedUserId;
-    const bool numericIdMatched =
-        !trimmedNumericId.isEmpty() && item.peerNumericId == trimmedNumericId;
-    if (!userIdMatched && !numericIdMatched) {
-      continue;
-    }
-
-    item.peerIsOnline = isOnline;
-    item.peerLastSeenAt = lastSeenAtUtc.trimmed();
-    item.peerLastSeenAtUtc = parseUtcIsoTime(item.peerLastSeenAt);
+  // Either id may match; the earlier row wins, as with a front-to-back scan.
+  const int byUserId =
+      trimmedUserId.isEmpty() ? -1 : m_indexByPeerUserId.value(trimmedUserId, -1);
+  const int byNumericId = trimmedNumericId.isEmpty()
+                              ? -1
+                              : m_indexByPeerNumericId.value(trimmedNumericId, -1);
+  const int row = (byUserId >= 0 && byNumericId >= 0) ? qMin(byUserId, byNumericId)
+                                                      : qMax(byUserId, byNumericId);
+  if (row < 0) {
+    return false;
+  }
 
-    if (updatedConversation) {
-      *updatedConversation = item;
-    }
+  ConversationItem &item = m_conversations[row].edit();
+  item.peerIsOnline = isOnline;
+  item.peerLastSeenAt = lastSeenAtUtc.trimmed();
+  item.peerLastSeenAtUtc = parseUtcIsoTime(item.peerLastSeenAt);
 
-    qInfo().noquote() << "[ConversationList] applied presence update peer_user_id="
-                      << item.peerUserId << "peer_numeric_id="
-                      << item.peerNumericId << "is_online=" << item.peerIsOnline
-                      << "last_seen_at=" << item.peerLastSeenAt;
-    return true;
+  if (updatedConversation) {
+    *updatedConversation = m_conversations.at(row);
   }
 
-  return false;
+  qInfo().noquote() << "[ConversationList] applied presence update peer_user_id="
+                    << item.peerUserId << "peer_numeric_id="
+                    << item.peerNumericId << "is_online=" << item.peerIsOnline
+                    << "last_seen_at=" << item.peerLastSeenAt;
+  return true;
 }
 
-const QList<ConversationItem> &ConversationListManager::conversations() const {
+const QList<ConversationRecord> &ConversationListManager::conversations() const {
   return m_conversations;
 }
 
-void ConversationListManager::clear() { m_conversations.clear(); }
+void ConversationListManager::clear() {
+  m_conversations.clear();
+  m_indexByConversationId.clear();
+  m_indexByPeerUserId.clear();
+  m_indexByPeerNumericId.clear();
+  m_syncCursor.clear();
+}
 
 } // namespace conversationlist
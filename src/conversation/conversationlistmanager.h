@@ -1,46 +1,64 @@
 #ifndef CONVERSATIONLISTMANAGER_H
 #define CONVERSATIONLISTMANAGER_H
 
+#include "conversationrecord.h"
+
 #include <QByteArray>
-#include <QDateTime>
+#include <QHash>
 #include <QJsonObject>
 #include <QList>
 #include <QString>
+#include <QStringList>
 
 namespace conversationlist {
 
-struct ConversationItem {
-  QString conversationId;
-  QString conversationUuid;
-  QString groupNumericId;
-  int conversationType = 0;
-  QString name;
-  QString avatarUrl;
-  int memberCount = 0;
-  QString peerUserId;
-  QString peerNumericId;
-  QString peerUsername;
-  QString peerNickname;
-  QString peerAvatarUrl;
-  QString peerBio;
-  int peerStatus = 0;
-  bool peerIsOnline = false;
-  QString peerLastSeenAt;
-  QDateTime peerLastSeenAtUtc;
+struct ConversationListDiff {
+  QStringList addedConversationIds;
+  QStringList changedConversationIds;
+  QStringList removedConversationIds;
+
+  bool isEmpty() const {
+    return addedConversationIds.isEmpty() && changedConversationIds.isEmpty() &&
+           removedConversationIds.isEmpty();
+  }
 };
 
 class ConversationListManager {
 public:
   bool updateFromJson(const QByteArray &jsonBytes);
   bool updateFromResponse(const QJsonObject &data);
+  // Applies a LIST_CONVERSATIONS response. A full response replaces the list;
+  // a delta response (sync_mode "delta") carries only changed conversations
+  // plus removed_conversation_ids. Either way diff reports what changed.
+  bool applySyncResponse(const QJsonObject &data,
+                         ConversationListDiff *diff = nullptr);
+  // Cursor returned by the last sync; empty until the server supports deltas.
+  QString syncCursor() const;
+  const ConversationItem *findConversation(const QString &conversationId) const;
   bool applyPeerPresenceUpdate(const QString &userId, const QString &numericId,
                                bool isOnline, const QString &lastSeenAtUtc,
-                               ConversationItem *updatedConversation = nullptr);
-  const QList<ConversationItem> &conversations() const;
+                               ConversationRecord *updatedConversation = nullptr);
+  const QList<ConversationRecord> &conversations() const;
   void clear();
 
 private:
-  QList<ConversationItem> m_conversations;
+  void rebuildIndex();
+  // Incremental upkeep for delta syncs. indexPeers keeps the lowest row per
+  // peer id; unindexPeers hands a peer id on to its next row, if any.
+  void indexPeers(const ConversationItem &item, int row);
+  void dropPeerEntries(const ConversationItem &item, int row);
+  void unindexPeers(const ConversationItem &item, int row);
+
+  // The records every other holder shares. A sync keeps the record of an
+  // unchanged conversation instead of replacing it with the parsed copy.
+  QList<ConversationRecord> m_conversations;
+  // Row indexes into m_conversations, rebuilt after a full sync and patched
+  // row by row after a delta. Peer indexes point at the first conversation
+  // with that peer.
+  QHash<QString, int> m_indexByConversationId;
+  QHash<QString, int> m_indexByPeerUserId;
+  QHash<QString, int> m_indexByPeerNumericId;
+  QString m_syncCursor;
 };
 
 } // namespace conversationlist
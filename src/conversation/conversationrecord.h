@@ -0,0 +1,78 @@
+#ifndef CONVERSATIONRECORD_H
+#define CONVERSATIONRECORD_H
+
+#include <QDateTime>
+#include <QMetaType>
+#include <QSharedData>
+#include <QSharedDataPointer>
+#include <QString>
+#include <QVector>
+
+#include <utility>
+
+namespace conversationlist {
+
+struct ConversationItem {
+  QString conversationId;
+  QString conversationUuid;
+  QString groupNumericId;
+  int conversationType = 0;
+  QString name;
+  QString avatarUrl;
+  int memberCount = 0;
+  QString peerUserId;
+  QString peerNumericId;
+  QString peerUsername;
+  QString peerNickname;
+  QString peerAvatarUrl;
+  QString peerBio;
+  int peerStatus = 0;
+  bool peerIsOnline = false;
+  QString peerLastSeenAt;
+  QDateTime peerLastSeenAtUtc;
+  // Read state, when the server reports it. unreadCount is -1 when absent.
+  qint64 lastSeq = 0;
+  qint64 lastReadSeq = 0;
+  int unreadCount = -1;
+  QString lastMessagePreview;
+  QDateTime lastActivityAtUtc;
+  bool pinned = false;
+};
+
+// The one copy of a conversation that the list manager, the main widget and
+// LIST_CONVERSATIONS signals pass around. Copies share the item; edit()
+// detaches only when someone else still holds it.
+class ConversationRecord {
+public:
+  ConversationRecord() : d(new Data) {}
+  explicit ConversationRecord(const ConversationItem &item) : d(new Data(item)) {}
+  explicit ConversationRecord(ConversationItem &&item)
+      : d(new Data(std::move(item))) {}
+
+  const ConversationItem &item() const { return d->item; }
+  const ConversationItem &operator*() const { return d->item; }
+  const ConversationItem *operator->() const { return &d->item; }
+  ConversationItem &edit() { return d->item; }
+
+  bool sharesDataWith(const ConversationRecord &other) const {
+    return d == other.d;
+  }
+
+private:
+  struct Data : public QSharedData {
+    Data() = default;
+    explicit Data(const ConversationItem &value) : item(value) {}
+    explicit Data(ConversationItem &&value) : item(std::move(value)) {}
+
+    ConversationItem item;
+  };
+
+  QSharedDataPointer<Data> d;
+};
+
+} // namespace conversationlist
+
+Q_DECLARE_METATYPE(conversationlist::ConversationRecord)
+Q_DECLARE_METATYPE(QVector<conversationlist::ConversationRecord>)
+
+#endif // CONVERSATIONRECORD_H
@@ -0,0 +1,269 @@
+#include "messagesequencer.h"
+
+#include <QDebug>
+#include <QStringList>
+#include <QTimer>
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+constexpr quint64 kStatsLogInterval = 500;
+} // namespace
+
+MessageSequencer::MessageSequencer(QObject *parent) : QObject(parent) {}
+
+void MessageSequencer::setGapGraceMs(int ms) { m_gapGraceMs = std::max(0, ms); }
+
+void MessageSequencer::setFetchTimeoutMs(int ms) {
+  m_fetchTimeoutMs = std::max(1, ms);
+}
+
+bool MessageSequencer::isTracking(const QString &conversationId) const {
+  return m_states.contains(conversationId);
+}
+
+void MessageSequencer::setDeliveredSeq(const QString &conversationId, qint64 seq) {
+  ConversationState &state = m_states[conversationId];
+  if (seq > state.deliveredSeq) {
+    state.deliveredSeq = seq;
+    // Buffered messages the new watermark covers are already delivered.
+    for (auto it = state.buffered.begin(); it != state.buffered.end();) {
+      it = it.key() <= seq ? state.buffered.erase(it) : std::next(it);
+    }
+  }
+}
+
+qint64 MessageSequencer::deliveredSeq(const QString &conversationId) const {
+  const auto it = m_states.constFind(conversationId);
+  return it == m_states.cend() ? 0 : it->deliveredSeq;
+}
+
+int MessageSequencer::bufferedCount(const QString &conversationId) const {
+  const auto it = m_states.constFind(conversationId);
+  return it == m_states.cend() ? 0 : it->buffered.size();
+}
+
+bool MessageSequencer::isFetching(const QString &conversationId) const {
+  const auto it = m_states.constFind(conversationId);
+  return it != m_states.cend() && it->fetching;
+}
+
+bool MessageSequencer::accept(const StoredMessage &message) {
+  if (message.seq <= 0) {
+    // Nothing to order by; pass it through as it came.
+    ++m_stats.accepted;
+    emit messagesReady(message.conversationId, {message});
+    return true;
+  }
+  return place(message, false);
+}
+
+bool MessageSequencer::acceptOwn(const StoredMessage &message) {
+  return message.seq > 0 && place(message, true);
+}
+
+bool MessageSequencer::place(const StoredMessage &message, bool silent) {
+  const QString &conversationId = message.conversationId;
+
+  ConversationState &state = m_states[conversationId];
+  if (state.deliveredSeq == 0) {
+    // No history to compare with: this message starts the sequence.
+    state.deliveredSeq = message.seq - 1;
+  }
+  if (message.seq <= state.deliveredSeq || state.buffered.contains(message.seq)) {
+    ++m_stats.duplicates;
+    return false;
+  }
+
+  ++m_stats.accepted;
+  if (m_stats.accepted % kStatsLogInterval == 0) {
+    qInfo() << "[MessageSequencer] accepted=" << m_stats.accepted
+            << "duplicates=" << m_stats.duplicates
+            << "reordered=" << m_stats.reordered << "fetches=" << m_stats.fetches
+            << "skipped_seqs=" << m_stats.skippedSeqs;
+  }
+
+  if (message.seq != state.deliveredSeq + 1) {
+    state.buffered.insert(message.seq, BufferedMessage{message, silent});
+    state.highestBufferedSeq = std::max(state.highestBufferedSeq, message.seq);
+    if (!state.fetching) {
+      armGrace(conversationId, state);
+    }
+    return true;
+  }
+
+  QVector<StoredMessage> ready;
+  if (!silent) {
+    ready.push_back(message);
+  }
+  state.deliveredSeq = message.seq;
+  drain(state, &ready);
+  if (state.buffered.isEmpty() && state.graceArmed) {
+    // The hole closed on its own; the pending grace timer is stale.
+    state.graceArmed = false;
+    state.timerGeneration = ++m_nextGeneration;
+  }
+  if (!ready.isEmpty()) {
+    emit messagesReady(conversationId, ready);
+  }
+  return true;
+}
+
+void MessageSequencer::completeFetch(const QString &conversationId,
+                                     const QVector<StoredMessage> &messages) {
+  const auto it = m_states.find(conversationId);
+  if (it == m_states.end()) {
+    return;
+  }
+
+  ConversationState &state = it.value();
+  const bool wasFetching = state.fetching;
+  state.fetching = false;
+  state.graceArmed = false;
+  state.timerGeneration = ++m_nextGeneration;
+
+  for (const StoredMessage &message : messages) {
+    if (message.seq <= state.deliveredSeq ||
+        state.buffered.contains(message.seq)) {
+      continue;
+    }
+    state.buffered.insert(message.seq, BufferedMessage{message, false});
+    state.highestBufferedSeq = std::max(state.highestBufferedSeq, message.seq);
+  }
+
+  QVector<StoredMessage> ready;
+  drain(state, &ready);
+  if (wasFetching) {
+    skipToBuffered(conversationId, state, &ready);
+  }
+  if (!state.buffered.isEmpty()) {
+    // A newer hole opened while the fetch was in flight.
+    armGrace(conversationId, state);
+  }
+  if (!ready.isEmpty()) {
+    emit messagesReady(conversationId, ready);
+  }
+}
+
+void MessageSequencer::extendFetch(const QString &conversationId) {
+  const auto it = m_states.find(conversationId);
+  if (it == m_states.end() || !it->fetching) {
+    return;
+  }
+  armFetchTimeout(conversationId, it.value());
+}
+
+void MessageSequencer::clear() {
+  QStringList fetching;
+  for (auto it = m_states.cbegin(); it != m_states.cend(); ++it) {
+    if (it->fetching) {
+      fetching.push_back(it.key());
+    }
+  }
+  m_states.clear();
+  m_stats = MessageSequencerStats();
+  for (const QString &conversationId : fetching) {
+    emit fetchAbandoned(conversationId);
+  }
+}
+
+const MessageSequencerStats &MessageSequencer::stats() const { return m_stats; }
+
+void MessageSequencer::drain(ConversationState &state,
+                             QVector<StoredMessage> *ready) {
+  for (auto it = state.buffered.find(state.deliveredSeq + 1);
+       it != state.buffered.end();
+       it = state.buffered.find(state.deliveredSeq + 1)) {
+    if (!it->silent) {
+      ready->push_back(it->message);
+    }
+    state.buffered.erase(it);
+    ++state.deliveredSeq;
+    ++m_stats.reordered;
+  }
+  if (state.buffered.isEmpty()) {
+    state.highestBufferedSeq = 0;
+  }
+}
+
+void MessageSequencer::skipToBuffered(const QString &conversationId,
+                                      ConversationState &state,
+                                      QVector<StoredMessage> *ready) {
+  while (!state.buffered.isEmpty()) {
+    qint64 lowestSeq = state.highestBufferedSeq;
+    for (auto it = state.buffered.cbegin(); it != state.buffered.cend(); ++it) {
+      lowestSeq = std::min(lowestSeq, it.key());
+    }
+    if (lowestSeq > state.fetchBeforeSeq) {
+      // Beyond the fetched range; that hole gets its own fetch.
+      return;
+    }
+    const qint64 skipped = lowestSeq - state.deliveredSeq - 1;
+    m_stats.skippedSeqs += static_cast<quint64>(skipped);
+    qWarning() << "[MessageSequencer] skip unavailable seqs conversation_id="
+               << conversationId << "from=" << state.deliveredSeq + 1
+               << "count=" << skipped;
+    state.deliveredSeq = lowestSeq - 1;
+    drain(state, ready);
+  }
+}
+
+void MessageSequencer::armGrace(const QString &conversationId,
+                                ConversationState &state) {
+  if (state.graceArmed) {
+    return;
+  }
+  state.graceArmed = true;
+  const quint64 generation = ++m_nextGeneration;
+  state.timerGeneration = generation;
+  // Pushes overtaking each other usually settle within the grace period, so
+  // short reorders never cost a round trip.
+  QTimer::singleShot(m_gapGraceMs, this, [this, conversationId, generation]() {
+    const auto it = m_states.find(conversationId);
+    if (it == m_states.end() || it->timerGeneration != generation) {
+      return;
+    }
+    it->graceArmed = false;
+    if (!it->buffered.isEmpty() && !it->fetching) {
+      startFetch(conversationId);
+    }
+  });
+}
+
+void MessageSequencer::startFetch(const QString &conversationId) {
+  ConversationState &state = m_states[conversationId];
+  state.fetching = true;
+  state.fetchBeforeSeq = state.highestBufferedSeq;
+  ++m_stats.fetches;
+
+  const qint64 afterSeq = state.deliveredSeq;
+  const qint64 beforeSeq = state.fetchBeforeSeq;
+  qInfo() << "[MessageSequencer] gap detected conversation_id=" << conversationId
+          << "after_seq=" << afterSeq << "before_seq=" << beforeSeq
+          << "buffered=" << state.buffered.size();
+  armFetchTimeout(conversationId, state);
+  emit fetchRequested(conversationId, afterSeq, beforeSeq);
+}
+
+void MessageSequencer::armFetchTimeout(const QString &conversationId,
+                                       ConversationState &state) {
+  // A newer generation makes the previous deadline a no-op.
+  const quint64 generation = ++m_nextGeneration;
+  state.timerGeneration = generation;
+  QTimer::singleShot(m_fetchTimeoutMs, this, [this, conversationId, generation]() {
+    onFetchTimeout(conversationId, generation);
+  });
+}
+
+void MessageSequencer::onFetchTimeout(const QString &conversationId,
+                                      quint64 generation) {
+  const auto it = m_states.constFind(conversationId);
+  if (it == m_states.cend() || it->timerGeneration != generation || !it->fetching) {
+    return;
+  }
+  qWarning() << "[MessageSequencer] history fetch timed out conversation_id="
+             << conversationId;
+  emit fetchAbandoned(conversationId);
+  completeFetch(conversationId, {});
+}
@@ -0,0 +1,104 @@
+#ifndef MESSAGESEQUENCER_H
+#define MESSAGESEQUENCER_H
+
+#include "messagestore.h"
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+struct MessageSequencerStats {
+  quint64 accepted = 0;
+  quint64 duplicates = 0;
+  quint64 reordered = 0;
+  quint64 fetches = 0;
+  quint64 skippedSeqs = 0;
+};
+
+// Puts incoming chat messages of every conversation back into seq order.
+// Each conversation keeps the highest seq delivered without holes; anything
+// at or below it is a duplicate, anything above it but not next waits in a
+// small buffer. A hole that is still open after a short grace period is
+// requested once as a single range covering everything up to the highest
+// buffered seq. Seqs the fetch cannot supply are skipped so later messages
+// are never held back for good.
+class MessageSequencer : public QObject {
+  Q_OBJECT
+
+public:
+  explicit MessageSequencer(QObject *parent = nullptr);
+
+  void setGapGraceMs(int ms);
+  void setFetchTimeoutMs(int ms);
+
+  bool isTracking(const QString &conversationId) const;
+  // Seeds the watermark, e.g. with the newest seq of local history.
+  void setDeliveredSeq(const QString &conversationId, qint64 seq);
+  qint64 deliveredSeq(const QString &conversationId) const;
+  int bufferedCount(const QString &conversationId) const;
+  bool isFetching(const QString &conversationId) const;
+
+  // Returns false for duplicates. Messages become available through
+  // messagesReady(), possibly together with buffered ones they unblock.
+  bool accept(const StoredMessage &message);
+  // Our own acked message: it takes its place in the sequence so it does not
+  // look like a gap, but it is never passed to messagesReady().
+  bool acceptOwn(const StoredMessage &message);
+  // Restarts the deadline of the fetch in flight, e.g. each time one page of
+  // a long range arrives and the next one is requested.
+  void extendFetch(const QString &conversationId);
+  // Answer to fetchRequested(); an empty vector when the fetch failed.
+  void completeFetch(const QString &conversationId,
+                     const QVector<StoredMessage> &messages);
+  // Drops every conversation; fetches in flight are reported as abandoned.
+  void clear();
+
+  const MessageSequencerStats &stats() const;
+
+signals:
+  // In seq order, each message exactly once.
+  void messagesReady(const QString &conversationId,
+                     const QVector<StoredMessage> &messages);
+  // Asks for the messages with afterSeq < seq < beforeSeq.
+  void fetchRequested(const QString &conversationId, qint64 afterSeq,
+                      qint64 beforeSeq);
+  // The fetch in flight timed out or was cleared; a late answer is ignored,
+  // so the requester can drop whatever it keeps for it.
+  void fetchAbandoned(const QString &conversationId);
+
+private:
+  struct BufferedMessage {
+    StoredMessage message;
+    bool silent = false;
+  };
+
+  struct ConversationState {
+    qint64 deliveredSeq = 0;
+    QHash<qint64, BufferedMessage> buffered;
+    qint64 highestBufferedSeq = 0;
+    bool fetching = false;
+    // Upper bound of the range asked for by the fetch in flight.
+    qint64 fetchBeforeSeq = 0;
+    // A grace or fetch timer only acts while its generation is current.
+    quint64 timerGeneration = 0;
+    bool graceArmed = false;
+  };
+
+  bool place(const StoredMessage &message, bool silent);
+  void drain(ConversationState &state, QVector<StoredMessage> *ready);
+  void skipToBuffered(const QString &conversationId, ConversationState &state,
+                      QVector<StoredMessage> *ready);
+  void armGrace(const QString &conversationId, ConversationState &state);
+  void startFetch(const QString &conversationId);
+  void armFetchTimeout(const QString &conversationId, ConversationState &state);
+  void onFetchTimeout(const QString &conversationId, quint64 generation);
+
+  int m_gapGraceMs = 300;
+  int m_fetchTimeoutMs = 10000;
+  QHash<QString, ConversationState> m_states;
+  quint64 m_nextGeneration = 0;
+  MessageSequencerStats m_stats;
+};
+
+#endif // MESSAGESEQUENCER_H
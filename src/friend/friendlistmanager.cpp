@@ -1,11 +1,11 @@
 #include "friendlistmanager.h"
 
+#include "stringpool.h"
+
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonParseError>
 #include <QJsonValue>
-#include <QListWidget>
-#include <QListWidgetItem>
 #include <QTimeZone>
 #include <QtGlobal>
 
@@ -20,6 +20,11 @@ QString valueToString(const QJsonValue &value) {
   return QString();
 }
 
+// Shared with the conversation list, which names the same peers.
+QString internedString(const QJsonValue &value) {
+  return StringPool::instance()->intern(valueToString(value));
+}
+
 int valueToInt(const QJsonValue &value, int defaultValue = 0) {
   if (value.isDouble()) {
     return value.toInt(defaultValue);
@@ -77,7 +82,7 @@ bool FriendListManager::updateFromResponse(const QJsonObject &data) {
   }
 
   const QJsonArray friendsArray = friendsValue.toArray();
-  QList<FriendItem> parsed;
+  QList<FriendRecord> parsed;
   parsed.reserve(friendsArray.size());
 
   for (int i = 0; i < friendsArray.size(); ++i) {
@@ -89,15 +94,15 @@ bool FriendListManager::updateFromResponse(const QJsonObject &data) {
 
     const QJsonObject obj = itemValue.toObject();
     FriendItem item;
-    item.conversationId = valueToString(obj.value("conversation_uuid"));
+    item.conversationId = internedString(obj.value("conversation_uuid"));
     if (item.conversationId.isEmpty()) {
-      item.conversationId = valueToString(obj.value("conversation_id"));
+      item.conversationId = internedString(obj.value("conversation_id"));
     }
-    item.userId = valueToString(obj.value("user_id"));
-    item.numericId = valueToString(obj.value("numeric_id"));
+    item.userId = internedString(obj.value("user_id"));
+    item.numericId = internedString(obj.value("numeric_id"));
     item.username = valueToString(obj.value("username"));
     item.nickname = valueToString(obj.value("nickname"));
-    item.avatarUrl = valueToString(obj.value("avatar_url"));
+    item.avatarUrl = internedString(obj.value("avatar_url"));
     item.bio = valueToString(obj.value("bio"));
     item.status = valueToInt(obj.value("status"), 0);
     item.userStatus = valueToInt(obj.value("user_status"), item.status);
@@ -113,10 +118,11 @@ bool FriendListManager::updateFromResponse(const QJsonObject &data) {
     }
 
     item.displayName = item.nickname.isEmpty() ? item.username : item.nickname;
-    parsed.push_back(item);
+    parsed.push_back(FriendRecord(std::move(item)));
   }
 
-  m_friends = parsed;
+  m_friends = std::move(parsed);
+  rebuildIndex();
   qInfo() << "[FriendList] sync completed, size=" << m_friends.size();
   return true;
 }
@@ -125,72 +131,59 @@ bool FriendListManager::applyPresenceUpdate(const QString &userId,
                                             const QString &numericId,
                                             bool isOnline,
                                             const QString &lastSeenAtUtc,
-                                            FriendItem *updatedFriend) {
+                                            FriendRecord *updatedFriend) {
   const QString trimmedUserId = userId.trimmed();
   const QString trimmedNumericId = numericId.trimmed();
 
-  for (FriendItem &item : m_friends) {
-    const bool userIdMatched =
-        !trimmedUserId.isEmpty() && item.userId == trimmedUserId;
-    const bool numericIdMatched =
-        !trimmedNumericId.isEmpty() && item.numericId == trimmedNumericId;
-    if (!userIdMatched && !numericIdMatched) {
-      continue;
-    }
+  // Either id may match; the earlier row wins, as with a front-to-back scan.
+  const int byUserId =
+      trimmedUserId.isEmpty() ? -1 : m_indexByUserId.value(trimmedUserId, -1);
+  const int byNumericId =
+      trimmedNumericId.isEmpty() ? -1 : m_indexByNumericId.value(trimmedNumericId, -1);
+  const int row = (byUserId >= 0 && byNumericId >= 0) ? qMin(byUserId, byNumericId)
+                                                      : qMax(byUserId, byNumericId);
+  if (row < 0) {
+    return false;
+  }
 
-    item.isOnline = isOnline;
-    item.lastSeenAtUtc = lastSeenAtUtc.trimmed();
-    item.lastSeenAt = parseUtcIsoTime(item.lastSeenAtUtc);
-    item.displayName = item.nickname.isEmpty() ? item.username : item.nickname;
+  FriendItem &item = m_friends[row].edit();
+  item.isOnline = isOnline;
+  item.lastSeenAtUtc = lastSeenAtUtc.trimmed();
+  item.lastSeenAt = parseUtcIsoTime(item.lastSeenAtUtc);
+  item.displayName = item.nickname.isEmpty() ? item.username : item.nickname;
 
-    if (updatedFriend) {
-      *updatedFriend = item;
-    }
-
-    qInfo().noquote()
-        << "[FriendList] applied presence update user_id=" << item.userId
-        << "numeric_id=" << item.numericId << "is_online=" << item.isOnline
-        << "last_seen_at=" << item.lastSeenAtUtc;
-    return true;
+  if (updatedFriend) {
+    *updatedFriend = m_friends.at(row);
   }
 
-  return false;
+  qInfo().noquote()
+      << "[FriendList] applied presence update user_id=" << item.userId
+      << "numeric_id=" << item.numericId << "is_online=" << item.isOnline
+      << "last_seen_at=" << item.lastSeenAtUtc;
+  return true;
 }
 
-const QList<FriendItem> &FriendListManager::friends() const { return m_friends; }
-
-void FriendListManager::clear() { m_friends.clear(); }
-
-void FriendListManager::refreshListWidget(QListWidget *listWidget,
-                                          const QList<FriendItem> &friends) {
-  if (!listWidget) {
-    qWarning() << "[FriendList] refresh UI skipped: listWidget is null";
-    return;
-  }
+const QList<FriendRecord> &FriendListManager::friends() const { return m_friends; }
 
-  listWidget->clear();
-  if (friends.isEmpty()) {
-    auto *emptyItem = new QListWidgetItem(QStringLiteral("暂无好友"));
-    emptyItem->setFlags(emptyItem->flags() & ~Qt::ItemIsSelectable &
-                        ~Qt::ItemIsEnabled);
-    listWidget->addItem(emptyItem);
-    return;
-  }
+void FriendListManager::clear() {
+  m_friends.clear();
+  m_indexByUserId.clear();
+  m_indexByNumericId.clear();
+}
 
-  for (const FriendItem &friendItem : friends) {
-    const QString avatarTag =
-        friendItem.avatarUrl.trimmed().isEmpty() ? QStringLiteral("[默认头像]")
-                                                 : QStringLiteral("[头像]");
-    const QString text =
-        QStringLiteral("%1 (%2) %3")
-            .arg(friendItem.displayName, friendItem.numericId, avatarTag);
-    auto *item = new QListWidgetItem(text);
-    item->setToolTip(friendItem.bio.trimmed().isEmpty()
-                         ? QStringLiteral("无个性签名")
-                         : friendItem.bio.trimmed());
-    item->setData(Qt::UserRole, friendItem.userId);
-    item->setData(Qt::UserRole + 1, friendItem.numericId);
-    listWidget->addItem(item);
+void FriendListManager::rebuildIndex() {
+  m_indexByUserId.clear();
+  m_indexByNumericId.clear();
+  m_indexByUserId.reserve(m_friends.size());
+  m_indexByNumericId.reserve(m_friends.size());
+  for (int i = 0; i < m_friends.size(); ++i) {
+    const FriendItem &item = *m_friends.at(i);
+    if (!m_indexByUserId.contains(item.userId)) {
+      m_indexByUserId.insert(item.userId, i);
+    }
+    if (!m_indexByNumericId.contains(item.numericId)) {
+      m_indexByNumericId.insert(item.numericId, i);
+    }
   }
 }
 
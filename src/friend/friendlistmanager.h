@@ -1,47 +1,33 @@
 #ifndef FRIENDLISTMANAGER_H
 #define FRIENDLISTMANAGER_H
 
+#include "friendrecord.h"
+
 #include <QByteArray>
-#include <QDateTime>
+#include <QHash>
 #include <QJsonObject>
 #include <QList>
 #include <QString>
 
-class QListWidget;
-
 namespace friendlist {
 
-struct FriendItem {
-  QString conversationId;
-  QString userId;
-  QString numericId;
-  QString username;
-  QString nickname;
-  QString displayName;
-  QString avatarUrl;
-  QString bio;
-  int status = 0;
-  int userStatus = 0;
-  bool isOnline = false;
-  QString lastSeenAtUtc;
-  QDateTime lastSeenAt;
-};
-
 class FriendListManager {
 public:
   bool updateFromJson(const QByteArray &jsonBytes);
   bool updateFromResponse(const QJsonObject &data);
   bool applyPresenceUpdate(const QString &userId, const QString &numericId,
                            bool isOnline, const QString &lastSeenAtUtc,
-                           FriendItem *updatedFriend = nullptr);
-  const QList<FriendItem> &friends() const;
+                           FriendRecord *updatedFriend = nullptr);
+  const QList<FriendRecord> &friends() const;
   void clear();
 
-  static void refreshListWidget(QListWidget *listWidget,
-                                const QList<FriendItem> &friends);
-
 private:
-  QList<FriendItem> m_friends;
+  void rebuildIndex();
+
+  QList<FriendRecord> m_friends;
+  // Row indexes into m_friends, rebuilt on every sync.
+  QHash<QString, int> m_indexByUserId;
+  QHash<QString, int> m_indexByNumericId;
 };
 
 } // namespace friendlist
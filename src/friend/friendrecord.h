@@ -0,0 +1,64 @@
+#ifndef FRIENDRECORD_H
+#define FRIENDRECORD_H
+
+#include <QDateTime>
+#include <QMetaType>
+#include <QSharedData>
+#include <QSharedDataPointer>
+#include <QString>
+#include <QVector>
+
+#include <utility>
+
+namespace friendlist {
+
+struct FriendItem {
+  QString conversationId;
+  QString userId;
+  QString numericId;
+  QString username;
+  QString nickname;
+  QString displayName;
+  QString avatarUrl;
+  QString bio;
+  int status = 0;
+  int userStatus = 0;
+  bool isOnline = false;
+  QString lastSeenAtUtc;
+  QDateTime lastSeenAt;
+};
+
+// Implicitly shared FriendItem. The friend list manager, the contact model
+// and the friend dialogs hold the same records; edit() detaches only a
+// record that is still shared.
+class FriendRecord {
+public:
+  FriendRecord() : d(new Data) {}
+  explicit FriendRecord(const FriendItem &item) : d(new Data(item)) {}
+  explicit FriendRecord(FriendItem &&item) : d(new Data(std::move(item))) {}
+
+  const FriendItem &item() const { return d->item; }
+  const FriendItem &operator*() const { return d->item; }
+  const FriendItem *operator->() const { return &d->item; }
+  FriendItem &edit() { return d->item; }
+
+  bool sharesDataWith(const FriendRecord &other) const { return d == other.d; }
+
+private:
+  struct Data : public QSharedData {
+    Data() = default;
+    explicit Data(const FriendItem &value) : item(value) {}
+    explicit Data(FriendItem &&value) : item(std::move(value)) {}
+
+    FriendItem item;
+  };
+
+  QSharedDataPointer<Data> d;
+};
+
+} // namespace friendlist
+
+Q_DECLARE_METATYPE(friendlist::FriendRecord)
+Q_DECLARE_METATYPE(QVector<friendlist::FriendRecord>)
+
+#endif // FRIENDRECORD_H
@@ -1,5 +1,7 @@
 #include "authapiclient.h"
 
+#include "envelopedispatcher.h"
+#include "requesttimeoutwheel.h"
 #include "usersession.h"
 
 #include <QJsonDocument>
@@ -11,6 +13,7 @@ namespace {
 constexpr const char *kTypeAuth = "AUTH";
 constexpr const char *kActionLogin = "LOGIN";
 constexpr const char *kActionLogout = "LOGOUT";
+constexpr const char *kActionResume = "RESUME";
 
 bool readRequiredString(const QJsonObject &obj, const char *key, QString *out,
                         bool allowNumber = false) {
@@ -104,8 +107,9 @@ AuthApiClient::AuthApiClient(websocketclient *client, QObject *parent)
     return;
   }
 
-  connect(m_client, &websocketclient::textMessageReceived, this,
-          &AuthApiClient::onTextMessageReceived);
+  EnvelopeDispatcher::instance()->subscribe(
+      QString::fromLatin1(kTypeAuth), QString(), this,
+      [this](const protocol::Envelope &envelope) { onEnvelopeReceived(envelope); });
   connect(m_client, &websocketclient::disconnected, this,
           &AuthApiClient::onDisconnected);
 }
@@ -132,7 +136,7 @@ QString AuthApiClient::login(const QString &username, const QString &password) {
   QJsonObject data;
   data.insert(QStringLiteral("username"), normalizedUsername);
   data.insert(QStringLiteral("password"), password);
-  addPendingRequest(requestId, QString::fromLatin1(kActionLogin));
+  addPendingRequest(requestId, protocol::EnvelopeAction::Login);
   if (!sendAuthPayload(QString::fromLatin1(kActionLogin), requestId, data)) {
     clearPendingRequest(requestId);
     failRequest(requestId, QString::fromLatin1(kActionLogin),
@@ -159,7 +163,7 @@ QString AuthApiClient::logout(const QString &token) {
 
   QJsonObject data;
   data.insert(QStringLiteral("token"), normalizedToken);
-  addPendingRequest(requestId, QString::fromLatin1(kActionLogout));
+  addPendingRequest(requestId, protocol::EnvelopeAction::Logout);
   if (!sendAuthPayload(QString::fromLatin1(kActionLogout), requestId, data)) {
     clearPendingRequest(requestId);
     failRequest(requestId, QString::fromLatin1(kActionLogout),
@@ -168,6 +172,32 @@ QString AuthApiClient::logout(const QString &token) {
   return requestId;
 }
 
+QString AuthApiClient::resumeSession() {
+  const QString requestId = generateRequestId();
+  const UserSession &session = UserSession::instance();
+  if (!session.isLoggedIn() || session.uploadToken().isEmpty()) {
+    failRequest(requestId, QString::fromLatin1(kActionResume),
+                QStringLiteral("no cached session to resume"));
+    return requestId;
+  }
+  if (!m_client || !m_client->isConnected()) {
+    failRequest(requestId, QString::fromLatin1(kActionResume),
+                QStringLiteral("websocket is not connected"));
+    return requestId;
+  }
+
+  QJsonObject data;
+  data.insert(QStringLiteral("token"), session.uploadToken());
+  data.insert(QStringLiteral("user_id"), session.userId());
+  addPendingRequest(requestId, protocol::EnvelopeAction::Resume);
+  if (!sendAuthPayload(QString::fromLatin1(kActionResume), requestId, data)) {
+    clearPendingRequest(requestId);
+    failRequest(requestId, QString::fromLatin1(kActionResume),
+                QStringLiteral("websocket is not connected"));
+  }
+  return requestId;
+}
+
 bool AuthApiClient::isCurrentLoginResponse(const protocol::Envelope &envelope,
                                            const QString &pendingRequestId) {
   if (pendingRequestId.isEmpty()) {
@@ -192,8 +222,8 @@ bool AuthApiClient::isCurrentLoginResponse(const protocol::Envelope &envelope,
   }
 
   return originalRequest.requestId == pendingRequestId &&
-         originalRequest.type == QLatin1String(kTypeAuth) &&
-         originalRequest.action == QLatin1String(kActionLogin);
+         originalRequest.typeId == protocol::EnvelopeType::Auth &&
+         originalRequest.actionId == protocol::EnvelopeAction::Login;
 }
 
 QString AuthApiClient::extractAuthErrorMessage(const protocol::Envelope &envelope,
@@ -252,8 +282,8 @@ bool AuthApiClient::parseLoginResult(const protocol::Envelope &envelope,
     }
     return false;
   }
-  if (envelope.type != QLatin1String(kTypeAuth) ||
-      envelope.action != QLatin1String(kActionLogin)) {
+  if (envelope.typeId != protocol::EnvelopeType::Auth ||
+      envelope.actionId != protocol::EnvelopeAction::Login) {
     if (error) {
       *error = QStringLiteral("invalid AUTH/LOGIN envelope");
     }
@@ -314,13 +344,8 @@ bool AuthApiClient::parseLoginResult(const protocol::Envelope &envelope,
   return true;
 }
 
-void AuthApiClient::onTextMessageReceived(const QString &message) {
-  protocol::Envelope envelope;
-  QString parseError;
-  if (!protocol::parseEnvelope(message, &envelope, &parseError)) {
-    return;
-  }
-  if (envelope.type != QLatin1String(kTypeAuth)) {
+void AuthApiClient::onEnvelopeReceived(const protocol::Envelope &envelope) {
+  if (envelope.typeId != protocol::EnvelopeType::Auth) {
     return;
   }
 
@@ -336,8 +361,8 @@ void AuthApiClient::onTextMessageReceived(const QString &message) {
   const PendingRequest pending = m_pendingRequests.value(requestId);
   clearPendingRequest(requestId);
 
-  const QString action = pending.action;
-  if (!envelope.action.isEmpty() && envelope.action != action) {
+  const QString action = protocol::envelopeActionName(pending.action);
+  if (!envelope.action.isEmpty() && envelope.actionId != pending.action) {
     failRequest(requestId, action, QStringLiteral("response action mismatch"));
     return;
   }
@@ -349,7 +374,7 @@ void AuthApiClient::onTextMessageReceived(const QString &message) {
     return;
   }
 
-  if (action == QLatin1String(kActionLogin)) {
+  if (pending.action == protocol::EnvelopeAction::Login) {
     LoginResult result;
     QString error;
     if (!parseLoginResult(envelope, &result, &error)) {
@@ -364,7 +389,7 @@ void AuthApiClient::onTextMessageReceived(const QString &message) {
     return;
   }
 
-  if (action == QLatin1String(kActionLogout)) {
+  if (pending.action == protocol::EnvelopeAction::Logout) {
     LogoutResult result;
     QString error;
     if (!parseLogoutResult(envelope, &result, &error)) {
@@ -376,13 +401,28 @@ void AuthApiClient::onTextMessageReceived(const QString &message) {
     return;
   }
 
+  if (pending.action == protocol::EnvelopeAction::Resume) {
+    const QJsonValue presenceValue = envelope.data.value(QStringLiteral("presence"));
+    if (presenceValue.isObject()) {
+      const QJsonObject presenceObj = presenceValue.toObject();
+      bool isOnline = true;
+      readRequiredBool(presenceObj, "is_online", &isOnline);
+      UserSession::instance().setPresence(
+          isOnline,
+          presenceObj.value(QStringLiteral("last_seen_at")).toString().trimmed());
+    }
+    emit sessionResumed(requestId);
+    return;
+  }
+
   failRequest(requestId, action, QStringLiteral("unsupported action"));
 }
 
 void AuthApiClient::onDisconnected() {
   const auto requestIds = m_pendingRequests.keys();
   for (const QString &requestId : requestIds) {
-    const QString action = m_pendingRequests.value(requestId).action;
+    const QString action =
+        protocol::envelopeActionName(m_pendingRequests.value(requestId).action);
     clearPendingRequest(requestId);
     failRequest(requestId, action, QStringLiteral("websocket disconnected"));
   }
@@ -405,24 +445,22 @@ bool AuthApiClient::sendAuthPayload(const QString &action, const QString &reques
   return true;
 }
 
-void AuthApiClient::addPendingRequest(const QString &requestId, const QString &action) {
+void AuthApiClient::addPendingRequest(const QString &requestId,
+                                      protocol::EnvelopeAction action) {
   clearPendingRequest(requestId);
 
-  auto *timer = new QTimer(this);
-  timer->setSingleShot(true);
-  connect(timer, &QTimer::timeout, this, [this, requestId, action]() {
-    if (!m_pendingRequests.contains(requestId)) {
-      return;
-    }
-    clearPendingRequest(requestId);
-    failRequest(requestId, action, QStringLiteral("request timeout"));
-  });
-  timer->start(kRequestTimeoutMs);
-
   PendingRequest pending;
   pending.action = action;
-  pending.timer = timer;
   m_pendingRequests.insert(requestId, pending);
+  RequestTimeoutWheel::instance()->schedule(
+      requestId, kRequestTimeoutMs, this, [this, action](const QString &key) {
+        if (!m_pendingRequests.contains(key)) {
+          return;
+        }
+        clearPendingRequest(key);
+        failRequest(key, protocol::envelopeActionName(action),
+                    QStringLiteral("request timeout"));
+      });
 }
 
 void AuthApiClient::clearPendingRequest(const QString &requestId) {
@@ -430,10 +468,7 @@ void AuthApiClient::clearPendingRequest(const QString &requestId) {
   if (it == m_pendingRequests.end()) {
     return;
   }
-  if (it->timer) {
-    it->timer->stop();
-    it->timer->deleteLater();
-  }
+  RequestTimeoutWheel::instance()->cancel(requestId);
   m_pendingRequests.erase(it);
 }
 
@@ -4,8 +4,6 @@
 #include <QDateTime>
 #include <QHash>
 #include <QObject>
-#include <QPointer>
-#include <QTimer>
 
 #include "protocol.h"
 #include "websocketclient.h"
@@ -69,6 +67,8 @@ public:
   QString login(const QString &username, const QString &password);
   QString logout();
   QString logout(const QString &token);
+  // Re-authenticates a reconnected socket with the token cached in UserSession.
+  QString resumeSession();
 
   static bool isCurrentLoginResponse(const protocol::Envelope &envelope,
                                      const QString &pendingRequestId);
@@ -81,25 +81,26 @@ public:
 signals:
   void loginSucceeded(const QString &requestId, const LoginResult &result);
   void logoutSucceeded(const QString &requestId, const LogoutResult &result);
+  void sessionResumed(const QString &requestId);
   void authRequestFailed(const QString &requestId, const QString &action,
                          const QString &error);
   void authRequestFailedDetailed(const QString &requestId, const QString &action,
                                  int code, const QString &error);
 
 private slots:
-  void onTextMessageReceived(const QString &message);
   void onDisconnected();
 
 private:
   struct PendingRequest {
-    QString action;
-    QPointer<QTimer> timer;
+    protocol::EnvelopeAction action = protocol::EnvelopeAction::Unknown;
   };
 
+  void onEnvelopeReceived(const protocol::Envelope &envelope);
   QString generateRequestId() const;
   bool sendAuthPayload(const QString &action, const QString &requestId,
                        const QJsonObject &data);
-  void addPendingRequest(const QString &requestId, const QString &action);
+  void addPendingRequest(const QString &requestId,
+                         protocol::EnvelopeAction action);
   void clearPendingRequest(const QString &requestId);
   void failRequest(const QString &requestId, const QString &action,
                    const QString &errorMessage, int code = -1);
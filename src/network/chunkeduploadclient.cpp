@@ -0,0 +1,400 @@
+#include "chunkeduploadclient.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QtGlobal>
+
+namespace {
+bool isTransientHttpCode(int httpCode) {
+  // 0 means the request never got an HTTP answer (refused, reset, timeout).
+  return httpCode == 0 || httpCode == 408 || httpCode == 429 || httpCode >= 500;
+}
+
+QJsonObject parseObject(const QByteArray &body, bool *ok) {
+  QJsonParseError parseError;
+  const QJsonDocument doc = QJsonDocument::fromJson(body, &parseError);
+  *ok = parseError.error == QJsonParseError::NoError && doc.isObject();
+  return *ok ? doc.object() : QJsonObject();
+}
+} // namespace
+
+ChunkedUploadClient::ChunkedUploadClient(QObject *parent)
+    : QObject(parent), m_networkManager(new QNetworkAccessManager(this)) {
+  m_retryTimer.setSingleShot(true);
+  connect(&m_retryTimer, &QTimer::timeout, this, [this]() {
+    if (m_uploadId.isEmpty()) {
+      sendCreate();
+    } else {
+      sendOffsetQuery();
+    }
+  });
+}
+
+ChunkedUploadClient::~ChunkedUploadClient() { abort(); }
+
+void ChunkedUploadClient::setOptions(const ChunkedUploadOptions &options) {
+  m_options = options;
+  m_options.chunkSize = qMax<qint64>(1, options.chunkSize);
+  m_options.maxRetries = qMax(0, options.maxRetries);
+}
+
+void ChunkedUploadClient::setAuthorization(const QString &headerValue) {
+  m_authorization = headerValue;
+}
+
+bool ChunkedUploadClient::startData(const QUrl &endpoint, const QByteArray &data,
+                                    const QString &fileName,
+                                    const QString &contentType,
+                                    const QJsonObject &metadata,
+                                    QString *error) {
+  if (isActive()) {
+    if (error) {
+      *error = QStringLiteral("an upload is already running");
+    }
+    return false;
+  }
+  if (data.isEmpty()) {
+    if (error) {
+      *error = QStringLiteral("nothing to upload");
+    }
+    return false;
+  }
+  m_file.reset();
+  m_data = data;
+  m_totalBytes = data.size();
+  return begin(endpoint, fileName, contentType, metadata, error);
+}
+
+bool ChunkedUploadClient::startFile(const QUrl &endpoint,
+                                    const QString &filePath,
+                                    const QString &contentType,
+                                    const QJsonObject &metadata,
+                                    QString *error) {
+  if (isActive()) {
+    if (error) {
+      *error = QStringLiteral("an upload is already running");
+    }
+    return false;
+  }
+  auto file = std::make_unique<QFile>(filePath);
+  if (!file->open(QIODevice::ReadOnly)) {
+    if (error) {
+      *error = file->errorString();
+    }
+    return false;
+  }
+  if (file->size() <= 0) {
+    if (error) {
+      *error = QStringLiteral("nothing to upload");
+    }
+    return false;
+  }
+  m_data.clear();
+  m_totalBytes = file->size();
+  m_file = std::move(file);
+  return begin(endpoint, QFileInfo(filePath).fileName(), contentType, metadata,
+               error);
+}
+
+bool ChunkedUploadClient::resume(QString *error) {
+  if (m_state != State::Failed && m_state != State::Idle) {
+    if (error) {
+      *error = QStringLiteral("upload is not paused");
+    }
+    return false;
+  }
+  if (m_totalBytes <= 0 || !m_endpoint.isValid()) {
+    if (error) {
+      *error = QStringLiteral("no upload to resume");
+    }
+    return false;
+  }
+
+  m_attempt = 0;
+  qInfo() << "[Upload] resume upload_id=" << m_uploadId
+          << "confirmed=" << m_confirmedBytes << "total=" << m_totalBytes;
+  if (m_uploadId.isEmpty()) {
+    sendCreate();
+  } else {
+    sendOffsetQuery();
+  }
+  return true;
+}
+
+void ChunkedUploadClient::abort() {
+  m_retryTimer.stop();
+  if (m_reply) {
+    QNetworkReply *reply = m_reply.data();
+    m_reply = nullptr;
+    disconnect(reply, nullptr, this, nullptr);
+    reply->abort();
+    reply->deleteLater();
+  }
+  if (isActive()) {
+    m_state = State::Idle;
+  }
+}
+
+ChunkedUploadClient::State ChunkedUploadClient::state() const { return m_state; }
+
+bool ChunkedUploadClient::isActive() const {
+  return m_state == State::Creating || m_state == State::Querying ||
+         m_state == State::Sending;
+}
+
+QString ChunkedUploadClient::uploadId() const { return m_uploadId; }
+
+qint64 ChunkedUploadClient::confirmedBytes() const { return m_confirmedBytes; }
+
+qint64 ChunkedUploadClient::totalBytes() const { return m_totalBytes; }
+
+void ChunkedUploadClient::onReplyFinished() {
+  QNetworkReply *reply = m_reply.data();
+  m_reply = nullptr;
+  if (!reply) {
+    return;
+  }
+  reply->deleteLater();
+
+  const QVariant statusCode =
+      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+  const int httpCode = statusCode.isValid() ? statusCode.toInt() : 0;
+  bool parsed = false;
+  const QJsonObject obj = parseObject(reply->readAll(), &parsed);
+
+  if (reply->error() != QNetworkReply::NoError) {
+    const QString message = obj.value("message").toString().trimmed();
+    const QString error = message.isEmpty() ? reply->errorString() : message;
+    if (httpCode == 409 && m_state == State::Sending && acceptOffset(obj)) {
+      // The server holds a different offset than we assumed; continue there.
+      sendNextChunk();
+      return;
+    }
+    if (isTransientHttpCode(httpCode)) {
+      retryOrFail(error, httpCode);
+    } else {
+      fail(error, httpCode);
+    }
+    return;
+  }
+  if (!parsed || !obj.value("ok").toBool(false)) {
+    const QString message = obj.value("message").toString().trimmed();
+    fail(message.isEmpty() ? QStringLiteral("invalid upload response") : message,
+         httpCode);
+    return;
+  }
+
+  switch (m_state) {
+  case State::Creating:
+    m_uploadId = obj.value("upload_id").toString().trimmed();
+    if (m_uploadId.isEmpty()) {
+      fail(QStringLiteral("upload_id missing in response"), httpCode);
+      return;
+    }
+    m_attempt = 0;
+    qInfo() << "[Upload] created upload_id=" << m_uploadId
+            << "total=" << m_totalBytes;
+    emit started(m_uploadId);
+    sendNextChunk();
+    return;
+  case State::Querying:
+    if (obj.value("completed").toBool(false)) {
+      complete(obj);
+      return;
+    }
+    if (!acceptOffset(obj)) {
+      fail(QStringLiteral("invalid offset in response"), httpCode);
+      return;
+    }
+    emit progress(m_confirmedBytes, m_totalBytes);
+    sendNextChunk();
+    return;
+  case State::Sending: {
+    const qint64 before = m_confirmedBytes;
+    if (!acceptOffset(obj)) {
+      fail(QStringLiteral("invalid offset in response"), httpCode);
+      return;
+    }
+    if (m_confirmedBytes > before) {
+      m_attempt = 0;
+    }
+    emit progress(m_confirmedBytes, m_totalBytes);
+    if (obj.value("completed").toBool(false)) {
+      complete(obj);
+    } else if (m_confirmedBytes >= m_totalBytes) {
+      fail(QStringLiteral("server did not complete the upload"), httpCode);
+    } else {
+      sendNextChunk();
+    }
+    return;
+  }
+  case State::Idle:
+  case State::Completed:
+  case State::Failed:
+    return;
+  }
+}
+
+void ChunkedUploadClient::onUploadProgress(qint64 bytesSent, qint64 bytesTotal) {
+  Q_UNUSED(bytesTotal);
+  if (m_state != State::Sending || bytesSent <= 0) {
+    return;
+  }
+  emit progress(m_confirmedBytes + qMin(bytesSent, m_sendingBytes), m_totalBytes);
+}
+
+bool ChunkedUploadClient::begin(const QUrl &endpoint, const QString &fileName,
+                                const QString &contentType,
+                                const QJsonObject &metadata, QString *error) {
+  if (!endpoint.isValid()) {
+    if (error) {
+      *error = QStringLiteral("invalid upload endpoint");
+    }
+    return false;
+  }
+  m_endpoint = endpoint;
+  m_fileName = fileName;
+  m_contentType = contentType;
+  m_metadata = metadata;
+  m_uploadId.clear();
+  m_confirmedBytes = 0;
+  m_sendingBytes = 0;
+  m_attempt = 0;
+  sendCreate();
+  return true;
+}
+
+void ChunkedUploadClient::sendCreate() {
+  m_state = State::Creating;
+  QJsonObject body;
+  body.insert("file_name", m_fileName);
+  body.insert("content_type", m_contentType);
+  body.insert("total_size", m_totalBytes);
+  body.insert("metadata", m_metadata);
+
+  QNetworkRequest request = buildRequest(m_endpoint);
+  request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+  watchReply(m_networkManager->post(
+      request, QJsonDocument(body).toJson(QJsonDocument::Compact)));
+}
+
+void ChunkedUploadClient::sendOffsetQuery() {
+  m_state = State::Querying;
+  watchReply(m_networkManager->get(buildRequest(uploadUrl())));
+}
+
+void ChunkedUploadClient::sendNextChunk() {
+  m_state = State::Sending;
+  const qint64 length =
+      qMin(m_options.chunkSize, m_totalBytes - m_confirmedBytes);
+  QString error;
+  const QByteArray chunk = readChunk(m_confirmedBytes, length, &error);
+  if (chunk.size() != length) {
+    fail(error.isEmpty() ? QStringLiteral("short read from upload source") : error,
+         0);
+    return;
+  }
+
+  QNetworkRequest request = buildRequest(uploadUrl());
+  request.setHeader(QNetworkRequest::ContentTypeHeader,
+                    "application/octet-stream");
+  request.setRawHeader("Content-Range",
+                       QStringLiteral("bytes %1-%2/%3")
+                           .arg(m_confirmedBytes)
+                           .arg(m_confirmedBytes + length - 1)
+                           .arg(m_totalBytes)
+                           .toLatin1());
+  m_sendingBytes = length;
+  watchReply(m_networkManager->put(request, chunk));
+}
+
+QNetworkRequest ChunkedUploadClient::buildRequest(const QUrl &url) const {
+  QNetworkRequest request(url);
+  if (!m_authorization.isEmpty()) {
+    request.setRawHeader("Authorization", m_authorization.toUtf8());
+  }
+  request.setTransferTimeout(m_options.transferTimeoutMs);
+  return request;
+}
+
+QUrl ChunkedUploadClient::uploadUrl() const {
+  QUrl url = m_endpoint;
+  QString path = url.path();
+  if (!path.endsWith(QLatin1Char('/'))) {
+    path.append(QLatin1Char('/'));
+  }
+  url.setPath(path + m_uploadId);
+  return url;
+}
+
+QByteArray ChunkedUploadClient::readChunk(qint64 offset, qint64 length,
+                                          QString *error) {
+  if (!m_file) {
+    return m_data.mid(offset, length);
+  }
+  if (!m_file->seek(offset)) {
+    *error = m_file->errorString();
+    return QByteArray();
+  }
+  const QByteArray chunk = m_file->read(length);
+  if (chunk.size() != length) {
+    *error = m_file->errorString();
+  }
+  return chunk;
+}
+
+void ChunkedUploadClient::watchReply(QNetworkReply *reply) {
+  m_reply = reply;
+  connect(reply, &QNetworkReply::finished, this,
+          &ChunkedUploadClient::onReplyFinished);
+  connect(reply, &QNetworkReply::uploadProgress, this,
+          &ChunkedUploadClient::onUploadProgress);
+}
+
+bool ChunkedUploadClient::acceptOffset(const QJsonObject &obj) {
+  if (!obj.contains("offset")) {
+    return false;
+  }
+  const qint64 offset = obj.value("offset").toVariant().toLongLong();
+  if (offset < 0 || offset > m_totalBytes) {
+    return false;
+  }
+  m_confirmedBytes = offset;
+  return true;
+}
+
+void ChunkedUploadClient::retryOrFail(const QString &error, int httpCode) {
+  if (m_attempt >= m_options.maxRetries) {
+    fail(error, httpCode);
+    return;
+  }
+  ++m_attempt;
+  const int delayMs = m_options.retryDelayMs << (m_attempt - 1);
+  qWarning() << "[Upload] retry upload_id=" << m_uploadId
+             << "offset=" << m_confirmedBytes << "attempt=" << m_attempt
+             << "delay_ms=" << delayMs << "http_code=" << httpCode
+             << "error=" << error;
+  m_retryTimer.start(delayMs);
+}
+
+void ChunkedUploadClient::fail(const QString &error, int httpCode) {
+  m_state = State::Failed;
+  qWarning() << "[Upload] failed upload_id=" << m_uploadId
+             << "offset=" << m_confirmedBytes << "total=" << m_totalBytes
+             << "http_code=" << httpCode << "error=" << error;
+  emit failed(error, httpCode);
+}
+
+void ChunkedUploadClient::complete(const QJsonObject &result) {
+  m_state = State::Completed;
+  m_confirmedBytes = m_totalBytes;
+  m_data.clear();
+  m_file.reset();
+  qInfo() << "[Upload] completed upload_id=" << m_uploadId
+          << "total=" << m_totalBytes;
+  emit finished(result);
+}
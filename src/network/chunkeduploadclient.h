@@ -0,0 +1,121 @@
+#ifndef CHUNKEDUPLOADCLIENT_H
+#define CHUNKEDUPLOADCLIENT_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QNetworkRequest>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QTimer>
+#include <QUrl>
+
+#include <memory>
+
+class QFile;
+class QNetworkAccessManager;
+class QNetworkReply;
+
+struct ChunkedUploadOptions {
+  qint64 chunkSize = 256 * 1024;
+  // Attempts per chunk after the first one; the counter resets whenever a
+  // chunk is accepted.
+  int maxRetries = 3;
+  // Doubled on every retry of the same chunk.
+  int retryDelayMs = 500;
+  int transferTimeoutMs = 20000;
+};
+
+// Uploads a byte array or a file in fixed-size chunks over the static
+// server's resumable upload endpoint:
+//
+//   POST {endpoint}              {"file_name", "content_type", "total_size",
+//                                 "metadata"} -> {"ok", "upload_id"}
+//   GET  {endpoint}/{upload_id}  -> {"ok", "offset", "completed"}
+//   PUT  {endpoint}/{upload_id}  Content-Range: bytes a-b/total
+//                                -> {"ok", "offset", "completed", ...}
+//
+// The response that completes the upload carries the server's result (e.g.
+// "avatar_url" or "file_url") and is passed to finished() as is. A failed
+// chunk is retried after asking the server how far it got, so a transfer
+// interrupted halfway through a chunk does not resend what already arrived.
+// After failed(), resume() continues the same upload from the server offset.
+class ChunkedUploadClient : public QObject {
+  Q_OBJECT
+
+public:
+  enum class State { Idle, Creating, Querying, Sending, Completed, Failed };
+
+  explicit ChunkedUploadClient(QObject *parent = nullptr);
+  ~ChunkedUploadClient() override;
+
+  void setOptions(const ChunkedUploadOptions &options);
+  // Sent as the Authorization header of every request.
+  void setAuthorization(const QString &headerValue);
+
+  bool startData(const QUrl &endpoint, const QByteArray &data,
+                 const QString &fileName, const QString &contentType,
+                 const QJsonObject &metadata = QJsonObject(),
+                 QString *error = nullptr);
+  bool startFile(const QUrl &endpoint, const QString &filePath,
+                 const QString &contentType,
+                 const QJsonObject &metadata = QJsonObject(),
+                 QString *error = nullptr);
+  bool resume(QString *error = nullptr);
+  // Stops without emitting failed(); resume() picks the upload up again.
+  void abort();
+
+  State state() const;
+  bool isActive() const;
+  QString uploadId() const;
+  qint64 confirmedBytes() const;
+  qint64 totalBytes() const;
+
+signals:
+  void started(const QString &uploadId);
+  void progress(qint64 sentBytes, qint64 totalBytes);
+  void finished(const QJsonObject &result);
+  void failed(const QString &error, int httpCode);
+
+private slots:
+  void onReplyFinished();
+  void onUploadProgress(qint64 bytesSent, qint64 bytesTotal);
+
+private:
+  bool begin(const QUrl &endpoint, const QString &fileName,
+             const QString &contentType, const QJsonObject &metadata,
+             QString *error);
+  void sendCreate();
+  void sendOffsetQuery();
+  void sendNextChunk();
+  QNetworkRequest buildRequest(const QUrl &url) const;
+  QUrl uploadUrl() const;
+  QByteArray readChunk(qint64 offset, qint64 length, QString *error);
+  void watchReply(QNetworkReply *reply);
+  bool acceptOffset(const QJsonObject &obj);
+  void retryOrFail(const QString &error, int httpCode);
+  void fail(const QString &error, int httpCode);
+  void complete(const QJsonObject &result);
+
+  ChunkedUploadOptions m_options;
+  QNetworkAccessManager *m_networkManager = nullptr;
+  QPointer<QNetworkReply> m_reply;
+  QTimer m_retryTimer;
+  QString m_authorization;
+
+  QUrl m_endpoint;
+  QString m_fileName;
+  QString m_contentType;
+  QJsonObject m_metadata;
+  QByteArray m_data;
+  std::unique_ptr<QFile> m_file;
+
+  State m_state = State::Idle;
+  QString m_uploadId;
+  qint64 m_totalBytes = 0;
+  qint64 m_confirmedBytes = 0;
+  qint64 m_sendingBytes = 0;
+  int m_attempt = 0;
+};
+
+#endif // CHUNKEDUPLOADCLIENT_H
@@ -0,0 +1,194 @@
+#include "envelopedispatcher.h"
+
+#include <QDebug>
+#include <QJsonValue>
+
+#include <iterator>
+
+EnvelopeDispatcher *EnvelopeDispatcher::instance() {
+  static EnvelopeDispatcher instance(websocketclient::instance());
+  return &instance;
+}
+
+EnvelopeDispatcher::EnvelopeDispatcher(websocketclient *client, QObject *parent)
+    : QObject(parent) {
+  if (!client) {
+    qWarning() << "[Dispatcher] init failed: websocket client is null";
+    return;
+  }
+  // Frames are parsed on the transport thread; only routing happens here.
+  connect(client, &websocketclient::envelopeReceived, this,
+          &EnvelopeDispatcher::dispatch);
+  connect(client, &websocketclient::envelopeParseFailed, this,
+          &EnvelopeDispatcher::envelopeParseFailed);
+}
+
+void EnvelopeDispatcher::subscribe(const QString &type, const QString &action,
+                                   QObject *receiver, Handler handler) {
+  if (!receiver || !handler || type.isEmpty()) {
+    return;
+  }
+  trackReceiver(receiver);
+
+  Route route;
+  route.receiverKey = receiver;
+  route.receiver = receiver;
+  route.handler = std::move(handler);
+
+  const protocol::EnvelopeType typeId = protocol::envelopeTypeFromString(type);
+  const protocol::EnvelopeAction actionId =
+      protocol::envelopeActionFromString(action);
+  if (typeId != protocol::EnvelopeType::Unknown &&
+      (action.isEmpty() || actionId != protocol::EnvelopeAction::Unknown)) {
+    m_routesByCode[routeCode(typeId, actionId)].push_back(std::move(route));
+    return;
+  }
+  m_routesByKey[routeKey(type, action)].push_back(std::move(route));
+}
+
+void EnvelopeDispatcher::unsubscribe(QObject *receiver) {
+  if (!receiver) {
+    return;
+  }
+  const auto it = m_trackedReceivers.find(receiver);
+  if (it != m_trackedReceivers.end()) {
+    disconnect(it.value());
+    m_trackedReceivers.erase(it);
+  }
+  removeReceiver(receiver);
+}
+
+void EnvelopeDispatcher::expectResponse(const QString &requestId,
+                                        QObject *receiver, Handler handler) {
+  const QString trimmedRequestId = requestId.trimmed();
+  if (trimmedRequestId.isEmpty() || !receiver || !handler) {
+    return;
+  }
+  trackReceiver(receiver);
+
+  Route route;
+  route.receiverKey = receiver;
+  route.receiver = receiver;
+  route.handler = std::move(handler);
+  m_responseRoutesByRequestId.insert(trimmedRequestId, std::move(route));
+}
+
+void EnvelopeDispatcher::cancelResponse(const QString &requestId) {
+  m_responseRoutesByRequestId.remove(requestId.trimmed());
+}
+
+void EnvelopeDispatcher::dispatch(const protocol::Envelope &envelope) {
+  if (!m_responseRoutesByRequestId.isEmpty()) {
+    const QString requestId = resolveResponseRequestId(envelope);
+    if (!requestId.isEmpty()) {
+      const Route route = m_responseRoutesByRequestId.take(requestId);
+      if (route.receiver && route.handler) {
+        route.handler(envelope);
+      }
+    }
+  }
+
+  if (envelope.typeId != protocol::EnvelopeType::Unknown) {
+    if (envelope.actionId != protocol::EnvelopeAction::Unknown) {
+      const auto it = m_routesByCode.constFind(
+          routeCode(envelope.typeId, envelope.actionId));
+      if (it != m_routesByCode.cend()) {
+        dispatchRoutes(it.value(), envelope);
+      }
+    }
+    const auto it = m_routesByCode.constFind(
+        routeCode(envelope.typeId, protocol::EnvelopeAction::Unknown));
+    if (it != m_routesByCode.cend()) {
+      dispatchRoutes(it.value(), envelope);
+    }
+  }
+
+  if (m_routesByKey.isEmpty()) {
+    return;
+  }
+  const bool knownType = envelope.typeId != protocol::EnvelopeType::Unknown;
+  if (!envelope.action.isEmpty() &&
+      (!knownType || envelope.actionId == protocol::EnvelopeAction::Unknown)) {
+    const auto it = m_routesByKey.constFind(routeKey(envelope.type, envelope.action));
+    if (it != m_routesByKey.cend()) {
+      dispatchRoutes(it.value(), envelope);
+    }
+  }
+  if (!knownType) {
+    const auto it = m_routesByKey.constFind(envelope.type);
+    if (it != m_routesByKey.cend()) {
+      dispatchRoutes(it.value(), envelope);
+    }
+  }
+}
+
+QString EnvelopeDispatcher::routeKey(const QString &type, const QString &action) {
+  return action.isEmpty() ? type : type + QLatin1Char('/') + action;
+}
+
+quint16 EnvelopeDispatcher::routeCode(protocol::EnvelopeType type,
+                                      protocol::EnvelopeAction action) {
+  return static_cast<quint16>((static_cast<quint16>(type) << 8) |
+                              static_cast<quint16>(action));
+}
+
+void EnvelopeDispatcher::trackReceiver(QObject *receiver) {
+  if (m_trackedReceivers.contains(receiver)) {
+    return;
+  }
+  const QMetaObject::Connection connection =
+      connect(receiver, &QObject::destroyed, this,
+              [this](QObject *obj) {
+                m_trackedReceivers.remove(obj);
+                removeReceiver(obj);
+              });
+  m_trackedReceivers.insert(receiver, connection);
+}
+
+void EnvelopeDispatcher::removeReceiver(const QObject *receiver) {
+  const auto isReceiver = [receiver](const Route &route) {
+    return route.receiverKey == receiver;
+  };
+  for (auto it = m_routesByCode.begin(); it != m_routesByCode.end();) {
+    it->removeIf(isReceiver);
+    it = it->isEmpty() ? m_routesByCode.erase(it) : std::next(it);
+  }
+  for (auto it = m_routesByKey.begin(); it != m_routesByKey.end();) {
+    it->removeIf(isReceiver);
+    it = it->isEmpty() ? m_routesByKey.erase(it) : std::next(it);
+  }
+  m_responseRoutesByRequestId.removeIf(
+      [receiver](const QHash<QString, Route>::iterator &it) {
+        return it->receiverKey == receiver;
+      });
+}
+
+QString EnvelopeDispatcher::resolveResponseRequestId(
+    const protocol::Envelope &envelope) const {
+  if (!envelope.requestId.isEmpty()) {
+    return envelope.requestId;
+  }
+
+  // Some error packets carry no request_id and echo the original request instead.
+  const QJsonValue receivedPayload =
+      envelope.data.value(QStringLiteral("received_payload"));
+  if (!receivedPayload.isString()) {
+    return QString();
+  }
+  protocol::Envelope originalRequest;
+  if (!protocol::parseEnvelope(receivedPayload.toString(), &originalRequest)) {
+    return QString();
+  }
+  return originalRequest.requestId;
+}
+
+// Takes the routes by value: handlers may (un)subscribe while running, so
+// they iterate over a snapshot.
+void EnvelopeDispatcher::dispatchRoutes(QVector<Route> routes,
+                                        const protocol::Envelope &envelope) {
+  for (const Route &route : std::as_const(routes)) {
+    if (route.receiver && route.handler) {
+      route.handler(envelope);
+    }
+  }
+}
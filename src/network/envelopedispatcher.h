@@ -0,0 +1,69 @@
+#ifndef ENVELOPEDISPATCHER_H
+#define ENVELOPEDISPATCHER_H
+
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+#include "protocol.h"
+#include "websocketclient.h"
+
+// Routes every envelope parsed by websocketclient by request_id and by
+// (type, action). Lookups are hash based, so the per-frame cost does not
+// depend on how many windows are subscribed. Known types and actions are
+// keyed by their enum values; only names the protocol does not list fall
+// back to string keys.
+class EnvelopeDispatcher : public QObject {
+  Q_OBJECT
+
+public:
+  using Handler = std::function<void(const protocol::Envelope &)>;
+
+  static EnvelopeDispatcher *instance();
+  explicit EnvelopeDispatcher(websocketclient *client, QObject *parent = nullptr);
+  ~EnvelopeDispatcher() override = default;
+
+  // An empty action subscribes to every action of the given type. Handlers are
+  // dropped automatically when the receiver is destroyed.
+  void subscribe(const QString &type, const QString &action, QObject *receiver,
+                 Handler handler);
+  void unsubscribe(QObject *receiver);
+
+  // One-shot route for the response of a request. Error packets without a
+  // request_id are matched through data.received_payload.
+  void expectResponse(const QString &requestId, QObject *receiver,
+                      Handler handler);
+  void cancelResponse(const QString &requestId);
+
+  void dispatch(const protocol::Envelope &envelope);
+
+signals:
+  void envelopeParseFailed(const QString &error);
+
+private:
+  struct Route {
+    const QObject *receiverKey = nullptr;
+    QPointer<QObject> receiver;
+    Handler handler;
+  };
+
+  static QString routeKey(const QString &type, const QString &action);
+  // Unknown as the action is the every-action route of the type.
+  static quint16 routeCode(protocol::EnvelopeType type,
+                           protocol::EnvelopeAction action);
+  void trackReceiver(QObject *receiver);
+  void removeReceiver(const QObject *receiver);
+  QString resolveResponseRequestId(const protocol::Envelope &envelope) const;
+  void dispatchRoutes(QVector<Route> routes, const protocol::Envelope &envelope);
+
+  QHash<quint16, QVector<Route>> m_routesByCode;
+  QHash<QString, QVector<Route>> m_routesByKey;
+  QHash<QString, Route> m_responseRoutesByRequestId;
+  QHash<const QObject *, QMetaObject::Connection> m_trackedReceivers;
+};
+
+#endif // ENVELOPEDISPATCHER_H
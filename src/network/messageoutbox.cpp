@@ -0,0 +1,364 @@
+#include "messageoutbox.h"
+
+#include "envelopedispatcher.h"
+#include "messagestore.h"
+#include "usersession.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+namespace {
+constexpr const char *kTypeMessage = "MESSAGE";
+constexpr const char *kActionSend = "SEND";
+// Short enough that a crash right after pressing send rarely loses the
+// message, long enough that a pasted burst becomes one write.
+constexpr int kDefaultFlushDelayMs = 100;
+// The journal is rewritten once it holds this many times more records than
+// there are pending entries.
+constexpr int kCompactRatio = 4;
+constexpr int kMinRecordsBeforeCompact = 64;
+
+QByteArray encodeEntry(const OutboxEntry &entry) {
+  QJsonObject obj;
+  obj.insert(QStringLiteral("request_id"), entry.requestId);
+  obj.insert(QStringLiteral("conversation_id"), entry.conversationId);
+  obj.insert(QStringLiteral("content"), entry.content);
+  obj.insert(QStringLiteral("created_at"), entry.createdAt);
+  return QJsonDocument(obj).toJson(QJsonDocument::Compact) + '\n';
+}
+
+QByteArray encodeSettled(const QString &requestId) {
+  QJsonObject obj;
+  obj.insert(QStringLiteral("request_id"), requestId);
+  obj.insert(QStringLiteral("settled"), true);
+  return QJsonDocument(obj).toJson(QJsonDocument::Compact) + '\n';
+}
+
+// MESSAGE/SEND errors that a replay would hit again: not a member or muted,
+// bad parameters, message too large, unknown conversation. Anything else,
+// such as not logged in or a server fault, may pass on a later session.
+bool isPermanentSendError(int code) {
+  switch (code) {
+  case 2005:
+  case 4001:
+  case 4002:
+  case 4005:
+    return true;
+  default:
+    return false;
+  }
+}
+} // namespace
+
+MessageOutbox *MessageOutbox::instance() {
+  static MessageOutbox instance(websocketclient::instance());
+  return &instance;
+}
+
+MessageOutbox::MessageOutbox(websocketclient *client, QObject *parent)
+    : QObject(parent), m_client(client) {
+  m_flushTimer.setSingleShot(true);
+  m_flushTimer.setInterval(kDefaultFlushDelayMs);
+  connect(&m_flushTimer, &QTimer::timeout, this, [this]() {
+    QString error;
+    if (!flush(&error)) {
+      qWarning() << "[Outbox] flush failed, error=" << error;
+    }
+  });
+  EnvelopeDispatcher::instance()->subscribe(
+      QString::fromLatin1(kTypeMessage), QString::fromLatin1(kActionSend), this,
+      [this](const protocol::Envelope &envelope) { onMessageEnvelope(envelope); });
+}
+
+MessageOutbox::~MessageOutbox() { flush(); }
+
+bool MessageOutbox::loadForUser(const QString &userId, QString *error) {
+  clear();
+  m_userId = userId.trimmed();
+  if (m_userId.isEmpty()) {
+    if (error) {
+      *error = QStringLiteral("user_id is required");
+    }
+    return false;
+  }
+
+  const QString path = storagePath();
+  QDir().mkpath(QFileInfo(path).absolutePath());
+  QFile file(path);
+  if (!file.exists()) {
+    return true;
+  }
+  if (!file.open(QIODevice::ReadOnly)) {
+    if (error) {
+      *error = file.errorString();
+    }
+    return false;
+  }
+
+  int skipped = 0;
+  while (!file.atEnd()) {
+    const QByteArray line = file.readLine().trimmed();
+    if (line.isEmpty()) {
+      continue;
+    }
+    ++m_journalRecords;
+    const QJsonObject obj = QJsonDocument::fromJson(line).object();
+    OutboxEntry entry;
+    entry.requestId = obj.value(QStringLiteral("request_id")).toString();
+    if (entry.requestId.isEmpty()) {
+      // A line cut short by a crash; later lines are still good.
+      ++skipped;
+      continue;
+    }
+    if (obj.value(QStringLiteral("settled")).toBool(false)) {
+      const auto keyIt = m_keyByRequestId.constFind(entry.requestId);
+      if (keyIt != m_keyByRequestId.cend()) {
+        m_entries.remove(keyIt.value());
+        m_keyByRequestId.erase(keyIt);
+      }
+      continue;
+    }
+    entry.conversationId = obj.value(QStringLiteral("conversation_id")).toString();
+    entry.content = obj.value(QStringLiteral("content")).toString();
+    entry.createdAt = obj.value(QStringLiteral("created_at")).toString();
+    if (entry.conversationId.isEmpty() || entry.content.isEmpty() ||
+        m_keyByRequestId.contains(entry.requestId)) {
+      continue;
+    }
+    m_keyByRequestId.insert(entry.requestId, m_nextKey);
+    m_entries.insert(m_nextKey++, entry);
+  }
+  file.close();
+  qInfo() << "[Outbox] loaded entries=" << m_entries.size() << "records="
+          << m_journalRecords << "skipped=" << skipped << "user_id=" << m_userId;
+
+  if (skipped > 0 || (m_journalRecords >= kMinRecordsBeforeCompact &&
+                      m_journalRecords > kCompactRatio * m_entries.size())) {
+    QString compactError;
+    if (!compact(&compactError)) {
+      // The journal still replays to the same entries; retried on next load.
+      qWarning() << "[Outbox] compact failed, error=" << compactError;
+    }
+  }
+  return true;
+}
+
+void MessageOutbox::clear() {
+  QString error;
+  if (!flush(&error)) {
+    qWarning() << "[Outbox] flush on clear failed, error=" << error;
+  }
+  m_flushTimer.stop();
+  m_entries.clear();
+  m_keyByRequestId.clear();
+  m_userId.clear();
+  m_pendingRecords.clear();
+  m_pendingRecordCount = 0;
+  m_journalRecords = 0;
+}
+
+void MessageOutbox::setFlushDelayMs(int ms) {
+  m_flushTimer.setInterval(std::max(0, ms));
+}
+
+bool MessageOutbox::flush(QString *error) {
+  m_flushTimer.stop();
+  if (m_userId.isEmpty() || m_pendingRecords.isEmpty()) {
+    return true;
+  }
+
+  QFile file(storagePath());
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Append) ||
+      file.write(m_pendingRecords) != m_pendingRecords.size()) {
+    if (error) {
+      *error = file.errorString();
+    }
+    // The records are kept; the next change retries.
+    return false;
+  }
+  file.close();
+  m_journalRecords += m_pendingRecordCount;
+  m_pendingRecords.clear();
+  m_pendingRecordCount = 0;
+
+  if (m_journalRecords >= kMinRecordsBeforeCompact &&
+      m_journalRecords > kCompactRatio * m_entries.size()) {
+    return compact(error);
+  }
+  return true;
+}
+
+bool MessageOutbox::submit(const OutboxEntry &entry, QString *error) {
+  if (entry.requestId.isEmpty() || entry.conversationId.isEmpty() ||
+      entry.content.isEmpty()) {
+    if (error) {
+      *error = QStringLiteral("request_id, conversation_id and content are required");
+    }
+    return false;
+  }
+  if (!m_client) {
+    if (error) {
+      *error = QStringLiteral("websocket client is null");
+    }
+    return false;
+  }
+  if (m_keyByRequestId.contains(entry.requestId)) {
+    if (error) {
+      *error = QStringLiteral("request_id is already pending");
+    }
+    return false;
+  }
+  if (!m_client->queueTextMessage(buildPayload(entry), entry.requestId)) {
+    if (error) {
+      *error = QStringLiteral("outbound queue is full");
+    }
+    return false;
+  }
+
+  m_keyByRequestId.insert(entry.requestId, m_nextKey);
+  m_entries.insert(m_nextKey++, entry);
+  appendRecord(encodeEntry(entry));
+  return true;
+}
+
+void MessageOutbox::replayPending() {
+  if (!m_client || m_entries.isEmpty()) {
+    return;
+  }
+  int replayed = 0;
+  for (const OutboxEntry &entry : std::as_const(m_entries)) {
+    if (!m_client->requeueTextMessage(buildPayload(entry), entry.requestId)) {
+      break;
+    }
+    ++replayed;
+  }
+  qInfo() << "[Outbox] replayed entries=" << replayed << "of" << m_entries.size();
+}
+
+bool MessageOutbox::contains(const QString &requestId) const {
+  return m_keyByRequestId.contains(requestId);
+}
+
+QVector<OutboxEntry>
+MessageOutbox::entriesForConversation(const QString &conversationId) const {
+  QVector<OutboxEntry> result;
+  for (const OutboxEntry &entry : m_entries) {
+    if (entry.conversationId == conversationId) {
+      result.push_back(entry);
+    }
+  }
+  return result;
+}
+
+int MessageOutbox::pendingCount() const {
+  return m_entries.size();
+}
+
+void MessageOutbox::onMessageEnvelope(const protocol::Envelope &envelope) {
+  const auto keyIt = m_keyByRequestId.constFind(envelope.requestId);
+  if (envelope.requestId.isEmpty() || keyIt == m_keyByRequestId.cend()) {
+    return;
+  }
+  if (m_client) {
+    m_client->forgetFrame(envelope.requestId);
+  }
+  const bool ok = envelope.code == 0 &&
+                  (envelope.hasOk ? envelope.ok
+                                  : envelope.data.value("ok").toBool(false));
+  // Only an ack or an error a replay would repeat settles the entry; other
+  // failures keep it for the next resume or login.
+  if (!ok && !isPermanentSendError(envelope.code)) {
+    qWarning() << "[Outbox] send failed, kept for replay, request_id="
+               << envelope.requestId << "code=" << envelope.code;
+    return;
+  }
+  const OutboxEntry entry = m_entries.take(keyIt.value());
+  m_keyByRequestId.erase(keyIt);
+  if (ok) {
+    // Acked messages go to local history even when no window shows them.
+    StoredMessage message;
+    message.conversationId =
+        envelope.data.value("conversation_id").toString().trimmed();
+    if (message.conversationId.isEmpty()) {
+      message.conversationId = entry.conversationId;
+    }
+    message.messageId =
+        envelope.data.value("message_id").toVariant().toString().trimmed();
+    message.seq = envelope.data.value("seq").toVariant().toLongLong();
+    message.content = envelope.data.value("content").toString();
+    if (message.content.isEmpty()) {
+      message.content = entry.content;
+    }
+    message.sentAt = envelope.data.value("sent_at").toString().trimmed();
+    if (message.sentAt.isEmpty()) {
+      message.sentAt = entry.createdAt;
+    }
+    message.senderUserId = UserSession::instance().userId().trimmed();
+    message.senderUsername = UserSession::instance().username().trimmed();
+    QString storeError;
+    if (message.seq > 0 && !message.messageId.isEmpty() &&
+        !MessageStore::instance()->append(message, &storeError)) {
+      qWarning() << "[Outbox] store acked message failed, request_id="
+                 << entry.requestId << "error=" << storeError;
+    }
+  }
+  appendRecord(encodeSettled(entry.requestId));
+  emit entryCompleted(envelope.requestId);
+}
+
+QString MessageOutbox::buildPayload(const OutboxEntry &entry) const {
+  QJsonObject data;
+  data.insert(QStringLiteral("conversation_id"), entry.conversationId);
+  data.insert(QStringLiteral("content"), entry.content);
+  return protocol::createRequest(QString::fromLatin1(kTypeMessage),
+                                 QString::fromLatin1(kActionSend), data,
+                                 entry.requestId);
+}
+
+QString MessageOutbox::storagePath() const {
+  const QString dir =
+      QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+      QStringLiteral("/outbox");
+  return dir + QStringLiteral("/%1.journal").arg(m_userId);
+}
+
+void MessageOutbox::appendRecord(const QByteArray &record) {
+  if (m_userId.isEmpty()) {
+    return;
+  }
+  m_pendingRecords += record;
+  ++m_pendingRecordCount;
+  // A burst of sends and acks becomes one append.
+  if (!m_flushTimer.isActive()) {
+    m_flushTimer.start();
+  }
+}
+
+bool MessageOutbox::compact(QString *error) {
+  QSaveFile file(storagePath());
+  if (!file.open(QIODevice::WriteOnly)) {
+    if (error) {
+      *error = file.errorString();
+    }
+    return false;
+  }
+  for (const OutboxEntry &entry : std::as_const(m_entries)) {
+    file.write(encodeEntry(entry));
+  }
+  if (!file.commit()) {
+    if (error) {
+      *error = file.errorString();
+    }
+    return false;
+  }
+  m_journalRecords = m_entries.size();
+  return true;
+}
@@ -0,0 +1,75 @@
+#ifndef MESSAGEOUTBOX_H
+#define MESSAGEOUTBOX_H
+
+#include <QHash>
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+#include "protocol.h"
+#include "websocketclient.h"
+
+struct OutboxEntry {
+  QString requestId;
+  QString conversationId;
+  QString content;
+  QString createdAt;
+};
+
+// Chat messages that have not been acknowledged yet. Submissions and settled
+// entries are appended to a per-user journal under AppDataLocation/outbox/ in
+// short batches, so unsent messages survive a restart and are replayed on the
+// next login; the journal is rewritten once it holds mostly settled records.
+// Frames go through websocketclient's outbound queue and therefore wait out
+// disconnects and write-buffer backpressure; frames written before a drop are
+// replayed once the session is resumed.
+class MessageOutbox : public QObject {
+  Q_OBJECT
+
+public:
+  static MessageOutbox *instance();
+  explicit MessageOutbox(websocketclient *client, QObject *parent = nullptr);
+  ~MessageOutbox() override;
+
+  bool loadForUser(const QString &userId, QString *error = nullptr);
+  // Writes pending records, then forgets the loaded entries; the user's
+  // journal stays for the next login.
+  void clear();
+  bool flush(QString *error = nullptr);
+  void setFlushDelayMs(int ms);
+
+  bool submit(const OutboxEntry &entry, QString *error = nullptr);
+  // Sends every unacknowledged entry again, except those still in the
+  // outbound queue or already written on the current connection.
+  void replayPending();
+  bool contains(const QString &requestId) const;
+  QVector<OutboxEntry> entriesForConversation(const QString &conversationId) const;
+  int pendingCount() const;
+
+signals:
+  void entryCompleted(const QString &requestId);
+
+private:
+  void onMessageEnvelope(const protocol::Envelope &envelope);
+  QString buildPayload(const OutboxEntry &entry) const;
+  QString storagePath() const;
+  void appendRecord(const QByteArray &record);
+  bool compact(QString *error);
+
+  websocketclient *m_client = nullptr;
+  QString m_userId;
+  // Journal lines not written yet, and the number of lines already on disk.
+  QByteArray m_pendingRecords;
+  int m_pendingRecordCount = 0;
+  int m_journalRecords = 0;
+  QTimer m_flushTimer;
+  // Entries in submit order, keyed by a running number, and that number by
+  // request_id so acks find their entry without a scan.
+  QMap<quint64, OutboxEntry> m_entries;
+  QHash<QString, quint64> m_keyByRequestId;
+  quint64 m_nextKey = 0;
+};
+
+#endif // MESSAGEOUTBOX_H
@@ -1,5 +1,9 @@
 #include "profileapiclient.h"
 
+#include "envelopedispatcher.h"
+#include "requesttimeoutwheel.h"
+#include "stringpool.h"
+
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
@@ -22,6 +26,13 @@ constexpr const char *kActionListConversations = "LIST_CONVERSATIONS";
 constexpr const char *kActionCreateGroup = "CREATE_GROUP";
 constexpr const char *kActionJoinGroup = "JOIN_GROUP";
 constexpr const char *kActionListGroups = "LIST_GROUPS";
+constexpr const char *kActionBatchGet = "BATCH_GET";
+constexpr const char *kTypeMessage = "MESSAGE";
+constexpr const char *kActionPresence = "PRESENCE";
+
+QString profileCacheKey(const char *action, const QString &id) {
+  return QString::fromLatin1(action) + QLatin1Char(':') + id;
+}
 
 QString normalizeTheme(const QString &theme) {
   const QString trimmed = theme.trimmed();
@@ -39,6 +50,20 @@ QString jsonValueToString(const QJsonValue &value) {
   return QString();
 }
 
+QString internedString(const QString &value) {
+  return StringPool::instance()->intern(value);
+}
+
+QStringList jsonStringList(const QJsonValue &value) {
+  QStringList out;
+  const QJsonArray array = value.toArray();
+  out.reserve(array.size());
+  for (const QJsonValue &item : array) {
+    out.push_back(item.toString());
+  }
+  return out;
+}
+
 QString readGroupNumericId(const QJsonObject &obj) {
   const QString groupNumericId = jsonValueToString(obj.value("group_numeric_id"));
   if (!groupNumericId.isEmpty()) {
@@ -153,21 +178,69 @@ bool isUnsignedIntegerString(const QString &value) {
 }
 }
 
+// Indexed by Action; keep in the same order as the enum.
+const ProfileApiClient::ActionSpec
+    ProfileApiClient::kActionTable[ProfileApiClient::kActionCount] = {
+        {kActionGetInfo, protocol::EnvelopeAction::GetInfo,
+         &ProfileApiClient::handleGetInfo, false},
+        {kActionSetInfo, protocol::EnvelopeAction::SetInfo,
+         &ProfileApiClient::handleSetInfo, false},
+        {kActionGet, protocol::EnvelopeAction::Get, &ProfileApiClient::handleGet,
+         true},
+        {kActionAddFriend, protocol::EnvelopeAction::AddFriend,
+         &ProfileApiClient::handleAddFriend, false},
+        {kActionDeleteFriend, protocol::EnvelopeAction::DeleteFriend,
+         &ProfileApiClient::handleDeleteFriend, false},
+        {kActionListFriends, protocol::EnvelopeAction::ListFriends,
+         &ProfileApiClient::handleListFriends, true},
+        {kActionListConversations, protocol::EnvelopeAction::ListConversations,
+         &ProfileApiClient::handleListConversations, true},
+        {kActionCreateGroup, protocol::EnvelopeAction::CreateGroup,
+         &ProfileApiClient::handleCreateGroup, false},
+        {kActionJoinGroup, protocol::EnvelopeAction::JoinGroup,
+         &ProfileApiClient::handleJoinGroup, false},
+        {kActionListGroups, protocol::EnvelopeAction::ListGroups,
+         &ProfileApiClient::handleListGroups, false},
+        {kActionBatchGet, protocol::EnvelopeAction::BatchGet,
+         &ProfileApiClient::handleBatchGet, false},
+};
+
+QString ProfileApiClient::actionName(Action action) {
+  const int index = static_cast<int>(action);
+  if (index < 0 || index >= kActionCount) {
+    return QString();
+  }
+  return QString::fromLatin1(kActionTable[index].name);
+}
+
+QStringList ProfileApiClient::requestIdsFor(const QString &requestId,
+                                            const PendingRequest &pending) {
+  QStringList requestIds;
+  requestIds.reserve(1 + pending.coalescedRequestIds.size());
+  requestIds.append(requestId);
+  requestIds.append(pending.coalescedRequestIds);
+  return requestIds;
+}
+
 ProfileApiClient::ProfileApiClient(websocketclient *client, QObject *parent)
-    : QObject(parent), m_client(client) {
+    : QObject(parent), m_client(client), m_profileCache(kProfileCacheCapacity) {
   qRegisterMetaType<ProfileInfo>("ProfileInfo");
   qRegisterMetaType<AddFriendResult>("AddFriendResult");
   qRegisterMetaType<DeleteFriendRequest>("DeleteFriendRequest");
   qRegisterMetaType<DeleteFriendResult>("DeleteFriendResult");
-  qRegisterMetaType<FriendItem>("FriendItem");
-  qRegisterMetaType<QVector<FriendItem>>("QVector<FriendItem>");
-  qRegisterMetaType<ConversationItem>("ConversationItem");
-  qRegisterMetaType<QVector<ConversationItem>>("QVector<ConversationItem>");
+  qRegisterMetaType<friendlist::FriendRecord>("friendlist::FriendRecord");
+  qRegisterMetaType<QVector<friendlist::FriendRecord>>(
+      "QVector<friendlist::FriendRecord>");
+  qRegisterMetaType<conversationlist::ConversationRecord>(
+      "conversationlist::ConversationRecord");
+  qRegisterMetaType<QVector<conversationlist::ConversationRecord>>(
+      "QVector<conversationlist::ConversationRecord>");
   qRegisterMetaType<CreateGroupResult>("CreateGroupResult");
   qRegisterMetaType<JoinGroupResult>("JoinGroupResult");
   qRegisterMetaType<GroupSearchItem>("GroupSearchItem");
   qRegisterMetaType<QVector<GroupSearchItem>>("QVector<GroupSearchItem>");
   qRegisterMetaType<QJsonObject>("QJsonObject");
+  m_profileCacheClock.start();
 
   Q_ASSERT_X(thread() == QThread::currentThread(), "ProfileApiClient",
              "ProfileApiClient should run in the main event thread");
@@ -177,15 +250,21 @@ ProfileApiClient::ProfileApiClient(websocketclient *client, QObject *parent)
     return;
   }
 
-  connect(m_client, &websocketclient::textMessageReceived, this,
-          &ProfileApiClient::onTextMessageReceived);
+  EnvelopeDispatcher::instance()->subscribe(
+      QString::fromLatin1(kTypeProfile), QString(), this,
+      [this](const protocol::Envelope &envelope) { onEnvelopeReceived(envelope); });
+  EnvelopeDispatcher::instance()->subscribe(
+      QString::fromLatin1(kTypeMessage), QString::fromLatin1(kActionPresence),
+      this, [this](const protocol::Envelope &envelope) {
+        onPresenceEnvelope(envelope);
+      });
   connect(m_client, &websocketclient::disconnected, this,
           &ProfileApiClient::onDisconnected);
 }
 
 QString ProfileApiClient::requestProfileInfo(const QString &userId) {
   const QString requestId = generateRequestId();
-  const QString action = QString::fromLatin1(kActionGetInfo);
+  const Action action = Action::GetInfo;
 
   QString error;
   if (!validateGetInfo(userId, &error)) {
@@ -193,9 +272,17 @@ QString ProfileApiClient::requestProfileInfo(const QString &userId) {
     return requestId;
   }
 
+  ProfileInfo cached;
+  if (lookupCachedProfile(kActionGetInfo, userId.trimmed(), &cached)) {
+    QMetaObject::invokeMethod(
+        this, [this, requestId, cached]() { emit profileInfoReceived(requestId, cached); },
+        Qt::QueuedConnection);
+    return requestId;
+  }
+
   QJsonObject data;
   data.insert("user_id", userId.trimmed());
-  sendProfileRequest(action, requestId, data, 0, false);
+  sendProfileRequest(action, requestId, std::move(data), 0, false);
   return requestId;
 }
 
@@ -205,7 +292,7 @@ QString ProfileApiClient::setProfileInfo(const QString &userId,
                                          const QString &signature,
                                          const QString &theme) {
   const QString requestId = generateRequestId();
-  const QString action = QString::fromLatin1(kActionSetInfo);
+  const Action action = Action::SetInfo;
 
   QString error;
   if (!validateSetInfo(userId, avatarUrl, nickname, signature, theme, &error)) {
@@ -219,13 +306,13 @@ QString ProfileApiClient::setProfileInfo(const QString &userId,
   data.insert("nickname", nickname.trimmed());
   data.insert("signature", signature.trimmed());
   data.insert("theme", normalizeTheme(theme));
-  sendProfileRequest(action, requestId, data, 0, false);
+  sendProfileRequest(action, requestId, std::move(data), 0, false);
   return requestId;
 }
 
 QString ProfileApiClient::queryUserProfile(const QString &numericId) {
   const QString requestId = generateRequestId();
-  const QString action = QString::fromLatin1(kActionGet);
+  const Action action = Action::Get;
 
   QString error;
   if (!validateQueryUserProfile(numericId, &error)) {
@@ -233,17 +320,96 @@ QString ProfileApiClient::queryUserProfile(const QString &numericId) {
     return requestId;
   }
 
+  ProfileInfo cached;
+  if (lookupCachedProfile(kActionGet, numericId.trimmed(), &cached)) {
+    QMetaObject::invokeMethod(
+        this, [this, requestId, cached]() { emit userProfileQueried(requestId, cached); },
+        Qt::QueuedConnection);
+    return requestId;
+  }
+
   QJsonObject data;
   data.insert("numeric_id", numericId.trimmed());
-  sendProfileRequest(action, requestId, data, kMaxRetryCount, true);
+  sendProfileRequest(action, requestId, std::move(data), kMaxRetryCount, true);
   return requestId;
 }
 
+QString ProfileApiClient::queryUserProfiles(const QStringList &numericIds) {
+  const QString batchId = generateRequestId();
+  const Action action = Action::BatchGet;
+
+  QString error;
+  if (!validateQueryUserProfiles(numericIds, &error)) {
+    // Reported after return like every other batch outcome, so the caller
+    // already holds batchId when the failure and the finish arrive.
+    QStringList unresolved;
+    for (const QString &numericId : numericIds) {
+      const QString id = numericId.trimmed();
+      if (!id.isEmpty() && !unresolved.contains(id)) {
+        unresolved.push_back(id);
+      }
+    }
+    QMetaObject::invokeMethod(
+        this,
+        [this, batchId, action, error, unresolved]() {
+          failRequest(batchId, action, error, 3003);
+          emit userProfileBatchFinished(batchId, unresolved);
+        },
+        Qt::QueuedConnection);
+    return batchId;
+  }
+
+  // Cache hits are answered locally; the remaining ids go to the server.
+  QVector<ProfileInfo> cachedProfiles;
+  QStringList remaining;
+  QSet<QString> seen;
+  for (const QString &numericId : numericIds) {
+    const QString id = numericId.trimmed();
+    if (seen.contains(id)) {
+      continue;
+    }
+    seen.insert(id);
+    ProfileInfo cached;
+    if (lookupCachedProfile(kActionGet, id, &cached)) {
+      cachedProfiles.push_back(cached);
+    } else {
+      remaining.push_back(id);
+    }
+  }
+
+  // The local share counts as one outstanding request, so the batch cannot
+  // finish before the caller has seen its batch id.
+  m_profileBatches[batchId].outstandingRequests = 1;
+  QMetaObject::invokeMethod(
+      this,
+      [this, batchId, cachedProfiles]() {
+        for (const ProfileInfo &info : cachedProfiles) {
+          emit userProfileBatchItem(batchId, info);
+        }
+        finishProfileBatchRequest(batchId, QStringList());
+      },
+      Qt::QueuedConnection);
+
+  for (int offset = 0; offset < remaining.size(); offset += kProfileBatchMaxIds) {
+    QJsonObject data;
+    data.insert("numeric_ids",
+                QJsonArray::fromStringList(remaining.mid(offset, kProfileBatchMaxIds)));
+    m_profileBatches[batchId].outstandingRequests += 1;
+    sendProfileRequest(action, generateRequestId(), std::move(data),
+                       kMaxRetryCount, true, batchId);
+  }
+  qInfo().noquote() << "[PROFILE] batch_id=" << batchId
+                    << "requested=" << seen.size()
+                    << "cached=" << cachedProfiles.size()
+                    << "requests=" << (m_profileBatches.value(batchId).outstandingRequests - 1);
+  return batchId;
+}
+
 QString ProfileApiClient::addFriend(const QString &userNumericId,
                                     const QString &friendNumericId,
                                     const QString &remark) {
   const QString requestId = generateRequestId();
-  const QString action = QString::fromLatin1(kActionAddFriend);
+  const Action action = Action::AddFriend;
 
   QString error;
   if (!validateAddFriend(userNumericId, friendNumericId, remark, &error)) {
@@ -257,14 +423,14 @@ QString ProfileApiClient::addFriend(const QString &userNumericId,
   if (!remark.trimmed().isEmpty()) {
     data.insert("remark", remark.trimmed());
   }
-  sendProfileRequest(action, requestId, data, 0, false);
+  sendProfileRequest(action, requestId, std::move(data), 0, false);
   return requestId;
 }
 
 QString ProfileApiClient::deleteFriend(const QString &userNumericId,
                                        const QString &friendNumericId) {
   const QString requestId = generateRequestId();
-  const QString action = QString::fromLatin1(kActionDeleteFriend);
+  const Action action = Action::DeleteFriend;
 
   QString error;
   if (!validateDeleteFriend(userNumericId, friendNumericId, &error)) {
@@ -275,13 +441,13 @@ QString ProfileApiClient::deleteFriend(const QString &userNumericId,
   QJsonObject data;
   data.insert("user_numeric_id", userNumericId.trimmed());
   data.insert("friend_numeric_id", friendNumericId.trimmed());
-  sendProfileRequest(action, requestId, data, 0, false);
+  sendProfileRequest(action, requestId, std::move(data), 0, false);
   return requestId;
 }
 
 QString ProfileApiClient::fetchFriendList(const QString &myNumericId) {
   const QString requestId = generateRequestId();
-  const QString action = QString::fromLatin1(kActionListFriends);
+  const Action action = Action::ListFriends;
 
   QString error;
   if (!validateFetchFriendList(myNumericId, &error)) {
@@ -291,13 +457,14 @@ QString ProfileApiClient::fetchFriendList(const QString &myNumericId) {
 
   QJsonObject data;
   data.insert("numeric_id", myNumericId.trimmed());
-  sendProfileRequest(action, requestId, data, kMaxRetryCount, true);
+  sendProfileRequest(action, requestId, std::move(data), kMaxRetryCount, true);
   return requestId;
 }
 
-QString ProfileApiClient::fetchConversationList(const QString &myNumericId) {
+QString ProfileApiClient::fetchConversationList(const QString &myNumericId,
+                                                const QString &sinceCursor) {
   const QString requestId = generateRequestId();
-  const QString action = QString::fromLatin1(kActionListConversations);
+  const Action action = Action::ListConversations;
 
   QString error;
   if (!validateFetchConversationList(myNumericId, &error)) {
@@ -307,14 +474,17 @@ QString ProfileApiClient::fetchConversationList(const QString &myNumericId) {
 
   QJsonObject data;
   data.insert("numeric_id", myNumericId.trimmed());
-  sendProfileRequest(action, requestId, data, kMaxRetryCount, true);
+  if (!sinceCursor.trimmed().isEmpty()) {
+    data.insert("since_cursor", sinceCursor.trimmed());
+  }
+  sendProfileRequest(action, requestId, std::move(data), kMaxRetryCount, true);
   return requestId;
 }
 
 QString ProfileApiClient::createGroup(const QString &name,
                                       const QStringList &memberNumericIds) {
   const QString requestId = generateRequestId();
-  const QString action = QString::fromLatin1(kActionCreateGroup);
+  const Action action = Action::CreateGroup;
 
   QString error;
   if (!validateCreateGroup(name, memberNumericIds, &error)) {
@@ -330,14 +500,14 @@ QString ProfileApiClient::createGroup(const QString &name,
   QJsonObject data;
   data.insert("name", name.trimmed());
   data.insert("member_numeric_ids", memberArray);
-  sendProfileRequest(action, requestId, data, 0, false);
+  sendProfileRequest(action, requestId, std::move(data), 0, false);
   return requestId;
 }
 
 QString ProfileApiClient::joinGroup(const QString &groupNumericId,
                                     const QString &conversationId) {
   const QString requestId = generateRequestId();
-  const QString action = QString::fromLatin1(kActionJoinGroup);
+  const Action action = Action::JoinGroup;
 
   QString error;
   if (!validateJoinGroup(groupNumericId, conversationId, &error)) {
@@ -353,14 +523,14 @@ QString ProfileApiClient::joinGroup(const QString &groupNumericId,
   } else if (!trimmedConversationId.isEmpty()) {
     data.insert("conversation_id", trimmedConversationId);
   }
-  sendProfileRequest(action, requestId, data, 0, false);
+  sendProfileRequest(action, requestId, std::move(data), 0, false);
   return requestId;
 }
 
 QString ProfileApiClient::listGroups(const QString &keyword,
                                      const QString &groupNumericId) {
   const QString requestId = generateRequestId();
-  const QString action = QString::fromLatin1(kActionListGroups);
+  const Action action = Action::ListGroups;
 
   QString error;
   if (!validateListGroups(keyword, groupNumericId, &error)) {
@@ -377,23 +547,25 @@ QString ProfileApiClient::listGroups(const QString &keyword,
   if (!trimmedGroupNumericId.isEmpty()) {
     data.insert("group_numeric_id", trimmedGroupNumericId);
   }
-  sendProfileRequest(action, requestId, data, 0, false);
+  sendProfileRequest(action, requestId, std::move(data), 0, false);
   return requestId;
 }
 
-void ProfileApiClient::onTextMessageReceived(const QString &message) {
-  protocol::Envelope envelope;
-  QString parseError;
-  if (!protocol::parseEnvelope(message, &envelope, &parseError)) {
-    return;
-  }
-
-  if (envelope.type != QLatin1String(kTypeProfile)) {
+void ProfileApiClient::onEnvelopeReceived(const protocol::Envelope &envelope) {
+  if (envelope.typeId != protocol::EnvelopeType::Profile) {
     return;
   }
 
   const QString requestId = envelope.requestId;
   if (requestId.isEmpty()) {
+    // Server-initiated profile pushes carry no request_id; they only make
+    // cached copies of that user stale.
+    const QString userId = jsonValueToString(envelope.data.value("user_id"));
+    const QString numericId = jsonValueToString(envelope.data.value("numeric_id"));
+    if (!userId.isEmpty() || !numericId.isEmpty()) {
+      invalidateCachedProfile(userId, numericId);
+      return;
+    }
     qWarning() << "[PROFILE] drop response: missing request_id";
     return;
   }
@@ -403,13 +575,11 @@ void ProfileApiClient::onTextMessageReceived(const QString &message) {
     return;
   }
 
-  const PendingRequest pending = m_pendingRequests.value(requestId);
-  clearPendingRequest(requestId);
+  const PendingRequest pending = takePendingRequest(requestId);
 
-  const QString responseAction = envelope.action;
-  const QString expectedAction = pending.action;
-  if (!responseAction.isEmpty() && responseAction != expectedAction) {
-    failRequest(requestId, expectedAction,
+  const ActionSpec &spec = kActionTable[static_cast<int>(pending.action)];
+  if (!envelope.action.isEmpty() && envelope.actionId != spec.envelopeAction) {
+    failRequest(requestId, pending,
                 QStringLiteral("response action mismatch"));
     return;
   }
@@ -422,145 +592,368 @@ void ProfileApiClient::onTextMessageReceived(const QString &message) {
           ? envelope.data.value("message").toString().trimmed()
           : envelope.message.trimmed();
 
-  qInfo().noquote() << "[PROFILE] action=" << expectedAction
+  qInfo().noquote() << "[PROFILE] action=" << spec.name
                     << "request_id=" << requestId << "code=" << code
                     << "message=" << msg;
 
   if (!(code == 0 && ok)) {
     const QString error =
         msg.isEmpty() ? QStringLiteral("request failed, code=%1").arg(code) : msg;
-    failRequest(requestId, expectedAction, error, code);
+    failRequest(requestId, pending, error, code);
     return;
   }
 
-  if (expectedAction == QLatin1String(kActionGetInfo)) {
-    ProfileInfo info;
-    QString error;
-    if (!parseProfileInfo(envelope.data, &info, false, &error)) {
-      failRequest(requestId, expectedAction, error);
-      return;
-    }
-    emit profileInfoReceived(requestId, info);
+  (this->*spec.handler)(requestId, pending, envelope, msg);
+}
+
+void ProfileApiClient::handleGetInfo(const QString &requestId,
+                                     const PendingRequest &pending,
+                                     const protocol::Envelope &envelope,
+                                     const QString &) {
+  ProfileInfo info;
+  QString error;
+  if (!parseProfileInfo(envelope.data, &info, false, &error)) {
+    failRequest(requestId, pending, error);
     return;
   }
+  cacheProfile(kActionGetInfo, pending.data.value("user_id").toString(), info);
+  emit profileInfoReceived(requestId, info);
+}
 
-  if (expectedAction == QLatin1String(kActionSetInfo)) {
-    ProfileInfo info;
-    QString error;
-    if (!parseProfileInfo(envelope.data, &info, false, &error)) {
-      failRequest(requestId, expectedAction, error);
-      return;
-    }
-    emit profileInfoSetSuccess(requestId, info);
+void ProfileApiClient::handleSetInfo(const QString &requestId,
+                                     const PendingRequest &pending,
+                                     const protocol::Envelope &envelope,
+                                     const QString &) {
+  ProfileInfo info;
+  QString error;
+  if (!parseProfileInfo(envelope.data, &info, false, &error)) {
+    failRequest(requestId, pending, error);
     return;
   }
+  invalidateCachedProfile(pending.data.value("user_id").toString(), info.numericId);
+  emit profileInfoSetSuccess(requestId, info);
+}
 
-  if (expectedAction == QLatin1String(kActionGet)) {
-    ProfileInfo info;
-    QString error;
-    if (!parseProfileInfo(envelope.data, &info, true, &error)) {
-      failRequest(requestId, expectedAction, error);
-      return;
-    }
-    emit userProfileQueried(requestId, info);
+void ProfileApiClient::handleGet(const QString &requestId,
+                                 const PendingRequest &pending,
+                                 const protocol::Envelope &envelope,
+                                 const QString &) {
+  ProfileInfo info;
+  QString error;
+  if (!parseProfileInfo(envelope.data, &info, true, &error)) {
+    failRequest(requestId, pending, error);
     return;
   }
+  cacheProfile(kActionGet, pending.data.value("numeric_id").toString(), info);
+  for (const QString &id : requestIdsFor(requestId, pending)) {
+    emit userProfileQueried(id, info);
+  }
+}
 
-  if (expectedAction == QLatin1String(kActionAddFriend)) {
-    AddFriendResult result;
-    QString error;
-    if (!parseAddFriendResult(envelope.data, &result, &error)) {
-      failRequest(requestId, expectedAction, error);
-      return;
-    }
-    emit addFriendSuccess(requestId, result);
+void ProfileApiClient::handleAddFriend(const QString &requestId,
+                                       const PendingRequest &pending,
+                                       const protocol::Envelope &envelope,
+                                       const QString &) {
+  AddFriendResult result;
+  QString error;
+  if (!parseAddFriendResult(envelope.data, &result, &error)) {
+    failRequest(requestId, pending, error);
     return;
   }
+  emit addFriendSuccess(requestId, result);
+}
 
-  if (expectedAction == QLatin1String(kActionDeleteFriend)) {
-    DeleteFriendResult result;
-    QString error;
-    if (!parseDeleteFriendResult(envelope.data, requestId, code, &result, &error)) {
-      failRequest(requestId, expectedAction, error, code);
-      return;
-    }
-    emit deleteFriendFinished(requestId, result);
+void ProfileApiClient::handleDeleteFriend(const QString &requestId,
+                                          const PendingRequest &pending,
+                                          const protocol::Envelope &envelope,
+                                          const QString &) {
+  const int code = envelope.hasCode ? envelope.code : 0;
+  DeleteFriendResult result;
+  QString error;
+  if (!parseDeleteFriendResult(envelope.data, requestId, code, &result, &error)) {
+    failRequest(requestId, pending, error, code);
     return;
   }
+  emit deleteFriendFinished(requestId, result);
+}
 
-  if (expectedAction == QLatin1String(kActionListFriends)) {
-    emit friendListPayloadReceived(requestId, envelope.data);
-    QVector<FriendItem> friends;
-    QString error;
-    if (!parseFriendList(envelope.data, &friends, &error)) {
-      failRequest(requestId, expectedAction, error, 3003);
-      return;
-    }
-    emit friendListFetched(requestId, friends);
+void ProfileApiClient::handleListFriends(const QString &requestId,
+                                         const PendingRequest &pending,
+                                         const protocol::Envelope &envelope,
+                                         const QString &) {
+  const QStringList requestIds = requestIdsFor(requestId, pending);
+  for (const QString &id : requestIds) {
+    emit friendListPayloadReceived(id, envelope.data);
+  }
+  QVector<friendlist::FriendRecord> friends;
+  QString error;
+  if (!parseFriendList(envelope.data, &friends, &error)) {
+    failRequest(requestId, pending, error, 3003);
     return;
   }
+  for (const QString &id : requestIds) {
+    emit friendListFetched(id, friends);
+  }
+}
 
-  if (expectedAction == QLatin1String(kActionListConversations)) {
-    emit conversationListPayloadReceived(requestId, envelope.data);
-    QVector<ConversationItem> conversations;
-    QString error;
-    if (!parseConversationList(envelope.data, &conversations, &error)) {
-      failRequest(requestId, expectedAction, error, 3003);
-      return;
-    }
-    emit conversationListFetched(requestId, conversations);
+void ProfileApiClient::handleListConversations(const QString &requestId,
+                                               const PendingRequest &pending,
+                                               const protocol::Envelope &envelope,
+                                               const QString &) {
+  const QStringList requestIds = requestIdsFor(requestId, pending);
+  for (const QString &id : requestIds) {
+    emit conversationListPayloadReceived(id, envelope.data);
+  }
+  QVector<conversationlist::ConversationRecord> conversations;
+  QString error;
+  if (!parseConversationList(envelope.data, &conversations, &error)) {
+    failRequest(requestId, pending, error, 3003);
+    return;
+  }
+  for (const QString &id : requestIds) {
+    emit conversationListFetched(id, conversations);
+  }
+}
+
+void ProfileApiClient::handleCreateGroup(const QString &requestId,
+                                         const PendingRequest &pending,
+                                         const protocol::Envelope &envelope,
+                                         const QString &) {
+  CreateGroupResult result;
+  QString error;
+  if (!parseCreateGroupResult(envelope.data, &result, &error)) {
+    failRequest(requestId, pending, error, 3003);
     return;
   }
+  emit createGroupSucceeded(requestId, result);
+}
 
-  if (expectedAction == QLatin1String(kActionCreateGroup)) {
-    CreateGroupResult result;
-    QString error;
-    if (!parseCreateGroupResult(envelope.data, &result, &error)) {
-      failRequest(requestId, expectedAction, error, 3003);
-      return;
-    }
-    emit createGroupSucceeded(requestId, result);
+void ProfileApiClient::handleJoinGroup(const QString &requestId,
+                                       const PendingRequest &pending,
+                                       const protocol::Envelope &envelope,
+                                       const QString &message) {
+  JoinGroupResult result;
+  QString error;
+  if (!parseJoinGroupResult(envelope.data, &result, &error)) {
+    failRequest(requestId, pending, error, 3003);
     return;
   }
+  result.ok = true;
+  result.message = message;
+  emit joinGroupSucceeded(requestId, result);
+}
 
-  if (expectedAction == QLatin1String(kActionJoinGroup)) {
-    JoinGroupResult result;
-    QString error;
-    if (!parseJoinGroupResult(envelope.data, &result, &error)) {
-      failRequest(requestId, expectedAction, error, 3003);
-      return;
-    }
-    result.ok = true;
-    result.message = msg;
-    emit joinGroupSucceeded(requestId, result);
+void ProfileApiClient::handleListGroups(const QString &requestId,
+                                        const PendingRequest &pending,
+                                        const protocol::Envelope &envelope,
+                                        const QString &) {
+  QVector<GroupSearchItem> groups;
+  QString error;
+  if (!parseGroupSearchList(envelope.data, &groups, &error)) {
+    failRequest(requestId, pending, error, 3003);
     return;
   }
+  emit groupsListed(requestId, groups);
+}
 
-  if (expectedAction == QLatin1String(kActionListGroups)) {
-    QVector<GroupSearchItem> groups;
+void ProfileApiClient::handleBatchGet(const QString &requestId,
+                                      const PendingRequest &pending,
+                                      const protocol::Envelope &envelope,
+                                      const QString &) {
+  const QJsonArray requested = pending.data.value("numeric_ids").toArray();
+  QSet<QString> unresolved;
+  for (const QJsonValue &value : requested) {
+    unresolved.insert(value.toString());
+  }
+
+  const QJsonArray profiles = envelope.data.value("profiles").toArray();
+  for (const QJsonValue &value : profiles) {
+    QJsonObject wrapper;
+    wrapper.insert("profile", value);
+    ProfileInfo info;
     QString error;
-    if (!parseGroupSearchList(envelope.data, &groups, &error)) {
-      failRequest(requestId, expectedAction, error, 3003);
-      return;
+    if (!parseProfileInfo(wrapper, &info, true, &error)) {
+      qWarning().noquote() << "[PROFILE] skip batch profile request_id="
+                           << requestId << "error=" << error;
+      continue;
+    }
+    if (!unresolved.remove(info.numericId)) {
+      continue;
+    }
+    cacheProfile(kActionGet, info.numericId, info);
+    emit userProfileBatchItem(pending.batchId, info);
+  }
+
+  QStringList missing;
+  for (const QJsonValue &value : requested) {
+    if (unresolved.contains(value.toString())) {
+      missing.push_back(value.toString());
     }
-    emit groupsListed(requestId, groups);
+  }
+  finishProfileBatchRequest(pending.batchId, missing);
+}
+
+void ProfileApiClient::finishProfileBatchRequest(
+    const QString &batchId, const QStringList &missingNumericIds) {
+  auto it = m_profileBatches.find(batchId);
+  if (it == m_profileBatches.end()) {
     return;
   }
+  it->missingNumericIds.append(missingNumericIds);
+  if (--it->outstandingRequests > 0) {
+    return;
+  }
+  const QStringList missing = std::move(it->missingNumericIds);
+  m_profileBatches.erase(it);
+  emit userProfileBatchFinished(batchId, missing);
+}
+
+void ProfileApiClient::resumePendingRequests() {
+  const auto requestIds = m_pendingRequests.keys();
+  for (const QString &requestId : requestIds) {
+    auto it = m_pendingRequests.find(requestId);
+    if (it == m_pendingRequests.end() || !it->awaitingReplay) {
+      continue;
+    }
+    it->awaitingReplay = false;
+    const Action action = it->action;
+    if (!sendProfilePayload(action, requestId, it->data)) {
+      failPendingRequest(requestId, QStringLiteral("websocket is not connected"));
+      continue;
+    }
+    armRequestTimeout(requestId);
+    qInfo().noquote() << "[PROFILE] replayed action=" << actionName(action)
+                      << "request_id=" << requestId;
+  }
+}
 
-  failRequest(requestId, expectedAction, QStringLiteral("unsupported action"));
+void ProfileApiClient::abandonPendingRequests(const QString &reason) {
+  const auto requestIds = m_pendingRequests.keys();
+  for (const QString &requestId : requestIds) {
+    const auto it = m_pendingRequests.constFind(requestId);
+    if (it == m_pendingRequests.cend() || !it->awaitingReplay) {
+      continue;
+    }
+    failPendingRequest(requestId, reason);
+  }
 }
 
 void ProfileApiClient::onDisconnected() {
+  const bool willReconnect = m_client && m_client->isReconnecting();
   const auto requestIds = m_pendingRequests.keys();
   for (const QString &requestId : requestIds) {
+    auto it = m_pendingRequests.find(requestId);
+    if (willReconnect && it != m_pendingRequests.end() && it->retryOnTransient) {
+      // Keep the timeout running: the request fails if the reconnect is slow.
+      it->awaitingReplay = true;
+      continue;
+    }
     if (!retryPendingRequest(requestId, QStringLiteral("websocket disconnected"))) {
-      const QString action = m_pendingRequests.value(requestId).action;
-      clearPendingRequest(requestId);
-      failRequest(requestId, action, QStringLiteral("websocket disconnected"));
+      failPendingRequest(requestId, QStringLiteral("websocket disconnected"));
     }
   }
 }
 
+ProfileCacheStats ProfileApiClient::profileCacheStats() const {
+  ProfileCacheStats stats = m_profileCacheStats;
+  stats.size = static_cast<int>(m_profileCache.size());
+  return stats;
+}
+
+void ProfileApiClient::clearProfileCache() {
+  m_profileCache.clear();
+  m_numericIdByUserId.clear();
+  m_userIdByNumericId.clear();
+}
+
+void ProfileApiClient::onPresenceEnvelope(const protocol::Envelope &envelope) {
+  invalidateCachedProfile(jsonValueToString(envelope.data.value("user_id")),
+                          jsonValueToString(envelope.data.value("numeric_id")));
+}
+
+bool ProfileApiClient::lookupCachedProfile(const char *action, const QString &id,
+                                           ProfileInfo *outInfo) {
+  const QString key = profileCacheKey(action, id);
+  bool hit = false;
+  if (CachedProfile *entry = m_profileCache.object(key)) {
+    if (m_profileCacheClock.elapsed() < entry->expiresAtMs) {
+      *outInfo = entry->info;
+      hit = true;
+    } else {
+      m_profileCache.remove(key);
+      ++m_profileCacheStats.expired;
+    }
+  }
+  if (hit) {
+    ++m_profileCacheStats.hits;
+  } else {
+    ++m_profileCacheStats.misses;
+  }
+
+  const quint64 lookups = m_profileCacheStats.hits + m_profileCacheStats.misses;
+  if (lookups % kProfileCacheLogEvery == 0) {
+    qInfo().noquote() << "[PROFILE] cache hits=" << m_profileCacheStats.hits
+                      << "misses=" << m_profileCacheStats.misses
+                      << "expired=" << m_profileCacheStats.expired
+                      << "invalidations=" << m_profileCacheStats.invalidations
+                      << "size=" << m_profileCache.size();
+  }
+  return hit;
+}
+
+void ProfileApiClient::cacheProfile(const char *action, const QString &id,
+                                    const ProfileInfo &info) {
+  if (id.isEmpty()) {
+    return;
+  }
+  auto *entry = new CachedProfile;
+  entry->info = info;
+  entry->expiresAtMs = m_profileCacheClock.elapsed() + kProfileCacheTtlMs;
+  m_profileCache.insert(profileCacheKey(action, id), entry);
+
+  const QString userId = info.userId.trimmed();
+  const QString numericId = info.numericId.trimmed();
+  if (userId.isEmpty() || numericId.isEmpty()) {
+    return;
+  }
+  m_numericIdByUserId.insert(userId, numericId);
+  m_userIdByNumericId.insert(numericId, userId);
+  if (m_numericIdByUserId.size() > 2 * kProfileCacheCapacity) {
+    // QCache evicts silently; drop pairs whose entries are both gone.
+    // contains() does not touch the LRU order.
+    m_numericIdByUserId.removeIf([this](const QHash<QString, QString>::iterator &it) {
+      return !m_profileCache.contains(profileCacheKey(kActionGetInfo, it.key())) &&
+             !m_profileCache.contains(profileCacheKey(kActionGet, it.value()));
+    });
+    m_userIdByNumericId.removeIf([this](const QHash<QString, QString>::iterator &it) {
+      return !m_numericIdByUserId.contains(it.value());
+    });
+  }
+}
+
+void ProfileApiClient::invalidateCachedProfile(const QString &userId,
+                                               const QString &numericId) {
+  if (m_profileCache.isEmpty()) {
+    return;
+  }
+  // Presence broadcasts often carry only one id; the cross-index supplies
+  // the other, so both entries are removed by key.
+  const QString resolvedUserId =
+      userId.isEmpty() ? m_userIdByNumericId.value(numericId) : userId;
+  const QString resolvedNumericId =
+      numericId.isEmpty() ? m_numericIdByUserId.value(userId) : numericId;
+  if (!resolvedUserId.isEmpty() &&
+      m_profileCache.remove(profileCacheKey(kActionGetInfo, resolvedUserId))) {
+    ++m_profileCacheStats.invalidations;
+  }
+  if (!resolvedNumericId.isEmpty() &&
+      m_profileCache.remove(profileCacheKey(kActionGet, resolvedNumericId))) {
+    ++m_profileCacheStats.invalidations;
+  }
+  m_numericIdByUserId.remove(resolvedUserId);
+  m_userIdByNumericId.remove(resolvedNumericId);
+}
+
 QString ProfileApiClient::generateRequestId() const {
   return QUuid::createUuid().toString(QUuid::WithoutBraces);
 }
@@ -651,6 +1044,22 @@ bool ProfileApiClient::validateQueryUserProfile(const QString &numericId,
   return true;
 }
 
+bool ProfileApiClient::validateQueryUserProfiles(const QStringList &numericIds,
+                                                 QString *error) const {
+  if (numericIds.isEmpty()) {
+    if (error) {
+      *error = QStringLiteral("numeric_ids is required");
+    }
+    return false;
+  }
+  for (const QString &numericId : numericIds) {
+    if (!validateQueryUserProfile(numericId, error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool ProfileApiClient::validateAddFriend(const QString &userNumericId,
                                          const QString &friendNumericId,
                                          const QString &remark,
@@ -823,76 +1232,113 @@ bool ProfileApiClient::validateListGroups(const QString &keyword,
          groupNumericId.trimmed().size() <= 255;
 }
 
-void ProfileApiClient::sendProfileRequest(const QString &action,
+void ProfileApiClient::sendProfileRequest(Action action,
                                           const QString &requestId,
-                                          const QJsonObject &data, int retries,
-                                          bool retryOnTransient) {
+                                          QJsonObject data, int retries,
+                                          bool retryOnTransient,
+                                          const QString &batchId) {
   if (!m_client) {
     failRequest(requestId, action, QStringLiteral("websocket client is null"));
+    if (!batchId.isEmpty()) {
+      finishProfileBatchRequest(batchId, jsonStringList(data.value("numeric_ids")));
+    }
     return;
   }
-  addPendingRequest(requestId, action, data, retries, retryOnTransient);
-  if (!sendProfilePayload(action, requestId, data)) {
-    clearPendingRequest(requestId);
-    failRequest(requestId, action, QStringLiteral("websocket is not connected"));
-  }
-}
-
-void ProfileApiClient::addPendingRequest(const QString &requestId,
-                                         const QString &action,
-                                         const QJsonObject &data, int retries,
-                                         bool retryOnTransient) {
   clearPendingRequest(requestId);
 
-  auto *timer = new QTimer(this);
-  timer->setSingleShot(true);
-  connect(timer, &QTimer::timeout, this, [this, requestId, action]() {
-    if (!m_pendingRequests.contains(requestId)) {
+  // Identical reads already on the wire absorb the new caller instead of
+  // costing another round-trip. QJsonObject keys are sorted, so the compact
+  // form is a normalized key.
+  QString coalesceKey;
+  if (kActionTable[static_cast<int>(action)].coalesce) {
+    coalesceKey = actionName(action) + QLatin1Char(' ') +
+                  QString::fromUtf8(QJsonDocument(data).toJson(QJsonDocument::Compact));
+    const QString ownerId = m_inFlightByKey.value(coalesceKey);
+    const auto owner = m_pendingRequests.find(ownerId);
+    if (!ownerId.isEmpty() && owner != m_pendingRequests.end()) {
+      owner->coalescedRequestIds.append(requestId);
+      qInfo().noquote() << "[PROFILE] coalesce action=" << actionName(action)
+                        << "request_id=" << requestId << "into=" << ownerId;
       return;
     }
-    if (!retryPendingRequest(requestId, QStringLiteral("request timeout"))) {
-      m_pendingRequests.remove(requestId);
-      qWarning().noquote() << "[PROFILE] timeout action=" << action
-                           << "request_id=" << requestId;
-      failRequest(requestId, action, QStringLiteral("request timeout"));
-    }
-  });
-  timer->start(kRequestTimeoutMs);
+  }
 
   PendingRequest pending;
   pending.action = action;
-  pending.data = data;
+  pending.data = std::move(data);
   pending.remainingRetries = qMax(0, retries);
   pending.retryOnTransient = retryOnTransient;
-  pending.timer = timer;
-  m_pendingRequests.insert(requestId, pending);
+  pending.coalesceKey = coalesceKey;
+  pending.batchId = batchId;
+  const auto it = m_pendingRequests.insert(requestId, std::move(pending));
+  if (!coalesceKey.isEmpty()) {
+    m_inFlightByKey.insert(coalesceKey, requestId);
+  }
+  armRequestTimeout(requestId);
+  if (!sendProfilePayload(action, requestId, it->data)) {
+    failPendingRequest(requestId, QStringLiteral("websocket is not connected"));
+  }
 }
 
-bool ProfileApiClient::sendProfilePayload(const QString &action,
+void ProfileApiClient::armRequestTimeout(const QString &requestId) {
+  RequestTimeoutWheel::instance()->schedule(
+      requestId, kRequestTimeoutMs, this,
+      [this](const QString &key) { onRequestTimeout(key); });
+}
+
+void ProfileApiClient::onRequestTimeout(const QString &requestId) {
+  const auto it = m_pendingRequests.constFind(requestId);
+  if (it == m_pendingRequests.cend()) {
+    return;
+  }
+  if (!retryPendingRequest(requestId, QStringLiteral("request timeout"))) {
+    qWarning().noquote() << "[PROFILE] timeout action=" << actionName(it->action)
+                         << "request_id=" << requestId;
+    failPendingRequest(requestId, QStringLiteral("request timeout"));
+  }
+}
+
+bool ProfileApiClient::sendProfilePayload(Action action,
                                           const QString &requestId,
                                           const QJsonObject &data) {
   if (!m_client || !m_client->isConnected()) {
     return false;
   }
   const QString payload = protocol::createRequest(QString::fromLatin1(kTypeProfile),
-                                                  action, data, requestId);
+                                                  actionName(action), data, requestId);
   m_client->sendTextMessage(payload);
-  qInfo().noquote() << "[PROFILE] send action=" << action
+  qInfo().noquote() << "[PROFILE] send action=" << actionName(action)
                     << "request_id=" << requestId;
   return true;
 }
 
-void ProfileApiClient::clearPendingRequest(const QString &requestId) {
+ProfileApiClient::PendingRequest
+ProfileApiClient::takePendingRequest(const QString &requestId) {
   auto it = m_pendingRequests.find(requestId);
   if (it == m_pendingRequests.end()) {
-    return;
+    return PendingRequest();
   }
 
-  if (it->timer) {
-    it->timer->stop();
-    it->timer->deleteLater();
-  }
+  RequestTimeoutWheel::instance()->cancel(requestId);
+  PendingRequest pending = std::move(it.value());
   m_pendingRequests.erase(it);
+  if (!pending.coalesceKey.isEmpty()) {
+    m_inFlightByKey.remove(pending.coalesceKey);
+  }
+  return pending;
+}
+
+void ProfileApiClient::clearPendingRequest(const QString &requestId) {
+  takePendingRequest(requestId);
+}
+
+void ProfileApiClient::failPendingRequest(const QString &requestId,
+                                          const QString &errorMessage) {
+  if (!m_pendingRequests.contains(requestId)) {
+    return;
+  }
+  const PendingRequest pending = takePendingRequest(requestId);
+  failRequest(requestId, pending, errorMessage);
 }
 
 bool ProfileApiClient::retryPendingRequest(const QString &requestId,
@@ -905,45 +1351,55 @@ bool ProfileApiClient::retryPendingRequest(const QString &requestId,
     return false;
   }
 
-  PendingRequest pending = it.value();
-  pending.remainingRetries -= 1;
-  m_pendingRequests.insert(requestId, pending);
+  it->remainingRetries -= 1;
 
-  qWarning().noquote() << "[PROFILE] retry action=" << pending.action
+  qWarning().noquote() << "[PROFILE] retry action=" << actionName(it->action)
                        << "request_id=" << requestId << "reason=" << reason
-                       << "remaining_retries=" << pending.remainingRetries;
-  QTimer::singleShot(kRetryDelayMs, this, [this, requestId]() {
-    auto it = m_pendingRequests.find(requestId);
-    if (it == m_pendingRequests.end()) {
-      return;
-    }
-    if (!sendProfilePayload(it->action, requestId, it->data)) {
-      const QString action = it->action;
-      clearPendingRequest(requestId);
-      failRequest(requestId, action, QStringLiteral("request timeout, please retry manually"));
-      return;
-    }
-    if (it->timer) {
-      it->timer->start(kRequestTimeoutMs);
-    }
-  });
+                       << "remaining_retries=" << it->remainingRetries;
+  // The retry delay takes the request's slot in the wheel; the timeout is
+  // re-armed once the payload has been resent.
+  RequestTimeoutWheel::instance()->schedule(
+      requestId, kRetryDelayMs, this, [this](const QString &key) {
+        const auto it = m_pendingRequests.constFind(key);
+        if (it == m_pendingRequests.cend()) {
+          return;
+        }
+        if (!sendProfilePayload(it->action, key, it->data)) {
+          failPendingRequest(key, QStringLiteral("request timeout, please retry manually"));
+          return;
+        }
+        armRequestTimeout(key);
+      });
   return true;
 }
 
-void ProfileApiClient::failRequest(const QString &requestId, const QString &action,
+void ProfileApiClient::failRequest(const QString &requestId, Action action,
                                    const QString &errorMessage, int code) {
-  qWarning().noquote() << "[PROFILE] action=" << action
+  const QString name = actionName(action);
+  qWarning().noquote() << "[PROFILE] action=" << name
                        << "request_id=" << requestId
                        << "code=" << code
                        << "message=" << errorMessage;
-  if (action == QLatin1String(kActionListFriends)) {
+  if (action == Action::ListFriends) {
     emit friendListFailed(requestId, code, errorMessage);
   }
-  if (action == QLatin1String(kActionListConversations)) {
+  if (action == Action::ListConversations) {
     emit conversationListFailed(requestId, code, errorMessage);
   }
-  emit requestFailedDetailed(requestId, action, code, errorMessage);
-  emit requestFailed(requestId, action, errorMessage);
+  emit requestFailedDetailed(requestId, name, code, errorMessage);
+  emit requestFailed(requestId, name, errorMessage);
+}
+
+void ProfileApiClient::failRequest(const QString &requestId,
+                                   const PendingRequest &pending,
+                                   const QString &errorMessage, int code) {
+  for (const QString &id : requestIdsFor(requestId, pending)) {
+    failRequest(id, pending.action, errorMessage, code);
+  }
+  if (!pending.batchId.isEmpty()) {
+    finishProfileBatchRequest(pending.batchId,
+                              jsonStringList(pending.data.value("numeric_ids")));
+  }
 }
 
 bool ProfileApiClient::parseProfileInfo(const QJsonObject &data, ProfileInfo *outInfo,
@@ -1244,9 +1700,9 @@ bool ProfileApiClient::parseGroupSearchList(const QJsonObject &data,
   return true;
 }
 
-bool ProfileApiClient::parseFriendList(const QJsonObject &data,
-                                       QVector<FriendItem> *outFriends,
-                                       QString *error) const {
+bool ProfileApiClient::parseFriendList(
+    const QJsonObject &data, QVector<friendlist::FriendRecord> *outFriends,
+    QString *error) const {
   if (!outFriends) {
     if (error) {
       *error = QStringLiteral("internal error: out friends is null");
@@ -1282,9 +1738,9 @@ bool ProfileApiClient::parseFriendList(const QJsonObject &data,
       continue;
     }
     const QJsonObject obj = itemVal.toObject();
-    FriendItem item;
-    item.userId = jsonValueToString(obj.value("user_id"));
-    item.numericId = jsonValueToString(obj.value("numeric_id"));
+    friendlist::FriendItem item;
+    item.userId = internedString(jsonValueToString(obj.value("user_id")));
+    item.numericId = internedString(jsonValueToString(obj.value("numeric_id")));
     item.username = obj.value("username").toString();
     item.status = readOptionalInt(obj, "status", 0);
     item.userStatus = readOptionalInt(obj, "user_status", item.status);
@@ -1292,15 +1748,17 @@ bool ProfileApiClient::parseFriendList(const QJsonObject &data,
     item.lastSeenAtUtc = obj.value("last_seen_at").toString().trimmed();
     item.lastSeenAt = parseUtcIsoTime(item.lastSeenAtUtc);
     item.nickname = obj.value("nickname").toString();
-    item.avatarUrl = obj.value("avatar_url").toString();
+    item.avatarUrl = internedString(obj.value("avatar_url").toString());
     item.bio = obj.value("bio").toString();
-    outFriends->push_back(item);
+    item.displayName = item.nickname.isEmpty() ? item.username : item.nickname;
+    outFriends->push_back(friendlist::FriendRecord(std::move(item)));
   }
   return true;
 }
 
 bool ProfileApiClient::parseConversationList(
-    const QJsonObject &data, QVector<ConversationItem> *outConversations,
+    const QJsonObject &data,
+    QVector<conversationlist::ConversationRecord> *outConversations,
     QString *error) const {
   if (!outConversations) {
     if (error) {
@@ -1338,19 +1796,23 @@ bool ProfileApiClient::parseConversationList(
       continue;
     }
     const QJsonObject obj = itemVal.toObject();
-    ConversationItem item;
-    item.conversationId = jsonValueToString(obj.value("conversation_id"));
-    item.conversationUuid = jsonValueToString(obj.value("conversation_uuid"));
-    item.groupNumericId = readGroupNumericId(obj);
+    conversationlist::ConversationItem item;
+    item.conversationId =
+        internedString(jsonValueToString(obj.value("conversation_id")));
+    item.conversationUuid =
+        internedString(jsonValueToString(obj.value("conversation_uuid")));
+    item.groupNumericId = internedString(readGroupNumericId(obj));
     item.conversationType = readOptionalInt(obj, "conversation_type", 0);
     item.name = obj.value("name").toString().trimmed();
-    item.avatarUrl = obj.value("avatar_url").toString().trimmed();
+    item.avatarUrl = internedString(obj.value("avatar_url").toString().trimmed());
     item.memberCount = readOptionalInt(obj, "member_count", 0);
-    item.peerUserId = jsonValueToString(obj.value("peer_user_id"));
-    item.peerNumericId = jsonValueToString(obj.value("peer_numeric_id"));
+    item.peerUserId = internedString(jsonValueToString(obj.value("peer_user_id")));
+    item.peerNumericId =
+        internedString(jsonValueToString(obj.value("peer_numeric_id")));
     item.peerUsername = obj.value("peer_username").toString().trimmed();
     item.peerNickname = obj.value("peer_nickname").toString().trimmed();
-    item.peerAvatarUrl = obj.value("peer_avatar_url").toString().trimmed();
+    item.peerAvatarUrl =
+        internedString(obj.value("peer_avatar_url").toString().trimmed());
     item.peerBio = obj.value("peer_bio").toString().trimmed();
     item.peerStatus = readOptionalInt(obj, "peer_status", 0);
     item.peerIsOnline = readOptionalBool(obj, "peer_is_online", false);
@@ -1377,7 +1839,8 @@ bool ProfileApiClient::parseConversationList(
     if (item.avatarUrl.isEmpty()) {
       item.avatarUrl = item.peerAvatarUrl;
     }
-    outConversations->push_back(item);
+    outConversations->push_back(
+        conversationlist::ConversationRecord(std::move(item)));
   }
   return true;
 }
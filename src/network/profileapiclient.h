@@ -1,15 +1,17 @@
 #ifndef PROFILEAPICLIENT_H
 #define PROFILEAPICLIENT_H
 
+#include <QCache>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QObject>
 #include <QHash>
 #include <QJsonObject>
-#include <QPointer>
 #include <QStringList>
-#include <QTimer>
 #include <QVector>
 
+#include "conversationrecord.h"
+#include "friendrecord.h"
 #include "protocol.h"
 #include "websocketclient.h"
 
@@ -58,44 +60,6 @@ struct DeleteFriendResult {
 };
 Q_DECLARE_METATYPE(DeleteFriendResult)
 
-struct FriendItem {
-  QString userId;
-  QString numericId;
-  QString username;
-  int status = 0;
-  int userStatus = 0;
-  bool isOnline = false;
-  QString lastSeenAtUtc;
-  QDateTime lastSeenAt;
-  QString nickname;
-  QString avatarUrl;
-  QString bio;
-};
-Q_DECLARE_METATYPE(FriendItem)
-Q_DECLARE_METATYPE(QVector<FriendItem>)
-
-struct ConversationItem {
-  QString conversationId;
-  QString conversationUuid;
-  QString groupNumericId;
-  int conversationType = 0;
-  QString name;
-  QString avatarUrl;
-  int memberCount = 0;
-  QString peerUserId;
-  QString peerNumericId;
-  QString peerUsername;
-  QString peerNickname;
-  QString peerAvatarUrl;
-  QString peerBio;
-  int peerStatus = 0;
-  bool peerIsOnline = false;
-  QString peerLastSeenAt;
-  QDateTime peerLastSeenAtUtc;
-};
-Q_DECLARE_METATYPE(ConversationItem)
-Q_DECLARE_METATYPE(QVector<ConversationItem>)
-
 struct CreateGroupResult {
   QString conversationId;
   QString conversationUuid;
@@ -140,6 +104,14 @@ struct JoinGroupResult {
 };
 Q_DECLARE_METATYPE(JoinGroupResult)
 
+struct ProfileCacheStats {
+  quint64 hits = 0;
+  quint64 misses = 0;
+  quint64 expired = 0;
+  quint64 invalidations = 0;
+  int size = 0;
+};
+
 class ProfileApiClient : public QObject {
   Q_OBJECT
 
@@ -152,33 +124,56 @@ public:
                          const QString &nickname, const QString &signature,
                          const QString &theme = QString());
   QString queryUserProfile(const QString &numericId);
+  // Fetches many profiles with PROFILE/BATCH_GET, kProfileBatchMaxIds ids per
+  // request. Each profile is reported through userProfileBatchItem as soon as
+  // its request completes; userProfileBatchFinished follows exactly once with
+  // the ids that could not be resolved. Invalid input is reported the same
+  // way, after return, preceded by requestFailed.
+  QString queryUserProfiles(const QStringList &numericIds);
   QString addFriend(const QString &userNumericId, const QString &friendNumericId,
                     const QString &remark = QString());
   QString deleteFriend(const QString &userNumericId,
                        const QString &friendNumericId);
   QString fetchFriendList(const QString &myNumericId);
-  QString fetchConversationList(const QString &myNumericId);
+  // A non-empty sinceCursor asks the server for a delta against that cursor.
+  QString fetchConversationList(const QString &myNumericId,
+                                const QString &sinceCursor = QString());
   QString createGroup(const QString &name, const QStringList &memberNumericIds);
   QString joinGroup(const QString &groupNumericId,
                     const QString &conversationId = QString());
   QString listGroups(const QString &keyword,
                      const QString &groupNumericId = QString());
 
+  // Idempotent requests survive a dropped socket while websocketclient is
+  // reconnecting; they are re-sent once the session is resumed.
+  void resumePendingRequests();
+  void abandonPendingRequests(const QString &reason);
+
+  // GET_INFO and GET results are cached per user for kProfileCacheTtlMs.
+  // Cache hits are answered on the next event loop turn with a fresh
+  // request_id, exactly like a server response.
+  ProfileCacheStats profileCacheStats() const;
+  void clearProfileCache();
+
 signals:
   void profileInfoReceived(const QString &requestId, const ProfileInfo &info);
   void profileInfoSetSuccess(const QString &requestId, const ProfileInfo &info);
   void userProfileQueried(const QString &requestId, const ProfileInfo &info);
+  void userProfileBatchItem(const QString &batchId, const ProfileInfo &info);
+  void userProfileBatchFinished(const QString &batchId,
+                                const QStringList &missingNumericIds);
   void addFriendSuccess(const QString &requestId, const AddFriendResult &result);
   void deleteFriendFinished(const QString &requestId,
                             const DeleteFriendResult &result);
   void friendListFetched(const QString &requestId,
-                         const QVector<FriendItem> &friends);
+                         const QVector<friendlist::FriendRecord> &friends);
   void friendListPayloadReceived(const QString &requestId,
                                  const QJsonObject &data);
   void friendListFailed(const QString &requestId, int code,
                         const QString &message);
   void conversationListFetched(const QString &requestId,
-                               const QVector<ConversationItem> &conversations);
+                               const QVector<conversationlist::ConversationRecord>
+                                   &conversations);
   void createGroupSucceeded(const QString &requestId,
                             const CreateGroupResult &result);
   void joinGroupSucceeded(const QString &requestId, const JoinGroupResult &result);
@@ -194,24 +189,120 @@ signals:
                              int code, const QString &error);
 
 private slots:
-  void onTextMessageReceived(const QString &message);
   void onDisconnected();
 
 private:
+  // Interned at request time; indexes kActionTable.
+  enum class Action : quint8 {
+    GetInfo,
+    SetInfo,
+    Get,
+    AddFriend,
+    DeleteFriend,
+    ListFriends,
+    ListConversations,
+    CreateGroup,
+    JoinGroup,
+    ListGroups,
+    BatchGet,
+    Count
+  };
+
   struct PendingRequest {
-    QString action;
+    Action action = Action::Count;
     QJsonObject data;
     int remainingRetries = 0;
     bool retryOnTransient = false;
-    QPointer<QTimer> timer;
+    bool awaitingReplay = false;
+    // Set for coalescable actions; callers that issued an identical request
+    // while this one was in flight share its response.
+    QString coalesceKey;
+    QStringList coalescedRequestIds;
+    // Owning queryUserProfiles() call, for BATCH_GET requests.
+    QString batchId;
+  };
+
+  struct ProfileBatch {
+    int outstandingRequests = 0;
+    QStringList missingNumericIds;
   };
 
+  // Called only for successful responses (code == 0 and ok).
+  using ResponseHandler = void (ProfileApiClient::*)(
+      const QString &requestId, const PendingRequest &pending,
+      const protocol::Envelope &envelope, const QString &message);
+
+  struct ActionSpec {
+    const char *name;
+    protocol::EnvelopeAction envelopeAction;
+    ResponseHandler handler;
+    bool coalesce;
+  };
+
+  static constexpr int kActionCount = static_cast<int>(Action::Count);
+  static const ActionSpec kActionTable[kActionCount];
+  static QString actionName(Action action);
+  static QStringList requestIdsFor(const QString &requestId,
+                                   const PendingRequest &pending);
+
+  struct CachedProfile {
+    ProfileInfo info;
+    qint64 expiresAtMs = 0;
+  };
+
+  void onEnvelopeReceived(const protocol::Envelope &envelope);
+  void onPresenceEnvelope(const protocol::Envelope &envelope);
+  bool lookupCachedProfile(const char *action, const QString &id,
+                           ProfileInfo *outInfo);
+  void cacheProfile(const char *action, const QString &id,
+                    const ProfileInfo &info);
+  void invalidateCachedProfile(const QString &userId, const QString &numericId);
+  void handleGetInfo(const QString &requestId, const PendingRequest &pending,
+                     const protocol::Envelope &envelope, const QString &message);
+  void handleSetInfo(const QString &requestId, const PendingRequest &pending,
+                     const protocol::Envelope &envelope, const QString &message);
+  void handleGet(const QString &requestId, const PendingRequest &pending,
+                 const protocol::Envelope &envelope, const QString &message);
+  void handleAddFriend(const QString &requestId, const PendingRequest &pending,
+                       const protocol::Envelope &envelope,
+                       const QString &message);
+  void handleDeleteFriend(const QString &requestId,
+                          const PendingRequest &pending,
+                          const protocol::Envelope &envelope,
+                          const QString &message);
+  void handleListFriends(const QString &requestId,
+                         const PendingRequest &pending,
+                         const protocol::Envelope &envelope,
+                         const QString &message);
+  void handleListConversations(const QString &requestId,
+                               const PendingRequest &pending,
+                               const protocol::Envelope &envelope,
+                               const QString &message);
+  void handleCreateGroup(const QString &requestId,
+                         const PendingRequest &pending,
+                         const protocol::Envelope &envelope,
+                         const QString &message);
+  void handleJoinGroup(const QString &requestId, const PendingRequest &pending,
+                       const protocol::Envelope &envelope,
+                       const QString &message);
+  void handleListGroups(const QString &requestId,
+                        const PendingRequest &pending,
+                        const protocol::Envelope &envelope,
+                        const QString &message);
+  void handleBatchGet(const QString &requestId, const PendingRequest &pending,
+                      const protocol::Envelope &envelope,
+                      const QString &message);
+  void finishProfileBatchRequest(const QString &batchId,
+                                 const QStringList &missingNumericIds);
+
   QString generateRequestId() const;
   bool validateGetInfo(const QString &userId, QString *error) const;
   bool validateSetInfo(const QString &userId, const QString &avatarUrl,
                        const QString &nickname, const QString &signature,
                        const QString &theme, QString *error) const;
   bool validateQueryUserProfile(const QString &numericId, QString *error) const;
+  bool validateQueryUserProfiles(const QStringList &numericIds,
+                                 QString *error) const;
   bool validateAddFriend(const QString &userNumericId,
                          const QString &friendNumericId, const QString &remark,
                          QString *error) const;
@@ -231,17 +322,20 @@ private:
                           const QString &groupNumericId,
                           QString *error) const;
 
-  void sendProfileRequest(const QString &action, const QString &requestId,
-                          const QJsonObject &data, int retries,
-                          bool retryOnTransient);
-  bool sendProfilePayload(const QString &action, const QString &requestId,
+  void sendProfileRequest(Action action, const QString &requestId,
+                          QJsonObject data, int retries, bool retryOnTransient,
+                          const QString &batchId = QString());
+  bool sendProfilePayload(Action action, const QString &requestId,
                           const QJsonObject &data);
-  void addPendingRequest(const QString &requestId, const QString &action,
-                         const QJsonObject &data, int retries,
-                         bool retryOnTransient);
+  PendingRequest takePendingRequest(const QString &requestId);
   void clearPendingRequest(const QString &requestId);
+  void failPendingRequest(const QString &requestId, const QString &errorMessage);
+  void armRequestTimeout(const QString &requestId);
+  void onRequestTimeout(const QString &requestId);
   bool retryPendingRequest(const QString &requestId, const QString &reason);
-  void failRequest(const QString &requestId, const QString &action,
+  void failRequest(const QString &requestId, Action action,
+                   const QString &errorMessage, int code = -1);
+  void failRequest(const QString &requestId, const PendingRequest &pending,
                    const QString &errorMessage, int code = -1);
 
   bool parseProfileInfo(const QJsonObject &data, ProfileInfo *outInfo, bool strict,
@@ -259,18 +353,34 @@ private:
   bool parseGroupSearchList(const QJsonObject &data,
                             QVector<GroupSearchItem> *outGroups,
                             QString *error) const;
-  bool parseFriendList(const QJsonObject &data, QVector<FriendItem> *outFriends,
+  bool parseFriendList(const QJsonObject &data,
+                       QVector<friendlist::FriendRecord> *outFriends,
                        QString *error) const;
-  bool parseConversationList(const QJsonObject &data,
-                             QVector<ConversationItem> *outConversations,
-                             QString *error) const;
+  bool parseConversationList(
+      const QJsonObject &data,
+      QVector<conversationlist::ConversationRecord> *outConversations,
+      QString *error) const;
 
 private:
   websocketclient *m_client = nullptr;
   QHash<QString, PendingRequest> m_pendingRequests;
+  // coalesce key -> request_id of the in-flight request that owns it.
+  QHash<QString, QString> m_inFlightByKey;
+  QHash<QString, ProfileBatch> m_profileBatches;
+  QCache<QString, CachedProfile> m_profileCache;
+  // Both ids of every cached profile, so a broadcast naming only one of
+  // them finds the entry keyed by the other without scanning the cache.
+  QHash<QString, QString> m_numericIdByUserId;
+  QHash<QString, QString> m_userIdByNumericId;
+  QElapsedTimer m_profileCacheClock;
+  ProfileCacheStats m_profileCacheStats;
   static constexpr int kRequestTimeoutMs = 8 * 1000;
   static constexpr int kRetryDelayMs = 500;
   static constexpr int kMaxRetryCount = 1;
+  static constexpr int kProfileCacheCapacity = 512;
+  static constexpr int kProfileCacheTtlMs = 60 * 1000;
+  static constexpr int kProfileCacheLogEvery = 100;
+  static constexpr int kProfileBatchMaxIds = 100;
 };
 
 #endif // PROFILEAPICLIENT_H
@@ -1,10 +1,88 @@
 #include "protocol.h"
 
+#include <QHash>
 #include <QJsonDocument>
 #include <QJsonParseError>
 #include <QUuid>
 
+#include <iterator>
+
 namespace protocol {
+namespace {
+constexpr int kTypeCount = static_cast<int>(EnvelopeType::Message) + 1;
+constexpr int kActionCount = static_cast<int>(EnvelopeAction::History) + 1;
+
+// Indexed by EnvelopeType / EnvelopeAction.
+const QString &typeNameAt(int index) {
+  static const QString kNames[] = {
+      QString(),
+      QStringLiteral("AUTH"),
+      QStringLiteral("PROFILE"),
+      QStringLiteral("MESSAGE"),
+  };
+  static_assert(static_cast<int>(std::size(kNames)) == kTypeCount);
+  return kNames[index];
+}
+
+const QString &actionNameAt(int index) {
+  static const QString kNames[] = {
+      QString(),
+      QStringLiteral("LOGIN"),
+      QStringLiteral("LOGOUT"),
+      QStringLiteral("RESUME"),
+      QStringLiteral("REGISTER"),
+      QStringLiteral("GET_INFO"),
+      QStringLiteral("SET_INFO"),
+      QStringLiteral("GET"),
+      QStringLiteral("ADD_FRIEND"),
+      QStringLiteral("DELETE_FRIEND"),
+      QStringLiteral("LIST_FRIENDS"),
+      QStringLiteral("LIST_CONVERSATIONS"),
+      QStringLiteral("CREATE_GROUP"),
+      QStringLiteral("JOIN_GROUP"),
+      QStringLiteral("LIST_GROUPS"),
+      QStringLiteral("BATCH_GET"),
+      QStringLiteral("SEND"),
+      QStringLiteral("PRESENCE"),
+      QStringLiteral("HISTORY"),
+  };
+  static_assert(static_cast<int>(std::size(kNames)) == kActionCount);
+  return kNames[index];
+}
+} // namespace
+
+namespace {
+// Keys view the static names above, which outlive every lookup.
+template <typename Enum>
+QHash<QStringView, Enum> nameLookup(const QString &(*nameAt)(int), int count) {
+  QHash<QStringView, Enum> byName;
+  byName.reserve(count - 1);
+  for (int i = 1; i < count; ++i) {
+    byName.insert(QStringView(nameAt(i)), static_cast<Enum>(i));
+  }
+  return byName;
+}
+} // namespace
+
+EnvelopeType envelopeTypeFromString(QStringView name) {
+  static const QHash<QStringView, EnvelopeType> kByName =
+      nameLookup<EnvelopeType>(typeNameAt, kTypeCount);
+  return kByName.value(name, EnvelopeType::Unknown);
+}
+
+EnvelopeAction envelopeActionFromString(QStringView name) {
+  static const QHash<QStringView, EnvelopeAction> kByName =
+      nameLookup<EnvelopeAction>(actionNameAt, kActionCount);
+  return kByName.value(name, EnvelopeAction::Unknown);
+}
+
+QString envelopeTypeName(EnvelopeType type) {
+  return typeNameAt(static_cast<int>(type));
+}
+
+QString envelopeActionName(EnvelopeAction action) {
+  return actionNameAt(static_cast<int>(action));
+}
 
 QString createRequest(const QString &type, const QString &action,
                       const QJsonObject &data, const QString &requestId) {
@@ -21,13 +99,17 @@ QString createRequest(const QString &type, const QString &action,
 
 bool parseEnvelope(const QString &payload, Envelope *outEnvelope,
                    QString *errorMessage) {
+  return parseEnvelope(payload.toUtf8(), outEnvelope, errorMessage);
+}
+
+bool parseEnvelope(const QByteArray &utf8Payload, Envelope *outEnvelope,
+                   QString *errorMessage) {
   if (!outEnvelope) {
     return false;
   }
 
   QJsonParseError parseError;
-  const QJsonDocument doc =
-      QJsonDocument::fromJson(payload.toUtf8(), &parseError);
+  const QJsonDocument doc = QJsonDocument::fromJson(utf8Payload, &parseError);
   if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
     if (errorMessage) {
       *errorMessage = parseError.errorString();
@@ -52,8 +134,18 @@ bool parseEnvelope(const QString &payload, Envelope *outEnvelope,
     return false;
   }
 
-  outEnvelope->type = type.toString();
-  outEnvelope->action = action.toString();
+  // Known names are swapped for the static copies, so the envelope does not
+  // keep a fresh allocation per frame for them.
+  const QString typeString = type.toString();
+  const QString actionString = action.toString();
+  outEnvelope->typeId = envelopeTypeFromString(typeString);
+  outEnvelope->actionId = envelopeActionFromString(actionString);
+  outEnvelope->type = outEnvelope->typeId == EnvelopeType::Unknown
+                          ? typeString
+                          : envelopeTypeName(outEnvelope->typeId);
+  outEnvelope->action = outEnvelope->actionId == EnvelopeAction::Unknown
+                            ? actionString
+                            : envelopeActionName(outEnvelope->actionId);
   outEnvelope->requestId = requestId.toString();
   outEnvelope->hasCode = false;
   outEnvelope->code = 0;
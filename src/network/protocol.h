@@ -1,12 +1,55 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
+#include <QByteArray>
 #include <QJsonObject>
+#include <QMetaType>
 #include <QString>
+#include <QStringView>
 
 namespace protocol {
 
+// The envelope types and actions the client knows. parseEnvelope maps the wire
+// strings once, so routing and response checks compare small integers.
+enum class EnvelopeType : quint8 {
+  Unknown = 0,
+  Auth,
+  Profile,
+  Message,
+};
+
+enum class EnvelopeAction : quint8 {
+  Unknown = 0,
+  Login,
+  Logout,
+  Resume,
+  Register,
+  GetInfo,
+  SetInfo,
+  Get,
+  AddFriend,
+  DeleteFriend,
+  ListFriends,
+  ListConversations,
+  CreateGroup,
+  JoinGroup,
+  ListGroups,
+  BatchGet,
+  Send,
+  Presence,
+  History,
+};
+
+EnvelopeType envelopeTypeFromString(QStringView name);
+EnvelopeAction envelopeActionFromString(QStringView name);
+// Wire names; empty for Unknown. The strings are static, so copies are free.
+QString envelopeTypeName(EnvelopeType type);
+QString envelopeActionName(EnvelopeAction action);
+
 struct Envelope {
+  EnvelopeType typeId = EnvelopeType::Unknown;
+  EnvelopeAction actionId = EnvelopeAction::Unknown;
+  // Wire strings, kept for logging and for values the client does not know.
   QString type;
   QString action;
   QString requestId;
@@ -25,7 +68,11 @@ QString createRequest(const QString &type, const QString &action,
 
 bool parseEnvelope(const QString &payload, Envelope *outEnvelope,
                    QString *errorMessage = nullptr);
+bool parseEnvelope(const QByteArray &utf8Payload, Envelope *outEnvelope,
+                   QString *errorMessage = nullptr);
 
 } // namespace protocol
 
+Q_DECLARE_METATYPE(protocol::Envelope)
+
 #endif // PROTOCOL_H
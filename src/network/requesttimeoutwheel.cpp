@@ -0,0 +1,106 @@
+#include "requesttimeoutwheel.h"
+
+#include <QtGlobal>
+
+RequestTimeoutWheel *RequestTimeoutWheel::instance() {
+  static RequestTimeoutWheel instance;
+  return &instance;
+}
+
+RequestTimeoutWheel::RequestTimeoutWheel(int tickMs, int slotCount,
+                                         QObject *parent)
+    : QObject(parent), m_tickMs(qMax(1, tickMs)), m_timer(this) {
+  m_slots.resize(qMax(1, slotCount));
+  m_timer.setTimerType(Qt::CoarseTimer);
+  connect(&m_timer, &QTimer::timeout, this, &RequestTimeoutWheel::onTick);
+}
+
+void RequestTimeoutWheel::schedule(const QString &key, int timeoutMs,
+                                   QObject *context, Callback callback) {
+  if (key.isEmpty() || !callback) {
+    return;
+  }
+  cancel(key);
+  if (!m_timer.isActive()) {
+    m_clock.start();
+    m_processedTicks = 0;
+    m_timer.start(m_tickMs);
+  }
+
+  // Delays below one tick still wait for the next tick.
+  const int ticks = qMax(1, (qMax(0, timeoutMs) + m_tickMs - 1) / m_tickMs);
+  const int slotCount = m_slots.size();
+
+  Entry entry;
+  entry.slot = (m_cursor + ticks) % slotCount;
+  entry.rounds = (ticks - 1) / slotCount;
+  entry.armedAtTick = m_processedTicks;
+  entry.context = context;
+  entry.callback = std::move(callback);
+  m_slots[entry.slot].insert(key);
+  m_entries.insert(key, std::move(entry));
+}
+
+bool RequestTimeoutWheel::cancel(const QString &key) {
+  const auto it = m_entries.find(key);
+  if (it == m_entries.end()) {
+    return false;
+  }
+  m_slots[it->slot].remove(key);
+  m_entries.erase(it);
+  return true;
+}
+
+bool RequestTimeoutWheel::contains(const QString &key) const {
+  return m_entries.contains(key);
+}
+
+int RequestTimeoutWheel::size() const {
+  return m_entries.size();
+}
+
+int RequestTimeoutWheel::tickMs() const {
+  return m_tickMs;
+}
+
+void RequestTimeoutWheel::onTick() {
+  // Catch up on ticks the event loop could not deliver in time.
+  const qint64 dueTicks = m_clock.elapsed() / m_tickMs;
+  while (m_processedTicks < dueTicks && !m_entries.isEmpty()) {
+    ++m_processedTicks;
+    advanceOneTick();
+  }
+  if (m_entries.isEmpty()) {
+    m_timer.stop();
+  }
+}
+
+void RequestTimeoutWheel::advanceOneTick() {
+  m_cursor = (m_cursor + 1) % m_slots.size();
+  if (m_slots.at(m_cursor).isEmpty()) {
+    return;
+  }
+
+  // Callbacks may schedule or cancel keys, including ones in this slot.
+  const QSet<QString> keys = m_slots.at(m_cursor);
+  for (const QString &key : keys) {
+    auto it = m_entries.find(key);
+    // Skip keys re-armed by a callback during this very tick.
+    if (it == m_entries.end() || it->slot != m_cursor ||
+        it->armedAtTick == m_processedTicks) {
+      continue;
+    }
+    if (it->rounds > 0) {
+      --it->rounds;
+      continue;
+    }
+
+    const QPointer<QObject> context = it->context;
+    const Callback callback = std::move(it->callback);
+    m_slots[m_cursor].remove(key);
+    m_entries.erase(it);
+    if (context) {
+      callback(key);
+    }
+  }
+}
@@ -0,0 +1,65 @@
+#ifndef REQUESTTIMEOUTWHEEL_H
+#define REQUESTTIMEOUTWHEEL_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+#include <functional>
+
+// Hashed timer wheel for request deadlines. One QTimer drives every pending
+// request; schedule() and cancel() are O(1) and the timer only runs while at
+// least one deadline is armed. Deadlines are rounded up to whole ticks.
+class RequestTimeoutWheel : public QObject {
+  Q_OBJECT
+
+public:
+  using Callback = std::function<void(const QString &key)>;
+
+  static RequestTimeoutWheel *instance();
+  explicit RequestTimeoutWheel(int tickMs = kDefaultTickMs,
+                               int slotCount = kDefaultSlotCount,
+                               QObject *parent = nullptr);
+  ~RequestTimeoutWheel() override = default;
+
+  // Re-scheduling an armed key replaces its deadline and callback. The
+  // callback is skipped if context has been destroyed in the meantime.
+  void schedule(const QString &key, int timeoutMs, QObject *context,
+                Callback callback);
+  bool cancel(const QString &key);
+  bool contains(const QString &key) const;
+  int size() const;
+  int tickMs() const;
+
+private slots:
+  void onTick();
+
+private:
+  struct Entry {
+    int slot = 0;
+    int rounds = 0;
+    qint64 armedAtTick = 0;
+    QPointer<QObject> context;
+    Callback callback;
+  };
+
+  void advanceOneTick();
+
+  static constexpr int kDefaultTickMs = 100;
+  static constexpr int kDefaultSlotCount = 128;
+
+  int m_tickMs = kDefaultTickMs;
+  int m_cursor = 0;
+  qint64 m_processedTicks = 0;
+  QElapsedTimer m_clock;
+  QTimer m_timer;
+  QVector<QSet<QString>> m_slots;
+  QHash<QString, Entry> m_entries;
+};
+
+#endif // REQUESTTIMEOUTWHEEL_H
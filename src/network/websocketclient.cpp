@@ -1,5 +1,12 @@
 #include "websocketclient.h"
+#include <QDebug>
+#include <QMutexLocker>
 #include <QNetworkProxy>
+#include <QRandomGenerator>
+#include <QStringEncoder>
+#include <QtGlobal>
+
+#include <algorithm>
 
 websocketclient *websocketclient::instance() {
   static websocketclient instance;
@@ -8,7 +15,11 @@ websocketclient *websocketclient::instance() {
 
 websocketclient::websocketclient(QObject *parent)
     : QObject(parent),
-      m_socket(QString(), QWebSocketProtocol::VersionLatest, this) {
+      m_socket(QString(), QWebSocketProtocol::VersionLatest, this),
+      m_reconnectTimer(this), m_heartbeatTimer(this) {
+  qRegisterMetaType<protocol::Envelope>("protocol::Envelope");
+  qRegisterMetaType<HeartbeatStats>("HeartbeatStats");
+
   m_socket.setProxy(QNetworkProxy(QNetworkProxy::NoProxy));
   connect(&m_socket, &QWebSocket::connected, this, &websocketclient::onConnected);
   connect(&m_socket, &QWebSocket::disconnected, this,
@@ -18,6 +29,8 @@ websocketclient::websocketclient(QObject *parent)
   connect(&m_socket, &QWebSocket::binaryMessageReceived, this,
           &websocketclient::onBinaryMessageReceived);
   connect(&m_socket, &QWebSocket::pong, this, &websocketclient::onPong);
+  connect(&m_socket, &QWebSocket::bytesWritten, this,
+          &websocketclient::onBytesWritten);
   connect(&m_socket, &QWebSocket::stateChanged, this,
           &websocketclient::onStateChanged);
 #if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
@@ -28,24 +41,110 @@ websocketclient::websocketclient(QObject *parent)
           QOverload<QAbstractSocket::SocketError>::of(&QWebSocket::error), this,
           &websocketclient::onErrorOccurred);
 #endif
+
+  m_reconnectTimer.setSingleShot(true);
+  connect(&m_reconnectTimer, &QTimer::timeout, this,
+          &websocketclient::onReconnectTimeout);
+  if (QNetworkInformation::loadDefaultBackend() && QNetworkInformation::instance()) {
+    connect(QNetworkInformation::instance(),
+            &QNetworkInformation::reachabilityChanged, this,
+            &websocketclient::onReachabilityChanged);
+  }
+
+  m_heartbeatTimer.setSingleShot(false);
+  connect(&m_heartbeatTimer, &QTimer::timeout, this,
+          &websocketclient::onHeartbeatTimeout);
+  m_rttSamples.reserve(kRttWindowSize);
+}
+
+void websocketclient::startNetworkThread() {
+  if (m_networkThread) {
+    return;
+  }
+  if (!isOwnerThread()) {
+    qWarning() << "[WebSocket] startNetworkThread must be called from the owner thread";
+    return;
+  }
+  // The timers and the socket are children, so they move along with us.
+  m_networkThread = new QThread();
+  m_networkThread->setObjectName(QStringLiteral("websocket-network"));
+  moveToThread(m_networkThread);
+  m_networkThread->start();
+  qInfo() << "[WebSocket] transport moved to network thread";
+}
+
+void websocketclient::stopNetworkThread() {
+  if (!m_networkThread) {
+    return;
+  }
+  QThread *callerThread = QThread::currentThread();
+  QMetaObject::invokeMethod(
+      this,
+      [this, callerThread]() {
+        m_closeRequested = true;
+        m_reconnectTimer.stop();
+        stopHeartbeat();
+        m_socket.abort();
+        moveToThread(callerThread);
+      },
+      Qt::BlockingQueuedConnection);
+  m_networkThread->quit();
+  m_networkThread->wait();
+  delete m_networkThread;
+  m_networkThread = nullptr;
+}
+
+bool websocketclient::isNetworkThreadRunning() const {
+  return m_networkThread != nullptr;
 }
 
 void websocketclient::open(const QUrl &url) {
+  if (postToOwnerThread([this, url]() { open(url); })) {
+    return;
+  }
   if (!url.isValid()) {
     emit errorOccurred(QAbstractSocket::SocketError::UnsupportedSocketOperationError,
                        QStringLiteral("Invalid WebSocket URL"));
     return;
   }
-  m_url = url;
+  {
+    QMutexLocker locker(&m_sharedMutex);
+    m_url = url;
+  }
+  m_closeRequested = false;
+  m_reconnectTimer.stop();
   m_socket.open(url);
 }
 
 void websocketclient::close(QWebSocketProtocol::CloseCode code,
                             const QString &reason) {
+  if (postToOwnerThread([this, code, reason]() { close(code, reason); })) {
+    return;
+  }
+  m_closeRequested = true;
+  m_reconnectTimer.stop();
+  m_reconnectAttempt = 0;
+  // Frames queued for this session are owned by their senders' outboxes.
+  bool queueDropped = false;
+  {
+    QMutexLocker locker(&m_sharedMutex);
+    queueDropped = !m_outboundQueue.isEmpty();
+    m_outboundQueue.clear();
+    m_outboundQueueBytes = 0;
+    m_queuedFrameIds.clear();
+    m_writtenFrameIds.clear();
+  }
+  if (queueDropped) {
+    emit outboundQueueChanged(0);
+  }
+  m_outboundHeld = false;
   m_socket.close(code, reason);
 }
 
 void websocketclient::sendTextMessage(const QString &message) {
+  if (postToOwnerThread([this, message]() { sendTextMessage(message); })) {
+    return;
+  }
   if (!isConnected()) {
     emit errorOccurred(QAbstractSocket::SocketError::OperationError,
                        QStringLiteral("WebSocket is not connected"));
@@ -55,6 +154,9 @@ void websocketclient::sendTextMessage(const QString &message) {
 }
 
 void websocketclient::sendBinaryMessage(const QByteArray &data) {
+  if (postToOwnerThread([this, data]() { sendBinaryMessage(data); })) {
+    return;
+  }
   if (!isConnected()) {
     emit errorOccurred(QAbstractSocket::SocketError::OperationError,
                        QStringLiteral("WebSocket is not connected"));
@@ -63,32 +165,250 @@ void websocketclient::sendBinaryMessage(const QByteArray &data) {
   m_socket.sendBinaryMessage(data);
 }
 
+bool websocketclient::queueTextMessage(const QString &message,
+                                       const QString &frameId) {
+  const bool ownerThread = isOwnerThread();
+  int pendingFrames = 0;
+  {
+    QMutexLocker locker(&m_sharedMutex);
+    if (ownerThread && m_outboundQueue.isEmpty() && !m_outboundHeld &&
+        isConnected() && m_socket.bytesToWrite() < kOutboundHighWatermarkBytes) {
+      if (!frameId.isEmpty()) {
+        m_writtenFrameIds.insert(frameId);
+      }
+      locker.unlock();
+      m_socket.sendTextMessage(message);
+      return true;
+    }
+    if (!enqueueLocked(message, frameId)) {
+      return false;
+    }
+    pendingFrames = m_outboundQueue.size();
+  }
+  emit outboundQueueChanged(pendingFrames);
+  if (!ownerThread) {
+    // The queue is the hand-off between threads; the owner drains it.
+    QMetaObject::invokeMethod(this, [this]() { flushOutboundQueue(); },
+                              Qt::QueuedConnection);
+  }
+  return true;
+}
+
+bool websocketclient::requeueTextMessage(const QString &message,
+                                         const QString &frameId) {
+  int pendingFrames = 0;
+  {
+    // Checked and queued under one lock, so a frame being flushed right now
+    // is never queued a second time.
+    QMutexLocker locker(&m_sharedMutex);
+    if (m_queuedFrameIds.contains(frameId) || m_writtenFrameIds.contains(frameId)) {
+      return true;
+    }
+    if (!enqueueLocked(message, frameId)) {
+      return false;
+    }
+    pendingFrames = m_outboundQueue.size();
+  }
+  emit outboundQueueChanged(pendingFrames);
+  QMetaObject::invokeMethod(this, [this]() { flushOutboundQueue(); },
+                            Qt::QueuedConnection);
+  return true;
+}
+
+void websocketclient::forgetFrame(const QString &frameId) {
+  QMutexLocker locker(&m_sharedMutex);
+  m_writtenFrameIds.remove(frameId);
+}
+
+bool websocketclient::enqueueLocked(const QString &message,
+                                    const QString &frameId) {
+  const qint64 frameBytes = message.size() * static_cast<qint64>(sizeof(QChar));
+  if (m_outboundQueue.size() >= kOutboundQueueMaxFrames ||
+      m_outboundQueueBytes + frameBytes > kOutboundQueueMaxBytes) {
+    qWarning() << "[WebSocket] outbound queue full, frames="
+               << m_outboundQueue.size() << "bytes=" << m_outboundQueueBytes;
+    return false;
+  }
+  m_outboundQueue.enqueue({frameId, message});
+  m_outboundQueueBytes += frameBytes;
+  if (!frameId.isEmpty()) {
+    m_queuedFrameIds.insert(frameId);
+  }
+  return true;
+}
+
+int websocketclient::outboundQueueSize() const {
+  QMutexLocker locker(&m_sharedMutex);
+  return m_outboundQueue.size();
+}
+
+void websocketclient::releaseOutboundQueue() {
+  if (postToOwnerThread([this]() { releaseOutboundQueue(); })) {
+    return;
+  }
+  m_outboundHeld = false;
+  flushOutboundQueue();
+}
+
 bool websocketclient::isConnected() const {
-  return m_socket.state() == QAbstractSocket::ConnectedState;
+  return state() == QAbstractSocket::ConnectedState;
 }
 
 QAbstractSocket::SocketState websocketclient::state() const {
-  return m_socket.state();
+  if (isOwnerThread()) {
+    return m_socket.state();
+  }
+  return static_cast<QAbstractSocket::SocketState>(m_publishedState.load());
 }
 
 QUrl websocketclient::url() const {
+  QMutexLocker locker(&m_sharedMutex);
   return m_url;
 }
 
+void websocketclient::setAutoReconnectEnabled(bool enabled) {
+  m_autoReconnectEnabled = enabled;
+  if (postToOwnerThread([this, enabled]() { setAutoReconnectEnabled(enabled); })) {
+    return;
+  }
+  if (!enabled) {
+    m_reconnectTimer.stop();
+    m_reconnectAttempt = 0;
+  }
+}
+
+void websocketclient::setReconnectBackoff(int initialDelayMs, int maxDelayMs) {
+  m_reconnectInitialDelayMs = qMax(1, initialDelayMs);
+  m_reconnectMaxDelayMs = qMax(m_reconnectInitialDelayMs.load(), maxDelayMs);
+}
+
+bool websocketclient::isAutoReconnectEnabled() const {
+  return m_autoReconnectEnabled;
+}
+
+bool websocketclient::isReconnecting() const {
+  // The attempt counter is raised before the timer starts and reset on connect.
+  return m_reconnectAttempt > 0 && !isConnected();
+}
+
+void websocketclient::reconnectNow() {
+  if (postToOwnerThread([this]() { reconnectNow(); })) {
+    return;
+  }
+  if (!shouldReconnect() || isConnected() ||
+      m_socket.state() == QAbstractSocket::ConnectingState) {
+    return;
+  }
+  m_reconnectTimer.stop();
+  if (m_reconnectAttempt == 0) {
+    m_reconnectAttempt = 1;
+  }
+  qInfo() << "[WebSocket] reconnect now, url=" << m_url.toString()
+          << "attempt=" << m_reconnectAttempt.load();
+  m_socket.open(m_url);
+}
+
+void websocketclient::setHeartbeatInterval(int intervalMs) {
+  m_heartbeatIntervalMs = qMax(0, intervalMs);
+  if (postToOwnerThread([this, intervalMs]() { setHeartbeatInterval(intervalMs); })) {
+    return;
+  }
+  if (isConnected()) {
+    startHeartbeat();
+  }
+}
+
+int websocketclient::heartbeatInterval() const {
+  return m_heartbeatIntervalMs;
+}
+
+void websocketclient::setHeartbeatMaxMissedPongs(int count) {
+  m_heartbeatMaxMissedPongs = qMax(1, count);
+}
+
+int websocketclient::heartbeatMaxMissedPongs() const {
+  return m_heartbeatMaxMissedPongs;
+}
+
+HeartbeatStats websocketclient::heartbeatStats() const {
+  HeartbeatStats stats;
+  stats.missedPongs = m_missedPongs;
+  stats.staleConnectionCount = m_staleConnectionCount;
+  QVector<quint64> sorted;
+  {
+    QMutexLocker locker(&m_sharedMutex);
+    stats.lastRttMs = m_lastRttMs;
+    sorted = m_rttSamples;
+  }
+  stats.sampleCount = static_cast<int>(sorted.size());
+  if (sorted.isEmpty()) {
+    return stats;
+  }
+
+  std::sort(sorted.begin(), sorted.end());
+  stats.p50RttMs = nearestRankPercentile(sorted, 50);
+  stats.p95RttMs = nearestRankPercentile(sorted, 95);
+  stats.p99RttMs = nearestRankPercentile(sorted, 99);
+  return stats;
+}
+
+quint64 websocketclient::nearestRankPercentile(const QVector<quint64> &sorted,
+                                               int percent) {
+  const int count = static_cast<int>(sorted.size());
+  if (count == 0) {
+    return 0;
+  }
+  // The smallest sample with at least percent% of the samples at or below it.
+  const int rank = (percent * count + 99) / 100;
+  return sorted.at(qBound(0, rank - 1, count - 1));
+}
+
 void websocketclient::onConnected() {
+  const bool resumed = m_reconnectAttempt > 0;
+  m_reconnectTimer.stop();
+  m_reconnectAttempt = 0;
+  {
+    // Frames written on the old connection may never have arrived.
+    QMutexLocker locker(&m_sharedMutex);
+    m_writtenFrameIds.clear();
+  }
+  startHeartbeat();
+  // Queued frames must not overtake the session resume handshake.
+  m_outboundHeld = resumed;
   emit connected();
+  if (resumed) {
+    qInfo() << "[WebSocket] reconnected, url=" << m_url.toString();
+    emit reconnected();
+  } else {
+    flushOutboundQueue();
+  }
 }
 
 void websocketclient::onDisconnected() {
+  stopHeartbeat();
+  // Schedule first so that listeners can already see isReconnecting().
+  if (shouldReconnect()) {
+    scheduleReconnect();
+  }
   emit disconnected();
 }
 
 void websocketclient::onTextMessageReceived(const QString &message) {
-  emit textMessageReceived(message);
+  // Any inbound frame proves the link is alive.
+  m_missedPongs = 0;
+  // Encode into a buffer that keeps its capacity between frames instead of
+  // allocating a fresh QByteArray per frame with toUtf8().
+  QStringEncoder encoder(QStringEncoder::Utf8, QStringEncoder::Flag::Stateless);
+  m_inboundUtf8.resize(encoder.requiredSpace(message.size()));
+  char *end = encoder.appendToBuffer(m_inboundUtf8.data(), message);
+  m_inboundUtf8.truncate(end - m_inboundUtf8.constData());
+  handleInboundFrame(m_inboundUtf8);
 }
 
 void websocketclient::onBinaryMessageReceived(const QByteArray &data) {
+  m_missedPongs = 0;
   emit binaryMessageReceived(data);
+  handleInboundFrame(data);
 }
 
 void websocketclient::onErrorOccurred(QAbstractSocket::SocketError error) {
@@ -96,9 +416,186 @@ void websocketclient::onErrorOccurred(QAbstractSocket::SocketError error) {
 }
 
 void websocketclient::onStateChanged(QAbstractSocket::SocketState state) {
+  m_publishedState = state;
+  // A failed connect attempt never emits disconnected(), only UnconnectedState.
+  if (state == QAbstractSocket::UnconnectedState && m_reconnectAttempt > 0 &&
+      shouldReconnect()) {
+    scheduleReconnect();
+  }
   emit stateChanged(state);
 }
 
 void websocketclient::onPong(quint64 elapsedTime, const QByteArray &payload) {
+  m_awaitingPong = false;
+  m_missedPongs = 0;
+  recordRttSample(elapsedTime);
   emit pongReceived(elapsedTime, payload);
+
+  const HeartbeatStats stats = heartbeatStats();
+  if (++m_pongCount % kHeartbeatLogEveryPongs == 1) {
+    qInfo() << "[WebSocket] heartbeat rtt_ms last=" << stats.lastRttMs
+            << "p50=" << stats.p50RttMs << "p95=" << stats.p95RttMs
+            << "p99=" << stats.p99RttMs << "samples=" << stats.sampleCount;
+  }
+  emit heartbeatStatsUpdated(stats);
+}
+
+void websocketclient::onBytesWritten(qint64 bytes) {
+  Q_UNUSED(bytes);
+  flushOutboundQueue();
+}
+
+void websocketclient::onHeartbeatTimeout() {
+  if (!isConnected()) {
+    stopHeartbeat();
+    return;
+  }
+
+  if (m_awaitingPong && ++m_missedPongs >= m_heartbeatMaxMissedPongs) {
+    ++m_staleConnectionCount;
+    const int missedPongs = m_missedPongs;
+    qWarning() << "[WebSocket] heartbeat lost, missed_pongs=" << missedPongs
+               << "abort half-open connection";
+    stopHeartbeat();
+    emit connectionStalled(missedPongs);
+    // abort() surfaces as disconnected(), which runs the reconnect path.
+    m_socket.abort();
+    return;
+  }
+
+  m_awaitingPong = true;
+  m_socket.ping(QByteArray::number(++m_pingSequence));
+}
+
+void websocketclient::onReconnectTimeout() {
+  if (!shouldReconnect() || isConnected() ||
+      m_socket.state() == QAbstractSocket::ConnectingState) {
+    return;
+  }
+  qInfo() << "[WebSocket] reconnect attempt=" << m_reconnectAttempt.load()
+          << "url=" << m_url.toString();
+  m_socket.open(m_url);
+}
+
+void websocketclient::onReachabilityChanged(
+    QNetworkInformation::Reachability reachability) {
+  if (reachability != QNetworkInformation::Reachability::Online &&
+      reachability != QNetworkInformation::Reachability::Site) {
+    return;
+  }
+  if (!m_reconnectTimer.isActive()) {
+    return;
+  }
+  // The network came back: skip the remaining backoff and retry right away.
+  qInfo() << "[WebSocket] network reachable again, retry immediately";
+  reconnectNow();
+}
+
+bool websocketclient::isOwnerThread() const {
+  return QThread::currentThread() == thread();
+}
+
+bool websocketclient::postToOwnerThread(std::function<void()> task) {
+  if (isOwnerThread()) {
+    return false;
+  }
+  QMetaObject::invokeMethod(this, std::move(task), Qt::QueuedConnection);
+  return true;
+}
+
+void websocketclient::handleInboundFrame(const QByteArray &utf8Payload) {
+  protocol::Envelope envelope;
+  QString parseError;
+  if (!protocol::parseEnvelope(utf8Payload, &envelope, &parseError)) {
+    qWarning() << "[WebSocket] drop frame: parse failed, error=" << parseError;
+    emit envelopeParseFailed(parseError);
+    return;
+  }
+  emit envelopeReceived(envelope);
+}
+
+bool websocketclient::shouldReconnect() const {
+  return m_autoReconnectEnabled && !m_closeRequested && m_url.isValid();
+}
+
+void websocketclient::scheduleReconnect() {
+  if (m_reconnectTimer.isActive()) {
+    return;
+  }
+
+  const int maxDelayMs = m_reconnectMaxDelayMs;
+  const int exponent = qMin(m_reconnectAttempt.load(), 16);
+  const int baseDelay = static_cast<int>(
+      qMin<qint64>(static_cast<qint64>(m_reconnectInitialDelayMs.load()) << exponent,
+                   maxDelayMs));
+  const int jitterRange = baseDelay * kReconnectJitterPercent / 100;
+  const int jitter =
+      jitterRange > 0
+          ? QRandomGenerator::global()->bounded(-jitterRange, jitterRange + 1)
+          : 0;
+  const int delayMs = qBound(0, baseDelay + jitter, maxDelayMs);
+
+  const int attempt = ++m_reconnectAttempt;
+  qInfo() << "[WebSocket] schedule reconnect attempt=" << attempt
+          << "delay_ms=" << delayMs;
+  m_reconnectTimer.start(delayMs);
+  emit reconnectScheduled(attempt, delayMs);
+}
+
+void websocketclient::startHeartbeat() {
+  m_awaitingPong = false;
+  m_missedPongs = 0;
+  const int intervalMs = m_heartbeatIntervalMs;
+  if (intervalMs <= 0) {
+    m_heartbeatTimer.stop();
+    return;
+  }
+  m_heartbeatTimer.start(intervalMs);
+}
+
+void websocketclient::stopHeartbeat() {
+  m_heartbeatTimer.stop();
+  m_awaitingPong = false;
+}
+
+void websocketclient::recordRttSample(quint64 rttMs) {
+  QMutexLocker locker(&m_sharedMutex);
+  m_lastRttMs = rttMs;
+  if (m_rttSamples.size() < kRttWindowSize) {
+    m_rttSamples.append(rttMs);
+    return;
+  }
+  m_rttSamples[m_rttSampleCursor] = rttMs;
+  m_rttSampleCursor = (m_rttSampleCursor + 1) % kRttWindowSize;
+}
+
+void websocketclient::flushOutboundQueue() {
+  if (m_outboundHeld || !isConnected()) {
+    return;
+  }
+  // Stop above the watermark; bytesWritten() resumes the flush.
+  bool flushed = false;
+  int pendingFrames = 0;
+  while (m_socket.bytesToWrite() < kOutboundHighWatermarkBytes) {
+    OutboundFrame frame;
+    {
+      QMutexLocker locker(&m_sharedMutex);
+      if (m_outboundQueue.isEmpty()) {
+        break;
+      }
+      frame = m_outboundQueue.dequeue();
+      m_outboundQueueBytes -=
+          frame.message.size() * static_cast<qint64>(sizeof(QChar));
+      pendingFrames = m_outboundQueue.size();
+      if (!frame.frameId.isEmpty()) {
+        m_queuedFrameIds.remove(frame.frameId);
+        m_writtenFrameIds.insert(frame.frameId);
+      }
+    }
+    m_socket.sendTextMessage(frame.message);
+    flushed = true;
+  }
+  if (flushed) {
+    emit outboundQueueChanged(pendingFrames);
+  }
 }
@@ -3,9 +3,33 @@
 
 #include <QObject>
 #include <QAbstractSocket>
+#include <QMetaType>
+#include <QMutex>
+#include <QQueue>
+#include <QSet>
+#include <QNetworkInformation>
+#include <QThread>
+#include <QTimer>
 #include <QUrl>
+#include <QVector>
 #include <QtWebSockets/QWebSocket>
 
+#include <atomic>
+#include <functional>
+
+#include "protocol.h"
+
+struct HeartbeatStats {
+    int sampleCount = 0;
+    quint64 lastRttMs = 0;
+    quint64 p50RttMs = 0;
+    quint64 p95RttMs = 0;
+    quint64 p99RttMs = 0;
+    int missedPongs = 0;
+    int staleConnectionCount = 0;
+};
+Q_DECLARE_METATYPE(HeartbeatStats)
+
 class websocketclient : public QObject
 {
     Q_OBJECT
@@ -14,23 +38,71 @@ public:
     ~websocketclient() override = default;
 
 public:
+    // Moves the socket, frame parsing, heartbeat and reconnect timers onto a
+    // dedicated thread so a busy GUI thread cannot stall socket reads or pongs.
+    // Signals then reach GUI receivers as queued calls and the public API may
+    // be called from any thread. Call from the GUI thread before open().
+    void startNetworkThread();
+    void stopNetworkThread();
+    bool isNetworkThreadRunning() const;
+
     void open(const QUrl &url);
     void close(QWebSocketProtocol::CloseCode code = QWebSocketProtocol::CloseCodeNormal,
                const QString &reason = QString());
     void sendTextMessage(const QString &message);
     void sendBinaryMessage(const QByteArray &data);
+    // Buffered send: frames wait in a bounded FIFO while the socket is down,
+    // while the queue is held after a reconnect, or while bytesToWrite is above
+    // the watermark. Returns false only when the queue is full. A frameId
+    // lets requeueTextMessage() recognise the frame later.
+    bool queueTextMessage(const QString &message, const QString &frameId = QString());
+    // Queues the frame again unless it is still queued or was already written
+    // on the current connection. Returns false only when the queue is full.
+    bool requeueTextMessage(const QString &message, const QString &frameId);
+    // The frame was answered; requeueTextMessage() may send it again.
+    void forgetFrame(const QString &frameId);
+    int outboundQueueSize() const;
+    // After a reconnect the queue stays held until the session is resumed.
+    void releaseOutboundQueue();
     bool isConnected() const;
     QAbstractSocket::SocketState state() const;
     QUrl url() const;
 
+    // Reconnects with jittered exponential backoff after an unexpected drop.
+    void setAutoReconnectEnabled(bool enabled);
+    // The delay starts at initialDelayMs, doubles per failed attempt up to
+    // maxDelayMs and is jittered by up to 20% within that cap.
+    void setReconnectBackoff(int initialDelayMs, int maxDelayMs);
+    bool isAutoReconnectEnabled() const;
+    bool isReconnecting() const;
+    void reconnectNow();
+
+    // Pings every intervalMs (0 disables). After maxMissedPongs unanswered pings
+    // the connection is treated as half-open and aborted, so a dead link is
+    // detected within intervalMs * (maxMissedPongs + 1) and handed to reconnect.
+    void setHeartbeatInterval(int intervalMs);
+    int heartbeatInterval() const;
+    void setHeartbeatMaxMissedPongs(int count);
+    int heartbeatMaxMissedPongs() const;
+    HeartbeatStats heartbeatStats() const;
+    // Nearest-rank percentile of ascending samples; 0 when there are none.
+    static quint64 nearestRankPercentile(const QVector<quint64> &sorted, int percent);
+
 signals:
     void connected();
     void disconnected();
-    void textMessageReceived(const QString &message);
     void binaryMessageReceived(const QByteArray &data);
+    // Every inbound frame is parsed once, on the transport thread.
+    void envelopeReceived(const protocol::Envelope &envelope);
+    void envelopeParseFailed(const QString &error);
     void errorOccurred(QAbstractSocket::SocketError error, const QString &message);
     void stateChanged(QAbstractSocket::SocketState state);
     void pongReceived(quint64 elapsedTime, const QByteArray &payload);
+    void reconnectScheduled(int attempt, int delayMs);
+    void reconnected();
+    void heartbeatStatsUpdated(const HeartbeatStats &stats);
+    void connectionStalled(int missedPongs);
+    void outboundQueueChanged(int pendingFrames);
 
 private slots:
     void onConnected();
@@ -40,13 +112,74 @@ private slots:
     void onErrorOccurred(QAbstractSocket::SocketError error);
     void onStateChanged(QAbstractSocket::SocketState state);
     void onPong(quint64 elapsedTime, const QByteArray &payload);
+    void onReconnectTimeout();
+    void onReachabilityChanged(QNetworkInformation::Reachability reachability);
+    void onHeartbeatTimeout();
+    void onBytesWritten(qint64 bytes);
 
 private:
     explicit websocketclient(QObject *parent = nullptr);
     Q_DISABLE_COPY_MOVE(websocketclient)
 
+    bool isOwnerThread() const;
+    bool postToOwnerThread(std::function<void()> task);
+    void handleInboundFrame(const QByteArray &utf8Payload);
+    bool shouldReconnect() const;
+    void scheduleReconnect();
+    void startHeartbeat();
+    void stopHeartbeat();
+    void recordRttSample(quint64 rttMs);
+    void flushOutboundQueue();
+    bool enqueueLocked(const QString &message, const QString &frameId);
+
     QWebSocket m_socket;
+    QThread *m_networkThread = nullptr;
+    // Guards state read from other threads: url, RTT window, outbound queue.
+    mutable QMutex m_sharedMutex;
+    std::atomic_int m_publishedState{QAbstractSocket::UnconnectedState};
     QUrl m_url;
+    // Owner thread only; reused for every text frame.
+    QByteArray m_inboundUtf8;
+    QTimer m_reconnectTimer;
+    std::atomic_bool m_autoReconnectEnabled{false};
+    bool m_closeRequested = false;
+    std::atomic_int m_reconnectAttempt{0};
+    std::atomic_int m_reconnectInitialDelayMs{kReconnectInitialDelayMs};
+    std::atomic_int m_reconnectMaxDelayMs{kReconnectMaxDelayMs};
+    static constexpr int kReconnectInitialDelayMs = 500;
+    static constexpr int kReconnectMaxDelayMs = 30 * 1000;
+    static constexpr int kReconnectJitterPercent = 20;
+
+    QTimer m_heartbeatTimer;
+    std::atomic_int m_heartbeatIntervalMs{kHeartbeatDefaultIntervalMs};
+    std::atomic_int m_heartbeatMaxMissedPongs{kHeartbeatDefaultMaxMissedPongs};
+    bool m_awaitingPong = false;
+    std::atomic_int m_missedPongs{0};
+    quint32 m_pingSequence = 0;
+    QVector<quint64> m_rttSamples;
+    int m_rttSampleCursor = 0;
+    quint64 m_lastRttMs = 0;
+    int m_pongCount = 0;
+    std::atomic_int m_staleConnectionCount{0};
+    static constexpr int kHeartbeatDefaultIntervalMs = 15 * 1000;
+    static constexpr int kHeartbeatDefaultMaxMissedPongs = 2;
+    static constexpr int kRttWindowSize = 128;
+    static constexpr int kHeartbeatLogEveryPongs = 20;
+
+    struct OutboundFrame {
+        QString frameId;
+        QString message;
+    };
+    QQueue<OutboundFrame> m_outboundQueue;
+    qint64 m_outboundQueueBytes = 0;
+    // Tagged frames waiting in the queue, and those written on the current
+    // connection that have not been answered yet.
+    QSet<QString> m_queuedFrameIds;
+    QSet<QString> m_writtenFrameIds;
+    bool m_outboundHeld = false;
+    static constexpr int kOutboundQueueMaxFrames = 512;
+    static constexpr qint64 kOutboundQueueMaxBytes = 4 * 1024 * 1024;
+    static constexpr qint64 kOutboundHighWatermarkBytes = 256 * 1024;
 };
 
 #endif // WEBSOCKETCLIENT_H
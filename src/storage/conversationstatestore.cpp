@@ -0,0 +1,360 @@
+#include "conversationstatestore.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTimeZone>
+
+#include <algorithm>
+
+namespace {
+constexpr int kDefaultFlushDelayMs = 250;
+// The journal is rewritten once it holds this many times more records than
+// there are conversations.
+constexpr int kCompactRatio = 4;
+constexpr int kMinRecordsBeforeCompact = 64;
+
+bool sameState(const ConversationState &a, const ConversationState &b) {
+  return a.unreadCount == b.unreadCount && a.lastSeq == b.lastSeq &&
+         a.lastReadSeq == b.lastReadSeq && a.lastPreview == b.lastPreview &&
+         a.lastActivityAt == b.lastActivityAt && a.pinned == b.pinned;
+}
+
+QByteArray encodeState(const ConversationState &state) {
+  QJsonObject obj;
+  obj.insert(QStringLiteral("id"), state.conversationId);
+  obj.insert(QStringLiteral("unread"), state.unreadCount);
+  obj.insert(QStringLiteral("last_seq"), state.lastSeq);
+  obj.insert(QStringLiteral("read_seq"), state.lastReadSeq);
+  obj.insert(QStringLiteral("preview"), state.lastPreview);
+  if (state.lastActivityAt.isValid()) {
+    obj.insert(QStringLiteral("at"), state.lastActivityAt.toMSecsSinceEpoch());
+  }
+  if (state.pinned) {
+    obj.insert(QStringLiteral("pinned"), true);
+  }
+  return QJsonDocument(obj).toJson(QJsonDocument::Compact) + '\n';
+}
+
+QByteArray encodeRemoval(const QString &conversationId) {
+  QJsonObject obj;
+  obj.insert(QStringLiteral("id"), conversationId);
+  obj.insert(QStringLiteral("removed"), true);
+  return QJsonDocument(obj).toJson(QJsonDocument::Compact) + '\n';
+}
+} // namespace
+
+ConversationStateStore *ConversationStateStore::instance() {
+  static ConversationStateStore instance;
+  return &instance;
+}
+
+ConversationStateStore::ConversationStateStore(QObject *parent)
+    : QObject(parent) {
+  m_flushTimer.setSingleShot(true);
+  m_flushTimer.setInterval(kDefaultFlushDelayMs);
+  connect(&m_flushTimer, &QTimer::timeout, this, [this]() {
+    QString error;
+    if (!flush(&error)) {
+      qWarning() << "[ConversationState] flush failed, error=" << error;
+    }
+  });
+}
+
+ConversationStateStore::~ConversationStateStore() { flush(); }
+
+bool ConversationStateStore::openForUser(const QString &userId, QString *error) {
+  const QString trimmed = userId.trimmed();
+  if (trimmed.isEmpty()) {
+    close();
+    if (error) {
+      *error = QStringLiteral("user_id is required");
+    }
+    return false;
+  }
+  return openAt(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+                    QStringLiteral("/conversations/%1.journal").arg(trimmed),
+                error);
+}
+
+bool ConversationStateStore::openAt(const QString &filePath, QString *error) {
+  close();
+  m_filePath = filePath;
+  QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+  if (!load(error)) {
+    m_filePath.clear();
+    m_states.clear();
+    return false;
+  }
+  return true;
+}
+
+void ConversationStateStore::close() {
+  QString error;
+  if (!flush(&error)) {
+    qWarning() << "[ConversationState] flush on close failed, error=" << error;
+  }
+  m_flushTimer.stop();
+  m_filePath.clear();
+  m_states.clear();
+  m_dirty.clear();
+  m_journalRecords = 0;
+}
+
+bool ConversationStateStore::isOpen() const { return !m_filePath.isEmpty(); }
+
+void ConversationStateStore::setFlushDelayMs(int ms) {
+  m_flushTimer.setInterval(std::max(0, ms));
+}
+
+bool ConversationStateStore::flush(QString *error) {
+  m_flushTimer.stop();
+  if (m_filePath.isEmpty() || m_dirty.isEmpty()) {
+    m_dirty.clear();
+    return true;
+  }
+
+  QByteArray records;
+  for (const QString &conversationId : std::as_const(m_dirty)) {
+    const auto it = m_states.constFind(conversationId);
+    records += it == m_states.cend() ? encodeRemoval(conversationId)
+                                     : encodeState(it.value());
+  }
+
+  QFile file(m_filePath);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Append) ||
+      file.write(records) != records.size()) {
+    if (error) {
+      *error = file.errorString();
+    }
+    // The dirty set is kept; the next change retries.
+    return false;
+  }
+  file.close();
+  m_journalRecords += m_dirty.size();
+  m_dirty.clear();
+
+  if (m_journalRecords >= kMinRecordsBeforeCompact &&
+      m_journalRecords > kCompactRatio * m_states.size()) {
+    return compact(error);
+  }
+  return true;
+}
+
+ConversationState ConversationStateStore::state(
+    const QString &conversationId) const {
+  ConversationState state = m_states.value(conversationId);
+  state.conversationId = conversationId;
+  return state;
+}
+
+int ConversationStateStore::unreadCount(const QString &conversationId) const {
+  const auto it = m_states.constFind(conversationId);
+  return it == m_states.cend() ? 0 : it->unreadCount;
+}
+
+int ConversationStateStore::conversationCount() const { return m_states.size(); }
+
+QList<ConversationState> ConversationStateStore::states() const {
+  return m_states.values();
+}
+
+void ConversationStateStore::recordIncoming(const QString &conversationId,
+                                            qint64 seq, const QString &preview,
+                                            const QDateTime &at, bool read) {
+  ConversationState next = state(conversationId);
+  next.lastSeq = std::max(next.lastSeq, seq);
+  next.lastPreview = preview;
+  next.lastActivityAt = at.isValid() ? at.toUTC() : QDateTime::currentDateTimeUtc();
+  if (read) {
+    next.unreadCount = 0;
+    next.lastReadSeq = next.lastSeq;
+  } else if (seq <= 0 || seq > next.lastReadSeq) {
+    // Already read on another device when seq is at or below the read mark.
+    ++next.unreadCount;
+  }
+  store(next);
+}
+
+void ConversationStateStore::recordOutgoing(const QString &conversationId,
+                                            qint64 seq, const QString &preview,
+                                            const QDateTime &at) {
+  ConversationState next = state(conversationId);
+  next.lastSeq = std::max(next.lastSeq, seq);
+  next.lastReadSeq = next.lastSeq;
+  next.unreadCount = 0;
+  next.lastPreview = preview;
+  next.lastActivityAt = at.isValid() ? at.toUTC() : QDateTime::currentDateTimeUtc();
+  store(next);
+}
+
+void ConversationStateStore::acknowledgeOutgoing(const QString &conversationId,
+                                                 qint64 seq) {
+  ConversationState next = state(conversationId);
+  next.lastSeq = std::max(next.lastSeq, seq);
+  next.lastReadSeq = std::max(next.lastReadSeq, seq);
+  if (next.lastReadSeq >= next.lastSeq) {
+    next.unreadCount = 0;
+  }
+  store(next);
+}
+
+void ConversationStateStore::markRead(const QString &conversationId) {
+  const auto it = m_states.constFind(conversationId);
+  if (it == m_states.cend()) {
+    return;
+  }
+  ConversationState next = it.value();
+  next.unreadCount = 0;
+  next.lastReadSeq = next.lastSeq;
+  store(next);
+}
+
+void ConversationStateStore::reconcile(const QString &conversationId,
+                                       const ServerConversationState &server) {
+  ConversationState next = state(conversationId);
+  const qint64 knownSeq = next.lastSeq;
+
+  if (server.lastSeq > knownSeq) {
+    // Messages that arrived while the client was away. With no count from
+    // the server, each unseen seq past the read mark is one unread message.
+    if (server.unreadCount < 0 && knownSeq > 0) {
+      const qint64 readUpTo = std::max(knownSeq, server.lastReadSeq);
+      next.unreadCount +=
+          static_cast<int>(std::max<qint64>(0, server.lastSeq - readUpTo));
+    }
+    next.lastSeq = server.lastSeq;
+  }
+  if (server.unreadCount >= 0 && server.lastSeq >= knownSeq) {
+    next.unreadCount = server.unreadCount;
+  }
+  if (server.lastReadSeq > next.lastReadSeq) {
+    next.lastReadSeq = server.lastReadSeq;
+  }
+  if (next.lastSeq > 0 && next.lastReadSeq >= next.lastSeq) {
+    next.unreadCount = 0;
+  }
+
+  const bool serverIsNewer =
+      server.lastActivityAt.isValid() &&
+      (!next.lastActivityAt.isValid() || server.lastActivityAt > next.lastActivityAt);
+  if (serverIsNewer) {
+    next.lastActivityAt = server.lastActivityAt.toUTC();
+    if (!server.lastPreview.isEmpty()) {
+      next.lastPreview = server.lastPreview;
+    }
+  } else if (next.lastPreview.isEmpty() && !server.lastPreview.isEmpty()) {
+    next.lastPreview = server.lastPreview;
+  }
+  next.pinned = server.pinned;
+  store(next);
+}
+
+void ConversationStateStore::remove(const QString &conversationId) {
+  if (m_states.remove(conversationId) == 0) {
+    return;
+  }
+  m_dirty.insert(conversationId);
+  if (isOpen()) {
+    m_flushTimer.start();
+  }
+  emit stateChanged(conversationId);
+}
+
+void ConversationStateStore::store(const ConversationState &state) {
+  if (state.conversationId.isEmpty()) {
+    return;
+  }
+  const auto it = m_states.constFind(state.conversationId);
+  if (it != m_states.cend() && sameState(it.value(), state)) {
+    return;
+  }
+  m_states.insert(state.conversationId, state);
+  m_dirty.insert(state.conversationId);
+  // Bursts of messages collapse into one journal write per conversation.
+  if (isOpen() && !m_flushTimer.isActive()) {
+    m_flushTimer.start();
+  }
+  emit stateChanged(state.conversationId);
+}
+
+bool ConversationStateStore::load(QString *error) {
+  QFile file(m_filePath);
+  if (!file.exists()) {
+    return true;
+  }
+  if (!file.open(QIODevice::ReadOnly)) {
+    if (error) {
+      *error = file.errorString();
+    }
+    return false;
+  }
+
+  int skipped = 0;
+  while (!file.atEnd()) {
+    const QByteArray line = file.readLine().trimmed();
+    if (line.isEmpty()) {
+      continue;
+    }
+    ++m_journalRecords;
+    const QJsonObject obj = QJsonDocument::fromJson(line).object();
+    const QString conversationId = obj.value(QStringLiteral("id")).toString();
+    if (conversationId.isEmpty()) {
+      // A line cut short by a crash; later lines are still good.
+      ++skipped;
+      continue;
+    }
+    if (obj.value(QStringLiteral("removed")).toBool(false)) {
+      m_states.remove(conversationId);
+      continue;
+    }
+    ConversationState state;
+    state.conversationId = conversationId;
+    state.unreadCount = obj.value(QStringLiteral("unread")).toInt();
+    state.lastSeq = obj.value(QStringLiteral("last_seq")).toInteger();
+    state.lastReadSeq = obj.value(QStringLiteral("read_seq")).toInteger();
+    state.lastPreview = obj.value(QStringLiteral("preview")).toString();
+    if (obj.contains(QStringLiteral("at"))) {
+      state.lastActivityAt = QDateTime::fromMSecsSinceEpoch(
+          obj.value(QStringLiteral("at")).toInteger(), QTimeZone::UTC);
+    }
+    state.pinned = obj.value(QStringLiteral("pinned")).toBool(false);
+    m_states.insert(conversationId, state);
+  }
+  file.close();
+  qInfo() << "[ConversationState] loaded" << m_states.size()
+          << "conversations from" << m_journalRecords << "records, skipped="
+          << skipped;
+
+  if (skipped > 0 || (m_journalRecords >= kMinRecordsBeforeCompact &&
+                      m_journalRecords > kCompactRatio * m_states.size())) {
+    return compact(error);
+  }
+  return true;
+}
+
+bool ConversationStateStore::compact(QString *error) {
+  QSaveFile file(m_filePath);
+  if (!file.open(QIODevice::WriteOnly)) {
+    if (error) {
+      *error = file.errorString();
+    }
+    return false;
+  }
+  for (const ConversationState &state : std::as_const(m_states)) {
+    file.write(encodeState(state));
+  }
+  if (!file.commit()) {
+    if (error) {
+      *error = file.errorString();
+    }
+    return false;
+  }
+  m_journalRecords = m_states.size();
+  return true;
+}
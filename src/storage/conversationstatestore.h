@@ -0,0 +1,94 @@
+#ifndef CONVERSATIONSTATESTORE_H
+#define CONVERSATIONSTATESTORE_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+
+// Read state of one conversation as the client last knew it.
+struct ConversationState {
+  QString conversationId;
+  int unreadCount = 0;
+  qint64 lastSeq = 0;
+  qint64 lastReadSeq = 0;
+  QString lastPreview;
+  QDateTime lastActivityAt;
+  bool pinned = false;
+};
+
+// What LIST_CONVERSATIONS reports about a conversation's read state. Fields
+// the server does not send stay at their defaults and are ignored.
+struct ServerConversationState {
+  qint64 lastSeq = 0;
+  qint64 lastReadSeq = 0;
+  int unreadCount = -1;
+  QString lastPreview;
+  QDateTime lastActivityAt;
+  bool pinned = false;
+};
+
+// Unread counts, read positions, last-message previews and the activity
+// ordering keys (pinned, last activity) of the logged-in user, kept apart
+// from the server's conversation list so a list refresh never resets them.
+// Changes are appended to a per-user journal under
+// AppDataLocation/conversations/ in short batches; the journal is rewritten
+// once it holds mostly superseded records. Without an open file the store
+// still works in memory.
+class ConversationStateStore : public QObject {
+  Q_OBJECT
+
+public:
+  static ConversationStateStore *instance();
+  explicit ConversationStateStore(QObject *parent = nullptr);
+  ~ConversationStateStore() override;
+
+  bool openForUser(const QString &userId, QString *error = nullptr);
+  bool openAt(const QString &filePath, QString *error = nullptr);
+  // Writes pending changes, then forgets every state.
+  void close();
+  bool isOpen() const;
+  bool flush(QString *error = nullptr);
+  void setFlushDelayMs(int ms);
+
+  ConversationState state(const QString &conversationId) const;
+  int unreadCount(const QString &conversationId) const;
+  int conversationCount() const;
+  QList<ConversationState> states() const;
+
+  // A message from someone else. It counts as unread unless the user is
+  // looking at the conversation.
+  void recordIncoming(const QString &conversationId, qint64 seq,
+                      const QString &preview, const QDateTime &at, bool read);
+  // Our own message; sending implies everything before it was read.
+  void recordOutgoing(const QString &conversationId, qint64 seq,
+                      const QString &preview, const QDateTime &at);
+  // The ack of our own message carries its seq; the preview is already set.
+  void acknowledgeOutgoing(const QString &conversationId, qint64 seq);
+  void markRead(const QString &conversationId);
+  // Folds server state in without losing local progress: read positions and
+  // seqs only move forward, and a server unread count older than what the
+  // client has seen is ignored. Pinning is owned by the server.
+  void reconcile(const QString &conversationId,
+                 const ServerConversationState &server);
+  void remove(const QString &conversationId);
+
+signals:
+  void stateChanged(const QString &conversationId);
+
+private:
+  void store(const ConversationState &state);
+  bool load(QString *error);
+  bool compact(QString *error);
+
+  QString m_filePath;
+  QHash<QString, ConversationState> m_states;
+  // Conversation ids whose latest state is not in the journal yet.
+  QSet<QString> m_dirty;
+  QTimer m_flushTimer;
+  int m_journalRecords = 0;
+};
+
+#endif // CONVERSATIONSTATESTORE_H
@@ -0,0 +1,419 @@
+#include "messagestore.h"
+
+#include <QCborMap>
+#include <QCborValue>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr char kFileMagic[] = "QTMSGLOG";
+constexpr qint64 kFileMagicSize = 8;
+constexpr quint32 kFileVersion = 1;
+constexpr qint64 kFileHeaderSize = kFileMagicSize + 4;
+
+// quint32 body size, quint16 checksum of id + body, quint16 id size,
+// qint64 seq, then the UTF-8 message_id and the CBOR body.
+constexpr qint64 kRecordHeaderSize = 16;
+constexpr quint32 kMaxBodySize = 16 * 1024 * 1024;
+constexpr int kMaxOpenLogs = 32;
+
+constexpr qint64 kContentKey = 0;
+constexpr qint64 kSentAtKey = 1;
+constexpr qint64 kSenderUserIdKey = 2;
+constexpr qint64 kSenderUsernameKey = 3;
+
+QByteArray fileHeader() {
+  QByteArray header(kFileMagic, kFileMagicSize);
+  char version[4];
+  qToLittleEndian<quint32>(kFileVersion, version);
+  header.append(version, sizeof(version));
+  return header;
+}
+
+QByteArray encodeRecord(const StoredMessage &message) {
+  QCborMap body;
+  body.insert(kContentKey, message.content);
+  if (!message.sentAt.isEmpty()) {
+    body.insert(kSentAtKey, message.sentAt);
+  }
+  if (!message.senderUserId.isEmpty()) {
+    body.insert(kSenderUserIdKey, message.senderUserId);
+  }
+  if (!message.senderUsername.isEmpty()) {
+    body.insert(kSenderUsernameKey, message.senderUsername);
+  }
+  const QByteArray id = message.messageId.toUtf8();
+  const QByteArray encodedBody = body.toCborValue().toCbor();
+  const QByteArray checked = id + encodedBody;
+
+  QByteArray record(kRecordHeaderSize, Qt::Uninitialized);
+  char *out = record.data();
+  qToLittleEndian<quint32>(static_cast<quint32>(encodedBody.size()), out);
+  qToLittleEndian<quint16>(qChecksum(checked), out + 4);
+  qToLittleEndian<quint16>(static_cast<quint16>(id.size()), out + 6);
+  qToLittleEndian<qint64>(message.seq, out + 8);
+  record.append(checked);
+  return record;
+}
+} // namespace
+
+MessageLog::MessageLog(const QString &filePath, const QString &conversationId)
+    : m_filePath(filePath), m_conversationId(conversationId) {}
+
+MessageLog::~MessageLog() { unmap(); }
+
+bool MessageLog::open(QString *error) {
+  QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+  m_file.setFileName(m_filePath);
+  if (!m_file.open(QIODevice::ReadWrite)) {
+    if (error) {
+      *error = m_file.errorString();
+    }
+    return false;
+  }
+  if (m_file.size() == 0) {
+    const QByteArray header = fileHeader();
+    if (m_file.write(header) != header.size() || !m_file.flush()) {
+      if (error) {
+        *error = m_file.errorString();
+      }
+      return false;
+    }
+  }
+  return scan(error);
+}
+
+bool MessageLog::scan(QString *error) {
+  QElapsedTimer timer;
+  timer.start();
+  const qint64 fileSize = m_file.size();
+  if (fileSize < kFileHeaderSize || !ensureMapped(fileSize) ||
+      memcmp(m_map, kFileMagic, kFileMagicSize) != 0 ||
+      qFromLittleEndian<quint32>(m_map + kFileMagicSize) != kFileVersion) {
+    if (error) {
+      *error = QStringLiteral("invalid message log: %1").arg(m_filePath);
+    }
+    return false;
+  }
+
+  m_bySeq.clear();
+  m_seqByMessageId.clear();
+  m_endOffset = fileSize;
+  bool sorted = true;
+  QString lastMessageId;
+  qint64 offset = kFileHeaderSize;
+  qint64 lastOffset = -1;
+  while (offset + kRecordHeaderSize <= fileSize) {
+    const uchar *header = m_map + offset;
+    const quint32 bodySize = qFromLittleEndian<quint32>(header);
+    const quint16 idSize = qFromLittleEndian<quint16>(header + 6);
+    const qint64 seq = qFromLittleEndian<qint64>(header + 8);
+    const qint64 end = offset + kRecordHeaderSize + idSize + bodySize;
+    if (bodySize > kMaxBodySize || idSize == 0 || seq <= 0 || end > fileSize) {
+      break;
+    }
+    const QString messageId = QString::fromUtf8(
+        reinterpret_cast<const char *>(header + kRecordHeaderSize), idSize);
+    if (!m_bySeq.isEmpty() && seq <= m_bySeq.constLast().seq) {
+      sorted = false;
+    }
+    m_bySeq.push_back({seq, offset});
+    m_seqByMessageId.insert(messageId, seq);
+    lastMessageId = messageId;
+    lastOffset = offset;
+    offset = end;
+  }
+
+  // Only the last record can be torn by a crash mid-append; earlier ones are
+  // checked when a page decodes them.
+  if (lastOffset >= 0 && !readAt(lastOffset, nullptr)) {
+    m_seqByMessageId.remove(lastMessageId);
+    m_bySeq.removeLast();
+    offset = lastOffset;
+  }
+  if (offset < fileSize) {
+    qWarning() << "[MessageStore] truncate torn tail file=" << m_filePath
+               << "at=" << offset << "size=" << fileSize;
+    unmap();
+    if (!m_file.resize(offset)) {
+      if (error) {
+        *error = m_file.errorString();
+      }
+      return false;
+    }
+  }
+  if (!sorted) {
+    std::sort(m_bySeq.begin(), m_bySeq.end(),
+              [](const IndexEntry &a, const IndexEntry &b) { return a.seq < b.seq; });
+  }
+  m_endOffset = offset;
+  qInfo() << "[MessageStore] opened" << m_filePath << "messages=" << m_bySeq.size()
+          << "took" << timer.elapsed() << "ms";
+  return true;
+}
+
+bool MessageLog::append(const StoredMessage &message, QString *error) {
+  if (message.seq <= 0 || message.messageId.isEmpty()) {
+    if (error) {
+      *error = QStringLiteral("seq and message_id are required");
+    }
+    return false;
+  }
+  if (containsSeq(message.seq) || containsMessageId(message.messageId)) {
+    return true;
+  }
+
+  const QByteArray record = encodeRecord(message);
+  if (!m_file.seek(m_endOffset) || m_file.write(record) != record.size() ||
+      !m_file.flush()) {
+    if (error) {
+      *error = m_file.errorString();
+    }
+    // Cut a partial write so the next record starts at a clean offset.
+    unmap();
+    m_file.resize(m_endOffset);
+    return false;
+  }
+
+  const IndexEntry entry{message.seq, m_endOffset};
+  m_endOffset += record.size();
+  if (m_bySeq.isEmpty() || message.seq > m_bySeq.constLast().seq) {
+    m_bySeq.push_back(entry);
+  } else {
+    m_bySeq.insert(lowerBound(message.seq), entry);
+  }
+  m_seqByMessageId.insert(message.messageId, message.seq);
+  return true;
+}
+
+int MessageLog::count() const { return m_bySeq.size(); }
+
+qint64 MessageLog::newestSeq() const {
+  return m_bySeq.isEmpty() ? 0 : m_bySeq.constLast().seq;
+}
+
+qint64 MessageLog::oldestSeq() const {
+  return m_bySeq.isEmpty() ? 0 : m_bySeq.constFirst().seq;
+}
+
+bool MessageLog::containsSeq(qint64 seq) const {
+  const int index = lowerBound(seq);
+  return index < m_bySeq.size() && m_bySeq.at(index).seq == seq;
+}
+
+bool MessageLog::containsMessageId(const QString &messageId) const {
+  return m_seqByMessageId.contains(messageId);
+}
+
+bool MessageLog::findByMessageId(const QString &messageId, StoredMessage *out) {
+  const auto it = m_seqByMessageId.constFind(messageId);
+  if (it == m_seqByMessageId.cend()) {
+    return false;
+  }
+  const int index = lowerBound(it.value());
+  return index < m_bySeq.size() && readAt(m_bySeq.at(index).offset, out);
+}
+
+QVector<StoredMessage> MessageLog::newest(int limit) {
+  const int size = static_cast<int>(m_bySeq.size());
+  return readRange(std::max(0, size - limit), size);
+}
+
+QVector<StoredMessage> MessageLog::before(qint64 beforeSeq, int limit) {
+  const int last = lowerBound(beforeSeq);
+  return readRange(std::max(0, last - limit), last);
+}
+
+QVector<StoredMessage> MessageLog::readRange(int first, int last) {
+  QVector<StoredMessage> page;
+  if (first >= last) {
+    return page;
+  }
+  page.reserve(last - first);
+  for (int i = first; i < last; ++i) {
+    StoredMessage message;
+    if (readAt(m_bySeq.at(i).offset, &message)) {
+      page.push_back(message);
+    }
+  }
+  return page;
+}
+
+int MessageLog::lowerBound(qint64 seq) const {
+  const auto it = std::lower_bound(
+      m_bySeq.cbegin(), m_bySeq.cend(), seq,
+      [](const IndexEntry &entry, qint64 value) { return entry.seq < value; });
+  return static_cast<int>(it - m_bySeq.cbegin());
+}
+
+bool MessageLog::ensureMapped(qint64 end) {
+  if (m_map && end <= m_mappedSize) {
+    return true;
+  }
+  unmap();
+  const qint64 size = std::max(end, m_endOffset);
+  m_map = m_file.map(0, size);
+  if (!m_map) {
+    qWarning() << "[MessageStore] map failed file=" << m_filePath
+               << "error=" << m_file.errorString();
+    return false;
+  }
+  m_mappedSize = size;
+  return true;
+}
+
+void MessageLog::unmap() {
+  if (m_map) {
+    m_file.unmap(m_map);
+    m_map = nullptr;
+    m_mappedSize = 0;
+  }
+}
+
+bool MessageLog::readAt(qint64 offset, StoredMessage *out) {
+  if (!ensureMapped(offset + kRecordHeaderSize)) {
+    return false;
+  }
+  const quint32 bodySize = qFromLittleEndian<quint32>(m_map + offset);
+  const quint16 checksum = qFromLittleEndian<quint16>(m_map + offset + 4);
+  const quint16 idSize = qFromLittleEndian<quint16>(m_map + offset + 6);
+  const qint64 end = offset + kRecordHeaderSize + idSize + bodySize;
+  if (end > m_endOffset || !ensureMapped(end)) {
+    return false;
+  }
+
+  const char *id = reinterpret_cast<const char *>(m_map + offset + kRecordHeaderSize);
+  if (qChecksum(QByteArrayView(id, idSize + bodySize)) != checksum) {
+    qWarning() << "[MessageStore] checksum mismatch file=" << m_filePath
+               << "offset=" << offset;
+    return false;
+  }
+  if (!out) {
+    return true;
+  }
+
+  const QCborMap body =
+      QCborValue::fromCbor(QByteArray::fromRawData(id + idSize, bodySize)).toMap();
+  out->conversationId = m_conversationId;
+  out->messageId = QString::fromUtf8(id, idSize);
+  out->seq = qFromLittleEndian<qint64>(m_map + offset + 8);
+  out->content = body.value(kContentKey).toString();
+  out->sentAt = body.value(kSentAtKey).toString();
+  out->senderUserId = body.value(kSenderUserIdKey).toString();
+  out->senderUsername = body.value(kSenderUsernameKey).toString();
+  return true;
+}
+
+MessageStore *MessageStore::instance() {
+  static MessageStore instance;
+  return &instance;
+}
+
+MessageStore::MessageStore() : m_logs(kMaxOpenLogs) {}
+
+bool MessageStore::openForUser(const QString &userId, QString *error) {
+  const QString trimmed = userId.trimmed();
+  if (trimmed.isEmpty()) {
+    close();
+    if (error) {
+      *error = QStringLiteral("user_id is required");
+    }
+    return false;
+  }
+  return openAt(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+                    QStringLiteral("/messages/") + trimmed,
+                error);
+}
+
+bool MessageStore::openAt(const QString &rootPath, QString *error) {
+  close();
+  if (!QDir().mkpath(rootPath)) {
+    if (error) {
+      *error = QStringLiteral("cannot create %1").arg(rootPath);
+    }
+    return false;
+  }
+  m_rootPath = rootPath;
+  return true;
+}
+
+void MessageStore::close() {
+  m_logs.clear();
+  m_rootPath.clear();
+}
+
+bool MessageStore::isOpen() const { return !m_rootPath.isEmpty(); }
+
+bool MessageStore::append(const StoredMessage &message, QString *error) {
+  MessageLog *log = logFor(message.conversationId, error);
+  return log && log->append(message, error);
+}
+
+QVector<StoredMessage> MessageStore::newestPage(const QString &conversationId,
+                                                int limit) {
+  MessageLog *log = logFor(conversationId);
+  return log ? log->newest(limit) : QVector<StoredMessage>();
+}
+
+QVector<StoredMessage> MessageStore::pageBefore(const QString &conversationId,
+                                                qint64 beforeSeq, int limit) {
+  MessageLog *log = logFor(conversationId);
+  return log ? log->before(beforeSeq, limit) : QVector<StoredMessage>();
+}
+
+bool MessageStore::findByMessageId(const QString &conversationId,
+                                   const QString &messageId, StoredMessage *out) {
+  MessageLog *log = logFor(conversationId);
+  return log && log->findByMessageId(messageId, out);
+}
+
+qint64 MessageStore::newestSeq(const QString &conversationId) {
+  MessageLog *log = logFor(conversationId);
+  return log ? log->newestSeq() : 0;
+}
+
+int MessageStore::messageCount(const QString &conversationId) {
+  MessageLog *log = logFor(conversationId);
+  return log ? log->count() : 0;
+}
+
+MessageLog *MessageStore::logFor(const QString &conversationId, QString *error) {
+  const QString key = conversationId.trimmed();
+  if (!isOpen() || key.isEmpty()) {
+    if (error) {
+      *error = isOpen() ? QStringLiteral("conversation_id is required")
+                        : QStringLiteral("message store is not open");
+    }
+    return nullptr;
+  }
+  if (MessageLog *log = m_logs.object(key)) {
+    return log;
+  }
+
+  auto *log = new MessageLog(logPath(key), key);
+  QString openError;
+  if (!log->open(&openError)) {
+    qWarning() << "[MessageStore] open failed conversation_id=" << key
+               << "error=" << openError;
+    if (error) {
+      *error = openError;
+    }
+    delete log;
+    return nullptr;
+  }
+  m_logs.insert(key, log);
+  return log;
+}
+
+QString MessageStore::logPath(const QString &conversationId) const {
+  // Hex keeps any conversation id a valid file name.
+  return m_rootPath + QStringLiteral("/%1.log").arg(
+                          QString::fromLatin1(conversationId.toUtf8().toHex()));
+}
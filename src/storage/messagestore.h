@@ -0,0 +1,108 @@
+#ifndef MESSAGESTORE_H
+#define MESSAGESTORE_H
+
+#include <QCache>
+#include <QFile>
+#include <QHash>
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+
+// A chat message as kept on disk. Only messages the server has assigned a
+// seq and a message_id to are stored.
+struct StoredMessage {
+  QString conversationId;
+  QString messageId;
+  qint64 seq = 0;
+  QString content;
+  QString sentAt;
+  QString senderUserId;
+  QString senderUsername;
+};
+Q_DECLARE_METATYPE(StoredMessage)
+
+// Append-only log of one conversation. Every record starts with a small
+// fixed header carrying the seq and message_id, so opening a log only walks
+// the headers of the memory-mapped file to build the seq and message_id
+// indexes; bodies are decoded when a page is read. A record torn by a crash
+// at the end of the file is cut off on open.
+class MessageLog {
+public:
+  MessageLog(const QString &filePath, const QString &conversationId);
+  ~MessageLog();
+
+  MessageLog(const MessageLog &) = delete;
+  MessageLog &operator=(const MessageLog &) = delete;
+
+  bool open(QString *error = nullptr);
+  // A message whose seq or message_id is already stored is not written again
+  // and counts as success.
+  bool append(const StoredMessage &message, QString *error = nullptr);
+
+  int count() const;
+  qint64 newestSeq() const;
+  qint64 oldestSeq() const;
+  bool containsSeq(qint64 seq) const;
+  bool containsMessageId(const QString &messageId) const;
+  bool findByMessageId(const QString &messageId, StoredMessage *out);
+
+  // Pages are returned oldest first.
+  QVector<StoredMessage> newest(int limit);
+  QVector<StoredMessage> before(qint64 beforeSeq, int limit);
+
+private:
+  struct IndexEntry {
+    qint64 seq = 0;
+    qint64 offset = 0;
+  };
+
+  bool scan(QString *error);
+  bool ensureMapped(qint64 end);
+  void unmap();
+  bool readAt(qint64 offset, StoredMessage *out);
+  QVector<StoredMessage> readRange(int first, int last);
+  int lowerBound(qint64 seq) const;
+
+  QString m_filePath;
+  QString m_conversationId;
+  QFile m_file;
+  uchar *m_map = nullptr;
+  qint64 m_mappedSize = 0;
+  qint64 m_endOffset = 0;
+  // Sorted by seq; appends in seq order stay O(1).
+  QVector<IndexEntry> m_bySeq;
+  QHash<QString, qint64> m_seqByMessageId;
+};
+
+// Local message history of the logged-in user, one MessageLog per
+// conversation under AppDataLocation/messages/<user_id>/. Logs are opened on
+// first use and a bounded number of them stays open.
+class MessageStore {
+public:
+  static MessageStore *instance();
+
+  bool openForUser(const QString &userId, QString *error = nullptr);
+  bool openAt(const QString &rootPath, QString *error = nullptr);
+  void close();
+  bool isOpen() const;
+
+  bool append(const StoredMessage &message, QString *error = nullptr);
+  QVector<StoredMessage> newestPage(const QString &conversationId, int limit);
+  QVector<StoredMessage> pageBefore(const QString &conversationId,
+                                    qint64 beforeSeq, int limit);
+  bool findByMessageId(const QString &conversationId, const QString &messageId,
+                       StoredMessage *out);
+  qint64 newestSeq(const QString &conversationId);
+  int messageCount(const QString &conversationId);
+
+private:
+  MessageStore();
+
+  MessageLog *logFor(const QString &conversationId, QString *error = nullptr);
+  QString logPath(const QString &conversationId) const;
+
+  QString m_rootPath;
+  QCache<QString, MessageLog> m_logs;
+};
+
+#endif // MESSAGESTORE_H
@@ -0,0 +1,36 @@
+#include "stringpool.h"
+
+StringPool *StringPool::instance() {
+  static StringPool instance;
+  return &instance;
+}
+
+QString StringPool::intern(const QString &value) {
+  if (value.isEmpty()) {
+    return QString();
+  }
+  const auto it = m_strings.constFind(value);
+  if (it != m_strings.cend()) {
+    return *it;
+  }
+  m_strings.insert(value);
+  return value;
+}
+
+int StringPool::size() const { return m_strings.size(); }
+
+int StringPool::releaseUnused() {
+  int released = 0;
+  for (auto it = m_strings.begin(); it != m_strings.end();) {
+    // A detached string is referenced by the pool alone.
+    if (it->isDetached()) {
+      it = m_strings.erase(it);
+      ++released;
+    } else {
+      ++it;
+    }
+  }
+  return released;
+}
+
+void StringPool::clear() { m_strings.clear(); }
@@ -0,0 +1,26 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <QSet>
+#include <QString>
+
+// Interns values that repeat across parsed records and list refreshes: user,
+// numeric and conversation ids and avatar URLs. Records holding the same value
+// share one buffer instead of each parse allocating its own. Used from the
+// main thread only, like the parsers that fill it.
+class StringPool {
+public:
+  static StringPool *instance();
+
+  // The pooled copy of value; empty values are never pooled.
+  QString intern(const QString &value);
+  int size() const;
+  // Drops strings no record holds any more. Returns how many were dropped.
+  int releaseUnused();
+  void clear();
+
+private:
+  QSet<QString> m_strings;
+};
+
+#endif // STRINGPOOL_H
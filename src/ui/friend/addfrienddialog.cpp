@@ -1,5 +1,6 @@
 #include "addfrienddialog.h"
 
+#include "avatarservice.h"
 #include "usersession.h"
 #include "websocketclient.h"
 
@@ -10,10 +11,7 @@
 #include <QLabel>
 #include <QLineEdit>
 #include <QMessageBox>
-#include <QNetworkReply>
-#include <QNetworkRequest>
 #include <QPainter>
-#include <QPainterPath>
 #include <QPushButton>
 #include <QRegularExpression>
 #include <QUrl>
@@ -104,6 +102,15 @@ AddFriendDialog::AddFriendDialog(const QString &currentUserId,
   buildUi();
   applyDefaultAvatar();
 
+  connect(AvatarService::instance(), &AvatarService::avatarReady, this,
+          &AddFriendDialog::onAvatarReady);
+  connect(AvatarService::instance(), &AvatarService::avatarFailed, this,
+          [this](const QUrl &url, const QString &) {
+            if (url == m_requestedAvatarUrl) {
+              applyDefaultAvatar();
+            }
+          });
+
   if (!m_profileApiClient) {
     m_statusLabel->setText("Profile 服务未初始化");
     m_queryButton->setEnabled(false);
@@ -127,13 +134,7 @@ AddFriendDialog::AddFriendDialog(const QString &currentUserId,
   }
 }
 
-AddFriendDialog::~AddFriendDialog() {
-  if (m_avatarReply) {
-    m_avatarReply->abort();
-    m_avatarReply->deleteLater();
-    m_avatarReply = nullptr;
-  }
-}
+AddFriendDialog::~AddFriendDialog() = default;
 
 void AddFriendDialog::buildUi() {
   auto *rootLayout = new QVBoxLayout(this);
@@ -225,11 +226,7 @@ void AddFriendDialog::clearQueryResult() {
   m_numericIdValue->setText("-");
   m_signatureValue->setText("-");
   m_addButton->setEnabled(false);
-  if (m_avatarReply) {
-    m_avatarReply->abort();
-    m_avatarReply->deleteLater();
-    m_avatarReply = nullptr;
-  }
+  m_requestedAvatarUrl.clear();
   applyDefaultAvatar();
 }
 
@@ -293,23 +290,17 @@ QString AddFriendDialog::resolveAddFriendErrorMessage(int code) const {
 }
 
 void AddFriendDialog::requestAvatar(const QString &avatarUrl) {
-  if (m_avatarReply) {
-    m_avatarReply->abort();
-    m_avatarReply->deleteLater();
-    m_avatarReply = nullptr;
-  }
-
-  const QUrl resolved = resolveAvatarUrl(avatarUrl);
-  if (!resolved.isValid()) {
+  m_requestedAvatarUrl = resolveAvatarUrl(avatarUrl);
+  if (!m_requestedAvatarUrl.isValid()) {
     applyDefaultAvatar();
     return;
   }
 
-  QNetworkRequest request(resolved);
-  request.setTransferTimeout(8000);
-  m_avatarReply = m_avatarNetworkManager.get(request);
-  connect(m_avatarReply, &QNetworkReply::finished, this,
-          &AddFriendDialog::onAvatarReplyFinished);
+  const int side = qMin(m_avatarLabel->width(), m_avatarLabel->height());
+  const QPixmap cached = AvatarService::instance()->avatar(m_requestedAvatarUrl, side);
+  if (!cached.isNull()) {
+    m_avatarLabel->setPixmap(cached);
+  }
 }
 
 void AddFriendDialog::applyDefaultAvatar() {
@@ -477,44 +468,11 @@ void AddFriendDialog::onRequestFailedDetailed(const QString &requestId,
   }
 }
 
-void AddFriendDialog::onAvatarReplyFinished() {
-  QNetworkReply *reply = m_avatarReply.data();
-  m_avatarReply = nullptr;
-  if (!reply) {
-    applyDefaultAvatar();
+void AddFriendDialog::onAvatarReady(const QUrl &url, int side,
+                                    const QPixmap &pixmap) {
+  if (url != m_requestedAvatarUrl ||
+      side != qMin(m_avatarLabel->width(), m_avatarLabel->height())) {
     return;
   }
-
-  const QVariant statusCode =
-      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
-  const int httpCode = statusCode.isValid() ? statusCode.toInt() : 0;
-  if (reply->error() != QNetworkReply::NoError || httpCode != 200) {
-    applyDefaultAvatar();
-    reply->deleteLater();
-    return;
-  }
-
-  QPixmap pixmap;
-  if (!pixmap.loadFromData(reply->readAll())) {
-    applyDefaultAvatar();
-    reply->deleteLater();
-    return;
-  }
-
-  const int side = qMin(m_avatarLabel->width(), m_avatarLabel->height());
-  const QPixmap scaled =
-      pixmap.scaled(side, side, Qt::KeepAspectRatioByExpanding,
-                    Qt::SmoothTransformation);
-  QPixmap circular(side, side);
-  circular.fill(Qt::transparent);
-  QPainter painter(&circular);
-  painter.setRenderHint(QPainter::Antialiasing, true);
-  QPainterPath clipPath;
-  clipPath.addEllipse(0, 0, side, side);
-  painter.setClipPath(clipPath);
-  painter.drawPixmap(0, 0, scaled);
-  painter.end();
-  m_avatarLabel->setPixmap(circular);
-
-  reply->deleteLater();
+  m_avatarLabel->setPixmap(pixmap);
 }
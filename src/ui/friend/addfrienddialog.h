@@ -4,13 +4,12 @@
 #include "profileapiclient.h"
 
 #include <QDialog>
-#include <QNetworkAccessManager>
-#include <QPointer>
+#include <QUrl>
 
 class QLabel;
 class QLineEdit;
 class QPushButton;
-class QNetworkReply;
+class QPixmap;
 
 class AddFriendDialog : public QDialog {
   Q_OBJECT
@@ -33,7 +32,7 @@ private slots:
   void onAddFriendSuccess(const QString &requestId, const AddFriendResult &result);
   void onRequestFailedDetailed(const QString &requestId, const QString &action,
                                int code, const QString &error);
-  void onAvatarReplyFinished();
+  void onAvatarReady(const QUrl &url, int side, const QPixmap &pixmap);
 
 private:
   void buildUi();
@@ -59,8 +58,7 @@ private:
   bool m_queryLoading = false;
   bool m_addLoading = false;
   ProfileInfo m_lastProfile;
-  QNetworkAccessManager m_avatarNetworkManager;
-  QPointer<QNetworkReply> m_avatarReply;
+  QUrl m_requestedAvatarUrl;
 
   QLineEdit *m_numericIdEdit = nullptr;
   QLineEdit *m_remarkEdit = nullptr;
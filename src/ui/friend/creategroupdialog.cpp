@@ -11,7 +11,7 @@
 #include <QVBoxLayout>
 
 CreateGroupDialog::CreateGroupDialog(
-    const QList<friendlist::FriendItem> &friends,
+    const QList<friendlist::FriendRecord> &friends,
     ProfileApiClient *profileApiClient, QWidget *parent)
     : QDialog(parent), m_profileApiClient(profileApiClient), m_friends(friends) {
   setAttribute(Qt::WA_DeleteOnClose);
@@ -35,7 +35,7 @@ CreateGroupDialog::CreateGroupDialog(
           &CreateGroupDialog::onRequestFailedDetailed);
 }
 
-void CreateGroupDialog::setFriends(const QList<friendlist::FriendItem> &friends) {
+void CreateGroupDialog::setFriends(const QList<friendlist::FriendRecord> &friends) {
   m_friends = friends;
   refreshFriendList();
 }
@@ -98,7 +98,8 @@ void CreateGroupDialog::refreshFriendList() {
     return;
   }
 
-  for (const friendlist::FriendItem &friendItem : m_friends) {
+  for (const friendlist::FriendRecord &friendRecord : m_friends) {
+    const friendlist::FriendItem &friendItem = *friendRecord;
     const QString text =
         QStringLiteral("%1 (%2)")
             .arg(friendItem.displayName.trimmed().isEmpty()
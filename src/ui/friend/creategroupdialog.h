@@ -14,11 +14,11 @@ class CreateGroupDialog : public QDialog {
   Q_OBJECT
 
 public:
-  explicit CreateGroupDialog(const QList<friendlist::FriendItem> &friends,
+  explicit CreateGroupDialog(const QList<friendlist::FriendRecord> &friends,
                              ProfileApiClient *profileApiClient,
                              QWidget *parent = nullptr);
 
-  void setFriends(const QList<friendlist::FriendItem> &friends);
+  void setFriends(const QList<friendlist::FriendRecord> &friends);
 
 signals:
   void groupCreated(const CreateGroupResult &result);
@@ -37,7 +37,7 @@ private:
   QStringList selectedMemberNumericIds() const;
 
   ProfileApiClient *m_profileApiClient = nullptr;
-  QList<friendlist::FriendItem> m_friends;
+  QList<friendlist::FriendRecord> m_friends;
   QString m_pendingCreateRequestId;
 
   QLineEdit *m_groupNameEdit = nullptr;
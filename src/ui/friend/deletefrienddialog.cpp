@@ -22,7 +22,7 @@ QString friendStatusText(int status) {
 
 DeleteFriendDialog::DeleteFriendDialog(
     const QString &currentUserNumericId,
-    const QList<friendlist::FriendItem> &friends,
+    const QList<friendlist::FriendRecord> &friends,
     ProfileApiClient *profileApiClient, QWidget *parent)
     : QDialog(parent), m_profileApiClient(profileApiClient),
       m_currentUserNumericId(currentUserNumericId.trimmed()), m_friends(friends) {
@@ -46,7 +46,7 @@ DeleteFriendDialog::DeleteFriendDialog(
           &DeleteFriendDialog::onRequestFailedDetailed);
 }
 
-void DeleteFriendDialog::setFriends(const QList<friendlist::FriendItem> &friends) {
+void DeleteFriendDialog::setFriends(const QList<friendlist::FriendRecord> &friends) {
   m_friends = friends;
   refreshList();
 }
@@ -87,7 +87,8 @@ void DeleteFriendDialog::refreshList() {
                         ~Qt::ItemIsEnabled);
     m_friendListWidget->addItem(emptyItem);
   } else {
-    for (const friendlist::FriendItem &friendItem : m_friends) {
+    for (const friendlist::FriendRecord &friendRecord : m_friends) {
+      const friendlist::FriendItem &friendItem = *friendRecord;
       const QString text =
           QStringLiteral("%1 (%2) [%3]")
               .arg(friendItem.displayName, friendItem.numericId,
@@ -166,7 +167,7 @@ void DeleteFriendDialog::onDeleteFriendFinished(const QString &requestId,
 
   const QString deletedNumericId = result.friendNumericId.trimmed();
   for (qsizetype i = 0; i < m_friends.size(); ++i) {
-    if (m_friends.at(i).numericId.trimmed() == deletedNumericId) {
+    if (m_friends.at(i)->numericId.trimmed() == deletedNumericId) {
       m_friends.removeAt(i);
       break;
     }
@@ -16,9 +16,9 @@ class DeleteFriendDialog : public QDialog {
 public:
   explicit DeleteFriendDialog(
       const QString &currentUserNumericId,
-      const QList<friendlist::FriendItem> &friends,
+      const QList<friendlist::FriendRecord> &friends,
       ProfileApiClient *profileApiClient, QWidget *parent = nullptr);
-  void setFriends(const QList<friendlist::FriendItem> &friends);
+  void setFriends(const QList<friendlist::FriendRecord> &friends);
 
 signals:
   void friendDeleted(const DeleteFriendResult &result);
@@ -38,7 +38,7 @@ private:
 
   ProfileApiClient *m_profileApiClient = nullptr;
   QString m_currentUserNumericId;
-  QList<friendlist::FriendItem> m_friends;
+  QList<friendlist::FriendRecord> m_friends;
   QString m_pendingDeleteRequestId;
 
   QLabel *m_tipLabel = nullptr;
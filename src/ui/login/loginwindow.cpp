@@ -1,5 +1,6 @@
 #include "loginwindow.h"
 #include "authapiclient.h"
+#include "envelopedispatcher.h"
 #include "protocol.h"
 #include "registerwindow.h"
 #include "usersession.h"
@@ -119,7 +120,8 @@ bool isCurrentLoginResponse(const protocol::Envelope &envelope,
   }
 
   return originalRequest.requestId == pendingRequestId &&
-         originalRequest.type == "AUTH" && originalRequest.action == "LOGIN";
+         originalRequest.typeId == protocol::EnvelopeType::Auth &&
+         originalRequest.actionId == protocol::EnvelopeAction::Login;
 }
 
 bool isLoginSuccess(const protocol::Envelope &envelope) {
@@ -266,8 +268,9 @@ LoginWindow::LoginWindow(QWidget *parent)
   auto ws = websocketclient::instance();
   connect(ws, &websocketclient::connected, this,
           &LoginWindow::onWebSocketConnected);
-  connect(ws, &websocketclient::textMessageReceived, this,
-          &LoginWindow::onWebSocketTextMessage);
+  connect(EnvelopeDispatcher::instance(),
+          &EnvelopeDispatcher::envelopeParseFailed, this,
+          &LoginWindow::onEnvelopeParseFailed);
   connect(ws, &websocketclient::errorOccurred, this,
           &LoginWindow::onWebSocketError);
 
@@ -278,6 +281,7 @@ LoginWindow::LoginWindow(QWidget *parent)
 LoginWindow::~LoginWindow() { delete ui; }
 
 void LoginWindow::resetLoginForm() {
+  EnvelopeDispatcher::instance()->cancelResponse(m_pendingLoginRequestId);
   m_isLoginPending = false;
   m_pendingUsername.clear();
   m_pendingPassword.clear();
@@ -378,37 +382,41 @@ void LoginWindow::onWebSocketConnected() {
       QUuid::createUuid().toString(QUuid::WithoutBraces);
   const QString payload =
       protocol::createRequest("AUTH", "LOGIN", data, m_pendingLoginRequestId);
+  EnvelopeDispatcher::instance()->expectResponse(
+      m_pendingLoginRequestId, this,
+      [this](const protocol::Envelope &envelope) { onLoginResponse(envelope); });
   websocketclient::instance()->sendTextMessage(payload);
   qInfo() << "AUTH LOGIN sent, request_id:" << m_pendingLoginRequestId;
   ui->loginButton->setText("登录中...");
 }
 
-void LoginWindow::onWebSocketTextMessage(const QString &message) {
+void LoginWindow::onEnvelopeParseFailed(const QString &error) {
   if (!m_isLoginPending || m_pendingLoginRequestId.isEmpty())
     return;
 
-  protocol::Envelope envelope;
-  QString parseError;
-  if (!protocol::parseEnvelope(message, &envelope, &parseError)) {
-    m_isLoginPending = false;
-    m_pendingLoginRequestId.clear();
-    m_pendingPassword.clear();
-    ui->loginButton->setEnabled(true);
-    ui->loginButton->setText("登录");
-    QMessageBox::warning(this, "登录失败",
-                         QStringLiteral("响应解析失败: %1")
-                             .arg(parseError.isEmpty()
-                                      ? QStringLiteral("未知协议错误")
-                                      : parseError));
+  EnvelopeDispatcher::instance()->cancelResponse(m_pendingLoginRequestId);
+  m_isLoginPending = false;
+  m_pendingLoginRequestId.clear();
+  m_pendingPassword.clear();
+  ui->loginButton->setEnabled(true);
+  ui->loginButton->setText("登录");
+  QMessageBox::warning(this, "登录失败",
+                       QStringLiteral("响应解析失败: %1")
+                           .arg(error.isEmpty() ? QStringLiteral("未知协议错误")
+                                                : error));
+}
+
+void LoginWindow::onLoginResponse(const protocol::Envelope &envelope) {
+  if (!m_isLoginPending || m_pendingLoginRequestId.isEmpty())
     return;
-  }
 
   if (!AuthApiClient::isCurrentLoginResponse(envelope, m_pendingLoginRequestId))
     return;
 
   const QString responseMessage =
       AuthApiClient::extractAuthErrorMessage(envelope, QStringLiteral("LOGIN"));
-  if (envelope.type != "AUTH" || envelope.action != "LOGIN") {
+  if (envelope.typeId != protocol::EnvelopeType::Auth ||
+      envelope.actionId != protocol::EnvelopeAction::Login) {
     m_isLoginPending = false;
     m_pendingLoginRequestId.clear();
     m_pendingPassword.clear();
@@ -483,7 +491,12 @@ void LoginWindow::onWebSocketTextMessage(const QString &message) {
 
 void LoginWindow::onWebSocketError(QAbstractSocket::SocketError,
                                    const QString &message) {
+  if (!m_isLoginPending) {
+    // Errors from background reconnect attempts are not login failures.
+    return;
+  }
   qWarning() << "WebSocket error during login:" << message;
+  EnvelopeDispatcher::instance()->cancelResponse(m_pendingLoginRequestId);
   m_isLoginPending = false;
   m_pendingLoginRequestId.clear();
   m_pendingPassword.clear();
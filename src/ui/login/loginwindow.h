@@ -8,6 +8,7 @@
 #include <QWidget>
 
 #include "..\\..\\network\\websocketclient.h"
+#include "protocol.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -35,7 +36,7 @@ signals:
   void onWebSocketConnected();
   void onWebSocketError(QAbstractSocket::SocketError error,
                         const QString &message);
-  void onWebSocketTextMessage(const QString &message);
+  void onEnvelopeParseFailed(const QString &error);
 
 protected:
   void mousePressEvent(QMouseEvent *event) override;
@@ -44,6 +45,8 @@ protected:
   void paintEvent(QPaintEvent *event) override;
 
  private:
+  void onLoginResponse(const protocol::Envelope &envelope);
+
   Ui::LoginWindow *ui;
   QPointer<RegisterWindow> m_registerWindow;
   QPoint m_dragPosition;
@@ -0,0 +1,259 @@
+#include "conversationlistmodel.h"
+
+#include <algorithm>
+
+namespace {
+// Pinned rows first, then the most recent activity. Rows with equal keys
+// keep their relative order.
+bool ordersBefore(const ConversationListRow &a, const ConversationListRow &b) {
+  if (a.pinned != b.pinned) {
+    return a.pinned;
+  }
+  return a.lastActivityMs > b.lastActivityMs;
+}
+} // namespace
+
+ConversationListModel::ConversationListModel(QObject *parent)
+    : QAbstractListModel(parent) {}
+
+int ConversationListModel::rowCount(const QModelIndex &parent) const {
+  if (parent.isValid()) {
+    return 0;
+  }
+  return showsPlaceholder() ? 1 : m_rows.size();
+}
+
+QVariant ConversationListModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid() || index.row() < 0 || index.row() >= rowCount()) {
+    return QVariant();
+  }
+  if (showsPlaceholder()) {
+    return role == Qt::DisplayRole ? QVariant(m_placeholderText) : QVariant();
+  }
+
+  const ConversationListRow &row = m_rows.at(index.row());
+  switch (role) {
+  case Qt::DisplayRole:
+    return row.title;
+  case Qt::DecorationRole:
+    return QVariant::fromValue(row.conversationType == 2 ? m_groupIcon
+                                                         : m_directIcon);
+  case Qt::ToolTipRole:
+    return row.toolTip;
+  case SessionIdRole:
+    return row.sessionId;
+  case ConversationTypeRole:
+    return row.conversationType;
+  case UserIdRole:
+    return row.userId;
+  case NumericIdRole:
+    return row.numericId;
+  case UserStatusRole:
+    return row.userStatus;
+  case IsOnlineRole:
+    return row.isOnline;
+  case LastSeenAtUtcRole:
+    return row.lastSeenAtUtc;
+  case ConversationIdRole:
+    return row.conversationId;
+  case PreviewRole:
+    return row.preview;
+  case UnreadCountRole:
+    return row.unreadCount;
+  case AvatarUrlRole:
+    return row.avatarUrl;
+  case DisplayNameRole:
+    return row.displayName;
+  default:
+    return QVariant();
+  }
+}
+
+Qt::ItemFlags ConversationListModel::flags(const QModelIndex &index) const {
+  if (!index.isValid() || showsPlaceholder()) {
+    return Qt::NoItemFlags;
+  }
+  return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemNeverHasChildren;
+}
+
+void ConversationListModel::setPlaceholderText(const QString &text) {
+  beginResetModel();
+  m_placeholderText = text;
+  endResetModel();
+}
+
+void ConversationListModel::setConversationIcons(const QIcon &directIcon,
+                                                 const QIcon &groupIcon) {
+  m_directIcon = directIcon;
+  m_groupIcon = groupIcon;
+  if (!m_rows.isEmpty()) {
+    emit dataChanged(index(0), index(m_rows.size() - 1), {Qt::DecorationRole});
+  }
+}
+
+void ConversationListModel::setActivityOrdered(bool ordered) {
+  if (m_activityOrdered == ordered) {
+    return;
+  }
+  m_activityOrdered = ordered;
+  if (ordered && !m_rows.isEmpty()) {
+    resetRows(QVector<ConversationListRow>(m_rows));
+  }
+}
+
+bool ConversationListModel::isActivityOrdered() const { return m_activityOrdered; }
+
+void ConversationListModel::resetRows(const QVector<ConversationListRow> &rows) {
+  beginResetModel();
+  m_rows.clear();
+  m_rows.reserve(rows.size());
+  m_rowByConversationId.clear();
+  m_rowByConversationId.reserve(rows.size());
+  for (const ConversationListRow &row : rows) {
+    if (row.conversationId.isEmpty() ||
+        m_rowByConversationId.contains(row.conversationId)) {
+      continue;
+    }
+    m_rowByConversationId.insert(row.conversationId, m_rows.size());
+    m_rows.push_back(row);
+  }
+  if (m_activityOrdered) {
+    std::stable_sort(m_rows.begin(), m_rows.end(), ordersBefore);
+    rebuildIndex(0);
+  }
+  endResetModel();
+}
+
+int ConversationListModel::upsertRow(const ConversationListRow &row) {
+  if (row.conversationId.isEmpty()) {
+    return -1;
+  }
+
+  const auto it = m_rowByConversationId.constFind(row.conversationId);
+  if (it != m_rowByConversationId.constEnd()) {
+    int existingRow = it.value();
+    m_rows[existingRow] = row;
+    if (m_activityOrdered) {
+      existingRow = moveToSortedPosition(existingRow);
+    }
+    const QModelIndex changed = index(existingRow);
+    emit dataChanged(changed, changed);
+    return existingRow;
+  }
+
+  const int newRow = m_rows.size();
+  if (showsPlaceholder()) {
+    // The placeholder row turns into the first conversation in place.
+    m_rows.push_back(row);
+    m_rowByConversationId.insert(row.conversationId, newRow);
+    const QModelIndex changed = index(newRow);
+    emit dataChanged(changed, changed);
+    return newRow;
+  }
+
+  if (m_activityOrdered) {
+    const int sortedRow = sortedPosition(row, 0, m_rows.size());
+    beginInsertRows(QModelIndex(), sortedRow, sortedRow);
+    m_rows.insert(sortedRow, row);
+    rebuildIndex(sortedRow);
+    endInsertRows();
+    return sortedRow;
+  }
+
+  beginInsertRows(QModelIndex(), newRow, newRow);
+  m_rows.push_back(row);
+  m_rowByConversationId.insert(row.conversationId, newRow);
+  endInsertRows();
+  return newRow;
+}
+
+bool ConversationListModel::removeConversation(const QString &conversationId) {
+  const int row = rowForConversationId(conversationId);
+  if (row < 0) {
+    return false;
+  }
+
+  if (m_rows.size() == 1 && !m_placeholderText.isEmpty()) {
+    // The last conversation turns back into the placeholder row in place.
+    m_rows.clear();
+    m_rowByConversationId.clear();
+    const QModelIndex changed = index(0);
+    emit dataChanged(changed, changed);
+    return true;
+  }
+
+  beginRemoveRows(QModelIndex(), row, row);
+  m_rowByConversationId.remove(m_rows.at(row).conversationId);
+  m_rows.remove(row);
+  rebuildIndex(row);
+  endRemoveRows();
+  return true;
+}
+
+void ConversationListModel::clear() {
+  beginResetModel();
+  m_rows.clear();
+  m_rowByConversationId.clear();
+  endResetModel();
+}
+
+int ConversationListModel::conversationCount() const { return m_rows.size(); }
+
+int ConversationListModel::rowForConversationId(
+    const QString &conversationId) const {
+  return m_rowByConversationId.value(conversationId.trimmed(), -1);
+}
+
+QModelIndex ConversationListModel::indexForConversationId(
+    const QString &conversationId) const {
+  const int row = rowForConversationId(conversationId);
+  return row < 0 ? QModelIndex() : index(row);
+}
+
+const ConversationListRow *ConversationListModel::findConversation(
+    const QString &conversationId) const {
+  const int row = rowForConversationId(conversationId);
+  return row < 0 ? nullptr : &m_rows.at(row);
+}
+
+bool ConversationListModel::showsPlaceholder() const {
+  return m_rows.isEmpty() && !m_placeholderText.isEmpty();
+}
+
+void ConversationListModel::rebuildIndex(int fromRow, int toRow) {
+  const int lastRow = toRow < 0 ? m_rows.size() - 1 : toRow;
+  for (int i = fromRow; i <= lastRow; ++i) {
+    m_rowByConversationId.insert(m_rows.at(i).conversationId, i);
+  }
+}
+
+int ConversationListModel::sortedPosition(const ConversationListRow &row,
+                                          int first, int last) const {
+  const auto it = std::lower_bound(m_rows.cbegin() + first,
+                                   m_rows.cbegin() + last, row, ordersBefore);
+  return static_cast<int>(it - m_rows.cbegin());
+}
+
+int ConversationListModel::moveToSortedPosition(int currentRow) {
+  const ConversationListRow &row = m_rows.at(currentRow);
+  int targetRow = currentRow;
+  if (currentRow > 0 && ordersBefore(row, m_rows.at(currentRow - 1))) {
+    // Usually a new message: the row moves up ahead of rows it now beats.
+    targetRow = sortedPosition(row, 0, currentRow);
+  } else if (currentRow + 1 < m_rows.size() &&
+             ordersBefore(m_rows.at(currentRow + 1), row)) {
+    targetRow = sortedPosition(row, currentRow + 1, m_rows.size()) - 1;
+  }
+  if (targetRow == currentRow) {
+    return currentRow;
+  }
+
+  // For a downward move Qt wants the row it will be inserted in front of.
+  const int destinationChild = targetRow > currentRow ? targetRow + 1 : targetRow;
+  beginMoveRows(QModelIndex(), currentRow, currentRow, QModelIndex(),
+                destinationChild);
+  m_rows.move(currentRow, targetRow);
+  rebuildIndex(std::min(currentRow, targetRow), std::max(currentRow, targetRow));
+  endMoveRows();
+  return targetRow;
+}
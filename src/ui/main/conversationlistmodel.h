@@ -0,0 +1,112 @@
+#ifndef CONVERSATIONLISTMODEL_H
+#define CONVERSATIONLISTMODEL_H
+
+#include "sessionlistdelegate.h"
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QIcon>
+#include <QString>
+#include <QVector>
+
+// Display state of one conversation row, filled in by the main widget.
+struct ConversationListRow {
+  QString sessionId;
+  QString conversationId;
+  int conversationType = 0;
+  QString displayName;
+  QString userId;
+  QString numericId;
+  int userStatus = 0;
+  bool isOnline = false;
+  QString lastSeenAtUtc;
+  QString title;
+  QString preview;
+  QString toolTip;
+  QString avatarUrl;
+  int unreadCount = 0;
+  // Sort key of activity-ordered models.
+  bool pinned = false;
+  qint64 lastActivityMs = 0;
+};
+
+// Conversation rows for the session and group tabs. Rows are looked up by
+// conversation id through a hash, and an update of one conversation emits
+// dataChanged for that row only. While the model is empty it shows a single
+// disabled placeholder row.
+//
+// An activity-ordered model keeps its rows sorted by (pinned, last activity),
+// newest first, so the row vector itself is the ordered index: an update that
+// changes a row's key finds the new position by binary search and moves that
+// one row, and an insert lands in place.
+//
+// Cost: finding the position is O(log n), but the vector and the id hash are
+// positional, so a move shifts and re-indexes the k rows between the old and
+// new position (for a bump to the top, k is the row's old index), and an
+// insert or removal re-indexes every row after it. That is O(k), up to O(n),
+// per update, bounded by one shift of the vector and n hash writes, with no
+// model reset. A tree keyed by position would make this O(log n) at the
+// price of an O(log n) lookup in every data() call while painting.
+class ConversationListModel : public QAbstractListModel {
+  Q_OBJECT
+
+public:
+  enum Role {
+    SessionIdRole = Qt::UserRole,
+    ConversationTypeRole,
+    UserIdRole,
+    NumericIdRole,
+    UserStatusRole,
+    IsOnlineRole,
+    LastSeenAtUtcRole,
+    ConversationIdRole,
+    PreviewRole = SessionListDelegate::SecondLineRole,
+    UnreadCountRole = SessionListDelegate::BadgeCountRole,
+    AvatarUrlRole = Qt::UserRole + 10,
+    DisplayNameRole,
+  };
+
+  explicit ConversationListModel(QObject *parent = nullptr);
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+  Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+  void setPlaceholderText(const QString &text);
+  void setConversationIcons(const QIcon &directIcon, const QIcon &groupIcon);
+  // Re-sorts the current rows when turned on.
+  void setActivityOrdered(bool ordered);
+  bool isActivityOrdered() const;
+
+  void resetRows(const QVector<ConversationListRow> &rows);
+  // Returns the row index, or -1 when row has no conversation id. In an
+  // activity-ordered model this is the row's position after any move.
+  int upsertRow(const ConversationListRow &row);
+  bool removeConversation(const QString &conversationId);
+  void clear();
+
+  int conversationCount() const;
+  int rowForConversationId(const QString &conversationId) const;
+  QModelIndex indexForConversationId(const QString &conversationId) const;
+  const ConversationListRow *findConversation(const QString &conversationId) const;
+
+private:
+  bool showsPlaceholder() const;
+  // Re-points the hash at rows shifted by an insert, removal or move; O(rows
+  // in [fromRow, toRow]), toRow defaulting to the last row.
+  void rebuildIndex(int fromRow, int toRow = -1);
+  // Where row belongs among the rows in [first, last).
+  int sortedPosition(const ConversationListRow &row, int first, int last) const;
+  // Moves the row at currentRow to where its key puts it; returns its new row.
+  // O(log n) to find the target plus O(|target - currentRow|) to shift.
+  int moveToSortedPosition(int currentRow);
+
+  QVector<ConversationListRow> m_rows;
+  QHash<QString, int> m_rowByConversationId;
+  QString m_placeholderText;
+  QIcon m_directIcon;
+  QIcon m_groupIcon;
+  bool m_activityOrdered = false;
+};
+
+#endif // CONVERSATIONLISTMODEL_H
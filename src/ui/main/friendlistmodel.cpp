@@ -0,0 +1,76 @@
+#include "friendlistmodel.h"
+
+#include "sessionlistdelegate.h"
+
+FriendListModel::FriendListModel(QObject *parent)
+    : QAbstractListModel(parent) {}
+
+int FriendListModel::rowCount(const QModelIndex &parent) const {
+  if (parent.isValid()) {
+    return 0;
+  }
+  return m_friends.isEmpty() ? 1 : m_friends.size();
+}
+
+QVariant FriendListModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid() || index.row() < 0 || index.row() >= rowCount()) {
+    return QVariant();
+  }
+  if (m_friends.isEmpty()) {
+    return role == Qt::DisplayRole ? QVariant(QStringLiteral("暂无好友"))
+                                   : QVariant();
+  }
+
+  const friendlist::FriendItem &friendItem = *m_friends.at(index.row());
+  switch (role) {
+  case Qt::DisplayRole: {
+    const QString avatarTag =
+        friendItem.avatarUrl.trimmed().isEmpty() ? QStringLiteral("[默认头像]")
+                                                 : QStringLiteral("[头像]");
+    return QStringLiteral("%1 (%2) %3")
+        .arg(friendItem.displayName, friendItem.numericId, avatarTag);
+  }
+  case Qt::ToolTipRole:
+  case SessionListDelegate::SecondLineRole:
+    return friendItem.bio.trimmed().isEmpty() ? QStringLiteral("无个性签名")
+                                              : friendItem.bio.trimmed();
+  case UserIdRole:
+    return friendItem.userId;
+  case NumericIdRole:
+    return friendItem.numericId;
+  default:
+    return QVariant();
+  }
+}
+
+Qt::ItemFlags FriendListModel::flags(const QModelIndex &index) const {
+  if (!index.isValid() || m_friends.isEmpty()) {
+    return Qt::NoItemFlags;
+  }
+  return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemNeverHasChildren;
+}
+
+void FriendListModel::setFriends(const QList<friendlist::FriendRecord> &friends) {
+  beginResetModel();
+  m_friends = friends;
+  m_rowByUserId.clear();
+  m_rowByUserId.reserve(m_friends.size());
+  for (int i = 0; i < m_friends.size(); ++i) {
+    const QString &userId = m_friends.at(i)->userId;
+    if (!userId.isEmpty() && !m_rowByUserId.contains(userId)) {
+      m_rowByUserId.insert(userId, i);
+    }
+  }
+  endResetModel();
+}
+
+bool FriendListModel::updateFriend(const friendlist::FriendRecord &friendRecord) {
+  const int row = m_rowByUserId.value(friendRecord->userId, -1);
+  if (row < 0) {
+    return false;
+  }
+  m_friends[row] = friendRecord;
+  const QModelIndex changed = index(row);
+  emit dataChanged(changed, changed);
+  return true;
+}
@@ -0,0 +1,38 @@
+#ifndef FRIENDLISTMODEL_H
+#define FRIENDLISTMODEL_H
+
+#include "friendlistmanager.h"
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+// Contact rows for the contact tab, one per friend. Shows a disabled
+// "暂无好友" row while the friend list is empty.
+class FriendListModel : public QAbstractListModel {
+  Q_OBJECT
+
+public:
+  enum Role {
+    UserIdRole = Qt::UserRole,
+    NumericIdRole,
+  };
+
+  explicit FriendListModel(QObject *parent = nullptr);
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+  Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+  // Shares the manager's records; nothing is copied.
+  void setFriends(const QList<friendlist::FriendRecord> &friends);
+  // Repaints the row of an already listed friend; false if it is not listed.
+  bool updateFriend(const friendlist::FriendRecord &friendRecord);
+
+private:
+  QList<friendlist::FriendRecord> m_friends;
+  QHash<QString, int> m_rowByUserId;
+};
+
+#endif // FRIENDLISTMODEL_H
@@ -0,0 +1,88 @@
+#include "presenceupdatebuffer.h"
+
+#include <QDebug>
+#include <QtGlobal>
+
+#include <algorithm>
+
+PresenceUpdateBuffer::PresenceUpdateBuffer(int flushIntervalMs, QObject *parent)
+    : QObject(parent), m_flushTimer(this) {
+  m_flushTimer.setSingleShot(true);
+  m_flushTimer.setTimerType(Qt::CoarseTimer);
+  m_flushTimer.setInterval(qMax(0, flushIntervalMs));
+  connect(&m_flushTimer, &QTimer::timeout, this, &PresenceUpdateBuffer::flush);
+}
+
+void PresenceUpdateBuffer::enqueue(const PresenceUpdate &update) {
+  const QString key = keyFor(update);
+  if (key.isEmpty()) {
+    return;
+  }
+  ++m_stats.received;
+
+  // Latest wins; re-sequencing moves the user behind earlier arrivals.
+  PendingEntry &entry = m_pendingByKey[key];
+  entry.sequence = ++m_sequence;
+  entry.update = update;
+  if (!m_flushTimer.isActive()) {
+    m_flushTimer.start();
+  }
+}
+
+void PresenceUpdateBuffer::flush() {
+  m_flushTimer.stop();
+  if (m_pendingByKey.isEmpty()) {
+    return;
+  }
+
+  QVector<PendingEntry> entries;
+  entries.reserve(m_pendingByKey.size());
+  for (auto it = m_pendingByKey.cbegin(); it != m_pendingByKey.cend(); ++it) {
+    entries.push_back(it.value());
+  }
+  m_pendingByKey.clear();
+  // A user seen once by user_id and once by numeric_id has two entries;
+  // arrival order keeps the later one in effect.
+  std::sort(entries.begin(), entries.end(),
+            [](const PendingEntry &left, const PendingEntry &right) {
+              return left.sequence < right.sequence;
+            });
+
+  QVector<PresenceUpdate> updates;
+  updates.reserve(entries.size());
+  for (const PendingEntry &entry : entries) {
+    updates.push_back(entry.update);
+  }
+  m_stats.applied += static_cast<quint64>(updates.size());
+  ++m_stats.flushes;
+  if (m_stats.flushes % kStatsLogEveryFlushes == 0) {
+    qInfo().noquote() << "[PresenceBuffer] received=" << m_stats.received
+                      << "applied=" << m_stats.applied
+                      << "flushes=" << m_stats.flushes;
+  }
+  emit updatesReady(updates);
+}
+
+void PresenceUpdateBuffer::clear() {
+  m_flushTimer.stop();
+  m_pendingByKey.clear();
+}
+
+int PresenceUpdateBuffer::pendingCount() const {
+  return static_cast<int>(m_pendingByKey.size());
+}
+
+PresenceBufferStats PresenceUpdateBuffer::stats() const {
+  PresenceBufferStats stats = m_stats;
+  stats.pending = pendingCount();
+  return stats;
+}
+
+QString PresenceUpdateBuffer::keyFor(const PresenceUpdate &update) {
+  const QString userId = update.userId.trimmed();
+  if (!userId.isEmpty()) {
+    return userId;
+  }
+  const QString numericId = update.numericId.trimmed();
+  return numericId.isEmpty() ? QString() : QStringLiteral("#") + numericId;
+}
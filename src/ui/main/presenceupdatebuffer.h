@@ -0,0 +1,64 @@
+#ifndef PRESENCEUPDATEBUFFER_H
+#define PRESENCEUPDATEBUFFER_H
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+struct PresenceUpdate {
+  QString userId;
+  QString numericId;
+  bool isOnline = false;
+  QString lastSeenAtUtc;
+};
+
+struct PresenceBufferStats {
+  quint64 received = 0;
+  quint64 applied = 0;
+  quint64 flushes = 0;
+  int pending = 0;
+};
+
+// Buffers MESSAGE/PRESENCE broadcasts and hands them out once per tick,
+// folded per user so only the latest state of each user is applied. A storm
+// of N events for M users costs M row updates and one repaint per tick.
+class PresenceUpdateBuffer : public QObject {
+  Q_OBJECT
+
+public:
+  static constexpr int kDefaultFlushIntervalMs = 33;
+
+  explicit PresenceUpdateBuffer(int flushIntervalMs = kDefaultFlushIntervalMs,
+                                QObject *parent = nullptr);
+
+  // Updates without any id are dropped.
+  void enqueue(const PresenceUpdate &update);
+  // Emits whatever is pending now instead of waiting for the tick.
+  void flush();
+  void clear();
+  int pendingCount() const;
+  PresenceBufferStats stats() const;
+
+signals:
+  // Folded updates, in the order each user's latest event arrived.
+  void updatesReady(const QVector<PresenceUpdate> &updates);
+
+private:
+  struct PendingEntry {
+    quint64 sequence = 0;
+    PresenceUpdate update;
+  };
+
+  static QString keyFor(const PresenceUpdate &update);
+
+  static constexpr int kStatsLogEveryFlushes = 100;
+
+  QTimer m_flushTimer;
+  QHash<QString, PendingEntry> m_pendingByKey;
+  quint64 m_sequence = 0;
+  PresenceBufferStats m_stats;
+};
+
+#endif // PRESENCEUPDATEBUFFER_H
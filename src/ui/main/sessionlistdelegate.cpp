@@ -0,0 +1,114 @@
+#include "sessionlistdelegate.h"
+
+#include <QApplication>
+#include <QFontMetrics>
+#include <QIcon>
+#include <QPainter>
+#include <QStyle>
+
+namespace {
+constexpr int kRowPadding = 10;
+constexpr int kIconSize = 32;
+constexpr int kLineSpacing = 4;
+constexpr int kBadgeHeight = 18;
+constexpr int kMaxBadgeCount = 99;
+
+QFont smallerFont(const QFont &font, qreal delta) {
+  QFont smaller = font;
+  if (font.pointSizeF() > 0) {
+    smaller.setPointSizeF(qMax(6.0, font.pointSizeF() - delta));
+  } else if (font.pixelSize() > 0) {
+    smaller.setPixelSize(qMax(8, font.pixelSize() - qRound(delta * 4 / 3)));
+  }
+  return smaller;
+}
+} // namespace
+
+SessionListDelegate::SessionListDelegate(QObject *parent)
+    : QStyledItemDelegate(parent) {}
+
+void SessionListDelegate::paint(QPainter *painter,
+                                const QStyleOptionViewItem &option,
+                                const QModelIndex &index) const {
+  QStyleOptionViewItem opt = option;
+  initStyleOption(&opt, index);
+  const QWidget *widget = opt.widget;
+  QStyle *style = widget ? widget->style() : QApplication::style();
+
+  // Background, hover and selection still come from the list style sheet.
+  const QString title = opt.text;
+  const QIcon icon = opt.icon;
+  opt.text.clear();
+  opt.icon = QIcon();
+  style->drawPrimitive(QStyle::PE_PanelItemViewItem, &opt, painter, widget);
+
+  painter->save();
+  painter->setRenderHint(QPainter::Antialiasing, true);
+  QRect content = opt.rect.adjusted(kRowPadding, kRowPadding, -kRowPadding,
+                                    -kRowPadding);
+  if (!icon.isNull()) {
+    const QRect iconRect(content.left(),
+                         content.top() + (content.height() - kIconSize) / 2,
+                         kIconSize, kIconSize);
+    icon.paint(painter, iconRect);
+    content.setLeft(iconRect.right() + 1 + kRowPadding);
+  }
+
+  const bool enabled = opt.state & QStyle::State_Enabled;
+  const QFontMetrics titleMetrics(opt.font);
+  QRect titleRect = content;
+  titleRect.setHeight(titleMetrics.height());
+
+  const int badgeCount = index.data(BadgeCountRole).toInt();
+  if (badgeCount > 0) {
+    const QString badgeText = badgeCount > kMaxBadgeCount
+                                  ? QStringLiteral("%1+").arg(kMaxBadgeCount)
+                                  : QString::number(badgeCount);
+    const QFont badgeFont = smallerFont(opt.font, 2);
+    const QFontMetrics badgeMetrics(badgeFont);
+    const int badgeWidth =
+        qMax(kBadgeHeight, badgeMetrics.horizontalAdvance(badgeText) + 10);
+    const QRect badgeRect(titleRect.right() - badgeWidth + 1,
+                          titleRect.center().y() - kBadgeHeight / 2,
+                          badgeWidth, kBadgeHeight);
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(QColor(0xe5, 0x48, 0x4d));
+    painter->drawRoundedRect(badgeRect, kBadgeHeight / 2.0, kBadgeHeight / 2.0);
+    painter->setFont(badgeFont);
+    painter->setPen(Qt::white);
+    painter->drawText(badgeRect, Qt::AlignCenter, badgeText);
+    titleRect.setRight(badgeRect.left() - kRowPadding);
+  }
+
+  const QString secondLine = index.data(SecondLineRole).toString();
+  if (secondLine.isEmpty()) {
+    // Placeholder rows ("暂无会话") have a single, vertically centred line.
+    titleRect.moveTop(content.top() + (content.height() - titleRect.height()) / 2);
+  }
+
+  painter->setFont(opt.font);
+  painter->setPen(enabled ? QColor(0x00, 0x00, 0x00) : QColor(0x99, 0x99, 0x99));
+  painter->drawText(titleRect, Qt::AlignLeft | Qt::AlignVCenter,
+                    titleMetrics.elidedText(title, Qt::ElideRight,
+                                            titleRect.width()));
+
+  if (!secondLine.isEmpty()) {
+    const QFont secondFont = smallerFont(opt.font, 1);
+    const QFontMetrics secondMetrics(secondFont);
+    const QRect secondRect(content.left(),
+                           titleRect.bottom() + 1 + kLineSpacing,
+                           content.width(), secondMetrics.height());
+    painter->setFont(secondFont);
+    painter->setPen(QColor(0x80, 0x80, 0x80));
+    painter->drawText(secondRect, Qt::AlignLeft | Qt::AlignVCenter,
+                      secondMetrics.elidedText(secondLine, Qt::ElideRight,
+                                               secondRect.width()));
+  }
+  painter->restore();
+}
+
+QSize SessionListDelegate::sizeHint(const QStyleOptionViewItem &option,
+                                    const QModelIndex &index) const {
+  Q_UNUSED(index);
+  return QSize(option.rect.width(), kRowHeight);
+}
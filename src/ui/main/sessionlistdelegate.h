@@ -0,0 +1,31 @@
+#ifndef SESSIONLISTDELEGATE_H
+#define SESSIONLISTDELEGATE_H
+
+#include <QStyledItemDelegate>
+
+// Paints one fixed-height row of the conversation, group and contact lists:
+// icon, title, a secondary line and an unread badge. Every row has the same
+// size hint, so the views can run with uniformItemSizes and only lay out the
+// rows that are actually visible.
+class SessionListDelegate : public QStyledItemDelegate {
+  Q_OBJECT
+
+public:
+  // Roles the delegate reads besides Qt::DisplayRole and Qt::DecorationRole.
+  // Models keep their own roles below Qt::UserRole + 64.
+  enum Role {
+    SecondLineRole = Qt::UserRole + 64,
+    BadgeCountRole,
+  };
+
+  static constexpr int kRowHeight = 70;
+
+  explicit SessionListDelegate(QObject *parent = nullptr);
+
+  void paint(QPainter *painter, const QStyleOptionViewItem &option,
+             const QModelIndex &index) const override;
+  QSize sizeHint(const QStyleOptionViewItem &option,
+                 const QModelIndex &index) const override;
+};
+
+#endif // SESSIONLISTDELEGATE_H
@@ -1,36 +1,39 @@
 #include "widget.h"
 
 #include "addfrienddialog.h"
+#include "avatarservice.h"
+#include "conversationstatestore.h"
 #include "creategroupdialog.h"
 #include "deletefrienddialog.h"
+#include "envelopedispatcher.h"
+#include "messagestore.h"
 #include "protocol.h"
 #include "searchgroupdialog.h"
+#include "sessionlistdelegate.h"
 #include "settingswindow.h"
 #include "sessionwindow.h"
 #include "ui_widget.h"
 #include "usersession.h"
 #include "websocketclient.h"
 
-#include <QDir>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QMenu>
 #include <QMessageBox>
-#include <QNetworkRequest>
-#include <QPainter>
-#include <QPainterPath>
 #include <QPixmap>
 #include <QRegularExpression>
-#include <QSet>
 #include <QStyle>
-#include <QStandardPaths>
 #include <QToolButton>
 #include <QTabBar>
+#include <QUuid>
 #include <QtGlobal>
 
 namespace {
 constexpr int kDefaultStaticPort = 18080;
 constexpr int kConversationListRefreshIntervalMs = 10 * 1000;
+// Largest MESSAGE/HISTORY page; longer gaps are fetched page by page.
+constexpr qint64 kHistoryPageLimit = 100;
 constexpr const char *kStaticPortEnv = "QT_SERVER_STATIC_PORT";
 constexpr const char *kStaticHostEnv = "QT_SERVER_STATIC_HOST";
 constexpr const char *kWebSocketHostEnv = "QT_SERVER_WS_HOST";
@@ -83,30 +86,43 @@ QString friendPresenceText(bool isOnline, const QString &lastSeenAtUtc) {
   }
   return QStringLiteral("离线 · 最近在线 %1").arg(trimmed);
 }
-
-constexpr int kRoleSessionId = Qt::UserRole;
-constexpr int kRoleSessionType = Qt::UserRole + 1;
-constexpr int kRoleUserId = Qt::UserRole + 2;
-constexpr int kRoleNumericId = Qt::UserRole + 3;
-constexpr int kRoleUserStatus = Qt::UserRole + 4;
-constexpr int kRoleIsOnline = Qt::UserRole + 5;
-constexpr int kRoleLastSeenAtUtc = Qt::UserRole + 6;
-constexpr int kRoleConversationId = Qt::UserRole + 7;
-constexpr int kRoleLastPreview = Qt::UserRole + 8;
-constexpr int kRoleUnreadCount = Qt::UserRole + 9;
-constexpr int kRoleAvatarUrl = Qt::UserRole + 10;
-constexpr int kRoleDisplayName = Qt::UserRole + 11;
 }
 
 Widget::Widget(QWidget *parent)
     : QWidget(parent), ui(new Ui::Widget), m_isDragging(false) {
   initUI();
-  initAvatarHttpClient();
+
+  AvatarService *avatarService = AvatarService::instance();
+  connect(avatarService, &AvatarService::avatarReady, this,
+          [this](const QUrl &url, int side, const QPixmap &pixmap) {
+            if (url == m_currentAvatarRequestUrl && side == avatarSide()) {
+              applyAvatarPixmap(pixmap);
+            }
+          });
+  connect(avatarService, &AvatarService::avatarFailed, this,
+          [this](const QUrl &url, const QString &) {
+            if (url == m_currentAvatarRequestUrl) {
+              applyDefaultAvatar();
+            }
+          });
 
   m_conversationListRefreshTimer = new QTimer(this);
   m_conversationListRefreshTimer->setInterval(kConversationListRefreshIntervalMs);
   connect(m_conversationListRefreshTimer, &QTimer::timeout, this,
           [this]() { requestConversationList(false); });
+
+  m_presenceUpdateBuffer = new PresenceUpdateBuffer(
+      PresenceUpdateBuffer::kDefaultFlushIntervalMs, this);
+  connect(m_presenceUpdateBuffer, &PresenceUpdateBuffer::updatesReady, this,
+          &Widget::applyPresenceUpdates);
+
+  m_messageSequencer = new MessageSequencer(this);
+  connect(m_messageSequencer, &MessageSequencer::messagesReady, this,
+          &Widget::deliverIncomingMessages);
+  connect(m_messageSequencer, &MessageSequencer::fetchRequested, this,
+          &Widget::requestMessageHistory);
+  connect(m_messageSequencer, &MessageSequencer::fetchAbandoned, this,
+          &Widget::dropHistoryFetch);
 }
 
 Widget::~Widget() { delete ui; }
@@ -295,16 +311,16 @@ void Widget::initUI() {
       "QTabBar::tab:selected { background: #ffffff; font-weight: bold; }"
       "QTabBar::tab:hover { background: #f5f5f5; }");
 
-  const QString listWidgetStyle =
-      "QListWidget { background-color: #ffffff; color: #000000; border: "
+  const QString listViewStyle =
+      "QListView { background-color: #ffffff; color: #000000; border: "
       "none; "
       "margin: 10px; border-radius: 1px; outline: none; }"
-      "QListWidget::item { height: 70px; border-bottom: 1px solid #e0e0e0; "
+      "QListView::item { border-bottom: 1px solid #e0e0e0; "
       "padding: 10px; color: #000000; outline: none; }"
-      "QListWidget::item:selected { background-color: #d0d0d0; color: "
+      "QListView::item:selected { background-color: #d0d0d0; color: "
       "#000000; "
       "}"
-      "QListWidget::item:hover { background-color: #f0f0f0; color: "
+      "QListView::item:hover { background-color: #f0f0f0; color: "
       "#000000; "
       "}"
       "QScrollBar:vertical { border: none; background: #f7f7f7; width: "
@@ -320,23 +336,33 @@ void Widget::initUI() {
       "QScrollBar::add-page:vertical, QScrollBar::sub-page:vertical { "
       "background: none; }";
 
-  m_sessionList = new QListWidget(m_tabWidget);
-  m_sessionList->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
-  m_sessionList->setFrameShape(QFrame::NoFrame);
-  m_sessionList->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
-  m_sessionList->setStyleSheet(listWidgetStyle);
-
-  m_contactList = new QListWidget(m_tabWidget);
-  m_contactList->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
-  m_contactList->setFrameShape(QFrame::NoFrame);
-  m_contactList->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
-  m_contactList->setStyleSheet(listWidgetStyle);
-
-  m_groupList = new QListWidget(m_tabWidget);
-  m_groupList->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
-  m_groupList->setFrameShape(QFrame::NoFrame);
-  m_groupList->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
-  m_groupList->setStyleSheet(listWidgetStyle);
+  m_sessionModel = new ConversationListModel(this);
+  m_sessionModel->setPlaceholderText(QStringLiteral("暂无会话"));
+  // Newest activity on top; a new message moves its row there.
+  m_sessionModel->setActivityOrdered(true);
+  m_sessionModel->setConversationIcons(conversationIcon(1), conversationIcon(2));
+  m_groupModel = new ConversationListModel(this);
+  m_groupModel->setPlaceholderText(QStringLiteral("暂无群聊"));
+  m_groupModel->setConversationIcons(conversationIcon(1), conversationIcon(2));
+  m_contactModel = new FriendListModel(this);
+
+  auto *sessionListDelegate = new SessionListDelegate(this);
+  const auto createListView = [&](QAbstractItemModel *model) {
+    auto *listView = new QListView(m_tabWidget);
+    listView->setModel(model);
+    listView->setItemDelegate(sessionListDelegate);
+    // Fixed-height rows: the view lays out only what is visible.
+    listView->setUniformItemSizes(true);
+    listView->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    listView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    listView->setFrameShape(QFrame::NoFrame);
+    listView->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
+    listView->setStyleSheet(listViewStyle);
+    return listView;
+  };
+  m_sessionList = createListView(m_sessionModel);
+  m_contactList = createListView(m_contactModel);
+  m_groupList = createListView(m_groupModel);
 
   m_tabWidget->addTab(m_sessionList, QStringLiteral("会话"));
   m_tabWidget->addTab(m_contactList, QStringLiteral("联系人"));
@@ -346,39 +372,20 @@ void Widget::initUI() {
   containerLayout->addWidget(m_topPanel);
   containerLayout->addWidget(m_tabWidget);
 
-  connect(m_sessionList, &QListWidget::itemDoubleClicked, this,
+  connect(m_sessionList, &QListView::doubleClicked, this,
           &Widget::onSessionDoubleClicked);
-  connect(m_groupList, &QListWidget::itemDoubleClicked, this,
+  connect(m_groupList, &QListView::doubleClicked, this,
           &Widget::onSessionDoubleClicked);
 
-  connect(websocketclient::instance(), &websocketclient::textMessageReceived,
-          this, [this](const QString &message) {
-            handleIncomingRealtimePayload(message, QStringLiteral("文本"));
-          });
-  connect(websocketclient::instance(), &websocketclient::binaryMessageReceived,
-          this, [this](const QByteArray &data) {
-            handleIncomingRealtimePayload(QString::fromUtf8(data),
-                                          QStringLiteral("二进制"));
-          });
-}
-
-void Widget::initAvatarHttpClient() {
-  if (m_avatarNetworkManager) {
-    return;
-  }
-
-  m_avatarNetworkManager = new QNetworkAccessManager(this);
-  m_avatarDiskCache = new QNetworkDiskCache(this);
-  const QString appDataPath =
-      QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-  const QString cachePath = appDataPath + "/http_cache/avatar";
-  QDir().mkpath(cachePath);
-  m_avatarDiskCache->setCacheDirectory(cachePath);
-  m_avatarDiskCache->setMaximumCacheSize(50 * 1024 * 1024); // 50MB
-  m_avatarNetworkManager->setCache(m_avatarDiskCache);
-
-  connect(m_avatarNetworkManager, &QNetworkAccessManager::finished, this,
-          &Widget::onAvatarReplyFinished);
+  EnvelopeDispatcher *dispatcher = EnvelopeDispatcher::instance();
+  dispatcher->subscribe(QStringLiteral("MESSAGE"), QStringLiteral("SEND"), this,
+                        [this](const protocol::Envelope &envelope) {
+                          handleMessageEnvelope(envelope);
+                        });
+  dispatcher->subscribe(QStringLiteral("MESSAGE"), QStringLiteral("PRESENCE"),
+                        this, [this](const protocol::Envelope &envelope) {
+                          handlePresenceEnvelope(envelope.data);
+                        });
 }
 
 QUrl Widget::resolveAvatarUrl(const QString &avatarUrl) const {
@@ -424,28 +431,26 @@ QUrl Widget::resolveAvatarUrl(const QString &avatarUrl) const {
 }
 
 void Widget::requestAvatarImage(const QString &avatarUrl) {
-  if (!m_avatarNetworkManager) {
-    applyDefaultAvatar();
-    return;
-  }
-
   const QUrl url = resolveAvatarUrl(avatarUrl);
   if (!url.isValid()) {
     qWarning() << "Avatar URL invalid, fallback to default avatar:" << avatarUrl;
+    m_currentAvatarRequestUrl.clear();
     applyDefaultAvatar();
     return;
   }
 
-  QNetworkRequest request(url);
-  request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
-                       QNetworkRequest::AlwaysNetwork);
-  request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
-  request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
-                       QNetworkRequest::NoLessSafeRedirectPolicy);
-  request.setTransferTimeout(8000);
+  m_currentAvatarRequestUrl = url;
+  const QPixmap cached = AvatarService::instance()->avatar(url, avatarSide());
+  if (!cached.isNull()) {
+    applyAvatarPixmap(cached);
+  }
+}
 
-  QNetworkReply *reply = m_avatarNetworkManager->get(request);
-  reply->setProperty("requested_avatar_url", avatarUrl.trimmed());
+int Widget::avatarSide() const {
+  if (!m_avatarLabel) {
+    return 0;
+  }
+  return qMin(m_avatarLabel->width(), m_avatarLabel->height());
 }
 
 void Widget::applyAvatarPixmap(const QPixmap &pixmap) {
@@ -454,23 +459,7 @@ void Widget::applyAvatarPixmap(const QPixmap &pixmap) {
     return;
   }
 
-  const QSize targetSize = m_avatarLabel->size();
-  const int side = qMin(targetSize.width(), targetSize.height());
-  const QPixmap scaled =
-      pixmap.scaled(side, side, Qt::KeepAspectRatioByExpanding,
-                    Qt::SmoothTransformation);
-
-  QPixmap circular(side, side);
-  circular.fill(Qt::transparent);
-  QPainter painter(&circular);
-  painter.setRenderHint(QPainter::Antialiasing, true);
-  QPainterPath clipPath;
-  clipPath.addEllipse(0, 0, side, side);
-  painter.setClipPath(clipPath);
-  painter.drawPixmap(0, 0, scaled);
-  painter.end();
-
-  m_avatarLabel->setPixmap(circular);
+  m_avatarLabel->setPixmap(pixmap);
   m_avatarLabel->setText(QString());
 }
 
@@ -495,6 +484,7 @@ void Widget::setUserInfo(const QString &username, const QString &avatarPath,
   m_signatureLabel->setText(m_currentSignature.isEmpty() ? "暂无签名"
                                                         : m_currentSignature);
   if (m_currentAvatarUrl.isEmpty()) {
+    m_currentAvatarRequestUrl.clear();
     applyDefaultAvatar();
     return;
   }
@@ -563,18 +553,21 @@ void Widget::mouseReleaseEvent(QMouseEvent *event) {
   }
 }
 
-void Widget::onSessionDoubleClicked(QListWidgetItem *item) {
-  if (!item)
+void Widget::onSessionDoubleClicked(const QModelIndex &index) {
+  if (!index.isValid())
     return;
-  const QString sessionId = item->data(kRoleSessionId).toString();
+  const QString sessionId =
+      index.data(ConversationListModel::SessionIdRole).toString();
   const Session session = m_sessionsById.value(sessionId);
   if (!session.isValid())
     return;
 
-  const QString peerUserId = item->data(kRoleUserId).toString().trimmed();
-  const QString peerNumericId = item->data(kRoleNumericId).toString().trimmed();
+  const QString peerUserId =
+      index.data(ConversationListModel::UserIdRole).toString().trimmed();
+  const QString peerNumericId =
+      index.data(ConversationListModel::NumericIdRole).toString().trimmed();
   const QString conversationId =
-      item->data(kRoleConversationId).toString().trimmed();
+      index.data(ConversationListModel::ConversationIdRole).toString().trimmed();
   SessionWindow *sessionWindow = nullptr;
   if (!conversationId.isEmpty()) {
     sessionWindow = m_sessionWindowsByConversationId.value(conversationId);
@@ -601,8 +594,9 @@ void Widget::onSessionDoubleClicked(QListWidgetItem *item) {
 
   sessionWindow = new SessionWindow(session);
   sessionWindow->setPeerIdentity(peerUserId, peerNumericId);
-  sessionWindow->updatePeerPresence(item->data(kRoleIsOnline).toBool(),
-                                    item->data(kRoleLastSeenAtUtc).toString());
+  sessionWindow->updatePeerPresence(
+      index.data(ConversationListModel::IsOnlineRole).toBool(),
+      index.data(ConversationListModel::LastSeenAtUtcRole).toString());
   if (!peerUserId.isEmpty()) {
     m_sessionWindowsByUserId.insert(peerUserId, sessionWindow);
   }
@@ -617,15 +611,14 @@ void Widget::onSessionDoubleClicked(QListWidgetItem *item) {
             if (conversationId.isEmpty()) {
               return;
             }
-            ConversationListState state =
-                m_conversationStatesByConversationId.value(conversationId);
-            state.conversationId = conversationId;
-            state.lastMessagePreview = previewText.trimmed();
-            state.unreadCount = 0;
-            m_conversationStatesByConversationId.insert(conversationId, state);
-            if (QListWidgetItem *listItem =
-                    findConversationItemByConversationId(conversationId)) {
-              applyConversationStateToItem(listItem, state, nullptr);
+            // The seq is not known until the ack; the store only moves it
+            // forward, so 0 leaves it untouched.
+            ConversationStateStore::instance()->recordOutgoing(
+                conversationId, 0, previewText.trimmed(),
+                QDateTime::currentDateTimeUtc());
+            if (const conversationlist::ConversationItem *conversation =
+                    conversationFor(conversationId)) {
+              refreshConversationRows(*conversation);
             }
           });
   connect(sessionWindow, &QObject::destroyed, this,
@@ -645,17 +638,58 @@ void Widget::onSessionDoubleClicked(QListWidgetItem *item) {
 }
 
 void Widget::addSessionItem(const Session &session) {
-  if (!session.isValid() || !m_sessionList)
+  if (!session.isValid() || !m_sessionModel)
     return;
 
   m_sessionsById.insert(session.id(), session);
-  QListWidgetItem *item = new QListWidgetItem(session.displayName());
-  item->setData(kRoleSessionId, session.id());
-  item->setData(kRoleSessionType,
-                session.type() == Session::Type::Group ? "group" : "direct");
-  item->setData(kRoleConversationId, session.conversationId());
-  item->setIcon(conversationIcon(session.type() == Session::Type::Group ? 2 : 1));
-  m_sessionList->addItem(item);
+  ConversationListRow row;
+  row.sessionId = session.id();
+  row.conversationId = session.conversationId().trimmed();
+  row.conversationType = session.type() == Session::Type::Group ? 2 : 1;
+  row.displayName = session.displayName();
+  row.title = session.displayName();
+  m_sessionModel->upsertRow(row);
+}
+
+void Widget::endSession() {
+  if (m_settingsWindow) {
+    m_settingsWindow->close();
+  }
+  if (m_addFriendDialog) {
+    m_addFriendDialog->close();
+  }
+  if (m_deleteFriendDialog) {
+    m_deleteFriendDialog->close();
+  }
+  if (m_createGroupDialog) {
+    m_createGroupDialog->close();
+  }
+  if (m_searchGroupDialog) {
+    m_searchGroupDialog->close();
+  }
+  m_currentUserId.clear();
+  m_currentUserNumericId.clear();
+  m_currentDisplayName.clear();
+  m_currentSignature.clear();
+  m_currentAvatarUrl.clear();
+  m_pendingConversationListRequestId.clear();
+  m_pendingFriendListRequestId.clear();
+  m_pendingOpenConversationId.clear();
+  if (m_conversationListRefreshTimer) {
+    m_conversationListRefreshTimer->stop();
+  }
+  m_conversationListManager.clear();
+  m_friendListManager.clear();
+  m_sessionWindowsByUserId.clear();
+  m_sessionWindowsByNumericId.clear();
+  m_sessionWindowsByConversationId.clear();
+  m_pendingConversations.clear();
+  m_messageSequencer->clear();
+  refreshConversationListUi();
+  refreshGroupListUi();
+  refreshContactListUi();
+  emit logoutRequested();
+  close();
 }
 
 void Widget::onOpenSettings() {
@@ -690,42 +724,8 @@ void Widget::onOpenSettings() {
                     << displayName << "avatar_url=" << avatarUrl;
             setUserInfo(displayName, avatarUrl, signature);
           });
-  connect(m_settingsWindow, &SettingsWindow::logoutRequested, this, [this]() {
-    if (m_addFriendDialog) {
-      m_addFriendDialog->close();
-    }
-    if (m_deleteFriendDialog) {
-      m_deleteFriendDialog->close();
-    }
-    if (m_createGroupDialog) {
-      m_createGroupDialog->close();
-    }
-    if (m_searchGroupDialog) {
-      m_searchGroupDialog->close();
-    }
-    m_currentUserId.clear();
-    m_currentUserNumericId.clear();
-    m_currentDisplayName.clear();
-    m_currentSignature.clear();
-    m_currentAvatarUrl.clear();
-    m_pendingConversationListRequestId.clear();
-    m_pendingFriendListRequestId.clear();
-    m_pendingOpenConversationId.clear();
-    if (m_conversationListRefreshTimer) {
-      m_conversationListRefreshTimer->stop();
-    }
-    m_conversationListManager.clear();
-    m_friendListManager.clear();
-    m_sessionWindowsByUserId.clear();
-    m_sessionWindowsByNumericId.clear();
-    m_sessionWindowsByConversationId.clear();
-    m_conversationStatesByConversationId.clear();
-    refreshConversationListUi();
-    refreshGroupListUi();
-    refreshContactListUi();
-    emit logoutRequested();
-    close();
-  });
+  connect(m_settingsWindow, &SettingsWindow::logoutRequested, this,
+          &Widget::endSession);
   connect(m_settingsWindow, &QObject::destroyed, this,
           [this]() { m_settingsWindow = nullptr; });
   m_settingsWindow->show();
@@ -733,43 +733,6 @@ void Widget::onOpenSettings() {
   m_settingsWindow->activateWindow();
 }
 
-void Widget::onAvatarReplyFinished(QNetworkReply *reply) {
-  if (!reply) {
-    return;
-  }
-
-  const QString requestedAvatarUrl =
-      reply->property("requested_avatar_url").toString().trimmed();
-  const bool isLatestRequest = (requestedAvatarUrl == m_currentAvatarUrl);
-  if (!isLatestRequest) {
-    reply->deleteLater();
-    return;
-  }
-
-  const QVariant statusCode =
-      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
-  const int httpCode = statusCode.isValid() ? statusCode.toInt() : 0;
-
-  if (reply->error() != QNetworkReply::NoError || httpCode != 200) {
-    qWarning() << "Avatar download failed, url=" << reply->url().toString()
-               << "http_code=" << httpCode << "error=" << reply->errorString();
-    applyDefaultAvatar();
-    reply->deleteLater();
-    return;
-  }
-
-  QPixmap pixmap;
-  if (!pixmap.loadFromData(reply->readAll())) {
-    qWarning() << "Avatar decode failed, url=" << reply->url().toString();
-    applyDefaultAvatar();
-    reply->deleteLater();
-    return;
-  }
-
-  applyAvatarPixmap(pixmap);
-  reply->deleteLater();
-}
-
 void Widget::onOpenAddFriend() {
   if (!m_profileApiClient) {
     QMessageBox::warning(this, "无法添加好友", "Profile 服务未初始化。");
@@ -907,9 +870,9 @@ void Widget::onOpenSearchGroup() {
             const QString action = result.message.trimmed();
             if (action == QStringLiteral("open_existing_group")) {
               if (!conversationId.isEmpty()) {
-                if (QListWidgetItem *item =
-                        findConversationItemByConversationId(conversationId)) {
-                  onSessionDoubleClicked(item);
+                const QModelIndex index = findConversationIndex(conversationId);
+                if (index.isValid()) {
+                  onSessionDoubleClicked(index);
                   return;
                 }
                 m_pendingOpenConversationId = conversationId;
@@ -948,8 +911,8 @@ void Widget::requestConversationList(bool force) {
       !kUnsignedIntRe.match(numericId).hasMatch()) {
     return;
   }
-  m_pendingConversationListRequestId =
-      m_profileApiClient->fetchConversationList(numericId);
+  m_pendingConversationListRequestId = m_profileApiClient->fetchConversationList(
+      numericId, m_conversationListManager.syncCursor());
 }
 
 void Widget::requestFriendListForContacts(bool force) {
@@ -973,209 +936,145 @@ void Widget::requestFriendListForContacts(bool force) {
 }
 
 void Widget::refreshConversationListUi() {
-  if (!m_sessionList) {
-    qWarning() << "[MainWidget] refresh conversation list skipped: session list is null";
+  if (!m_sessionModel) {
+    qWarning() << "[MainWidget] refresh conversation list skipped: session model is null";
     return;
   }
 
-  m_sessionList->clear();
   m_sessionsById.clear();
-  QSet<QString> activeConversationIds;
 
-  const QList<conversationlist::ConversationItem> &conversations =
-      m_conversationListManager.conversations();
-  bool hasConversation = false;
-  for (const conversationlist::ConversationItem &conversationItem : conversations) {
-    if (!conversationItem.conversationId.trimmed().isEmpty()) {
-      activeConversationIds.insert(conversationItem.conversationId.trimmed());
-    }
-    hasConversation = true;
-  }
+  // Conversations known only from message pushes are dropped with their rows;
+  // read state lives in ConversationStateStore and survives refreshes.
+  m_pendingConversations.clear();
 
-  for (auto it = m_conversationStatesByConversationId.begin();
-       it != m_conversationStatesByConversationId.end();) {
-    if (!activeConversationIds.contains(it.key())) {
-      it = m_conversationStatesByConversationId.erase(it);
-      continue;
-    }
-    ++it;
-  }
-
-  if (!hasConversation) {
-    auto *emptyItem = new QListWidgetItem(QStringLiteral("暂无会话"));
-    emptyItem->setFlags(emptyItem->flags() & ~Qt::ItemIsSelectable &
-                        ~Qt::ItemIsEnabled);
-    m_sessionList->addItem(emptyItem);
-  }
-
-  for (const conversationlist::ConversationItem &conversationItem : conversations) {
-    ConversationListState state =
-        m_conversationStatesByConversationId.value(conversationItem.conversationId);
-    state.conversationId = conversationItem.conversationId.trimmed();
-    state.conversationUuid = conversationItem.conversationUuid.trimmed();
-    state.groupNumericId = conversationItem.groupNumericId.trimmed();
-    state.conversationType = conversationItem.conversationType;
-    state.displayName = conversationItem.name;
-    state.avatarUrl = conversationItem.avatarUrl;
-    state.memberCount = conversationItem.memberCount;
-    state.peerUserId = conversationItem.peerUserId;
-    state.peerNumericId = conversationItem.peerNumericId;
-    state.peerUsername = conversationItem.peerUsername;
-    state.peerNickname = conversationItem.peerNickname;
-    state.peerAvatarUrl = conversationItem.peerAvatarUrl;
-    state.peerBio = conversationItem.peerBio;
-    state.peerStatus = conversationItem.peerStatus;
-    state.peerIsOnline = conversationItem.peerIsOnline;
-    state.peerLastSeenAt = conversationItem.peerLastSeenAt;
-    state.placeholder = false;
-    if (!state.conversationId.isEmpty()) {
-      m_conversationStatesByConversationId.insert(state.conversationId, state);
-    }
-    upsertConversationListItemToList(m_sessionList, state, &conversationItem);
+  const QList<conversationlist::ConversationRecord> &conversations =
+      m_conversationListManager.conversations();
+  QVector<ConversationListRow> rows;
+  rows.reserve(conversations.size());
+  for (const conversationlist::ConversationRecord &record : conversations) {
+    reconcileConversationState(*record);
+    rows.push_back(buildConversationRow(*record, nullptr, false));
   }
+  m_sessionModel->resetRows(rows);
 }
 
 void Widget::refreshGroupListUi() {
-  if (!m_groupList) {
-    qWarning() << "[MainWidget] refresh group list skipped: group list is null";
+  if (!m_groupModel) {
+    qWarning() << "[MainWidget] refresh group list skipped: group model is null";
     return;
   }
 
-  m_groupList->clear();
-
-  const QList<conversationlist::ConversationItem> &conversations =
+  const QList<conversationlist::ConversationRecord> &conversations =
       m_conversationListManager.conversations();
-  bool hasGroupConversation = false;
-  for (const conversationlist::ConversationItem &conversationItem : conversations) {
-    if (conversationItem.conversationType == 2) {
-      hasGroupConversation = true;
-      break;
-    }
-  }
-  if (!hasGroupConversation) {
-    auto *emptyItem = new QListWidgetItem(QStringLiteral("暂无群聊"));
-    emptyItem->setFlags(emptyItem->flags() & ~Qt::ItemIsSelectable &
-                        ~Qt::ItemIsEnabled);
-    m_groupList->addItem(emptyItem);
-  }
-
-  for (const conversationlist::ConversationItem &conversationItem : conversations) {
-    if (conversationItem.conversationType != 2) {
+  QVector<ConversationListRow> rows;
+  for (const conversationlist::ConversationRecord &record : conversations) {
+    if (record->conversationType != 2) {
       continue;
     }
-    ConversationListState state =
-        m_conversationStatesByConversationId.value(conversationItem.conversationId);
-    state.conversationId = conversationItem.conversationId.trimmed();
-    state.conversationUuid = conversationItem.conversationUuid.trimmed();
-    state.groupNumericId = conversationItem.groupNumericId.trimmed();
-    state.conversationType = conversationItem.conversationType;
-    state.displayName = conversationItem.name;
-    state.avatarUrl = conversationItem.avatarUrl;
-    state.memberCount = conversationItem.memberCount;
-    state.peerUserId = conversationItem.peerUserId;
-    state.peerNumericId = conversationItem.peerNumericId;
-    state.peerUsername = conversationItem.peerUsername;
-    state.peerNickname = conversationItem.peerNickname;
-    state.peerAvatarUrl = conversationItem.peerAvatarUrl;
-    state.peerBio = conversationItem.peerBio;
-    state.peerStatus = conversationItem.peerStatus;
-    state.peerIsOnline = conversationItem.peerIsOnline;
-    state.peerLastSeenAt = conversationItem.peerLastSeenAt;
-    state.placeholder = false;
-    if (!state.conversationId.isEmpty()) {
-      m_conversationStatesByConversationId.insert(state.conversationId, state);
-    }
-    upsertConversationListItem(state, &conversationItem);
+    rows.push_back(buildConversationRow(
+        *record,
+        m_sessionModel ? m_sessionModel->findConversation(record->conversationId)
+                       : nullptr,
+        true));
   }
+  m_groupModel->resetRows(rows);
 }
 
 void Widget::refreshContactListUi() {
-  if (!m_contactList) {
-    qWarning() << "[MainWidget] refresh contact list skipped: contact list is null";
+  if (!m_contactModel) {
+    qWarning() << "[MainWidget] refresh contact list skipped: contact model is null";
     return;
   }
   // Contacts still depend on LIST_FRIENDS until dedicated contact models are split out.
-  friendlist::FriendListManager::refreshListWidget(m_contactList,
-                                                   m_friendListManager.friends());
+  m_contactModel->setFriends(m_friendListManager.friends());
 }
 
 void Widget::updateConversationListItem(
     const conversationlist::ConversationItem &conversationItem) {
-  if (!m_sessionList && !m_groupList) {
+  if (!findConversationIndex(conversationItem.conversationId).isValid()) {
     return;
   }
-  QListWidgetItem *item =
-      findConversationItemByConversationId(conversationItem.conversationId);
-  if (!item) {
-    return;
+  refreshConversationRows(conversationItem);
+}
+
+const conversationlist::ConversationItem *
+Widget::conversationFor(const QString &conversationId) const {
+  if (const conversationlist::ConversationItem *listed =
+          m_conversationListManager.findConversation(conversationId)) {
+    return listed;
   }
+  const auto it = m_pendingConversations.constFind(conversationId.trimmed());
+  return it == m_pendingConversations.cend() ? nullptr : &it->item();
+}
 
-  ConversationListState state =
-      m_conversationStatesByConversationId.value(conversationItem.conversationId);
-  state.conversationId = conversationItem.conversationId.trimmed();
-  state.conversationUuid = conversationItem.conversationUuid.trimmed();
-  state.groupNumericId = conversationItem.groupNumericId.trimmed();
-  state.conversationType = conversationItem.conversationType;
-  state.displayName = conversationItem.name;
-  state.avatarUrl = conversationItem.avatarUrl;
-  state.memberCount = conversationItem.memberCount;
-  state.peerUserId = conversationItem.peerUserId;
-  state.peerNumericId = conversationItem.peerNumericId;
-  state.peerUsername = conversationItem.peerUsername;
-  state.peerNickname = conversationItem.peerNickname;
-  state.peerAvatarUrl = conversationItem.peerAvatarUrl;
-  state.peerBio = conversationItem.peerBio;
-  state.peerStatus = conversationItem.peerStatus;
-  state.peerIsOnline = conversationItem.peerIsOnline;
-  state.peerLastSeenAt = conversationItem.peerLastSeenAt;
-  state.placeholder = false;
-  if (!state.conversationId.isEmpty()) {
-    m_conversationStatesByConversationId.insert(state.conversationId, state);
-  }
-  applyConversationStateToItem(item, state, &conversationItem);
-  qInfo().noquote() << "[MainWidget] refreshed conversation list item peer_user_id="
-                    << conversationItem.peerUserId << "peer_numeric_id="
-                    << conversationItem.peerNumericId << "presence="
-                    << friendPresenceText(conversationItem.peerIsOnline,
-                                          conversationItem.peerLastSeenAt);
+void Widget::reconcileConversationState(
+    const conversationlist::ConversationItem &conversationItem) {
+  if (conversationItem.conversationId.isEmpty()) {
+    return;
+  }
+  ServerConversationState serverState;
+  serverState.lastSeq = conversationItem.lastSeq;
+  serverState.lastReadSeq = conversationItem.lastReadSeq;
+  serverState.unreadCount = conversationItem.unreadCount;
+  serverState.lastPreview = conversationItem.lastMessagePreview;
+  serverState.lastActivityAt = conversationItem.lastActivityAtUtc;
+  serverState.pinned = conversationItem.pinned;
+  ConversationStateStore::instance()->reconcile(conversationItem.conversationId,
+                                                serverState);
 }
 
-void Widget::syncFriendListToDeleteDialog() {
-  if (m_deleteFriendDialog) {
-    m_deleteFriendDialog->setFriends(m_friendListManager.friends());
+void Widget::applyConversationListDiff(
+    const conversationlist::ConversationListDiff &diff) {
+  for (const QString &conversationId : diff.removedConversationIds) {
+    removeConversationListItems(conversationId);
+    m_pendingConversations.remove(conversationId);
+    ConversationStateStore::instance()->remove(conversationId);
   }
-  if (m_createGroupDialog) {
-    m_createGroupDialog->setFriends(m_friendListManager.friends());
+
+  const QStringList upsertIds =
+      diff.addedConversationIds + diff.changedConversationIds;
+  for (const QString &conversationId : upsertIds) {
+    const conversationlist::ConversationItem *conversationItem =
+        m_conversationListManager.findConversation(conversationId);
+    if (!conversationItem) {
+      continue;
+    }
+    m_pendingConversations.remove(conversationId);
+    reconcileConversationState(*conversationItem);
+    upsertConversationRows(*conversationItem);
   }
+
+  qInfo() << "[MainWidget] applied conversation list diff added="
+          << diff.addedConversationIds.size()
+          << "changed=" << diff.changedConversationIds.size()
+          << "removed=" << diff.removedConversationIds.size();
 }
 
-void Widget::handleIncomingRealtimePayload(const QString &payload,
-                                           const QString &sourceTag) {
-  protocol::Envelope envelope;
-  QString parseError;
-  if (!protocol::parseEnvelope(payload, &envelope, &parseError)) {
-    return;
+void Widget::removeConversationListItems(const QString &conversationId) {
+  const QList<ConversationListModel *> models = {m_sessionModel, m_groupModel};
+  for (ConversationListModel *model : models) {
+    const ConversationListRow *row =
+        model ? model->findConversation(conversationId) : nullptr;
+    if (!row) {
+      continue;
+    }
+    m_sessionsById.remove(row->sessionId);
+    model->removeConversation(conversationId);
   }
+}
 
-  if (envelope.type == QStringLiteral("MESSAGE") &&
-      envelope.action == QStringLiteral("SEND")) {
-    handleMessageEnvelope(envelope);
-    return;
+void Widget::syncFriendListToDeleteDialog() {
+  if (m_deleteFriendDialog) {
+    m_deleteFriendDialog->setFriends(m_friendListManager.friends());
   }
-
-  if (envelope.type == QStringLiteral("MESSAGE") &&
-      envelope.action == QStringLiteral("PRESENCE")) {
-    qInfo().noquote() << "[MainWidget] received presence broadcast source="
-                      << sourceTag << "payload="
-                      << QString::fromUtf8(
-                             QJsonDocument(envelope.data)
-                                 .toJson(QJsonDocument::Compact));
-    handlePresenceEnvelope(envelope.data);
+  if (m_createGroupDialog) {
+    m_createGroupDialog->setFriends(m_friendListManager.friends());
   }
 }
 
 void Widget::handleMessageEnvelope(const protocol::Envelope &envelope) {
   if (!envelope.requestId.trimmed().isEmpty()) {
+    handleMessageSendAck(envelope);
     return;
   }
 
@@ -1190,44 +1089,222 @@ void Widget::handleMessageEnvelope(const protocol::Envelope &envelope) {
     return;
   }
 
-  ConversationListState state =
-      m_conversationStatesByConversationId.value(conversationId);
-  state.conversationId = conversationId;
-  if (state.displayName.isEmpty()) {
-    state.displayName =
-        envelope.data.value(QStringLiteral("from_username")).toString().trimmed();
-    if (state.displayName.isEmpty()) {
-      state.displayName = conversationId;
+  if (!m_conversationListManager.findConversation(conversationId)) {
+    // Not listed yet; the push itself names the peer until the list does.
+    conversationlist::ConversationItem &pending =
+        m_pendingConversations[conversationId].edit();
+    pending.conversationId = conversationId;
+    if (pending.name.isEmpty()) {
+      pending.name =
+          envelope.data.value(QStringLiteral("from_username")).toString().trimmed();
+      if (pending.name.isEmpty()) {
+        pending.name = conversationId;
+      }
+    }
+    if (pending.peerUserId.isEmpty()) {
+      pending.peerUserId =
+          envelope.data.value(QStringLiteral("from_user_id")).toString().trimmed();
+    }
+    if (pending.peerNumericId.isEmpty()) {
+      pending.peerNumericId = envelope.data.value(QStringLiteral("from_numeric_id"))
+                                  .toString()
+                                  .trimmed();
     }
   }
-  if (state.peerUserId.isEmpty()) {
-    state.peerUserId =
-        envelope.data.value(QStringLiteral("from_user_id")).toString().trimmed();
+
+  StoredMessage incoming;
+  incoming.conversationId = conversationId;
+  incoming.messageId = envelope.data.value(QStringLiteral("message_id"))
+                           .toVariant()
+                           .toString()
+                           .trimmed();
+  incoming.seq = envelope.data.value(QStringLiteral("seq")).toVariant().toLongLong();
+  incoming.content = content;
+  incoming.sentAt =
+      envelope.data.value(QStringLiteral("sent_at")).toString().trimmed();
+  incoming.senderUserId =
+      envelope.data.value(QStringLiteral("from_user_id")).toString().trimmed();
+  incoming.senderUsername =
+      envelope.data.value(QStringLiteral("from_username")).toString().trimmed();
+
+  // Pushes replayed after a reconnect come back as duplicates, and pushes
+  // racing each other can arrive out of order; the sequencer hands them over
+  // once each and in seq order.
+  trackConversationSequence(conversationId);
+  if (!m_messageSequencer->accept(incoming)) {
+    qInfo() << "[MainWidget] drop duplicate MESSAGE/SEND conversation_id="
+            << conversationId << "seq=" << incoming.seq;
+  }
+}
+
+void Widget::handleMessageSendAck(const protocol::Envelope &envelope) {
+  const bool ok =
+      envelope.code == 0 &&
+      (envelope.hasOk ? envelope.ok
+                      : envelope.data.value(QStringLiteral("ok")).toBool(false));
+  StoredMessage own;
+  own.conversationId =
+      envelope.data.value(QStringLiteral("conversation_id")).toString().trimmed();
+  own.seq = envelope.data.value(QStringLiteral("seq")).toVariant().toLongLong();
+  if (!ok || own.conversationId.isEmpty() || own.seq <= 0) {
+    return;
+  }
+  // Our own messages take seqs too; without them every reply would look like
+  // a gap.
+  trackConversationSequence(own.conversationId);
+  m_messageSequencer->acceptOwn(own);
+  ConversationStateStore::instance()->acknowledgeOutgoing(own.conversationId,
+                                                        own.seq);
+}
+
+void Widget::trackConversationSequence(const QString &conversationId) {
+  if (!m_messageSequencer->isTracking(conversationId)) {
+    m_messageSequencer->setDeliveredSeq(
+        conversationId, MessageStore::instance()->newestSeq(conversationId));
   }
-  if (state.peerNumericId.isEmpty()) {
-    state.peerNumericId =
-        envelope.data.value(QStringLiteral("from_numeric_id")).toString().trimmed();
+}
+
+void Widget::deliverIncomingMessages(const QString &conversationId,
+                                     const QVector<StoredMessage> &messages) {
+  if (messages.isEmpty()) {
+    return;
   }
-  state.lastMessagePreview = content;
-  state.placeholder = false;
 
+  // Every message reaches local history, whether or not its window is open.
+  const QString selfUserId = UserSession::instance().userId().trimmed();
   SessionWindow *openWindow = m_sessionWindowsByConversationId.value(conversationId);
-  if (!openWindow) {
-    state.unreadCount += 1;
-  } else {
-    state.unreadCount = 0;
+  ConversationStateStore *stateStore = ConversationStateStore::instance();
+  for (const StoredMessage &message : messages) {
+    QString storeError;
+    if (message.seq > 0 && !message.messageId.isEmpty() &&
+        !MessageStore::instance()->append(message, &storeError)) {
+      qWarning() << "[MainWidget] store incoming message failed conversation_id="
+                 << conversationId << "error=" << storeError;
+    }
+    const bool ownMessage =
+        !selfUserId.isEmpty() && message.senderUserId == selfUserId;
+    stateStore->recordIncoming(
+        conversationId, message.seq, message.content,
+        QDateTime::fromString(message.sentAt, Qt::ISODate),
+        openWindow != nullptr || ownMessage);
+    if (openWindow) {
+      openWindow->handleIncomingMessage(message);
+    }
   }
-  m_conversationStatesByConversationId.insert(conversationId, state);
 
-  if (QListWidgetItem *item = findConversationItemByConversationId(conversationId)) {
-    applyConversationStateToItem(item, state, nullptr);
-  } else {
-    upsertConversationListItem(state, nullptr);
+  const conversationlist::ConversationItem *conversation =
+      conversationFor(conversationId);
+  if (!conversation) {
+    conversationlist::ConversationItem &pending =
+        m_pendingConversations[conversationId].edit();
+    pending.conversationId = conversationId;
+    pending.name = conversationId;
+    conversation = &pending;
   }
+  upsertConversationRows(*conversation);
 
   qInfo() << "[MainWidget] routed incoming MESSAGE/SEND conversation_id="
-          << conversationId << "open_window=" << (openWindow != nullptr)
-          << "unread=" << state.unreadCount;
+          << conversationId << "count=" << messages.size()
+          << "open_window=" << (openWindow != nullptr)
+          << "unread=" << stateStore->unreadCount(conversationId);
+}
+
+void Widget::requestMessageHistory(const QString &conversationId,
+                                   qint64 afterSeq, qint64 beforeSeq) {
+  dropHistoryFetch(conversationId);
+  m_historyFetches[conversationId].beforeSeq = beforeSeq;
+  sendHistoryPage(conversationId, afterSeq);
+}
+
+void Widget::sendHistoryPage(const QString &conversationId, qint64 afterSeq) {
+  HistoryFetch &fetch = m_historyFetches[conversationId];
+  const qint64 beforeSeq = fetch.beforeSeq;
+  const qint64 limit = qMin(beforeSeq - afterSeq - 1, kHistoryPageLimit);
+  const QString requestId = QUuid::createUuid().toString(QUuid::WithoutBraces);
+  fetch.requestId = requestId;
+  QJsonObject data;
+  data.insert(QStringLiteral("conversation_id"), conversationId);
+  data.insert(QStringLiteral("after_seq"), afterSeq);
+  data.insert(QStringLiteral("before_seq"), beforeSeq);
+  data.insert(QStringLiteral("limit"), limit);
+
+  EnvelopeDispatcher::instance()->expectResponse(
+      requestId, this,
+      [this, conversationId, requestId, limit](const protocol::Envelope &envelope) {
+        auto it = m_historyFetches.find(conversationId);
+        if (it == m_historyFetches.end() || it->requestId != requestId) {
+          return;
+        }
+        it->requestId.clear();
+        const bool ok = envelope.code == 0 &&
+                        (envelope.hasOk
+                             ? envelope.ok
+                             : envelope.data.value(QStringLiteral("ok")).toBool(false));
+        if (!ok) {
+          qWarning() << "[MainWidget] MESSAGE/HISTORY failed conversation_id="
+                     << conversationId << "code=" << envelope.code
+                     << "message=" << envelope.message;
+        }
+        const QJsonArray items =
+            envelope.data.value(QStringLiteral("messages")).toArray();
+        qint64 pageHighestSeq = 0;
+        for (const QJsonValue &item : items) {
+          const QJsonObject obj = item.toObject();
+          StoredMessage message;
+          message.conversationId = conversationId;
+          message.messageId = obj.value(QStringLiteral("message_id"))
+                                  .toVariant()
+                                  .toString()
+                                  .trimmed();
+          message.seq = obj.value(QStringLiteral("seq")).toVariant().toLongLong();
+          message.content = obj.value(QStringLiteral("content")).toString();
+          message.sentAt = obj.value(QStringLiteral("sent_at")).toString().trimmed();
+          message.senderUserId =
+              obj.value(QStringLiteral("from_user_id")).toVariant().toString().trimmed();
+          message.senderUsername =
+              obj.value(QStringLiteral("from_username")).toString().trimmed();
+          pageHighestSeq = qMax(pageHighestSeq, message.seq);
+          if (message.seq > 0 && !message.content.isEmpty()) {
+            it->messages.push_back(message);
+          }
+        }
+
+        // A full page that stops short of the range means there is more;
+        // each page gets the full fetch timeout again.
+        if (ok && items.size() >= limit && pageHighestSeq + 1 < it->beforeSeq) {
+          m_messageSequencer->extendFetch(conversationId);
+          sendHistoryPage(conversationId, pageHighestSeq);
+          return;
+        }
+        const QVector<StoredMessage> messages =
+            m_historyFetches.take(conversationId).messages;
+        m_messageSequencer->completeFetch(conversationId, messages);
+      });
+
+  const QString payload = protocol::createRequest(
+      QStringLiteral("MESSAGE"), QStringLiteral("HISTORY"), data, requestId);
+  if (!websocketclient::instance()->queueTextMessage(payload)) {
+    EnvelopeDispatcher::instance()->cancelResponse(requestId);
+    // Pages already received still close part of the gap.
+    const QVector<StoredMessage> messages =
+        m_historyFetches.take(conversationId).messages;
+    m_messageSequencer->completeFetch(conversationId, messages);
+    return;
+  }
+  qInfo() << "[MainWidget] MESSAGE/HISTORY request_id=" << requestId
+          << "conversation_id=" << conversationId << "after_seq=" << afterSeq
+          << "before_seq=" << beforeSeq << "limit=" << limit;
+}
+
+void Widget::dropHistoryFetch(const QString &conversationId) {
+  const auto it = m_historyFetches.constFind(conversationId);
+  if (it == m_historyFetches.cend()) {
+    return;
+  }
+  if (!it->requestId.isEmpty()) {
+    EnvelopeDispatcher::instance()->cancelResponse(it->requestId);
+  }
+  m_historyFetches.erase(it);
 }
 
 void Widget::handlePresenceEnvelope(const QJsonObject &data) {
@@ -1243,42 +1320,62 @@ void Widget::handlePresenceEnvelope(const QJsonObject &data) {
   } else if (presenceEvent == QStringLiteral("offline")) {
     isOnline = false;
   }
-  const QString lastSeenAtUtc =
+  PresenceUpdate update;
+  update.userId = userId;
+  update.numericId = numericId;
+  update.isOnline = isOnline;
+  update.lastSeenAtUtc =
       data.value(QStringLiteral("last_seen_at")).toString().trimmed();
-
-  qInfo().noquote()
-      << "[MainWidget] apply presence event user_id=" << userId
-      << "numeric_id=" << numericId << "presence_event=" << presenceEvent
-      << "is_online=" << isOnline << "last_seen_at=" << lastSeenAtUtc;
-
-  conversationlist::ConversationItem updatedConversation;
-  if (!m_conversationListManager.applyPeerPresenceUpdate(
-          userId, numericId, isOnline, lastSeenAtUtc, &updatedConversation)) {
-    qInfo().noquote()
-        << "[MainWidget] ignore presence update: conversation peer not found user_id="
-        << userId << "numeric_id=" << numericId;
+  if (update.userId.isEmpty() && update.numericId.isEmpty()) {
+    qWarning() << "[MainWidget] ignore presence broadcast without user id"
+               << QString::fromUtf8(
+                      QJsonDocument(data).toJson(QJsonDocument::Compact));
     return;
   }
+  // Applied on the next buffer tick, folded with later events of the user.
+  m_presenceUpdateBuffer->enqueue(update);
+}
 
-  updateConversationListItem(updatedConversation);
-
-  SessionWindow *sessionWindow = nullptr;
-  if (!updatedConversation.peerUserId.isEmpty()) {
-    sessionWindow =
-        m_sessionWindowsByUserId.value(updatedConversation.peerUserId);
-  }
-  if (!sessionWindow && !updatedConversation.peerNumericId.isEmpty()) {
-    sessionWindow =
-        m_sessionWindowsByNumericId.value(updatedConversation.peerNumericId);
+void Widget::applyPresenceUpdates(const QVector<PresenceUpdate> &updates) {
+  int matched = 0;
+  int refreshedWindows = 0;
+  for (const PresenceUpdate &update : updates) {
+    conversationlist::ConversationRecord updatedRecord;
+    if (!m_conversationListManager.applyPeerPresenceUpdate(
+            update.userId, update.numericId, update.isOnline,
+            update.lastSeenAtUtc, &updatedRecord)) {
+      continue;
+    }
+    ++matched;
+    const conversationlist::ConversationItem &updatedConversation = *updatedRecord;
+    updateConversationListItem(updatedConversation);
+
+    SessionWindow *sessionWindow = nullptr;
+    if (!updatedConversation.peerUserId.isEmpty()) {
+      sessionWindow =
+          m_sessionWindowsByUserId.value(updatedConversation.peerUserId);
+    }
+    if (!sessionWindow && !updatedConversation.peerNumericId.isEmpty()) {
+      sessionWindow =
+          m_sessionWindowsByNumericId.value(updatedConversation.peerNumericId);
+    }
+    if (sessionWindow) {
+      sessionWindow->updatePeerPresence(updatedConversation.peerIsOnline,
+                                        updatedConversation.peerLastSeenAt);
+      ++refreshedWindows;
+    }
   }
-  if (sessionWindow) {
-    sessionWindow->updatePeerPresence(updatedConversation.peerIsOnline,
-                                      updatedConversation.peerLastSeenAt);
-    qInfo().noquote()
-        << "[MainWidget] refreshed open session window user_id="
-        << updatedConversation.peerUserId << "numeric_id="
-        << updatedConversation.peerNumericId;
+
+  // Runs on every flush tick during a presence storm; keep it out of the
+  // default log.
+  if (matched == 0) {
+    return;
   }
+  const PresenceBufferStats stats = m_presenceUpdateBuffer->stats();
+  qDebug() << "[MainWidget] applied presence updates folded=" << updates.size()
+           << "matched=" << matched << "session_windows=" << refreshedWindows
+           << "received_total=" << stats.received
+           << "applied_total=" << stats.applied;
 }
 
 void Widget::onConversationListPayloadReceived(const QString &requestId,
@@ -1288,18 +1385,24 @@ void Widget::onConversationListPayloadReceived(const QString &requestId,
     return;
   }
   m_pendingConversationListRequestId.clear();
-  if (!m_conversationListManager.updateFromResponse(data)) {
+  const bool wasEmpty = m_conversationListManager.conversations().isEmpty();
+  conversationlist::ConversationListDiff diff;
+  if (!m_conversationListManager.applySyncResponse(data, &diff)) {
     qWarning() << "[MainWidget] failed to parse conversation list payload";
     return;
   }
-  refreshConversationListUi();
-  refreshGroupListUi();
+  if (wasEmpty) {
+    refreshConversationListUi();
+    refreshGroupListUi();
+  } else {
+    applyConversationListDiff(diff);
+  }
   if (!m_pendingOpenConversationId.isEmpty()) {
-    if (QListWidgetItem *item =
-            findConversationItemByConversationId(m_pendingOpenConversationId)) {
+    const QModelIndex index = findConversationIndex(m_pendingOpenConversationId);
+    if (index.isValid()) {
       const QString createdConversationId = m_pendingOpenConversationId;
       m_pendingOpenConversationId.clear();
-      onSessionDoubleClicked(item);
+      onSessionDoubleClicked(index);
       qInfo() << "[MainWidget] opened created group conversation_id="
               << createdConversationId;
     }
@@ -1349,84 +1452,56 @@ void Widget::onFriendListFailed(const QString &requestId, int code,
   syncFriendListToDeleteDialog();
 }
 
-QListWidget *Widget::listWidgetForConversationType(int conversationType) const {
-  return conversationType == 2 ? m_groupList : m_sessionList;
-}
-
-QListWidgetItem *Widget::findConversationItemInList(
-    QListWidget *listWidget, const QString &conversationId) const {
-  if (!listWidget || conversationId.trimmed().isEmpty()) {
-    return nullptr;
+QModelIndex Widget::findConversationIndex(const QString &conversationId) const {
+  const QString trimmedConversationId = conversationId.trimmed();
+  if (trimmedConversationId.isEmpty()) {
+    return QModelIndex();
   }
 
-  for (int i = 0; i < listWidget->count(); ++i) {
-    QListWidgetItem *item = listWidget->item(i);
-    if (!item) {
+  const QList<ConversationListModel *> models = {m_sessionModel, m_groupModel};
+  for (ConversationListModel *model : models) {
+    if (!model) {
       continue;
     }
-    if (item->data(kRoleConversationId).toString().trimmed() ==
-        conversationId.trimmed()) {
-      return item;
+    const QModelIndex index = model->indexForConversationId(trimmedConversationId);
+    if (index.isValid()) {
+      return index;
     }
   }
-  return nullptr;
+  return QModelIndex();
 }
 
-QListWidgetItem *Widget::findConversationItemByConversationId(
-    const QString &conversationId) const {
-  if (conversationId.trimmed().isEmpty()) {
-    return nullptr;
+void Widget::upsertConversationRows(
+    const conversationlist::ConversationItem &conversation) {
+  if (conversation.conversationId.isEmpty() || !m_sessionModel) {
+    return;
   }
 
-  const QList<QListWidget *> listWidgets = {m_sessionList, m_groupList};
-  for (QListWidget *listWidget : listWidgets) {
-    if (QListWidgetItem *item =
-            findConversationItemInList(listWidget, conversationId)) {
-      return item;
-    }
+  const ConversationListRow sessionRow = buildConversationRow(
+      conversation, m_sessionModel->findConversation(conversation.conversationId),
+      false);
+  m_sessionModel->upsertRow(sessionRow);
+  if (conversation.conversationType == 2 && m_groupModel) {
+    // Both tabs open the same Session for a group conversation.
+    m_groupModel->upsertRow(buildConversationRow(conversation, &sessionRow, true));
   }
-  return nullptr;
-}
-
-QListWidgetItem *Widget::upsertConversationListItem(
-    const ConversationListState &state,
-    const conversationlist::ConversationItem *conversationItem) {
-  QListWidget *targetList = listWidgetForConversationType(state.conversationType);
-  return upsertConversationListItemToList(targetList, state, conversationItem);
 }
 
-QListWidgetItem *Widget::upsertConversationListItemToList(
-    QListWidget *targetList, const ConversationListState &state,
-    const conversationlist::ConversationItem *conversationItem) {
-  if (!targetList) {
-    return nullptr;
-  }
-
-  if (!state.conversationId.isEmpty()) {
-    if (QListWidgetItem *existing =
-            findConversationItemInList(targetList, state.conversationId)) {
-      applyConversationStateToItem(existing, state, conversationItem);
-      return existing;
+bool Widget::refreshConversationRows(
+    const conversationlist::ConversationItem &conversation) {
+  bool refreshed = false;
+  const QList<ConversationListModel *> models = {m_sessionModel, m_groupModel};
+  for (ConversationListModel *model : models) {
+    const ConversationListRow *previousRow =
+        model ? model->findConversation(conversation.conversationId) : nullptr;
+    if (!previousRow) {
+      continue;
     }
+    model->upsertRow(buildConversationRow(conversation, previousRow,
+                                          model == m_groupModel));
+    refreshed = true;
   }
-
-  const QString displayName =
-      state.displayName.isEmpty() ? QStringLiteral("未知会话") : state.displayName;
-  const Session::Type sessionType =
-      state.conversationType == 2 ? Session::Type::Group : Session::Type::Direct;
-  const Session session = Session::create(displayName, sessionType,
-                                          state.conversationId,
-                                          state.groupNumericId);
-  m_sessionsById.insert(session.id(), session);
-
-  auto *item = new QListWidgetItem();
-  item->setData(kRoleSessionId, session.id());
-  item->setData(kRoleSessionType,
-                sessionType == Session::Type::Group ? "group" : "direct");
-  item->setIcon(conversationIcon(state.conversationType));
-  applyConversationStateToItem(item, state, conversationItem);
-  targetList->addItem(item);
-  return item;
+  return refreshed;
 }
 
 QIcon Widget::conversationIcon(int conversationType) const {
@@ -1438,82 +1513,76 @@ QIcon Widget::conversationIcon(int conversationType) const {
              : style()->standardIcon(QStyle::SP_FileDialogContentsView);
 }
 
-void Widget::applyConversationStateToItem(QListWidgetItem *item,
-                                          const ConversationListState &state,
-                                          const conversationlist::ConversationItem *conversationItem) {
-  if (!item) {
-    return;
+ConversationListRow Widget::buildConversationRow(
+    const conversationlist::ConversationItem &conversation,
+    const ConversationListRow *previousRow, bool preferGroupMeta) {
+  ConversationListRow row;
+  if (previousRow) {
+    row = *previousRow;
   }
 
   const QString displayName =
-      state.displayName.isEmpty()
-          ? item->data(kRoleDisplayName).toString().trimmed()
-          : state.displayName;
-  const QString numericId = !state.peerNumericId.isEmpty()
-                                ? state.peerNumericId
-                                : item->data(kRoleNumericId).toString().trimmed();
-
-  bool isOnline = state.peerIsOnline;
-  int userStatus = state.peerStatus;
-  QString lastSeenAtUtc = item->data(kRoleLastSeenAtUtc).toString();
-  QString userId = state.peerUserId;
-
-  if (conversationItem) {
-    isOnline = conversationItem->peerIsOnline;
-    userStatus = conversationItem->peerStatus;
-    lastSeenAtUtc = conversationItem->peerLastSeenAt;
-    if (userId.isEmpty()) {
-      userId = conversationItem->peerUserId;
-    }
-  } else if (lastSeenAtUtc.isEmpty()) {
-    lastSeenAtUtc = state.peerLastSeenAt;
-  }
-
-  QString sessionId = item->data(kRoleSessionId).toString().trimmed();
-  if (sessionId.isEmpty() || !m_sessionsById.contains(sessionId)) {
-    const Session::Type sessionType =
-        state.conversationType == 2 ? Session::Type::Group : Session::Type::Direct;
+      conversation.name.isEmpty() ? row.displayName.trimmed() : conversation.name;
+  const QString numericId =
+      !conversation.peerNumericId.isEmpty() ? conversation.peerNumericId
+                                            : row.numericId.trimmed();
+
+  const bool isOnline = conversation.peerIsOnline;
+  const int userStatus = conversation.peerStatus;
+  const QString lastSeenAtUtc = conversation.peerLastSeenAt.isEmpty()
+                                    ? row.lastSeenAtUtc
+                                    : conversation.peerLastSeenAt;
+  const QString userId = conversation.peerUserId;
+
+  if (row.sessionId.isEmpty() || !m_sessionsById.contains(row.sessionId)) {
+    const Session::Type sessionType = conversation.conversationType == 2
+                                          ? Session::Type::Group
+                                          : Session::Type::Direct;
     const Session session = Session::create(
         displayName.isEmpty() ? QStringLiteral("未知会话") : displayName,
-        sessionType, state.conversationId, state.groupNumericId);
-    sessionId = session.id();
-    m_sessionsById.insert(sessionId, session);
-    item->setData(kRoleSessionId, sessionId);
-    item->setData(kRoleSessionType,
-                  sessionType == Session::Type::Group ? "group" : "direct");
-  }
-
-  item->setText(buildSessionItemText(state.conversationType, displayName,
-                                     state.groupNumericId, numericId,
-                                     isOnline, userStatus,
-                                     state.lastMessagePreview, state.memberCount,
-                                     item->listWidget() == m_groupList,
-                                     state.unreadCount));
-  item->setData(kRoleDisplayName, displayName);
-  item->setData(kRoleUserId, userId);
-  item->setData(kRoleNumericId, numericId);
-  item->setData(kRoleUserStatus, userStatus);
-  item->setData(kRoleIsOnline, isOnline);
-  item->setData(kRoleLastSeenAtUtc, lastSeenAtUtc);
-  item->setData(kRoleConversationId, state.conversationId);
-  item->setData(kRoleLastPreview, state.lastMessagePreview);
-  item->setData(kRoleUnreadCount, state.unreadCount);
-  item->setData(kRoleAvatarUrl, state.avatarUrl);
-  item->setIcon(conversationIcon(state.conversationType));
-  if (state.conversationType == 2) {
+        sessionType, conversation.conversationId, conversation.groupNumericId);
+    row.sessionId = session.id();
+    m_sessionsById.insert(row.sessionId, session);
+  }
+
+  row.conversationId = conversation.conversationId;
+  row.conversationType = conversation.conversationType;
+  row.displayName = displayName;
+  row.userId = userId;
+  row.numericId = numericId;
+  row.userStatus = userStatus;
+  row.isOnline = isOnline;
+  row.lastSeenAtUtc = lastSeenAtUtc;
+  row.title = buildSessionItemTitle(conversation.conversationType, displayName,
+                                    numericId, isOnline, userStatus);
+  const ConversationState readState =
+      ConversationStateStore::instance()->state(conversation.conversationId);
+  row.preview = buildSessionItemPreview(conversation.conversationType,
+                                        conversation.groupNumericId,
+                                        readState.lastPreview,
+                                        conversation.memberCount, preferGroupMeta);
+  row.unreadCount = readState.unreadCount;
+  row.pinned = readState.pinned;
+  row.lastActivityMs = readState.lastActivityAt.isValid()
+                           ? readState.lastActivityAt.toMSecsSinceEpoch()
+                           : 0;
+  row.avatarUrl = conversation.avatarUrl;
+  if (conversation.conversationType == 2) {
     QStringList toolTipParts;
-    if (!state.groupNumericId.trimmed().isEmpty()) {
+    if (!conversation.groupNumericId.trimmed().isEmpty()) {
       toolTipParts.push_back(
-          QStringLiteral("群号: %1").arg(state.groupNumericId.trimmed()));
+          QStringLiteral("群号: %1").arg(conversation.groupNumericId.trimmed()));
     }
-    if (state.memberCount > 0) {
-      toolTipParts.push_back(QStringLiteral("群聊成员数: %1").arg(state.memberCount));
+    if (conversation.memberCount > 0) {
+      toolTipParts.push_back(
+          QStringLiteral("群聊成员数: %1").arg(conversation.memberCount));
     }
-    item->setToolTip(toolTipParts.isEmpty() ? QStringLiteral("群聊")
-                                            : toolTipParts.join(QStringLiteral("\n")));
+    row.toolTip = toolTipParts.isEmpty() ? QStringLiteral("群聊")
+                                         : toolTipParts.join(QStringLiteral("\n"));
   } else {
-    item->setToolTip(friendPresenceText(isOnline, lastSeenAtUtc));
+    row.toolTip = friendPresenceText(isOnline, lastSeenAtUtc);
   }
+  return row;
 }
 
 void Widget::resetConversationUnread(const QString &conversationId) {
@@ -1522,30 +1591,31 @@ void Widget::resetConversationUnread(const QString &conversationId) {
     return;
   }
 
-  auto it = m_conversationStatesByConversationId.find(trimmedConversationId);
-  if (it == m_conversationStatesByConversationId.end()) {
-    return;
+  ConversationStateStore::instance()->markRead(trimmedConversationId);
+  if (const conversationlist::ConversationItem *conversation =
+          conversationFor(trimmedConversationId)) {
+    refreshConversationRows(*conversation);
   }
+}
 
-  it->unreadCount = 0;
-  if (QListWidgetItem *item =
-          findConversationItemByConversationId(trimmedConversationId)) {
-    applyConversationStateToItem(item, it.value(), nullptr);
+QString Widget::buildSessionItemTitle(int conversationType,
+                                      const QString &displayName,
+                                      const QString &numericId, bool isOnline,
+                                      int userStatus) const {
+  if (conversationType == 2) {
+    return displayName;
   }
+  return QStringLiteral("%1 (%2) [%3|%4]")
+      .arg(displayName, numericId.isEmpty() ? QStringLiteral("-") : numericId,
+           friendOnlineText(isOnline), friendStatusText(userStatus));
 }
 
-QString Widget::buildSessionItemText(int conversationType,
-                                     const QString &displayName,
-                                     const QString &groupNumericId,
-                                     const QString &numericId, bool isOnline,
-                                     int userStatus, const QString &preview,
-                                     int memberCount,
-                                     bool preferGroupMeta,
-                                     int unreadCount) const {
-  QString firstLine;
-  QString previewText;
+QString Widget::buildSessionItemPreview(int conversationType,
+                                        const QString &groupNumericId,
+                                        const QString &preview,
+                                        int memberCount,
+                                        bool preferGroupMeta) const {
   if (conversationType == 2) {
-    firstLine = displayName;
     QStringList groupMeta;
     if (!groupNumericId.trimmed().isEmpty()) {
       groupMeta.push_back(QStringLiteral("群号: %1").arg(groupNumericId));
@@ -1557,22 +1627,12 @@ QString Widget::buildSessionItemText(int conversationType,
         groupMeta.isEmpty() ? QStringLiteral("群聊")
                             : groupMeta.join(QStringLiteral("  "));
     if (preferGroupMeta || preview.trimmed().isEmpty()) {
-      previewText = groupMetaText;
-    } else {
-      previewText = elidePreview(preview);
+      return groupMetaText;
     }
-  } else {
-    firstLine = QStringLiteral("%1 (%2) [%3|%4]")
-                    .arg(displayName,
-                         numericId.isEmpty() ? QStringLiteral("-") : numericId,
-                         friendOnlineText(isOnline), friendStatusText(userStatus));
-    previewText = preview.trimmed().isEmpty() ? QStringLiteral("暂无消息")
-                                              : elidePreview(preview);
-  }
-  if (unreadCount > 0) {
-    firstLine += QStringLiteral("  未读:%1").arg(unreadCount);
+    return elidePreview(preview);
   }
-  return firstLine + QLatin1Char('\n') + previewText;
+  return preview.trimmed().isEmpty() ? QStringLiteral("暂无消息")
+                                     : elidePreview(preview);
 }
 
 QString Widget::elidePreview(const QString &preview) const {
@@ -2,15 +2,16 @@
 #define WIDGET_H
 
 #include "conversationlistmanager.h"
+#include "conversationlistmodel.h"
 #include "friendlistmanager.h"
+#include "friendlistmodel.h"
+#include "messagesequencer.h"
+#include "presenceupdatebuffer.h"
 #include "profileapiclient.h"
 #include "session.h"
 
-#include <QNetworkAccessManager>
-#include <QNetworkDiskCache>
-#include <QNetworkReply>
 #include <QHash>
-#include <QListWidget>
+#include <QListView>
 #include <QPointer>
 #include <QJsonObject>
 #include <QPoint>
@@ -54,6 +55,8 @@ public:
     void setCurrentUserId(const QString& userId);
     void setCurrentUserNumericId(const QString& numericId);
     void setProfileApiClient(ProfileApiClient* profileApiClient);
+    // 清空当前用户的会话状态并关闭窗口，随后发出 logoutRequested
+    void endSession();
 
 signals:
     void logoutRequested();
@@ -64,30 +67,7 @@ protected:
     void mouseReleaseEvent(QMouseEvent *event) override;
 
 private:
-    struct ConversationListState {
-        QString conversationId;
-        QString conversationUuid;
-        QString groupNumericId;
-        int conversationType = 0;
-        QString displayName;
-        QString avatarUrl;
-        int memberCount = 0;
-        QString peerUserId;
-        QString peerNumericId;
-        QString peerUsername;
-        QString peerNickname;
-        QString peerAvatarUrl;
-        QString peerBio;
-        int peerStatus = 0;
-        bool peerIsOnline = false;
-        QString peerLastSeenAt;
-        QString lastMessagePreview;
-        int unreadCount = 0;
-        bool placeholder = false;
-    };
-
     void initUI();
-    void initAvatarHttpClient();
     void addSessionItem(const Session &session);
     void requestConversationList(bool force = false);
     void requestFriendListForContacts(bool force = false);
@@ -96,39 +76,48 @@ private:
     void refreshContactListUi();
     void updateConversationListItem(
         const conversationlist::ConversationItem &conversationItem);
-    void handleIncomingRealtimePayload(const QString &payload,
-                                       const QString &sourceTag);
+    // The listed conversation, or one so far known only from message pushes.
+    const conversationlist::ConversationItem *conversationFor(
+        const QString &conversationId) const;
+    void reconcileConversationState(
+        const conversationlist::ConversationItem &conversationItem);
+    void applyConversationListDiff(const conversationlist::ConversationListDiff &diff);
+    void removeConversationListItems(const QString &conversationId);
     void handleMessageEnvelope(const protocol::Envelope &envelope);
+    void handleMessageSendAck(const protocol::Envelope &envelope);
+    void trackConversationSequence(const QString &conversationId);
+    void deliverIncomingMessages(const QString &conversationId,
+                                 const QVector<StoredMessage> &messages);
+    void requestMessageHistory(const QString &conversationId, qint64 afterSeq,
+                               qint64 beforeSeq);
+    void sendHistoryPage(const QString &conversationId, qint64 afterSeq);
+    void dropHistoryFetch(const QString &conversationId);
     void handlePresenceEnvelope(const QJsonObject &data);
+    void applyPresenceUpdates(const QVector<PresenceUpdate> &updates);
     QUrl resolveAvatarUrl(const QString &avatarUrl) const;
     void requestAvatarImage(const QString &avatarUrl);
+    int avatarSide() const;
     void applyAvatarPixmap(const QPixmap &pixmap);
     void applyDefaultAvatar();
     void syncFriendListToDeleteDialog();
     QIcon conversationIcon(int conversationType) const;
-    QListWidget *listWidgetForConversationType(int conversationType) const;
-    QListWidgetItem *findConversationItemInList(QListWidget *listWidget,
-                                                const QString &conversationId) const;
-    QListWidgetItem *upsertConversationListItemToList(
-        QListWidget *targetList, const ConversationListState &state,
-        const conversationlist::ConversationItem *conversationItem);
-    QListWidgetItem *findConversationItemByConversationId(const QString &conversationId) const;
-    QListWidgetItem *upsertConversationListItem(const ConversationListState &state,
-                                                const conversationlist::ConversationItem *conversationItem);
-    void applyConversationStateToItem(QListWidgetItem *item,
-                                      const ConversationListState &state,
-                                      const conversationlist::ConversationItem *conversationItem);
+    QModelIndex findConversationIndex(const QString &conversationId) const;
+    void upsertConversationRows(const conversationlist::ConversationItem &conversation);
+    bool refreshConversationRows(const conversationlist::ConversationItem &conversation);
+    ConversationListRow buildConversationRow(
+        const conversationlist::ConversationItem &conversation,
+        const ConversationListRow *previousRow, bool preferGroupMeta);
     void resetConversationUnread(const QString &conversationId);
-    QString buildSessionItemText(int conversationType,
-                                 const QString &displayName,
-                                 const QString &groupNumericId,
-                                 const QString &numericId,
-                                 bool isOnline,
-                                 int userStatus,
-                                 const QString &preview,
-                                 int memberCount,
-                                 bool preferGroupMeta,
-                                 int unreadCount) const;
+    QString buildSessionItemTitle(int conversationType,
+                                  const QString &displayName,
+                                  const QString &numericId,
+                                  bool isOnline,
+                                  int userStatus) const;
+    QString buildSessionItemPreview(int conversationType,
+                                    const QString &groupNumericId,
+                                    const QString &preview,
+                                    int memberCount,
+                                    bool preferGroupMeta) const;
     QString elidePreview(const QString &preview) const;
 
     Ui::Widget *ui;
@@ -138,13 +127,12 @@ private:
     QLabel* m_avatarLabel;
     QLabel* m_nameLabel;
     QLabel* m_signatureLabel;
-    QNetworkAccessManager* m_avatarNetworkManager = nullptr;
-    QNetworkDiskCache* m_avatarDiskCache = nullptr;
     QString m_currentUserId;
     QString m_currentUserNumericId;
     QString m_currentDisplayName;
     QString m_currentSignature;
     QString m_currentAvatarUrl;
+    QUrl m_currentAvatarRequestUrl;
     ProfileApiClient* m_profileApiClient = nullptr;
     QPointer<SettingsWindow> m_settingsWindow;
     QPointer<AddFriendDialog> m_addFriendDialog;
@@ -157,28 +145,42 @@ private:
     QString m_pendingFriendListRequestId;
     QString m_pendingOpenConversationId;
     QTimer* m_conversationListRefreshTimer = nullptr;
+    PresenceUpdateBuffer* m_presenceUpdateBuffer = nullptr;
+    MessageSequencer* m_messageSequencer = nullptr;
     QTabWidget* m_tabWidget = nullptr;
-    QListWidget* m_sessionList = nullptr;
-    QListWidget* m_groupList = nullptr;
-    QListWidget* m_contactList = nullptr;
+    QListView* m_sessionList = nullptr;
+    QListView* m_groupList = nullptr;
+    QListView* m_contactList = nullptr;
+    ConversationListModel* m_sessionModel = nullptr;
+    ConversationListModel* m_groupModel = nullptr;
+    FriendListModel* m_contactModel = nullptr;
     QHash<QString, Session> m_sessionsById;
     QHash<QString, QPointer<SessionWindow>> m_sessionWindowsByUserId;
     QHash<QString, QPointer<SessionWindow>> m_sessionWindowsByNumericId;
     QHash<QString, QPointer<SessionWindow>> m_sessionWindowsByConversationId;
-    QHash<QString, ConversationListState> m_conversationStatesByConversationId;
+    // Conversations with messages that LIST_CONVERSATIONS does not know yet.
+    // Listed conversations are only ever read from m_conversationListManager.
+    QHash<QString, conversationlist::ConversationRecord> m_pendingConversations;
+    // A MESSAGE/HISTORY range being fetched for the sequencer, one page at a
+    // time; requestId is the page whose response route is registered.
+    struct HistoryFetch {
+        QString requestId;
+        qint64 beforeSeq = 0;
+        QVector<StoredMessage> messages;
+    };
+    QHash<QString, HistoryFetch> m_historyFetches;
     
     // Dragging support
     bool m_isDragging;
     QPoint m_dragPosition;
 
 private slots:
-    void onSessionDoubleClicked(QListWidgetItem *item);
+    void onSessionDoubleClicked(const QModelIndex &index);
     void onOpenSettings();
     void onOpenAddFriend();
     void onOpenDeleteFriend();
     void onOpenCreateGroup();
     void onOpenSearchGroup();
-    void onAvatarReplyFinished(QNetworkReply *reply);
     void onConversationListPayloadReceived(const QString &requestId,
                                            const QJsonObject &data);
     void onConversationListFailed(const QString &requestId, int code,
@@ -1,5 +1,6 @@
 #include "registerwindow.h"
 
+#include "envelopedispatcher.h"
 #include "protocol.h"
 #include "ui_registerwindow.h"
 #include "websocketclient.h"
@@ -74,7 +75,8 @@ bool isCurrentRegisterResponse(const protocol::Envelope &envelope,
   }
 
   return originalRequest.requestId == pendingRequestId &&
-         originalRequest.type == "AUTH" && originalRequest.action == "REGISTER";
+         originalRequest.typeId == protocol::EnvelopeType::Auth &&
+         originalRequest.actionId == protocol::EnvelopeAction::Register;
 }
 
 QString extractResponseMessage(const protocol::Envelope &envelope) {
@@ -139,8 +141,9 @@ RegisterWindow::RegisterWindow(QWidget *parent)
   auto ws = websocketclient::instance();
   connect(ws, &websocketclient::connected, this,
           &RegisterWindow::onWebSocketConnected);
-  connect(ws, &websocketclient::textMessageReceived, this,
-          &RegisterWindow::onWebSocketTextMessage);
+  connect(EnvelopeDispatcher::instance(),
+          &EnvelopeDispatcher::envelopeParseFailed, this,
+          &RegisterWindow::onEnvelopeParseFailed);
   connect(ws, &websocketclient::disconnected, this,
           &RegisterWindow::onWebSocketDisconnected);
   connect(ws, &websocketclient::errorOccurred, this,
@@ -174,6 +177,7 @@ void RegisterWindow::setRegisterLoading(bool loading, const QString &text) {
 }
 
 void RegisterWindow::resetPendingState() {
+  EnvelopeDispatcher::instance()->cancelResponse(m_pendingRegisterRequestId);
   m_isRegisterPending = false;
   m_pendingRegisterRequestId.clear();
   m_requestTimer.stop();
@@ -193,6 +197,9 @@ void RegisterWindow::sendRegisterRequest() {
   const QString payload = auth::createRegisterRequestPayload(
       m_pendingInput, QString(), &requestId);
   m_pendingRegisterRequestId = requestId;
+  EnvelopeDispatcher::instance()->expectResponse(
+      requestId, this,
+      [this](const protocol::Envelope &envelope) { onRegisterResponse(envelope); });
   websocketclient::instance()->sendTextMessage(payload);
   setRegisterLoading(true, "注册中...");
   m_requestTimer.start();
@@ -275,26 +282,26 @@ void RegisterWindow::onWebSocketConnected() {
   sendRegisterRequest();
 }
 
-void RegisterWindow::onWebSocketTextMessage(const QString &message) {
+void RegisterWindow::onEnvelopeParseFailed(const QString &error) {
   if (!m_isRegisterPending || m_pendingRegisterRequestId.isEmpty()) {
     return;
   }
+  resetPendingState();
+  QMessageBox::warning(this, "注册失败",
+                       QStringLiteral("响应解析失败: %1")
+                           .arg(error.isEmpty() ? QStringLiteral("未知协议错误")
+                                                : error));
+}
 
-  protocol::Envelope envelope;
-  QString parseError;
-  if (!protocol::parseEnvelope(message, &envelope, &parseError)) {
-    resetPendingState();
-    QMessageBox::warning(this, "注册失败",
-                         QStringLiteral("响应解析失败: %1")
-                             .arg(parseError.isEmpty()
-                                      ? QStringLiteral("未知协议错误")
-                                      : parseError));
+void RegisterWindow::onRegisterResponse(const protocol::Envelope &envelope) {
+  if (!m_isRegisterPending || m_pendingRegisterRequestId.isEmpty()) {
     return;
   }
   if (!isCurrentRegisterResponse(envelope, m_pendingRegisterRequestId)) {
     return;
   }
-  if (envelope.type != "AUTH" || envelope.action != "REGISTER") {
+  if (envelope.typeId != protocol::EnvelopeType::Auth ||
+      envelope.actionId != protocol::EnvelopeAction::Register) {
     const QString msg = extractResponseMessage(envelope);
     resetPendingState();
     QMessageBox::warning(
@@ -9,6 +9,7 @@
 #include <QTimer>
 #include <QWidget>
 
+#include "protocol.h"
 #include "registerutils.h"
 
 QT_BEGIN_NAMESPACE
@@ -32,7 +33,7 @@ private slots:
   void onBackClicked();
   void onCloseClicked();
   void onWebSocketConnected();
-  void onWebSocketTextMessage(const QString &message);
+  void onEnvelopeParseFailed(const QString &error);
   void onWebSocketDisconnected();
   void onWebSocketError(QAbstractSocket::SocketError error,
                         const QString &message);
@@ -51,6 +52,7 @@ private:
   void resetPendingState();
   void applyNormalizedInput(const auth::RegisterInput &normalized);
   void sendRegisterRequest();
+  void onRegisterResponse(const protocol::Envelope &envelope);
 
   Ui::RegisterWindow *ui;
   QPoint m_dragPosition;
@@ -0,0 +1,145 @@
+#include "chatmessagedelegate.h"
+#include "chatmessagemodel.h"
+
+#include <QAbstractItemView>
+#include <QPainter>
+#include <QTextLayout>
+#include <QtMath>
+
+namespace {
+constexpr int kRowSpacing = 8;
+constexpr int kRightMargin = 10;
+constexpr int kPaddingX = 12;
+constexpr int kPaddingY = 8;
+
+struct BubbleStyle {
+  QColor background;
+  QColor text;
+  qreal radius;
+};
+
+BubbleStyle styleFor(ChatMessageModel::BubbleKind kind) {
+  switch (kind) {
+  case ChatMessageModel::BubbleKind::Status:
+    return {QColor(0xf1, 0xf3, 0xf5), QColor(0x4f, 0x5b, 0x66), 10};
+  case ChatMessageModel::BubbleKind::Outgoing:
+    return {QColor(0xe2, 0xf0, 0xff), QColor(0x1f, 0x35, 0x52), 12};
+  case ChatMessageModel::BubbleKind::Incoming:
+    break;
+  }
+  return {QColor(0xf7, 0xf7, 0xf8), QColor(0x2f, 0x2f, 0x2f), 12};
+}
+} // namespace
+
+struct ChatMessageDelegate::BubbleLayout {
+  QTextLayout layout;
+  QSize textSize;
+};
+
+ChatMessageDelegate::ChatMessageDelegate(QObject *parent)
+    : QStyledItemDelegate(parent), m_layouts(kLayoutCacheSize) {}
+
+ChatMessageDelegate::~ChatMessageDelegate() = default;
+
+void ChatMessageDelegate::paint(QPainter *painter,
+                                const QStyleOptionViewItem &option,
+                                const QModelIndex &index) const {
+  const QString text = index.data(Qt::DisplayRole).toString();
+  const auto kind = static_cast<ChatMessageModel::BubbleKind>(
+      index.data(ChatMessageModel::BubbleKindRole).toInt());
+  const int maxTextWidth =
+      qMin(kMaxBubbleWidth, option.rect.width() - kRightMargin) - 2 * kPaddingX;
+  const BubbleLayout *bubble = layoutFor(text, option.font, maxTextWidth);
+  if (!bubble) {
+    return;
+  }
+
+  const QSize bubbleSize(bubble->textSize.width() + 2 * kPaddingX,
+                         bubble->textSize.height() + 2 * kPaddingY);
+  const int top = option.rect.top() + kRowSpacing / 2;
+  const int left = kind == ChatMessageModel::BubbleKind::Outgoing
+                       ? option.rect.right() - kRightMargin - bubbleSize.width() + 1
+                       : option.rect.left();
+  const QRect bubbleRect(QPoint(left, top), bubbleSize);
+  const BubbleStyle style = styleFor(kind);
+
+  painter->save();
+  painter->setRenderHint(QPainter::Antialiasing, true);
+  painter->setPen(Qt::NoPen);
+  painter->setBrush((option.state & QStyle::State_Selected)
+                        ? style.background.darker(110)
+                        : style.background);
+  painter->drawRoundedRect(bubbleRect, style.radius, style.radius);
+  painter->setPen(style.text);
+  bubble->layout.draw(painter, QPointF(bubbleRect.left() + kPaddingX,
+                                       bubbleRect.top() + kPaddingY));
+  painter->restore();
+}
+
+QSize ChatMessageDelegate::sizeHint(const QStyleOptionViewItem &option,
+                                    const QModelIndex &index) const {
+  const int width = availableWidth(option);
+  const int maxTextWidth =
+      qMin(kMaxBubbleWidth, width - kRightMargin) - 2 * kPaddingX;
+  const BubbleLayout *bubble =
+      layoutFor(index.data(Qt::DisplayRole).toString(), option.font, maxTextWidth);
+  const int textHeight = bubble ? bubble->textSize.height() : 0;
+  return QSize(width, textHeight + 2 * kPaddingY + kRowSpacing);
+}
+
+int ChatMessageDelegate::cachedLayoutCount() const {
+  return static_cast<int>(m_layouts.count());
+}
+
+void ChatMessageDelegate::clearLayoutCache() { m_layouts.clear(); }
+
+const ChatMessageDelegate::BubbleLayout *
+ChatMessageDelegate::layoutFor(const QString &text, const QFont &font,
+                               int maxTextWidth) const {
+  maxTextWidth = qMax(1, maxTextWidth);
+  if (font != m_layoutFont) {
+    m_layouts.clear();
+    m_layoutFont = font;
+  }
+
+  const LayoutKey key{text, maxTextWidth};
+  if (const BubbleLayout *cached = m_layouts.object(key)) {
+    return cached;
+  }
+
+  auto *bubble = new BubbleLayout;
+  bubble->layout.setText(text);
+  bubble->layout.setFont(font);
+  QTextOption textOption;
+  textOption.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+  bubble->layout.setTextOption(textOption);
+  bubble->layout.setCacheEnabled(true);
+
+  qreal height = 0;
+  qreal widest = 0;
+  bubble->layout.beginLayout();
+  for (;;) {
+    QTextLine line = bubble->layout.createLine();
+    if (!line.isValid()) {
+      break;
+    }
+    line.setLineWidth(maxTextWidth);
+    line.setPosition(QPointF(0, height));
+    height += line.height();
+    widest = qMax(widest, line.naturalTextWidth());
+  }
+  bubble->layout.endLayout();
+  bubble->textSize = QSize(qCeil(widest), qCeil(height));
+
+  m_layouts.insert(key, bubble);
+  return bubble;
+}
+
+int ChatMessageDelegate::availableWidth(const QStyleOptionViewItem &option) {
+  // QListView asks for size hints without a rect; wrap to its viewport.
+  if (option.rect.width() > 0) {
+    return option.rect.width();
+  }
+  const auto *view = qobject_cast<const QAbstractItemView *>(option.widget);
+  return view ? view->viewport()->width() : kMaxBubbleWidth + kRightMargin;
+}
@@ -0,0 +1,57 @@
+#ifndef CHATMESSAGEDELEGATE_H
+#define CHATMESSAGEDELEGATE_H
+
+#include <QCache>
+#include <QFont>
+#include <QHash>
+#include <QString>
+#include <QStyledItemDelegate>
+
+class QTextLayout;
+
+// Paints chat bubbles for ChatMessageModel rows. Wrapped text layouts are
+// cached per (text, width), so scrolling and repeated size hints reuse them
+// and a resize only lays out rows the view actually asks for again.
+class ChatMessageDelegate : public QStyledItemDelegate {
+  Q_OBJECT
+
+public:
+  static constexpr int kMaxBubbleWidth = 420;
+
+  explicit ChatMessageDelegate(QObject *parent = nullptr);
+  ~ChatMessageDelegate() override;
+
+  void paint(QPainter *painter, const QStyleOptionViewItem &option,
+             const QModelIndex &index) const override;
+  QSize sizeHint(const QStyleOptionViewItem &option,
+                 const QModelIndex &index) const override;
+
+  int cachedLayoutCount() const;
+  void clearLayoutCache();
+
+private:
+  struct LayoutKey {
+    QString text;
+    int width = 0;
+    bool operator==(const LayoutKey &other) const {
+      return width == other.width && text == other.text;
+    }
+  };
+  friend size_t qHash(const LayoutKey &key, size_t seed) {
+    return qHash(key.text, seed) ^ static_cast<size_t>(key.width);
+  }
+
+  struct BubbleLayout;
+
+  // Layout of text wrapped to at most maxTextWidth, from the cache if present.
+  const BubbleLayout *layoutFor(const QString &text, const QFont &font,
+                                int maxTextWidth) const;
+  static int availableWidth(const QStyleOptionViewItem &option);
+
+  static constexpr int kLayoutCacheSize = 2000;
+
+  mutable QCache<LayoutKey, BubbleLayout> m_layouts;
+  mutable QFont m_layoutFont;
+};
+
+#endif // CHATMESSAGEDELEGATE_H
@@ -0,0 +1,194 @@
+#include "chatmessagemodel.h"
+
+#include <QDateTime>
+
+namespace {
+QString formatMessageTime(const QString &utcIsoTime) {
+  const QString trimmed = utcIsoTime.trimmed();
+  if (trimmed.isEmpty()) {
+    return QDateTime::currentDateTime().toString(QStringLiteral("HH:mm:ss"));
+  }
+
+  const QDateTime parsed = QDateTime::fromString(trimmed, Qt::ISODate);
+  if (!parsed.isValid()) {
+    return QDateTime::currentDateTime().toString(QStringLiteral("HH:mm:ss"));
+  }
+  return parsed.toLocalTime().toString(QStringLiteral("HH:mm:ss"));
+}
+
+QString messageStatusText(ChatMessageStatus status) {
+  switch (status) {
+  case ChatMessageStatus::Pending:
+    return QStringLiteral("发送中");
+  case ChatMessageStatus::Sent:
+    return QStringLiteral("已发送");
+  case ChatMessageStatus::Failed:
+    return QStringLiteral("发送失败");
+  case ChatMessageStatus::Received:
+    return QStringLiteral("已接收");
+  }
+  return QStringLiteral("未知状态");
+}
+} // namespace
+
+ChatMessageModel::ChatMessageModel(QObject *parent)
+    : QAbstractListModel(parent) {}
+
+int ChatMessageModel::rowCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : m_rows.size();
+}
+
+QVariant ChatMessageModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid() || index.row() < 0 || index.row() >= m_rows.size()) {
+    return QVariant();
+  }
+
+  const Row &row = m_rows.at(index.row());
+  const ChatMessage &message = row.message;
+  switch (role) {
+  case Qt::DisplayRole:
+    return row.displayText;
+  case BubbleKindRole:
+    if (row.isStatusLine) {
+      return static_cast<int>(BubbleKind::Status);
+    }
+    return static_cast<int>(message.status == ChatMessageStatus::Received
+                                ? BubbleKind::Incoming
+                                : BubbleKind::Outgoing);
+  case LocalIdRole:
+    return message.localId;
+  case RequestIdRole:
+    return message.requestId;
+  case MessageIdRole:
+    return message.messageId;
+  case SeqRole:
+    return message.seq;
+  default:
+    return QVariant();
+  }
+}
+
+Qt::ItemFlags ChatMessageModel::flags(const QModelIndex &index) const {
+  if (!index.isValid()) {
+    return Qt::NoItemFlags;
+  }
+  return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemNeverHasChildren;
+}
+
+int ChatMessageModel::appendMessage(const ChatMessage &message) {
+  const int row = m_rows.size();
+  beginInsertRows(QModelIndex(), row, row);
+  m_rows.push_back(messageRow(message));
+  if (!message.localId.isEmpty()) {
+    m_rowByLocalId.insert(message.localId, row);
+  }
+  endInsertRows();
+  return row;
+}
+
+int ChatMessageModel::appendStatusLine(const QString &text) {
+  ChatMessage line;
+  line.content = text;
+  const int row = m_rows.size();
+  beginInsertRows(QModelIndex(), row, row);
+  m_rows.push_back(Row{line, true, text});
+  endInsertRows();
+  return row;
+}
+
+void ChatMessageModel::prependMessages(const QVector<ChatMessage> &messages) {
+  if (messages.isEmpty()) {
+    return;
+  }
+  QVector<Row> rows;
+  rows.reserve(messages.size() + m_rows.size());
+  for (const ChatMessage &message : messages) {
+    rows.push_back(messageRow(message));
+  }
+  beginInsertRows(QModelIndex(), 0, messages.size() - 1);
+  rows += m_rows;
+  m_rows.swap(rows);
+  rebuildLocalIdIndex();
+  endInsertRows();
+}
+
+bool ChatMessageModel::updateMessage(int row, const ChatMessage &message) {
+  if (row < 0 || row >= m_rows.size() || m_rows.at(row).isStatusLine) {
+    return false;
+  }
+  const QString previousLocalId = m_rows.at(row).message.localId;
+  if (previousLocalId != message.localId) {
+    m_rowByLocalId.remove(previousLocalId);
+    if (!message.localId.isEmpty()) {
+      m_rowByLocalId.insert(message.localId, row);
+    }
+  }
+  ChatMessage next = message;
+  if (next.sentAt.trimmed().isEmpty()) {
+    // An ack without a time keeps the one the bubble already shows.
+    next.sentAt = m_rows.at(row).message.sentAt;
+  }
+  m_rows[row] = messageRow(next);
+  const QModelIndex changed = index(row);
+  emit dataChanged(changed, changed);
+  return true;
+}
+
+void ChatMessageModel::clear() {
+  beginResetModel();
+  m_rows.clear();
+  m_rowByLocalId.clear();
+  endResetModel();
+}
+
+const ChatMessage *ChatMessageModel::messageAt(int row) const {
+  if (row < 0 || row >= m_rows.size() || m_rows.at(row).isStatusLine) {
+    return nullptr;
+  }
+  return &m_rows.at(row).message;
+}
+
+int ChatMessageModel::rowForLocalId(const QString &localId) const {
+  return m_rowByLocalId.value(localId, -1);
+}
+
+ChatMessageModel::Row ChatMessageModel::messageRow(const ChatMessage &message) {
+  Row entry{message, false, QString()};
+  if (entry.message.sentAt.trimmed().isEmpty()) {
+    // Pin the time once; the bubble text must not change on every repaint.
+    entry.message.sentAt =
+        QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+  }
+  // An unparsable sentAt falls back to the current time, also only here.
+  entry.displayText = bubbleText(entry.message);
+  return entry;
+}
+
+void ChatMessageModel::rebuildLocalIdIndex() {
+  m_rowByLocalId.clear();
+  m_rowByLocalId.reserve(m_rows.size());
+  for (int row = 0; row < m_rows.size(); ++row) {
+    const QString &localId = m_rows.at(row).message.localId;
+    if (!localId.isEmpty()) {
+      m_rowByLocalId.insert(localId, row);
+    }
+  }
+}
+
+QString ChatMessageModel::bubbleText(const ChatMessage &message) {
+  const QString timeText = formatMessageTime(message.sentAt);
+  if (message.status == ChatMessageStatus::Received) {
+    const QString sender =
+        message.senderUsername.trimmed().isEmpty() ? QStringLiteral("对方")
+                                                   : message.senderUsername.trimmed();
+    return QStringLiteral("%1 %2: %3").arg(timeText, sender, message.content);
+  }
+
+  QString text = QStringLiteral("%1 我: %2 [%3]")
+                     .arg(timeText, message.content,
+                          messageStatusText(message.status));
+  if (message.status == ChatMessageStatus::Sent && message.seq > 0) {
+    text += QStringLiteral(" (#%1)").arg(message.seq);
+  }
+  return text;
+}
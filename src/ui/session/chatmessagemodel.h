@@ -0,0 +1,81 @@
+#ifndef CHATMESSAGEMODEL_H
+#define CHATMESSAGEMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+enum class ChatMessageStatus { Pending, Sent, Failed, Received };
+
+struct ChatMessage {
+  QString localId;
+  QString requestId;
+  QString conversationId;
+  QString messageId;
+  qint64 seq = 0;
+  QString content;
+  QString sentAt;
+  QString senderUserId;
+  QString senderUsername;
+  ChatMessageStatus status = ChatMessageStatus::Received;
+};
+
+// Transcript of one session window: chat messages plus local status lines
+// ("连接已断开..."), in display order. Rows hold plain data only; bubbles are
+// painted by ChatMessageDelegate, so a long history costs no widgets.
+class ChatMessageModel : public QAbstractListModel {
+  Q_OBJECT
+
+public:
+  enum class BubbleKind { Incoming, Outgoing, Status };
+
+  enum Role {
+    BubbleKindRole = Qt::UserRole,
+    LocalIdRole,
+    RequestIdRole,
+    MessageIdRole,
+    SeqRole,
+  };
+
+  explicit ChatMessageModel(QObject *parent = nullptr);
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+  Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+  // Both return the new row.
+  int appendMessage(const ChatMessage &message);
+  int appendStatusLine(const QString &text);
+  // Inserts an older page (oldest first) above the current rows.
+  void prependMessages(const QVector<ChatMessage> &messages);
+  // Replaces the message in row and emits dataChanged for that row only.
+  bool updateMessage(int row, const ChatMessage &message);
+  void clear();
+
+  // Null for status lines and rows out of range.
+  const ChatMessage *messageAt(int row) const;
+  int rowForLocalId(const QString &localId) const;
+
+  // Text shown in the bubble of message, e.g. "12:00:01 我: hi [已发送]".
+  static QString bubbleText(const ChatMessage &message);
+
+private:
+  struct Row {
+    ChatMessage message;
+    bool isStatusLine = false;
+    // What data(Qt::DisplayRole) returns; built once per append, prepend or
+    // update, so painting never re-parses sentAt.
+    QString displayText;
+  };
+
+  // Pins a missing sentAt to now and formats the bubble text once.
+  static Row messageRow(const ChatMessage &message);
+  // Re-points the hash at every row after rows moved.
+  void rebuildLocalIdIndex();
+
+  QVector<Row> m_rows;
+  QHash<QString, int> m_rowByLocalId;
+};
+
+#endif // CHATMESSAGEMODEL_H
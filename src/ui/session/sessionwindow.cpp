@@ -1,16 +1,27 @@
 #include "sessionwindow.h"
+#include "envelopedispatcher.h"
+#include "messageoutbox.h"
+#include "messagestore.h"
 #include "protocol.h"
 #include <QAbstractSocket>
+#include <QAction>
+#include <QClipboard>
 #include <QDateTime>
 #include <QDebug>
+#include <QGuiApplication>
 #include <QHBoxLayout>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QScrollBar>
 #include <QTimer>
 #include <QUuid>
+#include <QVBoxLayout>
+
+#include <algorithm>
 
 namespace {
+constexpr int kHistoryPageSize = 50;
+
 QString presenceText(bool isOnline, const QString &lastSeenAtUtc) {
   if (isOnline) {
     return QStringLiteral("在线");
@@ -47,33 +58,6 @@ qint64 jsonIntegerValue(const QJsonObject &obj, const char *key,
   return defaultValue;
 }
 
-QString formatMessageTime(const QString &utcIsoTime) {
-  const QString trimmed = utcIsoTime.trimmed();
-  if (trimmed.isEmpty()) {
-    return QDateTime::currentDateTime().toString(QStringLiteral("HH:mm:ss"));
-  }
-
-  const QDateTime parsed = QDateTime::fromString(trimmed, Qt::ISODate);
-  if (!parsed.isValid()) {
-    return QDateTime::currentDateTime().toString(QStringLiteral("HH:mm:ss"));
-  }
-  return parsed.toLocalTime().toString(QStringLiteral("HH:mm:ss"));
-}
-
-QString messageStatusText(SessionWindow::MessageStatus status) {
-  switch (status) {
-  case SessionWindow::MessageStatus::Pending:
-    return QStringLiteral("发送中");
-  case SessionWindow::MessageStatus::Sent:
-    return QStringLiteral("已发送");
-  case SessionWindow::MessageStatus::Failed:
-    return QStringLiteral("发送失败");
-  case SessionWindow::MessageStatus::Received:
-    return QStringLiteral("已接收");
-  }
-  return QStringLiteral("未知状态");
-}
-
 QString messageErrorText(int code, const QString &fallback) {
   switch (code) {
   case 2001:
@@ -98,17 +82,41 @@ QString messageErrorText(int code, const QString &fallback) {
   }
   return QStringLiteral("发送失败：未知错误(%1)").arg(code);
 }
+
+QVector<ChatMessage> chatMessagesFromStore(const QVector<StoredMessage> &page) {
+  const QString selfUserId = UserSession::instance().userId().trimmed();
+  QVector<ChatMessage> messages;
+  messages.reserve(page.size());
+  for (const StoredMessage &stored : page) {
+    ChatMessage message;
+    message.localId = stored.messageId;
+    message.conversationId = stored.conversationId;
+    message.messageId = stored.messageId;
+    message.seq = stored.seq;
+    message.content = stored.content;
+    message.sentAt = stored.sentAt;
+    message.senderUserId = stored.senderUserId;
+    message.senderUsername = stored.senderUsername;
+    message.status = !selfUserId.isEmpty() && stored.senderUserId == selfUserId
+                         ? ChatMessageStatus::Sent
+                         : ChatMessageStatus::Received;
+    messages.push_back(message);
+  }
+  return messages;
+}
 } // namespace
 
 SessionWindow::SessionWindow(const Session &session, QWidget *parent)
     : QWidget(parent), m_session(session), m_isDragging(false),
-      m_resizeDir(None), m_chatScroll(nullptr), m_chatContainer(nullptr),
-      m_chatLayout(nullptr), m_inputLine(nullptr), m_sendBtn(nullptr),
+      m_resizeDir(None), m_chatView(nullptr), m_messageModel(nullptr),
+      m_messageDelegate(nullptr), m_inputLine(nullptr), m_sendBtn(nullptr),
       m_presenceLabel(nullptr),
       m_websocket(websocketclient::instance()) {
   setAttribute(Qt::WA_DeleteOnClose);
   setMouseTracking(true); // Enable mouse tracking for resize cursor feedback
   initUI();
+  loadNewestHistory();
+  restoreOutboxMessages();
 }
 
 void SessionWindow::setPeerIdentity(const QString &userId,
@@ -220,20 +228,40 @@ void SessionWindow::initUI() {
   contentLayout->setContentsMargins(12, 12, 12, 12);
   contentLayout->setSpacing(12);
 
-  m_chatScroll = new QScrollArea(contentArea);
-  m_chatScroll->setWidgetResizable(true);
-  m_chatScroll->setFrameShape(QFrame::NoFrame);
-  m_chatScroll->setStyleSheet("QScrollArea { background-color: #ffffff; border: "
-                              "1px solid #dcdcdc; border-radius: 8px; }");
-
-  m_chatContainer = new QWidget(m_chatScroll);
-  m_chatLayout = new QVBoxLayout(m_chatContainer);
-  m_chatLayout->setContentsMargins(0, 10, 10, 10);
-  m_chatLayout->setSpacing(8);
-  m_chatLayout->setAlignment(Qt::AlignTop);
-
-  m_chatScroll->setWidget(m_chatContainer);
-  contentLayout->addWidget(m_chatScroll);
+  // Bubbles are painted by the delegate; no widget exists per message.
+  m_messageModel = new ChatMessageModel(this);
+  m_messageDelegate = new ChatMessageDelegate(this);
+  m_chatView = new QListView(contentArea);
+  m_chatView->setModel(m_messageModel);
+  m_chatView->setItemDelegate(m_messageDelegate);
+  m_chatView->setFrameShape(QFrame::NoFrame);
+  m_chatView->setStyleSheet("QListView { background-color: #ffffff; border: "
+                            "1px solid #dcdcdc; border-radius: 8px; "
+                            "padding: 10px 0px 10px 0px; }");
+  m_chatView->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+  m_chatView->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+  m_chatView->setResizeMode(QListView::Adjust);
+  // Batched layout spreads size hints for a long history over several event
+  // loop passes instead of blocking the first show.
+  m_chatView->setLayoutMode(QListView::Batched);
+  m_chatView->setBatchSize(200);
+  m_chatView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+  m_chatView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  m_chatView->setWordWrap(true);
+
+  QAction *copyAction = new QAction(m_chatView);
+  copyAction->setShortcut(QKeySequence::Copy);
+  copyAction->setShortcutContext(Qt::WidgetShortcut);
+  connect(copyAction, &QAction::triggered, this,
+          &SessionWindow::copySelectedMessages);
+  m_chatView->addAction(copyAction);
+  connect(m_chatView->verticalScrollBar(), &QScrollBar::valueChanged, this,
+          [this](int value) {
+            if (value == m_chatView->verticalScrollBar()->minimum()) {
+              loadOlderHistory();
+            }
+          });
+  contentLayout->addWidget(m_chatView);
 
   QHBoxLayout *inputLayout = new QHBoxLayout();
   inputLayout->setSpacing(8);
@@ -259,17 +287,6 @@ void SessionWindow::initUI() {
           &QPushButton::click);
   connect(m_sendBtn, &QPushButton::clicked, this,
           &SessionWindow::sendPendingMessage);
-  connect(m_websocket, &websocketclient::textMessageReceived, this,
-          [this](const QString &message) {
-            handleIncomingPayload(message, QStringLiteral("文本"));
-            qDebug() << "Received text payload: " << message << Qt::endl;
-          });
-  connect(m_websocket, &websocketclient::binaryMessageReceived, this,
-          [this](const QByteArray &data) {
-            const QString payload = QString::fromUtf8(data);
-            handleIncomingPayload(payload, QStringLiteral("二进制"));
-            qDebug() << "Received binary payload: " << data << Qt::endl;
-          });
   connect(m_websocket, &websocketclient::errorOccurred, this,
           [this](QAbstractSocket::SocketError, const QString &message) {
             appendStatusLine("连接错误: " + message);
@@ -282,7 +299,7 @@ void SessionWindow::initUI() {
 }
 
 void SessionWindow::sendPendingMessage() {
-  if (!m_inputLine || !m_chatLayout)
+  if (!m_inputLine || !m_messageModel)
     return;
 
   QString message = m_pendingMessage;
@@ -311,25 +328,104 @@ void SessionWindow::sendPendingMessage() {
   localMessage.senderUsername = UserSession::instance().username().trimmed();
   localMessage.status = MessageStatus::Pending;
   const int messageIndex = appendMessage(localMessage);
-  m_pendingMessageIndexesByRequestId.insert(localMessage.requestId, messageIndex);
+  m_pendingLocalIdsByRequestId.insert(localMessage.requestId, localMessage.localId);
 
-  QJsonObject data;
-  data.insert("conversation_id", conversationId);
-  data.insert("content", message);
-
-  const QString payload =
-      protocol::createRequest("MESSAGE", "SEND", data, localMessage.requestId);
   qInfo() << "[SessionWindow] MESSAGE SEND request_id=" << localMessage.requestId
           << "conversation_id=" << conversationId;
-  if (!m_websocket || !m_websocket->isConnected()) {
-    markPendingMessageFailed(messageIndex, QStringLiteral("连接未建立"));
-    appendStatusLine(QStringLiteral("发送失败：WebSocket 未连接"));
+  EnvelopeDispatcher::instance()->expectResponse(
+      localMessage.requestId, this, [this](const protocol::Envelope &envelope) {
+        handleMessageSendResponse(envelope);
+      });
+  // The outbox queues the frame while offline and keeps it across restarts.
+  OutboxEntry entry;
+  entry.requestId = localMessage.requestId;
+  entry.conversationId = conversationId;
+  entry.content = message;
+  entry.createdAt = localMessage.sentAt;
+  QString outboxError;
+  if (!MessageOutbox::instance()->submit(entry, &outboxError)) {
+    EnvelopeDispatcher::instance()->cancelResponse(localMessage.requestId);
+    m_pendingLocalIdsByRequestId.remove(localMessage.requestId);
+    markPendingMessageFailed(messageIndex, outboxError);
+    appendStatusLine(QStringLiteral("发送失败：发送队列已满"));
     return;
   }
-  m_websocket->sendTextMessage(payload);
+  if (!m_websocket || !m_websocket->isConnected()) {
+    appendStatusLine(QStringLiteral("连接已断开，消息将在重连后发送"));
+  }
   m_inputLine->clear();
   emit outgoingMessageSubmitted(conversationId, message);
 }
+
+void SessionWindow::restoreOutboxMessages() {
+  const QString conversationId = m_session.conversationId().trimmed();
+  if (conversationId.isEmpty()) {
+    return;
+  }
+
+  // Messages still waiting in the outbox (e.g. from before a restart) show up
+  // as pending until their ack arrives.
+  const QVector<OutboxEntry> entries =
+      MessageOutbox::instance()->entriesForConversation(conversationId);
+  for (const OutboxEntry &entry : entries) {
+    ChatMessage message;
+    message.localId = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    message.requestId = entry.requestId;
+    message.conversationId = conversationId;
+    message.content = entry.content;
+    message.sentAt = entry.createdAt;
+    message.senderUserId = UserSession::instance().userId().trimmed();
+    message.senderUsername = UserSession::instance().username().trimmed();
+    message.status = MessageStatus::Pending;
+    appendMessage(message);
+    m_pendingLocalIdsByRequestId.insert(entry.requestId, message.localId);
+    EnvelopeDispatcher::instance()->expectResponse(
+        entry.requestId, this, [this](const protocol::Envelope &envelope) {
+          handleMessageSendResponse(envelope);
+        });
+  }
+}
+
+void SessionWindow::loadNewestHistory() {
+  const QString conversationId = m_session.conversationId().trimmed();
+  if (conversationId.isEmpty()) {
+    m_historyExhausted = true;
+    return;
+  }
+
+  // The newest page comes from the local store, so the window has content
+  // before the first frame is painted.
+  const QVector<StoredMessage> page =
+      MessageStore::instance()->newestPage(conversationId, kHistoryPageSize);
+  m_historyExhausted = page.size() < kHistoryPageSize;
+  if (page.isEmpty()) {
+    return;
+  }
+  m_oldestLoadedSeq = page.constFirst().seq;
+  m_messageModel->prependMessages(chatMessagesFromStore(page));
+  scrollTranscriptToBottom();
+}
+
+void SessionWindow::loadOlderHistory() {
+  if (m_historyExhausted || m_oldestLoadedSeq <= 0) {
+    return;
+  }
+
+  const QVector<StoredMessage> page = MessageStore::instance()->pageBefore(
+      m_session.conversationId().trimmed(), m_oldestLoadedSeq, kHistoryPageSize);
+  m_historyExhausted = page.size() < kHistoryPageSize;
+  if (page.isEmpty()) {
+    return;
+  }
+  m_oldestLoadedSeq = page.constFirst().seq;
+  m_messageModel->prependMessages(chatMessagesFromStore(page));
+  // Keep the message that was at the top in place instead of jumping.
+  m_chatView->scrollTo(m_messageModel->index(page.size()),
+                       QAbstractItemView::PositionAtTop);
+  qInfo() << "[SessionWindow] loaded older history conversation_id="
+          << m_session.conversationId() << "count=" << page.size()
+          << "oldest_seq=" << m_oldestLoadedSeq;
+}
 
 void SessionWindow::onSendClicked() {
   if (!m_inputLine)
@@ -338,51 +434,37 @@ void SessionWindow::onSendClicked() {
 }
 
 void SessionWindow::appendStatusLine(const QString &message) {
+  if (!m_messageModel)
+    return;
   const QString line =
       QDateTime::currentDateTime().toString("HH:mm:ss ") + message;
-  appendChatBubble(line, false, true);
+  m_messageModel->appendStatusLine(line);
+  scrollTranscriptToBottom();
   qInfo() << "Session status:" << message;
 }
 
-QLabel *SessionWindow::appendChatBubble(const QString &message, bool outgoing,
-                                        bool status) {
-  if (!m_chatLayout || !m_chatContainer || !m_chatScroll)
-    return nullptr;
-
-  QWidget *row = new QWidget(m_chatContainer);
-  QHBoxLayout *rowLayout = new QHBoxLayout(row);
-  rowLayout->setContentsMargins(0, 0, 0, 0);
-
-  QLabel *bubble = new QLabel(message, row);
-  bubble->setWordWrap(true);
-  bubble->setTextInteractionFlags(Qt::TextSelectableByMouse);
-  bubble->setMaximumWidth(420);
-
-  if (status) {
-    bubble->setStyleSheet("QLabel { background: #f1f3f5; color: #4f5b66; "
-                          "border-radius: 10px; padding: 8px 12px; }");
-    rowLayout->addWidget(bubble);
-    rowLayout->addStretch();
-  } else if (outgoing) {
-    bubble->setStyleSheet("QLabel { background: #e2f0ff; color: #1f3552; "
-                          "border-radius: 12px; padding: 8px 12px; }");
-    rowLayout->addStretch();
-    rowLayout->addWidget(bubble);
-  } else {
-    bubble->setStyleSheet("QLabel { background: #f7f7f8; color: #2f2f2f; "
-                          "border-radius: 12px; padding: 8px 12px; }");
-    rowLayout->addWidget(bubble);
-    rowLayout->addStretch();
-  }
-
-  m_chatLayout->addWidget(row);
+void SessionWindow::scrollTranscriptToBottom() {
   QTimer::singleShot(0, this, [this]() {
-    if (m_chatScroll && m_chatScroll->verticalScrollBar()) {
-      m_chatScroll->verticalScrollBar()->setValue(
-          m_chatScroll->verticalScrollBar()->maximum());
+    if (m_chatView) {
+      m_chatView->scrollToBottom();
     }
   });
-  return bubble;
+}
+
+void SessionWindow::copySelectedMessages() {
+  if (!m_chatView) {
+    return;
+  }
+  QModelIndexList selected = m_chatView->selectionModel()->selectedRows();
+  std::sort(selected.begin(), selected.end());
+  QStringList lines;
+  lines.reserve(selected.size());
+  for (const QModelIndex &index : selected) {
+    lines.push_back(index.data(Qt::DisplayRole).toString());
+  }
+  if (!lines.isEmpty()) {
+    QGuiApplication::clipboard()->setText(lines.join(QLatin1Char('\n')));
+  }
 }
 
 void SessionWindow::refreshPresenceLabel() {
@@ -395,85 +477,32 @@ void SessionWindow::refreshPresenceLabel() {
   }
   m_presenceLabel->setText(presenceText(m_peerIsOnline, m_peerLastSeenAtUtc));
 }
-
-void SessionWindow::handleIncomingPayload(const QString &payload,
-                                          const QString &sourceTag) {
-  if (!m_chatLayout)
-    return;
-
-  protocol::Envelope envelope;
-  QString parseError;
-  if (protocol::parseEnvelope(payload, &envelope, &parseError)) {
-    if (envelope.type == QStringLiteral("MESSAGE") &&
-        envelope.action == QStringLiteral("SEND")) {
-      if (envelope.requestId.trimmed().isEmpty()) {
-        handleIncomingMessagePush(envelope);
-      } else {
-        handleMessageSendResponse(envelope);
-      }
-    }
-    return;
-  }
-
-  qWarning() << "Protocol parse failed, source:" << sourceTag << "error:"
-             << parseError << "payload:" << payload;
-}
 
 int SessionWindow::appendMessage(const ChatMessage &message) {
-  m_messages.push_back(message);
-  const int index = m_messages.size() - 1;
-  m_messages[index].bubbleLabel =
-      appendChatBubble(QString(), message.status != MessageStatus::Received, false);
-  updateMessageBubble(index);
+  const int index = m_messageModel->appendMessage(message);
+  scrollTranscriptToBottom();
   return index;
 }
 
-void SessionWindow::updateMessageBubble(int index) {
-  if (index < 0 || index >= m_messages.size()) {
-    return;
-  }
-
-  ChatMessage &message = m_messages[index];
-  if (!message.bubbleLabel) {
-    return;
-  }
-
-  const QString timeText = formatMessageTime(message.sentAt);
-  QString bubbleText;
-  if (message.status == MessageStatus::Received) {
-    const QString sender =
-        message.senderUsername.trimmed().isEmpty() ? QStringLiteral("对方")
-                                                   : message.senderUsername.trimmed();
-    bubbleText = QStringLiteral("%1 %2: %3")
-                     .arg(timeText, sender, message.content);
-  } else {
-    bubbleText = QStringLiteral("%1 我: %2 [%3]")
-                     .arg(timeText, message.content, messageStatusText(message.status));
-    if (message.status == MessageStatus::Sent && message.seq > 0) {
-      bubbleText += QStringLiteral(" (#%1)").arg(message.seq);
-    }
-  }
-  message.bubbleLabel->setText(bubbleText);
-}
-
 void SessionWindow::handleMessageSendResponse(const protocol::Envelope &envelope) {
   const QString requestId = envelope.requestId.trimmed();
   if (requestId.isEmpty()) {
     return;
   }
 
-  const auto it = m_pendingMessageIndexesByRequestId.constFind(requestId);
-  if (it == m_pendingMessageIndexesByRequestId.cend()) {
+  const auto it = m_pendingLocalIdsByRequestId.constFind(requestId);
+  if (it == m_pendingLocalIdsByRequestId.cend()) {
     return;
   }
 
-  const int index = it.value();
-  if (index < 0 || index >= m_messages.size()) {
-    m_pendingMessageIndexesByRequestId.remove(requestId);
+  const int index = m_messageModel->rowForLocalId(it.value());
+  const ChatMessage *pending = m_messageModel->messageAt(index);
+  if (!pending) {
+    m_pendingLocalIdsByRequestId.remove(requestId);
     return;
   }
 
-  ChatMessage &message = m_messages[index];
+  ChatMessage message = *pending;
   const QString responseConversationId =
       jsonStringValue(envelope.data, "conversation_id");
   if (!responseConversationId.isEmpty() &&
@@ -497,7 +526,7 @@ void SessionWindow::handleMessageSendResponse(const protocol::Envelope &envelope
     const QString errorText = messageErrorText(envelope.code, errorMessage);
     markPendingMessageFailed(index, errorText);
     appendStatusLine(errorText);
-    m_pendingMessageIndexesByRequestId.remove(requestId);
+    m_pendingLocalIdsByRequestId.remove(requestId);
     qWarning() << "[SessionWindow] MESSAGE/SEND failed request_id=" << requestId
                << "code=" << envelope.code << "data="
                << QString::fromUtf8(
@@ -508,6 +537,9 @@ void SessionWindow::handleMessageSendResponse(const protocol::Envelope &envelope
   message.conversationId = responseConversationId.isEmpty() ? message.conversationId
                                                             : responseConversationId;
   message.messageId = jsonStringValue(envelope.data, "message_id");
+  if (!message.messageId.isEmpty()) {
+    message.localId = message.messageId;
+  }
   message.seq = jsonIntegerValue(envelope.data, "seq");
   const QString sentAt = jsonStringValue(envelope.data, "sent_at");
   if (!sentAt.isEmpty()) {
@@ -518,31 +550,31 @@ void SessionWindow::handleMessageSendResponse(const protocol::Envelope &envelope
     message.content = content;
   }
   message.status = MessageStatus::Sent;
-  updateMessageBubble(index);
-  m_pendingMessageIndexesByRequestId.remove(requestId);
+  m_messageModel->updateMessage(index, message);
+  m_pendingLocalIdsByRequestId.remove(requestId);
 
   qInfo() << "[SessionWindow] MESSAGE/SEND ack request_id=" << requestId
           << "message_id=" << message.messageId << "seq=" << message.seq
           << "sent_at=" << message.sentAt;
 }
 
-void SessionWindow::handleIncomingMessagePush(const protocol::Envelope &envelope) {
-  const QString conversationId = jsonStringValue(envelope.data, "conversation_id");
+void SessionWindow::handleIncomingMessage(const StoredMessage &message) {
+  const QString conversationId = message.conversationId;
   if (conversationId.isEmpty() ||
       conversationId != m_session.conversationId().trimmed()) {
     return;
   }
+  // Rows loaded from the store and acked sends are keyed by message_id, so a
+  // message already on screen is not shown twice.
+  if (!message.messageId.isEmpty() &&
+      m_messageModel->rowForLocalId(message.messageId) >= 0) {
+    return;
+  }
 
-  ChatMessage incoming;
-  incoming.localId = QUuid::createUuid().toString(QUuid::WithoutBraces);
-  incoming.conversationId = conversationId;
-  incoming.messageId = jsonStringValue(envelope.data, "message_id");
-  incoming.seq = jsonIntegerValue(envelope.data, "seq");
-  incoming.content = jsonStringValue(envelope.data, "content");
-  incoming.sentAt = jsonStringValue(envelope.data, "sent_at");
-  incoming.senderUserId = jsonStringValue(envelope.data, "from_user_id");
-  incoming.senderUsername = jsonStringValue(envelope.data, "from_username");
-  incoming.status = MessageStatus::Received;
+  ChatMessage incoming = chatMessagesFromStore({message}).constFirst();
+  if (incoming.localId.isEmpty()) {
+    incoming.localId = QUuid::createUuid().toString(QUuid::WithoutBraces);
+  }
 
   if (incoming.content.isEmpty()) {
     qWarning() << "[SessionWindow] ignore incoming MESSAGE/SEND without content "
@@ -558,13 +590,14 @@ void SessionWindow::handleIncomingMessagePush(const protocol::Envelope &envelope
 }
 
 void SessionWindow::markPendingMessageFailed(int index, const QString &reason) {
-  if (index < 0 || index >= m_messages.size()) {
+  const ChatMessage *pending = m_messageModel->messageAt(index);
+  if (!pending) {
     return;
   }
 
-  ChatMessage &message = m_messages[index];
+  ChatMessage message = *pending;
   message.status = MessageStatus::Failed;
-  updateMessageBubble(index);
+  m_messageModel->updateMessage(index, message);
   qWarning() << "[SessionWindow] pending message failed request_id="
              << message.requestId << "reason=" << reason;
 }
@@ -1,6 +1,9 @@
 #ifndef SESSIONWINDOW_H
 #define SESSIONWINDOW_H
 
+#include "chatmessagedelegate.h"
+#include "chatmessagemodel.h"
+#include "messagestore.h"
 #include "protocol.h"
 #include "session.h"
 #include "usersession.h"
@@ -10,37 +13,24 @@
 #include <QHash>
 #include <QLabel>
 #include <QLineEdit>
+#include <QListView>
 #include <QMouseEvent>
 #include <QPoint>
 #include <QPushButton>
-#include <QScrollArea>
 #include <QString>
-#include <QVector>
-#include <QVBoxLayout>
 #include <QWidget>
 
 class SessionWindow : public QWidget {
   Q_OBJECT
 public:
-  enum class MessageStatus { Pending, Sent, Failed, Received };
-
-  struct ChatMessage {
-    QString localId;
-    QString requestId;
-    QString conversationId;
-    QString messageId;
-    qint64 seq = 0;
-    QString content;
-    QString sentAt;
-    QString senderUserId;
-    QString senderUsername;
-    MessageStatus status = MessageStatus::Received;
-    QLabel *bubbleLabel = nullptr;
-  };
+  using MessageStatus = ChatMessageStatus;
+  using ChatMessage = ::ChatMessage;
 
   explicit SessionWindow(const Session &session, QWidget *parent = nullptr);
   void setPeerIdentity(const QString &userId, const QString &numericId);
   void updatePeerPresence(bool isOnline, const QString &lastSeenAtUtc);
+  // Called by the main widget in seq order, once per message.
+  void handleIncomingMessage(const StoredMessage &message);
 
 signals:
   void outgoingMessageSubmitted(const QString &conversationId,
@@ -55,15 +45,15 @@ protected:
 private:
   void initUI();
   void appendStatusLine(const QString &message);
-  QLabel *appendChatBubble(const QString &message, bool outgoing = false,
-                           bool status = false);
+  void scrollTranscriptToBottom();
+  void copySelectedMessages();
   void refreshPresenceLabel();
-  void handleIncomingPayload(const QString &payload, const QString &sourceTag);
   int appendMessage(const ChatMessage &message);
-  void updateMessageBubble(int index);
   void handleMessageSendResponse(const protocol::Envelope &envelope);
-  void handleIncomingMessagePush(const protocol::Envelope &envelope);
   void markPendingMessageFailed(int index, const QString &reason);
+  void restoreOutboxMessages();
+  void loadNewestHistory();
+  void loadOlderHistory();
   Session m_session;
 
   // Dragging support
@@ -91,9 +81,9 @@ private:
   void handleMouseRelease(QMouseEvent *event);
 
   // Network & UI helpers
-  QScrollArea *m_chatScroll;
-  QWidget *m_chatContainer;
-  QVBoxLayout *m_chatLayout;
+  QListView *m_chatView;
+  ChatMessageModel *m_messageModel;
+  ChatMessageDelegate *m_messageDelegate;
   QLineEdit *m_inputLine;
   QPushButton *m_sendBtn;
   QLabel *m_presenceLabel;
@@ -102,8 +92,11 @@ private:
   QString m_peerNumericId;
   QString m_peerLastSeenAtUtc;
   bool m_peerIsOnline = false;
-  QVector<ChatMessage> m_messages;
-  QHash<QString, int> m_pendingMessageIndexesByRequestId;
+  // Rows shift when older history is prepended, so pending messages are
+  // tracked by local id rather than by row.
+  QHash<QString, QString> m_pendingLocalIdsByRequestId;
+  qint64 m_oldestLoadedSeq = 0;
+  bool m_historyExhausted = false;
   void onSendClicked();
   void sendPendingMessage();
 
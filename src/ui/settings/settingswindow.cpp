@@ -1,8 +1,8 @@
 #include "settingswindow.h"
+#include "avatarimage.h"
 #include "usersession.h"
 #include "websocketclient.h"
 
-#include <QFile>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QFormLayout>
@@ -22,7 +22,14 @@
 #include <QVBoxLayout>
 
 namespace {
+// The server limit applies to what is uploaded, i.e. after re-encoding.
 constexpr qint64 kMaxAvatarFileSizeBytes = 2 * 1024 * 1024;
+constexpr qint64 kMaxAvatarSourceFileSizeBytes = 32 * 1024 * 1024;
+constexpr int kDefaultAvatarMaxDimension = 512;
+constexpr int kDefaultAvatarQuality = 85;
+constexpr const char *kAvatarMaxDimensionEnv = "QT_AVATAR_UPLOAD_MAX_DIMENSION";
+constexpr const char *kAvatarFormatEnv = "QT_AVATAR_UPLOAD_FORMAT";
+constexpr const char *kAvatarQualityEnv = "QT_AVATAR_UPLOAD_QUALITY";
 constexpr int kDefaultStaticPort = 18080;
 constexpr const char *kStaticPortEnv = "QT_SERVER_STATIC_PORT";
 constexpr const char *kStaticHostEnv = "QT_SERVER_STATIC_HOST";
@@ -67,20 +74,20 @@ int resolveStaticPort() {
   return staticPort;
 }
 
-QString contentTypeFromSuffix(const QString &suffixLower) {
-  if (suffixLower == "jpg" || suffixLower == "jpeg") {
-    return "image/jpeg";
-  }
-  if (suffixLower == "png") {
-    return "image/png";
-  }
-  if (suffixLower == "webp") {
-    return "image/webp";
-  }
-  if (suffixLower == "gif") {
-    return "image/gif";
-  }
-  return "application/octet-stream";
+avatarimage::UploadEncodeOptions resolveAvatarEncodeOptions() {
+  avatarimage::UploadEncodeOptions options;
+  bool ok = false;
+  const int maxDimension =
+      qEnvironmentVariableIntValue(kAvatarMaxDimensionEnv, &ok);
+  options.maxDimension =
+      ok && maxDimension > 0 ? maxDimension : kDefaultAvatarMaxDimension;
+  const int quality = qEnvironmentVariableIntValue(kAvatarQualityEnv, &ok);
+  options.quality =
+      ok && quality > 0 && quality <= 100 ? quality : kDefaultAvatarQuality;
+  const QString format =
+      qEnvironmentVariable(kAvatarFormatEnv).trimmed().toLower();
+  options.format = format == "webp" ? QByteArray("webp") : QByteArray("jpeg");
+  return options;
 }
 }
 
@@ -110,6 +117,12 @@ SettingsWindow::SettingsWindow(const QString &userId,
           &SettingsWindow::onProfileSetSuccess);
   connect(m_profileApiClient, &ProfileApiClient::requestFailed, this,
           &SettingsWindow::onProfileRequestFailed);
+  connect(&m_avatarUploadClient, &ChunkedUploadClient::progress, this,
+          &SettingsWindow::onAvatarUploadProgress);
+  connect(&m_avatarUploadClient, &ChunkedUploadClient::finished, this,
+          &SettingsWindow::onAvatarUploadFinished);
+  connect(&m_avatarUploadClient, &ChunkedUploadClient::failed, this,
+          &SettingsWindow::onAvatarUploadFailed);
   connect(&m_authApiClient, &AuthApiClient::logoutSucceeded, this,
           &SettingsWindow::onLogoutSucceeded);
   connect(&m_authApiClient, &AuthApiClient::authRequestFailed, this,
@@ -133,10 +146,18 @@ SettingsWindow::~SettingsWindow() {
     m_avatarPreviewReply->deleteLater();
     m_avatarPreviewReply = nullptr;
   }
+  if (m_avatarUploadClient.isActive()) {
+    qInfo() << "[AvatarUpload] cancel pending request, request_id="
+            << m_pendingUploadRequestId
+            << "upload_id=" << m_avatarUploadClient.uploadId();
+    m_pendingUploadRequestId.clear();
+    m_avatarUploadClient.abort();
+  }
   if (m_uploadReply) {
     qInfo() << "[AvatarUpload] cancel pending request, request_id="
             << m_pendingUploadRequestId;
     m_pendingUploadRequestId.clear();
+    disconnect(m_uploadReply, nullptr, this, nullptr);
     m_uploadReply->abort();
     m_uploadReply->deleteLater();
     m_uploadReply = nullptr;
@@ -370,9 +391,9 @@ bool SettingsWindow::validateSelectedAvatarFile(QString *error) const {
     }
     return false;
   }
-  if (info.size() > kMaxAvatarFileSizeBytes) {
+  if (info.size() > kMaxAvatarSourceFileSizeBytes) {
     if (error) {
-      *error = "头像文件不能超过 2MB";
+      *error = "头像文件不能超过 32MB";
     }
     return false;
   }
@@ -415,6 +436,7 @@ void SettingsWindow::onChooseAvatarClicked() {
   }
 
   m_selectedAvatarFilePath = filePath;
+  m_avatarUploadResumable = false;
   QString error;
   if (!validateSelectedAvatarFile(&error)) {
     m_selectedAvatarFilePath.clear();
@@ -441,6 +463,14 @@ QUrl SettingsWindow::buildUploadEndpoint() const {
   return uploadUrl;
 }
 
+// Resumable upload endpoint (see chunkeduploadclient.h). Static servers that
+// only have the multipart /upload/avatar answer its create POST with 404/405.
+QUrl SettingsWindow::buildChunkedUploadEndpoint() const {
+  QUrl uploadUrl = buildUploadEndpoint();
+  uploadUrl.setPath("/upload/chunks");
+  return uploadUrl;
+}
+
 QUrl SettingsWindow::resolveAvatarUrlForPreview(const QString &avatarUrl) const {
   const QString trimmed = avatarUrl.trimmed();
   if (trimmed.isEmpty()) {
@@ -513,15 +543,123 @@ void SettingsWindow::onUploadAvatarClicked() {
     return;
   }
 
-  QFile *file = new QFile(m_selectedAvatarFilePath);
-  if (!file->open(QIODevice::ReadOnly)) {
-    const QString message = "头像文件打开失败，请重试。";
-    file->deleteLater();
+  const QUrl uploadUrl = buildUploadEndpoint();
+  if (!uploadUrl.isValid()) {
+    const QString message = "上传地址无效";
     m_statusLabel->setText("上传失败: " + message);
     QMessageBox::warning(this, "上传失败", message);
     return;
   }
 
+  // The same file after a network failure: carry on where the server
+  // stopped rather than encoding and sending it again.
+  if (m_avatarUploadResumable &&
+      m_encodedAvatarFilePath == m_selectedAvatarFilePath &&
+      resumeAvatarUpload()) {
+    return;
+  }
+
+  // Decoding and re-encoding a phone photo takes far too long for the GUI
+  // thread; the upload starts once the smaller file is back.
+  const QString filePath = m_selectedAvatarFilePath;
+  const avatarimage::UploadEncodeOptions options = resolveAvatarEncodeOptions();
+  setUploading(true, "头像压缩中...");
+  avatarimage::runInPool(
+      this,
+      [filePath, options]() {
+        return avatarimage::encodeForUpload(filePath, options);
+      },
+      [this, filePath](const avatarimage::EncodedUpload &encoded) {
+        m_encodedAvatar = encoded;
+        m_encodedAvatarFilePath = filePath;
+        startAvatarUpload(encoded);
+      });
+}
+
+void SettingsWindow::startAvatarUpload(
+    const avatarimage::EncodedUpload &encoded) {
+  QString message;
+  if (!encoded.isValid()) {
+    message = QStringLiteral("头像图片解析失败");
+  } else if (encoded.bytes.size() > kMaxAvatarFileSizeBytes) {
+    message = QStringLiteral("压缩后头像仍超过 2MB");
+  }
+  if (!message.isEmpty()) {
+    qWarning() << "[AvatarUpload] encode failed user_id=" << m_userId.trimmed()
+               << "message=" << message << "error=" << encoded.error;
+    setUploading(false, "上传失败: " + message);
+    QMessageBox::warning(this, "上传失败", message);
+    return;
+  }
+
+  m_avatarUploadResumable = false;
+  m_avatarUploadSummary = QString("已压缩 %1 KB → %2 KB")
+                              .arg(qMax<qint64>(1, encoded.originalBytes / 1024))
+                              .arg(qMax<qint64>(1, encoded.bytes.size() / 1024));
+  m_pendingUploadRequestId =
+      QUuid::createUuid().toString(QUuid::WithoutBraces);
+  m_avatarUploadRequestId = m_pendingUploadRequestId;
+  if (m_chunkedUploadUnsupported) {
+    startMultipartAvatarUpload();
+    return;
+  }
+
+  const QUrl uploadUrl = buildChunkedUploadEndpoint();
+  const QString fileName =
+      QFileInfo(m_selectedAvatarFilePath).completeBaseName() +
+      QLatin1Char('.') + encoded.suffix;
+  QJsonObject metadata;
+  metadata.insert("purpose", "avatar");
+  metadata.insert("user_id", m_userId.trimmed());
+  metadata.insert("request_id", m_pendingUploadRequestId);
+
+  m_avatarUploadClient.setAuthorization(
+      UserSession::instance().authorizationHeaderValue());
+  QString error;
+  if (!m_avatarUploadClient.startData(uploadUrl, encoded.bytes, fileName,
+                                      encoded.contentType, metadata, &error)) {
+    m_pendingUploadRequestId.clear();
+    setUploading(false, "上传失败: " + error);
+    QMessageBox::warning(this, "上传失败", error);
+    return;
+  }
+  qInfo() << "[AvatarUpload] send request_id=" << m_pendingUploadRequestId
+          << "user_id=" << m_userId.trimmed() << "url=" << uploadUrl.toString()
+          << "original_bytes=" << encoded.originalBytes
+          << "encoded_bytes=" << encoded.bytes.size()
+          << "saved_bytes=" << encoded.bytesSaved() << "size=" << encoded.size;
+  setUploading(true,
+               QString("头像上传中... 0%（%1）").arg(m_avatarUploadSummary));
+}
+
+bool SettingsWindow::resumeAvatarUpload() {
+  m_avatarUploadClient.setAuthorization(
+      UserSession::instance().authorizationHeaderValue());
+  QString error;
+  if (!m_avatarUploadClient.resume(&error)) {
+    qWarning() << "[AvatarUpload] resume failed request_id="
+               << m_avatarUploadRequestId << "error=" << error;
+    m_avatarUploadResumable = false;
+    return false;
+  }
+  m_avatarUploadResumable = false;
+  m_pendingUploadRequestId = m_avatarUploadRequestId;
+  qInfo() << "[AvatarUpload] resume request_id=" << m_pendingUploadRequestId
+          << "upload_id=" << m_avatarUploadClient.uploadId()
+          << "confirmed_bytes=" << m_avatarUploadClient.confirmedBytes()
+          << "total_bytes=" << m_avatarUploadClient.totalBytes();
+  const qint64 total = qMax<qint64>(1, m_avatarUploadClient.totalBytes());
+  setUploading(true, QString("头像上传中... %1%（%2）")
+                         .arg(m_avatarUploadClient.confirmedBytes() * 100 / total)
+                         .arg(m_avatarUploadSummary));
+  return true;
+}
+
+// The single-request upload every static server supports.
+void SettingsWindow::startMultipartAvatarUpload() {
+  const avatarimage::EncodedUpload &encoded = m_encodedAvatar;
+  const QUrl uploadUrl = buildUploadEndpoint();
+  const UserSession &session = UserSession::instance();
   QHttpMultiPart *multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
 
   QHttpPart userIdPart;
@@ -530,43 +668,36 @@ void SettingsWindow::onUploadAvatarClicked() {
   userIdPart.setBody(m_userId.trimmed().toUtf8());
   multiPart->append(userIdPart);
 
-  const QFileInfo fileInfo(*file);
-  const QString suffixLower = fileInfo.suffix().trimmed().toLower();
-
+  const QString fileName =
+      QFileInfo(m_encodedAvatarFilePath).completeBaseName() +
+      QLatin1Char('.') + encoded.suffix;
   QHttpPart filePart;
   filePart.setHeader(QNetworkRequest::ContentTypeHeader,
-                     QVariant(contentTypeFromSuffix(suffixLower)));
+                     QVariant(encoded.contentType));
   filePart.setHeader(
       QNetworkRequest::ContentDispositionHeader,
       QVariant(QString("form-data; name=\"file\"; filename=\"%1\"")
-                   .arg(fileInfo.fileName())));
-  filePart.setBodyDevice(file);
-  file->setParent(multiPart);
+                   .arg(fileName)));
+  filePart.setBody(encoded.bytes);
   multiPart->append(filePart);
 
-  const QUrl uploadUrl = buildUploadEndpoint();
-  if (!uploadUrl.isValid()) {
-    multiPart->deleteLater();
-    const QString message = "上传地址无效";
-    m_statusLabel->setText("上传失败: " + message);
-    QMessageBox::warning(this, "上传失败", message);
-    return;
-  }
-
   QNetworkRequest request(uploadUrl);
-  m_pendingUploadRequestId =
-      QUuid::createUuid().toString(QUuid::WithoutBraces);
   request.setRawHeader("Authorization",
                        session.authorizationHeaderValue().toUtf8());
   request.setTransferTimeout(20000);
 
   m_uploadReply = m_uploadNetworkManager.post(request, multiPart);
   multiPart->setParent(m_uploadReply);
+  connect(m_uploadReply, &QNetworkReply::uploadProgress, this,
+          &SettingsWindow::onAvatarUploadProgress);
   connect(m_uploadReply, &QNetworkReply::finished, this,
           &SettingsWindow::onUploadReplyFinished);
-  qInfo() << "[AvatarUpload] send request_id=" << m_pendingUploadRequestId
-          << "user_id=" << m_userId.trimmed() << "url=" << uploadUrl.toString();
-  setUploading(true, "头像上传中...");
+  qInfo() << "[AvatarUpload] send multipart request_id="
+          << m_pendingUploadRequestId << "user_id=" << m_userId.trimmed()
+          << "url=" << uploadUrl.toString()
+          << "encoded_bytes=" << encoded.bytes.size();
+  setUploading(true,
+               QString("头像上传中... 0%（%1）").arg(m_avatarUploadSummary));
 }
 
 void SettingsWindow::applyProfileToUi(const ProfileInfo &info) {
@@ -577,15 +708,16 @@ void SettingsWindow::applyProfileToUi(const ProfileInfo &info) {
 }
 
 void SettingsWindow::updateAvatarPreviewFromLocal(const QString &filePath) {
-  QPixmap pixmap(filePath);
-  if (pixmap.isNull()) {
-    applyDefaultAvatarPreview();
-    return;
-  }
-  const QPixmap scaled =
-      pixmap.scaled(m_avatarPreviewLabel->size(), Qt::KeepAspectRatioByExpanding,
-                    Qt::SmoothTransformation);
-  m_avatarPreviewLabel->setPixmap(scaled);
+  const quint64 serial = ++m_avatarPreviewSerial;
+  const QSize target = m_avatarPreviewLabel->size();
+  avatarimage::runInPool(
+      this,
+      [filePath, target]() {
+        return avatarimage::decodeFileCovering(filePath, target);
+      },
+      [this, serial](const QImage &image) {
+        applyAvatarPreviewImage(serial, image);
+      });
 }
 
 void SettingsWindow::updateAvatarPreviewFromUrl(const QString &avatarUrl) {
@@ -594,6 +726,7 @@ void SettingsWindow::updateAvatarPreviewFromUrl(const QString &avatarUrl) {
     return;
   }
 
+  ++m_avatarPreviewSerial;
   if (m_avatarPreviewReply) {
     m_avatarPreviewReply->abort();
     m_avatarPreviewReply->deleteLater();
@@ -630,24 +763,37 @@ void SettingsWindow::onAvatarPreviewReplyFinished() {
     return;
   }
 
-  QPixmap pixmap;
-  if (!pixmap.loadFromData(reply->readAll())) {
+  const quint64 serial = m_avatarPreviewSerial;
+  const QSize target = m_avatarPreviewLabel->size();
+  const QByteArray bytes = reply->readAll();
+  reply->deleteLater();
+  avatarimage::runInPool(
+      this,
+      [bytes, target]() { return avatarimage::decodeCovering(bytes, target); },
+      [this, serial](const QImage &image) {
+        applyAvatarPreviewImage(serial, image);
+      });
+}
+
+void SettingsWindow::applyAvatarPreviewImage(quint64 serial,
+                                             const QImage &image) {
+  // A newer file or URL was picked while this one was decoding.
+  if (serial != m_avatarPreviewSerial) {
+    return;
+  }
+  if (image.isNull()) {
     applyDefaultAvatarPreview();
-    reply->deleteLater();
     return;
   }
-  const QPixmap scaled =
-      pixmap.scaled(m_avatarPreviewLabel->size(), Qt::KeepAspectRatioByExpanding,
-                    Qt::SmoothTransformation);
-  m_avatarPreviewLabel->setPixmap(scaled);
+  m_avatarPreviewLabel->setPixmap(QPixmap::fromImage(image));
   m_avatarPreviewLabel->setText(QString());
-  reply->deleteLater();
 }
 
 void SettingsWindow::applyDefaultAvatarPreview() {
   if (!m_avatarPreviewLabel) {
     return;
   }
+  ++m_avatarPreviewSerial;
   m_avatarPreviewLabel->setPixmap(QPixmap());
   m_avatarPreviewLabel->setText("头像");
 }
@@ -657,90 +803,114 @@ QString SettingsWindow::extractMessageFromJson(const QJsonObject &obj) const {
   return message.isEmpty() ? QStringLiteral("请求失败") : message;
 }
 
-void SettingsWindow::onUploadReplyFinished() {
-  QNetworkReply *reply = m_uploadReply.data();
-  m_uploadReply = nullptr;
+void SettingsWindow::onAvatarUploadProgress(qint64 sentBytes,
+                                            qint64 totalBytes) {
+  if (!m_uploading || totalBytes <= 0) {
+    return;
+  }
+  const int percent = static_cast<int>(sentBytes * 100 / totalBytes);
+  m_statusLabel->setText(QString("头像上传中... %1%（%2）")
+                             .arg(percent)
+                             .arg(m_avatarUploadSummary));
+}
+
+void SettingsWindow::onAvatarUploadFailed(const QString &error, int httpCode) {
+  // The create POST was rejected: this static server has no chunked
+  // endpoint, so send the same bytes to /upload/avatar instead.
+  if ((httpCode == 404 || httpCode == 405) && !m_uploadReply &&
+      m_avatarUploadClient.uploadId().isEmpty() && !m_chunkedUploadUnsupported) {
+    qWarning() << "[AvatarUpload] chunked upload unsupported, request_id="
+               << m_pendingUploadRequestId << "http_code=" << httpCode
+               << "fallback=" << buildUploadEndpoint().toString();
+    m_chunkedUploadUnsupported = true;
+    startMultipartAvatarUpload();
+    return;
+  }
+
   const QString requestId = m_pendingUploadRequestId;
   m_pendingUploadRequestId.clear();
+  // Transport errors and 5xx leave a chunked upload that resume() can
+  // continue on the next click.
+  m_avatarUploadResumable = !m_uploadReply && (httpCode == 0 || httpCode >= 500) &&
+                            m_avatarUploadClient.state() ==
+                                ChunkedUploadClient::State::Failed;
+  QString message;
+  if (httpCode == 401) {
+    message = QStringLiteral("上传凭证失效，请重新登录");
+  } else if (httpCode == 413) {
+    message = QStringLiteral("头像超过 2MB 限制");
+  } else if (httpCode == 415) {
+    message = QStringLiteral("仅支持 jpg/png/webp/gif");
+  } else if (httpCode == 0 || httpCode >= 500) {
+    message = QStringLiteral("网络异常，请稍后重试");
+  } else {
+    message = error.trimmed().isEmpty() ? QStringLiteral("请求失败")
+                                        : error.trimmed();
+  }
+  qWarning() << "[AvatarUpload] failed request_id=" << requestId
+             << "user_id=" << m_userId.trimmed() << "http_code=" << httpCode
+             << "message=" << message << "error=" << error
+             << "resumable=" << m_avatarUploadResumable;
+  setUploading(false, m_avatarUploadResumable
+                          ? "上传失败: " + message + "，再次点击上传将从断点继续"
+                          : "上传失败: " + message);
+  QMessageBox::warning(this, "上传失败", message);
+}
+
+void SettingsWindow::onUploadReplyFinished() {
+  QNetworkReply *reply = m_uploadReply.data();
   if (!reply) {
     setUploading(false, QString());
     return;
   }
+  reply->deleteLater();
 
   const QVariant statusCodeAttr =
       reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
   const int httpCode = statusCodeAttr.isValid() ? statusCodeAttr.toInt() : 0;
   const QByteArray body = reply->readAll();
-  if (reply->error() != QNetworkReply::NoError) {
-    QString message;
-    if (httpCode == 401) {
-      message = QStringLiteral("上传凭证失效，请重新登录");
-    } else if (httpCode == 413) {
-      message = QStringLiteral("头像超过 2MB 限制");
-    } else if (httpCode == 415) {
-      message = QStringLiteral("仅支持 jpg/png/webp/gif");
-    } else {
-      message = QStringLiteral("网络异常，请稍后重试");
-    }
-    qWarning() << "[AvatarUpload] failed request_id=" << requestId
-               << "user_id=" << m_userId.trimmed() << "http_code=" << httpCode
-               << "message=" << message << "error=" << reply->errorString();
-    setUploading(false, "上传失败: " + message);
-    QMessageBox::warning(this, "上传失败", message);
-    reply->deleteLater();
-    return;
-  }
-
   QJsonParseError parseError;
   const QJsonDocument doc = QJsonDocument::fromJson(body, &parseError);
-  if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
-    const QString message = QStringLiteral("上传响应解析失败");
-    qWarning() << "[AvatarUpload] parse failed request_id=" << requestId
-               << "user_id=" << m_userId.trimmed() << "http_code=" << httpCode
-               << "message=" << message;
-    setUploading(false, "上传失败: " + message);
-    QMessageBox::warning(this, "上传失败", message);
-    reply->deleteLater();
-    return;
-  }
-
   const QJsonObject obj = doc.object();
-  const bool ok = obj.value("ok").toBool(false);
-  if (!ok) {
-    QString message = extractMessageFromJson(obj);
-    if (httpCode == 401) {
-      message = QStringLiteral("上传凭证失效，请重新登录");
-    } else if (httpCode == 413) {
-      message = QStringLiteral("头像超过 2MB 限制");
-    } else if (httpCode == 415) {
-      message = QStringLiteral("仅支持 jpg/png/webp/gif");
-    }
-    qWarning() << "[AvatarUpload] business failed request_id=" << requestId
-               << "user_id=" << m_userId.trimmed() << "http_code=" << httpCode
-               << "message=" << message;
-    setUploading(false, "上传失败: " + message);
-    QMessageBox::warning(this, "上传失败", message);
-    reply->deleteLater();
+  QString error;
+  if (reply->error() != QNetworkReply::NoError) {
+    error = reply->errorString();
+  } else if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+    error = QStringLiteral("上传响应解析失败");
+  } else if (!obj.value("ok").toBool(false)) {
+    error = extractMessageFromJson(obj);
+  }
+  // Cleared only now so onAvatarUploadFailed sees this was the multipart
+  // request, not a chunked one.
+  if (!error.isEmpty()) {
+    onAvatarUploadFailed(error, httpCode);
+    m_uploadReply = nullptr;
     return;
   }
+  m_uploadReply = nullptr;
+  onAvatarUploadFinished(obj);
+}
 
-  const QString avatarUrl = obj.value("avatar_url").toString().trimmed();
+void SettingsWindow::onAvatarUploadFinished(const QJsonObject &result) {
+  const QString requestId = m_pendingUploadRequestId;
+  m_pendingUploadRequestId.clear();
+  m_avatarUploadResumable = false;
+  const QString avatarUrl = result.value("avatar_url").toString().trimmed();
   if (avatarUrl.isEmpty()) {
     const QString message = QStringLiteral("上传成功但未返回 avatar_url");
     qWarning() << "[AvatarUpload] empty avatar_url request_id=" << requestId
-               << "user_id=" << m_userId.trimmed() << "http_code=" << httpCode
-               << "message=" << message;
+               << "user_id=" << m_userId.trimmed() << "message=" << message;
     setUploading(false, "上传失败: " + message);
     QMessageBox::warning(this, "上传失败", message);
-    reply->deleteLater();
     return;
   }
 
   m_avatarUrl = avatarUrl;
   updateAvatarPreviewFromLocal(m_selectedAvatarFilePath);
   qInfo() << "[AvatarUpload] success request_id=" << requestId
-          << "user_id=" << m_userId.trimmed() << "http_code=" << httpCode
-          << "message=" << extractMessageFromJson(obj);
+          << "user_id=" << m_userId.trimmed()
+          << "upload_id=" << m_avatarUploadClient.uploadId()
+          << "message=" << extractMessageFromJson(result);
   setUploading(false, "头像上传成功，正在保存资料...");
   QMessageBox::information(this, "成功", "头像上传成功");
 
@@ -749,13 +919,11 @@ void SettingsWindow::onUploadReplyFinished() {
   if (!m_profileApiClient) {
     setUploading(false, "保存失败: Profile 服务未初始化");
     QMessageBox::warning(this, "保存失败", "Profile 服务未初始化");
-    reply->deleteLater();
     return;
   }
   setSaving(true, "保存中...");
   m_pendingSetRequestId = m_profileApiClient->setProfileInfo(
       m_userId.trimmed(), avatarUrl, nickname, signature);
-  reply->deleteLater();
 }
 
 void SettingsWindow::onProfileInfoReceived(const QString &requestId,
@@ -813,9 +981,14 @@ void SettingsWindow::onLogoutClicked() {
   if (m_avatarPreviewReply) {
     m_avatarPreviewReply->abort();
   }
+  if (m_avatarUploadClient.isActive()) {
+    m_avatarUploadClient.abort();
+    setUploading(false, QString());
+  }
   if (m_uploadReply) {
     m_uploadReply->abort();
   }
+  m_avatarUploadResumable = false;
 
   m_loggingOut = true;
   updateActionButtons();
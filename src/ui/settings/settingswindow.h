@@ -2,8 +2,11 @@
 #define SETTINGSWINDOW_H
 
 #include "authapiclient.h"
+#include "avatarimage.h"
+#include "chunkeduploadclient.h"
 #include "profileapiclient.h"
 
+#include <QImage>
 #include <QJsonObject>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
@@ -37,6 +40,9 @@ private slots:
   void onProfileSetSuccess(const QString &requestId, const ProfileInfo &info);
   void onProfileRequestFailed(const QString &requestId, const QString &action,
                               const QString &error);
+  void onAvatarUploadProgress(qint64 sentBytes, qint64 totalBytes);
+  void onAvatarUploadFinished(const QJsonObject &result);
+  void onAvatarUploadFailed(const QString &error, int httpCode);
   void onUploadReplyFinished();
   void onAvatarPreviewReplyFinished();
   void onLogoutClicked();
@@ -56,9 +62,14 @@ private:
   void setSaving(bool saving, const QString &statusText);
   void setUploading(bool uploading, const QString &statusText);
   QUrl buildUploadEndpoint() const;
+  QUrl buildChunkedUploadEndpoint() const;
+  void startAvatarUpload(const avatarimage::EncodedUpload &encoded);
+  bool resumeAvatarUpload();
+  void startMultipartAvatarUpload();
   QUrl resolveAvatarUrlForPreview(const QString &avatarUrl) const;
   void updateAvatarPreviewFromLocal(const QString &filePath);
   void updateAvatarPreviewFromUrl(const QString &avatarUrl);
+  void applyAvatarPreviewImage(quint64 serial, const QImage &image);
   void applyDefaultAvatarPreview();
   QString extractMessageFromJson(const QJsonObject &obj) const;
 
@@ -77,7 +88,22 @@ private:
   AuthApiClient m_authApiClient;
   QNetworkAccessManager m_uploadNetworkManager;
   QPointer<QNetworkReply> m_uploadReply;
+  ChunkedUploadClient m_avatarUploadClient;
+  // The last encoded avatar and the file it came from. A failed chunked
+  // upload of the same file is resumed with these bytes instead of being
+  // encoded and sent again from byte 0.
+  avatarimage::EncodedUpload m_encodedAvatar;
+  QString m_encodedAvatarFilePath;
+  QString m_avatarUploadRequestId;
+  bool m_avatarUploadResumable = false;
+  // Set once the static server rejects the chunked endpoint; later uploads
+  // go straight to the multipart /upload/avatar.
+  bool m_chunkedUploadUnsupported = false;
+  // "已压缩 x KB → y KB", repeated in every progress update.
+  QString m_avatarUploadSummary;
   QPointer<QNetworkReply> m_avatarPreviewReply;
+  // Bumped per preview request so a slow decode cannot replace a newer one.
+  quint64 m_avatarPreviewSerial = 0;
 
   QLineEdit *m_nicknameEdit = nullptr;
   QTextEdit *m_signatureEdit = nullptr;
@@ -0,0 +1,322 @@
+#include "avatarimage.h"
+#include "avatarservice.h"
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QFileInfo>
+#include <QHostAddress>
+#include <QImage>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QtTest/QtTest>
+
+namespace {
+constexpr int kAvatarSide = 48;
+const QByteArray kEtag = QByteArrayLiteral("\"avatar-v1\"");
+
+QByteArray pngAvatar() {
+  QImage image(256, 128, QImage::Format_ARGB32);
+  image.fill(QColor(0x33, 0x99, 0xcc));
+  QByteArray bytes;
+  QBuffer buffer(&bytes);
+  buffer.open(QIODevice::WriteOnly);
+  image.save(&buffer, "PNG");
+  return bytes;
+}
+
+// Minimal static file server: one PNG, an ETag, and "no-cache" so every
+// disk-cached copy is revalidated. Answers 304 to a matching If-None-Match.
+class StaticStandInServer : public QObject {
+  Q_OBJECT
+
+public:
+  quint16 start() {
+    m_body = pngAvatar();
+    if (!m_server.listen(QHostAddress::LocalHost, 0)) {
+      return 0;
+    }
+    connect(&m_server, &QTcpServer::newConnection, this, [this]() {
+      QTcpSocket *socket = m_server.nextPendingConnection();
+      connect(socket, &QTcpSocket::readyRead, socket,
+              [this, socket]() { reply(socket); });
+      connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    });
+    return m_server.serverPort();
+  }
+
+  int fullResponses = 0;
+  int notModifiedResponses = 0;
+  int missingResponses = 0;
+  // Answers every request with a 500 while set.
+  bool failing = false;
+
+private:
+  void reply(QTcpSocket *socket) {
+    const QByteArray request = socket->readAll();
+    const QByteArray path = request.split(' ').value(1);
+    QByteArray response;
+    if (failing) {
+      response = "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n";
+    } else if (path != "/static/avatar.png") {
+      ++missingResponses;
+      response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+    } else if (request.contains("If-None-Match: " + kEtag)) {
+      ++notModifiedResponses;
+      response = "HTTP/1.1 304 Not Modified\r\nETag: " + kEtag +
+                 "\r\nCache-Control: no-cache\r\nContent-Length: 0\r\n\r\n";
+    } else {
+      ++fullResponses;
+      response = "HTTP/1.1 200 OK\r\nContent-Type: image/png\r\nETag: " + kEtag +
+                 "\r\nCache-Control: no-cache\r\nContent-Length: " +
+                 QByteArray::number(m_body.size()) + "\r\n\r\n" + m_body;
+    }
+    socket->write(response);
+  }
+
+  QTcpServer m_server;
+  QByteArray m_body;
+};
+} // namespace
+
+class AvatarServiceTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void concurrentRequestsShareOneDownload();
+  void memoryHitSkipsNetwork();
+  void staleDiskEntryIsRevalidated();
+  void failedRevalidationKeepsCachedAvatar();
+  void failedDownloadIsReported();
+  void largeImageDecodesAtCoveringSize();
+  void poolResultArrivesOnGuiThread();
+  void uploadEncodeShrinksAndStripsMetadata();
+
+private:
+  QUrl avatarUrl(const QString &path) const;
+  // A disk cache of its own per test function, so no test sees files
+  // another one downloaded.
+  QString cacheDirectory() const;
+
+  QTemporaryDir m_cacheRoot;
+  StaticStandInServer m_server;
+  quint16 m_port = 0;
+};
+
+void AvatarServiceTest::initTestCase() {
+  QStandardPaths::setTestModeEnabled(true);
+  QVERIFY(m_cacheRoot.isValid());
+  m_port = m_server.start();
+  QVERIFY(m_port != 0);
+}
+
+QUrl AvatarServiceTest::avatarUrl(const QString &path) const {
+  return QUrl(QStringLiteral("http://127.0.0.1:%1%2").arg(m_port).arg(path));
+}
+
+QString AvatarServiceTest::cacheDirectory() const {
+  return m_cacheRoot.filePath(QString::fromLatin1(QTest::currentTestFunction()));
+}
+
+void AvatarServiceTest::concurrentRequestsShareOneDownload() {
+  AvatarService service(cacheDirectory());
+  QSignalSpy ready(&service, &AvatarService::avatarReady);
+  const QUrl url = avatarUrl(QStringLiteral("/static/avatar.png"));
+
+  // Ten rows ask at once, two of them at a different size.
+  for (int i = 0; i < 8; ++i) {
+    QVERIFY(service.avatar(url, kAvatarSide).isNull());
+  }
+  QVERIFY(service.avatar(url, kAvatarSide * 2).isNull());
+  QVERIFY(service.avatar(url, kAvatarSide * 2).isNull());
+  QTRY_COMPARE_WITH_TIMEOUT(ready.count(), 2, 5000);
+
+  const AvatarCacheStats stats = service.stats();
+  QCOMPARE(stats.downloads, quint64(1));
+  QCOMPARE(stats.joined, quint64(9));
+  QCOMPARE(stats.size, 2);
+  for (const QList<QVariant> &arguments : ready) {
+    const int side = arguments.at(1).toInt();
+    const QPixmap pixmap = arguments.at(2).value<QPixmap>();
+    QCOMPARE(pixmap.size(), QSize(side, side));
+    // Corners are outside the circular mask.
+    QCOMPARE(pixmap.toImage().pixelColor(0, 0).alpha(), 0);
+  }
+}
+
+void AvatarServiceTest::memoryHitSkipsNetwork() {
+  AvatarService service(cacheDirectory());
+  QSignalSpy ready(&service, &AvatarService::avatarReady);
+  const QUrl url = avatarUrl(QStringLiteral("/static/avatar.png"));
+  service.avatar(url, kAvatarSide);
+  QTRY_COMPARE_WITH_TIMEOUT(ready.count(), 1, 5000);
+
+  const int requestsBefore =
+      m_server.fullResponses + m_server.notModifiedResponses;
+  QVERIFY(!service.avatar(url, kAvatarSide).isNull());
+  QVERIFY(!service.avatar(url, kAvatarSide).isNull());
+  QTest::qWait(50);
+  QCOMPARE(m_server.fullResponses + m_server.notModifiedResponses, requestsBefore);
+  QCOMPARE(service.stats().hits, quint64(2));
+  QCOMPARE(ready.count(), 1);
+}
+
+void AvatarServiceTest::staleDiskEntryIsRevalidated() {
+  AvatarService service(cacheDirectory());
+  QSignalSpy ready(&service, &AvatarService::avatarReady);
+  const QUrl url = avatarUrl(QStringLiteral("/static/avatar.png"));
+  service.avatar(url, kAvatarSide);
+  QTRY_COMPARE_WITH_TIMEOUT(ready.count(), 1, 5000);
+
+  // Only the decoded copy is dropped; the file stays in the disk cache and
+  // is revalidated with If-None-Match instead of downloaded again.
+  service.clear();
+  const int fullBefore = m_server.fullResponses;
+  const int notModifiedBefore = m_server.notModifiedResponses;
+  QVERIFY(service.avatar(url, kAvatarSide).isNull());
+  QTRY_COMPARE_WITH_TIMEOUT(ready.count(), 2, 5000);
+  QCOMPARE(m_server.fullResponses, fullBefore);
+  QCOMPARE(m_server.notModifiedResponses, notModifiedBefore + 1);
+  QCOMPARE(service.stats().diskCacheHits, quint64(1));
+}
+
+void AvatarServiceTest::failedRevalidationKeepsCachedAvatar() {
+  AvatarService service(cacheDirectory());
+  QSignalSpy ready(&service, &AvatarService::avatarReady);
+  QSignalSpy failed(&service, &AvatarService::avatarFailed);
+  const QUrl url = avatarUrl(QStringLiteral("/static/avatar.png"));
+  service.avatar(url, kAvatarSide);
+  QTRY_COMPARE_WITH_TIMEOUT(ready.count(), 1, 5000);
+
+  // Every hit is now stale, and the server is down.
+  service.setRevalidateAfterMs(0);
+  m_server.failing = true;
+  QVERIFY(!service.avatar(url, kAvatarSide).isNull());
+  QTRY_COMPARE_WITH_TIMEOUT(service.stats().failures, quint64(1), 5000);
+  m_server.failing = false;
+  QCOMPARE(failed.count(), 0);
+  QVERIFY(service.contains(url, kAvatarSide));
+
+  // A side with nothing cached that joined the refresh still hears about it.
+  m_server.failing = true;
+  QVERIFY(!service.avatar(url, kAvatarSide).isNull());
+  QVERIFY(service.avatar(url, kAvatarSide * 2).isNull());
+  QTRY_COMPARE_WITH_TIMEOUT(failed.count(), 1, 5000);
+  m_server.failing = false;
+  QVERIFY(service.contains(url, kAvatarSide));
+  QVERIFY(!service.contains(url, kAvatarSide * 2));
+}
+
+void AvatarServiceTest::failedDownloadIsReported() {
+  AvatarService service(cacheDirectory());
+  QSignalSpy failed(&service, &AvatarService::avatarFailed);
+  const QUrl url = avatarUrl(QStringLiteral("/static/missing.png"));
+  service.avatar(url, kAvatarSide);
+  service.avatar(url, kAvatarSide);
+  QTRY_COMPARE_WITH_TIMEOUT(failed.count(), 1, 5000);
+  QCOMPARE(failed.at(0).at(0).toUrl(), url);
+  QCOMPARE(service.stats().failures, quint64(1));
+  QVERIFY(!service.contains(url, kAvatarSide));
+}
+
+void AvatarServiceTest::largeImageDecodesAtCoveringSize() {
+  QImage large(4000, 2000, QImage::Format_RGB32);
+  large.fill(QColor(0xcc, 0x66, 0x33));
+  QByteArray bytes;
+  QBuffer buffer(&bytes);
+  buffer.open(QIODevice::WriteOnly);
+  QVERIFY(large.save(&buffer, "JPEG"));
+
+  // Covers the square without cropping on the decoder side.
+  const QImage decoded = avatarimage::decodeCovering(
+      bytes, QSize(kAvatarSide, kAvatarSide));
+  QCOMPARE(decoded.size(), QSize(kAvatarSide * 2, kAvatarSide));
+
+  const QImage circle = avatarimage::circular(decoded, kAvatarSide);
+  QCOMPARE(circle.size(), QSize(kAvatarSide, kAvatarSide));
+  QCOMPARE(circle.pixelColor(0, 0).alpha(), 0);
+  QCOMPARE(circle.pixelColor(kAvatarSide / 2, kAvatarSide / 2).alpha(), 255);
+
+  QString error;
+  QVERIFY(avatarimage::decodeCovering(QByteArray("not an image"),
+                                      QSize(kAvatarSide, kAvatarSide), &error)
+              .isNull());
+  QVERIFY(!error.isEmpty());
+}
+
+void AvatarServiceTest::poolResultArrivesOnGuiThread() {
+  QThread *workerThread = nullptr;
+  QThread *deliveryThread = nullptr;
+  QObject context;
+  avatarimage::runInPool(
+      &context,
+      [&workerThread]() {
+        workerThread = QThread::currentThread();
+        return QImage(8, 8, QImage::Format_ARGB32_Premultiplied);
+      },
+      [&deliveryThread](const QImage &) {
+        deliveryThread = QThread::currentThread();
+      });
+  QTRY_VERIFY_WITH_TIMEOUT(deliveryThread != nullptr, 5000);
+  QVERIFY(workerThread != QThread::currentThread());
+  QCOMPARE(deliveryThread, QThread::currentThread());
+
+  // A result for a destroyed context is dropped.
+  bool delivered = false;
+  auto *shortLived = new QObject;
+  avatarimage::runInPool(
+      shortLived, []() { return QImage(); },
+      [&delivered](const QImage &) { delivered = true; });
+  delete shortLived;
+  avatarimage::decodePool()->waitForDone();
+  QTest::qWait(20);
+  QVERIFY(!delivered);
+}
+
+void AvatarServiceTest::uploadEncodeShrinksAndStripsMetadata() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  // A noisy, semi-transparent PNG compresses poorly, like a phone photo.
+  QImage photo(3000, 2000, QImage::Format_ARGB32);
+  for (int y = 0; y < photo.height(); ++y) {
+    QRgb *line = reinterpret_cast<QRgb *>(photo.scanLine(y));
+    for (int x = 0; x < photo.width(); ++x) {
+      line[x] = qRgba((x * 7 + y * 3) & 0xff, (x ^ y) & 0xff, (x * y) & 0xff,
+                      x < 100 ? 0 : 255);
+    }
+  }
+  photo.setText(QStringLiteral("Location"), QStringLiteral("31.2,121.5"));
+  const QString path = dir.filePath(QStringLiteral("photo.png"));
+  QVERIFY(photo.save(path, "PNG"));
+
+  avatarimage::UploadEncodeOptions options;
+  options.maxDimension = 600;
+  options.quality = 80;
+  const avatarimage::EncodedUpload encoded =
+      avatarimage::encodeForUpload(path, options);
+  QVERIFY2(encoded.isValid(), qPrintable(encoded.error));
+  QCOMPARE(encoded.size, QSize(600, 400));
+  QCOMPARE(encoded.contentType, QStringLiteral("image/jpeg"));
+  QCOMPARE(encoded.suffix, QStringLiteral("jpg"));
+  QCOMPARE(encoded.originalBytes, QFileInfo(path).size());
+  QVERIFY(encoded.bytesSaved() > 0);
+
+  QImage uploaded;
+  QVERIFY(uploaded.loadFromData(encoded.bytes, "JPEG"));
+  QCOMPARE(uploaded.size(), QSize(600, 400));
+  QVERIFY(uploaded.textKeys().isEmpty());
+  // Transparent pixels are flattened onto white.
+  QVERIFY(uploaded.pixelColor(5, 200).lightness() > 240);
+
+  const avatarimage::EncodedUpload missing = avatarimage::encodeForUpload(
+      dir.filePath(QStringLiteral("missing.png")), options);
+  QVERIFY(!missing.isValid());
+  QVERIFY(!missing.error.isEmpty());
+}
+
+QTEST_MAIN(AvatarServiceTest)
+#include "avatarservice_test.moc"
@@ -0,0 +1,229 @@
+#include "chatmessagedelegate.h"
+#include "chatmessagemodel.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QListView>
+#include <QSignalSpy>
+#include <QString>
+#include <QtTest/QtTest>
+
+namespace {
+constexpr int kMessageCount = 5000;
+
+ChatMessage messageFor(int index) {
+  ChatMessage message;
+  message.localId = QStringLiteral("local-%1").arg(index);
+  message.messageId = QStringLiteral("m-%1").arg(index);
+  message.seq = index + 1;
+  message.sentAt = QStringLiteral("2026-01-01T08:00:00Z");
+  message.senderUsername = QStringLiteral("alice");
+  // Every seventh message is long enough to wrap.
+  message.content = index % 7 == 0
+                        ? QStringLiteral("long message %1 ").arg(index).repeated(12)
+                        : QStringLiteral("message %1").arg(index);
+  message.status = index % 2 == 0 ? ChatMessageStatus::Received
+                                  : ChatMessageStatus::Sent;
+  return message;
+}
+
+void fill(ChatMessageModel *model, int count) {
+  for (int i = 0; i < count; ++i) {
+    model->appendMessage(messageFor(i));
+  }
+}
+
+QStyleOptionViewItem optionForWidth(QListView *view, int width) {
+  QStyleOptionViewItem option;
+  option.initFrom(view);
+  option.widget = view;
+  option.rect = QRect(0, 0, width, 0);
+  return option;
+}
+} // namespace
+
+// A session window with thousands of messages: the transcript keeps plain
+// rows and the delegate only lays out what the view asks for.
+class ChatTranscriptBench : public QObject {
+  Q_OBJECT
+
+private slots:
+  void updateEmitsSingleRowChange();
+  void bubbleTextKeepsFormat();
+  void statusLinesAreNotMessages();
+  void prependShiftsLocalIdLookup();
+  void narrowerWidthWrapsTaller();
+  void repeatedSizeHintsReuseLayouts();
+  void longHistoryOpensWithBoundedCache();
+  void benchmarkColdSizeHints();
+  void benchmarkWarmSizeHints();
+};
+
+void ChatTranscriptBench::updateEmitsSingleRowChange() {
+  ChatMessageModel model;
+  fill(&model, 100);
+  QSignalSpy changed(&model, &QAbstractItemModel::dataChanged);
+
+  ChatMessage updated = *model.messageAt(41);
+  updated.status = ChatMessageStatus::Failed;
+  QVERIFY(model.updateMessage(41, updated));
+  QCOMPARE(changed.count(), 1);
+  QCOMPARE(changed.at(0).at(0).toModelIndex().row(), 41);
+  QCOMPARE(changed.at(0).at(1).toModelIndex().row(), 41);
+  QCOMPARE(model.messageAt(41)->status, ChatMessageStatus::Failed);
+  QCOMPARE(model.rowForLocalId(QStringLiteral("local-41")), 41);
+  QVERIFY(!model.updateMessage(100, updated));
+}
+
+void ChatTranscriptBench::bubbleTextKeepsFormat() {
+  ChatMessage sent = messageFor(1);
+  QVERIFY(ChatMessageModel::bubbleText(sent).endsWith(
+      QStringLiteral(" 我: message 1 [已发送] (#2)")));
+
+  ChatMessage received = messageFor(2);
+  received.senderUsername.clear();
+  QVERIFY(ChatMessageModel::bubbleText(received).endsWith(
+      QStringLiteral(" 对方: message 2")));
+
+  // A message without a time gets one when appended and keeps it; so does an
+  // unparsable one from history, and an update that carries no time.
+  ChatMessageModel model;
+  ChatMessage undated = messageFor(3);
+  undated.sentAt.clear();
+  const int row = model.appendMessage(undated);
+  QVERIFY(!model.messageAt(row)->sentAt.isEmpty());
+  ChatMessage garbled = messageFor(4);
+  garbled.sentAt = QStringLiteral("not a time");
+  model.prependMessages({garbled});
+  ChatMessage acked = *model.messageAt(1);
+  acked.sentAt.clear();
+  acked.status = ChatMessageStatus::Sent;
+  QVERIFY(model.updateMessage(1, acked));
+  const QString firstGarbled = model.index(0).data().toString();
+  const QString firstUndated = model.index(1).data().toString();
+  QVERIFY(firstUndated.endsWith(QStringLiteral(" 我: message 3 [已发送] (#4)")));
+  QTest::qWait(1100);
+  QCOMPARE(model.index(0).data().toString(), firstGarbled);
+  QCOMPARE(model.index(1).data().toString(), firstUndated);
+}
+
+void ChatTranscriptBench::statusLinesAreNotMessages() {
+  ChatMessageModel model;
+  const int row = model.appendStatusLine(QStringLiteral("连接已断开"));
+  QCOMPARE(model.index(row).data().toString(), QStringLiteral("连接已断开"));
+  QCOMPARE(model.index(row).data(ChatMessageModel::BubbleKindRole).toInt(),
+           static_cast<int>(ChatMessageModel::BubbleKind::Status));
+  QVERIFY(model.messageAt(row) == nullptr);
+  QVERIFY(!model.updateMessage(row, messageFor(0)));
+}
+
+void ChatTranscriptBench::prependShiftsLocalIdLookup() {
+  ChatMessageModel model;
+  for (int i = 10; i < 13; ++i) {
+    model.appendMessage(messageFor(i));
+  }
+  QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+
+  QVector<ChatMessage> older;
+  for (int i = 0; i < 10; ++i) {
+    older.push_back(messageFor(i));
+  }
+  model.prependMessages(older);
+  QCOMPARE(inserted.count(), 1);
+  QCOMPARE(inserted.at(0).at(1).toInt(), 0);
+  QCOMPARE(inserted.at(0).at(2).toInt(), 9);
+  QCOMPARE(model.rowCount(), 13);
+  QCOMPARE(model.messageAt(0)->messageId, QStringLiteral("m-0"));
+  QCOMPARE(model.rowForLocalId(QStringLiteral("local-10")), 10);
+  QCOMPARE(model.rowForLocalId(QStringLiteral("local-3")), 3);
+}
+
+void ChatTranscriptBench::narrowerWidthWrapsTaller() {
+  ChatMessageModel model;
+  model.appendMessage(messageFor(0));
+  QListView view;
+  ChatMessageDelegate delegate;
+  const QModelIndex index = model.index(0);
+
+  const QSize wide = delegate.sizeHint(optionForWidth(&view, 600), index);
+  const QSize narrow = delegate.sizeHint(optionForWidth(&view, 200), index);
+  QCOMPARE(wide.width(), 600);
+  QVERIFY(narrow.height() > wide.height());
+}
+
+void ChatTranscriptBench::repeatedSizeHintsReuseLayouts() {
+  ChatMessageModel model;
+  fill(&model, 200);
+  QListView view;
+  ChatMessageDelegate delegate;
+  const QStyleOptionViewItem option = optionForWidth(&view, 500);
+
+  for (int i = 0; i < model.rowCount(); ++i) {
+    delegate.sizeHint(option, model.index(i));
+  }
+  QCOMPARE(delegate.cachedLayoutCount(), 200);
+  for (int i = 0; i < model.rowCount(); ++i) {
+    delegate.sizeHint(option, model.index(i));
+  }
+  QCOMPARE(delegate.cachedLayoutCount(), 200);
+}
+
+void ChatTranscriptBench::longHistoryOpensWithBoundedCache() {
+  ChatMessageModel model;
+  fill(&model, kMessageCount);
+  QListView view;
+  ChatMessageDelegate delegate;
+  view.setModel(&model);
+  view.setItemDelegate(&delegate);
+  view.setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+  view.setResizeMode(QListView::Adjust);
+  view.setLayoutMode(QListView::Batched);
+  view.setBatchSize(200);
+  view.resize(600, 400);
+
+  QElapsedTimer timer;
+  timer.start();
+  view.show();
+  QVERIFY(QTest::qWaitForWindowExposed(&view));
+  view.scrollToBottom();
+  QCoreApplication::processEvents();
+  qInfo() << "[ChatTranscriptBench] first layout of" << kMessageCount
+          << "messages took" << timer.elapsed() << "ms, cached layouts ="
+          << delegate.cachedLayoutCount();
+  QVERIFY(delegate.cachedLayoutCount() <= 2000);
+
+  const QModelIndex last = model.index(kMessageCount - 1);
+  QVERIFY(view.visualRect(last).intersects(view.viewport()->rect()));
+}
+
+void ChatTranscriptBench::benchmarkColdSizeHints() {
+  ChatMessageModel model;
+  fill(&model, kMessageCount);
+  QListView view;
+  const QStyleOptionViewItem option = optionForWidth(&view, 600);
+  QBENCHMARK {
+    ChatMessageDelegate delegate;
+    for (int i = 0; i < kMessageCount; ++i) {
+      delegate.sizeHint(option, model.index(i));
+    }
+  }
+}
+
+void ChatTranscriptBench::benchmarkWarmSizeHints() {
+  ChatMessageModel model;
+  fill(&model, 1000);
+  QListView view;
+  ChatMessageDelegate delegate;
+  const QStyleOptionViewItem option = optionForWidth(&view, 600);
+  for (int i = 0; i < model.rowCount(); ++i) {
+    delegate.sizeHint(option, model.index(i));
+  }
+  QBENCHMARK {
+    for (int i = 0; i < model.rowCount(); ++i) {
+      delegate.sizeHint(option, model.index(i));
+    }
+  }
+}
+
+QTEST_MAIN(ChatTranscriptBench)
+#include "chattranscript_bench.moc"
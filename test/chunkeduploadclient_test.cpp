@@ -0,0 +1,342 @@
+#include "chunkeduploadclient.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QHostAddress>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QtTest/QtTest>
+
+namespace {
+constexpr qint64 kChunkSize = 64 * 1024;
+const QString kEndpointPath = QStringLiteral("/upload/chunks");
+
+QByteArray payload(qint64 size) {
+  QByteArray bytes(size, Qt::Uninitialized);
+  for (qint64 i = 0; i < size; ++i) {
+    bytes[i] = static_cast<char>((i * 31 + i / 7) & 0xff);
+  }
+  return bytes;
+}
+
+// Stand-in for the static server's resumable upload endpoint, with knobs to
+// inject the failures the client has to survive.
+class UploadStandInServer : public QObject {
+  Q_OBJECT
+
+public:
+  quint16 start() {
+    if (!m_server.listen(QHostAddress::LocalHost, 0)) {
+      return 0;
+    }
+    connect(&m_server, &QTcpServer::newConnection, this, [this]() {
+      QTcpSocket *socket = m_server.nextPendingConnection();
+      connect(socket, &QTcpSocket::readyRead, this,
+              [this, socket]() { onReadyRead(socket); });
+      connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+        m_buffers.remove(socket);
+        socket->deleteLater();
+      });
+    });
+    return m_server.serverPort();
+  }
+
+  void reset() {
+    m_uploads.clear();
+    failNextPuts = 0;
+    createStatus = 200;
+    createCount = 0;
+    queryCount = 0;
+    putCount = 0;
+    putBodyBytes = 0;
+  }
+
+  QByteArray received(const QString &uploadId) const {
+    return m_uploads.value(uploadId).data;
+  }
+  QString fileName(const QString &uploadId) const {
+    return m_uploads.value(uploadId).fileName;
+  }
+
+  // PUTs answered with 503 after keeping only the first half of the chunk.
+  int failNextPuts = 0;
+  int createStatus = 200;
+  int createCount = 0;
+  int queryCount = 0;
+  int putCount = 0;
+  qint64 putBodyBytes = 0;
+
+private:
+  struct Upload {
+    qint64 total = 0;
+    QString fileName;
+    QByteArray data;
+  };
+
+  void onReadyRead(QTcpSocket *socket) {
+    QByteArray &buffer = m_buffers[socket];
+    buffer += socket->readAll();
+    for (;;) {
+      const int headerEnd = buffer.indexOf("\r\n\r\n");
+      if (headerEnd < 0) {
+        return;
+      }
+      const QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+      const QList<QByteArray> requestLine = lines.value(0).trimmed().split(' ');
+      QHash<QByteArray, QByteArray> headers;
+      for (int i = 1; i < lines.size(); ++i) {
+        const int colon = lines.at(i).indexOf(':');
+        if (colon > 0) {
+          headers.insert(lines.at(i).left(colon).trimmed().toLower(),
+                         lines.at(i).mid(colon + 1).trimmed());
+        }
+      }
+      const int length = headers.value("content-length").toInt();
+      if (buffer.size() < headerEnd + 4 + length) {
+        return;
+      }
+      const QByteArray body = buffer.mid(headerEnd + 4, length);
+      buffer.remove(0, headerEnd + 4 + length);
+      handle(socket, requestLine.value(0), QString::fromLatin1(requestLine.value(1)),
+             headers, body);
+    }
+  }
+
+  void handle(QTcpSocket *socket, const QByteArray &method, const QString &path,
+              const QHash<QByteArray, QByteArray> &headers,
+              const QByteArray &body) {
+    if (method == "POST" && path == kEndpointPath) {
+      ++createCount;
+      if (createStatus != 200) {
+        respond(socket, createStatus, {{"ok", false}, {"message", "denied"}});
+        return;
+      }
+      const QJsonObject request = QJsonDocument::fromJson(body).object();
+      const QString uploadId = QStringLiteral("u%1").arg(createCount);
+      Upload upload;
+      upload.total = request.value("total_size").toVariant().toLongLong();
+      upload.fileName = request.value("file_name").toString();
+      m_uploads.insert(uploadId, upload);
+      respond(socket, 200, {{"ok", true}, {"upload_id", uploadId}});
+      return;
+    }
+
+    const QString uploadId = path.section(QLatin1Char('/'), 3);
+    if (!path.startsWith(kEndpointPath + QLatin1Char('/')) ||
+        !m_uploads.contains(uploadId)) {
+      respond(socket, 404, {{"ok", false}, {"message", "unknown upload"}});
+      return;
+    }
+    Upload &upload = m_uploads[uploadId];
+    if (method == "GET") {
+      ++queryCount;
+      respond(socket, 200, state(uploadId, upload));
+      return;
+    }
+
+    ++putCount;
+    putBodyBytes += body.size();
+    // "bytes a-b/total"
+    const QByteArray range = headers.value("content-range").mid(6);
+    const qint64 first = range.left(range.indexOf('-')).toLongLong();
+    if (first != upload.data.size()) {
+      QJsonObject conflict = state(uploadId, upload);
+      conflict.insert("ok", false);
+      respond(socket, 409, conflict);
+      return;
+    }
+    if (failNextPuts > 0) {
+      --failNextPuts;
+      upload.data += body.left(body.size() / 2);
+      respond(socket, 503, {{"ok", false}, {"message", "busy"}});
+      return;
+    }
+    upload.data += body;
+    respond(socket, 200, state(uploadId, upload));
+  }
+
+  QJsonObject state(const QString &uploadId, const Upload &upload) const {
+    QJsonObject obj{{"ok", true}, {"offset", upload.data.size()}};
+    const bool completed = upload.data.size() == upload.total;
+    obj.insert("completed", completed);
+    if (completed) {
+      obj.insert("file_url",
+                 QStringLiteral("/static/uploads/%1/%2").arg(uploadId, upload.fileName));
+    }
+    return obj;
+  }
+
+  void respond(QTcpSocket *socket, int status, const QJsonObject &obj) {
+    const QByteArray body = QJsonDocument(obj).toJson(QJsonDocument::Compact);
+    socket->write("HTTP/1.1 " + QByteArray::number(status) +
+                  " X\r\nContent-Type: application/json\r\nContent-Length: " +
+                  QByteArray::number(body.size()) + "\r\n\r\n" + body);
+  }
+
+  QTcpServer m_server;
+  QHash<QTcpSocket *, QByteArray> m_buffers;
+  QHash<QString, Upload> m_uploads;
+};
+} // namespace
+
+class ChunkedUploadClientTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void init();
+  void uploadsInChunksWithProgress();
+  void failedChunkResumesFromServerOffset();
+  void resumeAfterRetriesAreExhausted();
+  void clientErrorIsNotRetried();
+  void uploadsFromFile();
+
+private:
+  QUrl endpoint() const;
+  ChunkedUploadOptions options() const;
+
+  UploadStandInServer m_server;
+  quint16 m_port = 0;
+};
+
+void ChunkedUploadClientTest::initTestCase() {
+  m_port = m_server.start();
+  QVERIFY(m_port != 0);
+}
+
+void ChunkedUploadClientTest::init() { m_server.reset(); }
+
+QUrl ChunkedUploadClientTest::endpoint() const {
+  return QUrl(QStringLiteral("http://127.0.0.1:%1%2").arg(m_port).arg(kEndpointPath));
+}
+
+ChunkedUploadOptions ChunkedUploadClientTest::options() const {
+  ChunkedUploadOptions options;
+  options.chunkSize = kChunkSize;
+  options.retryDelayMs = 10;
+  return options;
+}
+
+void ChunkedUploadClientTest::uploadsInChunksWithProgress() {
+  const QByteArray data = payload(4 * kChunkSize + 123);
+  ChunkedUploadClient client;
+  client.setOptions(options());
+  QSignalSpy started(&client, &ChunkedUploadClient::started);
+  QSignalSpy progress(&client, &ChunkedUploadClient::progress);
+  QSignalSpy finished(&client, &ChunkedUploadClient::finished);
+  QSignalSpy failed(&client, &ChunkedUploadClient::failed);
+
+  QString error;
+  QVERIFY2(client.startData(endpoint(), data, QStringLiteral("a.jpg"),
+                            QStringLiteral("image/jpeg"), QJsonObject(), &error),
+           qPrintable(error));
+  QVERIFY(client.isActive());
+  QTRY_COMPARE_WITH_TIMEOUT(finished.count(), 1, 5000);
+  QCOMPARE(failed.count(), 0);
+  QCOMPARE(started.count(), 1);
+
+  const QString uploadId = started.at(0).at(0).toString();
+  QCOMPARE(m_server.received(uploadId), data);
+  QCOMPARE(m_server.putCount, 5);
+  QCOMPARE(m_server.putBodyBytes, qint64(data.size()));
+  QCOMPARE(client.state(), ChunkedUploadClient::State::Completed);
+  QCOMPARE(finished.at(0).at(0).toJsonObject().value("file_url").toString(),
+           QStringLiteral("/static/uploads/%1/a.jpg").arg(uploadId));
+
+  qint64 last = 0;
+  for (const QList<QVariant> &arguments : progress) {
+    QVERIFY(arguments.at(0).toLongLong() >= last);
+    QCOMPARE(arguments.at(1).toLongLong(), qint64(data.size()));
+    last = arguments.at(0).toLongLong();
+  }
+  QCOMPARE(last, qint64(data.size()));
+}
+
+void ChunkedUploadClientTest::failedChunkResumesFromServerOffset() {
+  const QByteArray data = payload(3 * kChunkSize);
+  ChunkedUploadClient client;
+  client.setOptions(options());
+  QSignalSpy finished(&client, &ChunkedUploadClient::finished);
+  m_server.failNextPuts = 1;
+
+  QVERIFY(client.startData(endpoint(), data, QStringLiteral("b.png"),
+                           QStringLiteral("image/png")));
+  QTRY_COMPARE_WITH_TIMEOUT(finished.count(), 1, 5000);
+  QCOMPARE(m_server.received(client.uploadId()), data);
+  QCOMPARE(m_server.queryCount, 1);
+  // Only the half the server did not keep is sent again.
+  QCOMPARE(m_server.putBodyBytes, qint64(data.size()) + kChunkSize / 2);
+}
+
+void ChunkedUploadClientTest::resumeAfterRetriesAreExhausted() {
+  const QByteArray data = payload(2 * kChunkSize + 1);
+  ChunkedUploadClient client;
+  ChunkedUploadOptions retryTwice = options();
+  retryTwice.maxRetries = 2;
+  client.setOptions(retryTwice);
+  QSignalSpy finished(&client, &ChunkedUploadClient::finished);
+  QSignalSpy failed(&client, &ChunkedUploadClient::failed);
+  m_server.failNextPuts = 3;
+
+  QVERIFY(client.startData(endpoint(), data, QStringLiteral("c.jpg"),
+                           QStringLiteral("image/jpeg")));
+  QTRY_COMPARE_WITH_TIMEOUT(failed.count(), 1, 5000);
+  QCOMPARE(failed.at(0).at(1).toInt(), 503);
+  QCOMPARE(client.state(), ChunkedUploadClient::State::Failed);
+  QCOMPARE(m_server.putCount, 3);
+  const qint64 kept = m_server.received(client.uploadId()).size();
+  QVERIFY(kept > 0);
+
+  QString error;
+  QVERIFY2(client.resume(&error), qPrintable(error));
+  QTRY_COMPARE_WITH_TIMEOUT(finished.count(), 1, 5000);
+  QCOMPARE(m_server.received(client.uploadId()), data);
+  QCOMPARE(m_server.createCount, 1);
+}
+
+void ChunkedUploadClientTest::clientErrorIsNotRetried() {
+  ChunkedUploadClient client;
+  client.setOptions(options());
+  QSignalSpy failed(&client, &ChunkedUploadClient::failed);
+  m_server.createStatus = 401;
+
+  QVERIFY(client.startData(endpoint(), payload(10), QStringLiteral("d.jpg"),
+                           QStringLiteral("image/jpeg")));
+  QTRY_COMPARE_WITH_TIMEOUT(failed.count(), 1, 5000);
+  QCOMPARE(failed.at(0).at(0).toString(), QStringLiteral("denied"));
+  QCOMPARE(failed.at(0).at(1).toInt(), 401);
+  QTest::qWait(50);
+  QCOMPARE(m_server.createCount, 1);
+
+  QString error;
+  QVERIFY(!client.startData(endpoint(), QByteArray(), QStringLiteral("e.jpg"),
+                            QStringLiteral("image/jpeg"), QJsonObject(), &error));
+  QVERIFY(!error.isEmpty());
+}
+
+void ChunkedUploadClientTest::uploadsFromFile() {
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  const QByteArray data = payload(kChunkSize * 2 + kChunkSize / 3);
+  const QString path = dir.filePath(QStringLiteral("clip.bin"));
+  QFile file(path);
+  QVERIFY(file.open(QIODevice::WriteOnly));
+  file.write(data);
+  file.close();
+
+  ChunkedUploadClient client;
+  client.setOptions(options());
+  QSignalSpy finished(&client, &ChunkedUploadClient::finished);
+  QVERIFY(client.startFile(endpoint(), path,
+                           QStringLiteral("application/octet-stream")));
+  QTRY_COMPARE_WITH_TIMEOUT(finished.count(), 1, 5000);
+  QCOMPARE(m_server.received(client.uploadId()), data);
+  QCOMPARE(m_server.fileName(client.uploadId()), QStringLiteral("clip.bin"));
+}
+
+QTEST_GUILESS_MAIN(ChunkedUploadClientTest)
+#include "chunkeduploadclient_test.moc"
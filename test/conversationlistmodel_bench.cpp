@@ -0,0 +1,296 @@
+#include "conversationlistmodel.h"
+
+#include <QSignalSpy>
+#include <QString>
+#include <QVector>
+#include <QtTest/QtTest>
+
+namespace {
+constexpr int kRowCount = 10000;
+constexpr int kUpdateCount = 1000;
+
+QString conversationIdFor(int index) {
+  return QStringLiteral("c-%1").arg(index);
+}
+
+ConversationListRow rowFor(int index) {
+  ConversationListRow row;
+  row.sessionId = QStringLiteral("s-%1").arg(index);
+  row.conversationId = conversationIdFor(index);
+  row.conversationType = index % 10 == 0 ? 2 : 1;
+  row.displayName = QStringLiteral("name%1").arg(index);
+  row.numericId = QString::number(100000 + index);
+  row.title = row.displayName;
+  row.preview = QStringLiteral("preview %1").arg(index);
+  return row;
+}
+
+// Activity-ordered rows: c-0 is the most recent.
+ConversationListRow activityRowFor(int index) {
+  ConversationListRow row = rowFor(index);
+  row.lastActivityMs = 1000000 - index;
+  return row;
+}
+
+QVector<ConversationListRow> rows(int count) {
+  QVector<ConversationListRow> result;
+  result.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    result.push_back(rowFor(i));
+  }
+  return result;
+}
+} // namespace
+
+// Row updates against a 10k-conversation list, as a new message or presence
+// change produces them.
+class ConversationListModelBench : public QObject {
+  Q_OBJECT
+
+private slots:
+  void lookupByConversationId();
+  void updateEmitsSingleRowChange();
+  void placeholderTurnsIntoFirstRow();
+  void removeKeepsLookupConsistent();
+  void repeatedUpdatesKeepRowsInPlace();
+  void resetSortsByActivity();
+  void newMessageMovesRowToTop();
+  void pinnedRowsStayAboveNewerActivity();
+  void orderedInsertLandsInPlace();
+  void repeatedBumpsMoveRowsToTop();
+  void benchmarkResetRows();
+  void benchmarkUpsertExistingRow();
+  void benchmarkBumpToTop();
+};
+
+void ConversationListModelBench::lookupByConversationId() {
+  ConversationListModel model;
+  model.resetRows(rows(kRowCount));
+  QCOMPARE(model.rowCount(), kRowCount);
+  QCOMPARE(model.rowForConversationId(conversationIdFor(4242)), 4242);
+  QCOMPARE(model.rowForConversationId(QStringLiteral(" c-7 ")), 7);
+  QCOMPARE(model.rowForConversationId(QStringLiteral("missing")), -1);
+  QCOMPARE(model.indexForConversationId(conversationIdFor(9))
+               .data(ConversationListModel::NumericIdRole)
+               .toString(),
+           QStringLiteral("100009"));
+}
+
+void ConversationListModelBench::updateEmitsSingleRowChange() {
+  ConversationListModel model;
+  model.resetRows(rows(kRowCount));
+  QSignalSpy changed(&model, &QAbstractItemModel::dataChanged);
+  QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+  QSignalSpy reset(&model, &QAbstractItemModel::modelReset);
+
+  ConversationListRow row = rowFor(500);
+  row.unreadCount = 3;
+  QCOMPARE(model.upsertRow(row), 500);
+
+  QCOMPARE(changed.count(), 1);
+  QCOMPARE(changed.at(0).at(0).toModelIndex().row(), 500);
+  QCOMPARE(changed.at(0).at(1).toModelIndex().row(), 500);
+  QCOMPARE(inserted.count(), 0);
+  QCOMPARE(reset.count(), 0);
+  QCOMPARE(model.index(500).data(ConversationListModel::UnreadCountRole).toInt(), 3);
+}
+
+void ConversationListModelBench::placeholderTurnsIntoFirstRow() {
+  ConversationListModel model;
+  model.setPlaceholderText(QStringLiteral("暂无会话"));
+  QCOMPARE(model.rowCount(), 1);
+  QCOMPARE(model.flags(model.index(0)), Qt::ItemFlags());
+
+  QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+  QCOMPARE(model.upsertRow(rowFor(0)), 0);
+  QCOMPARE(model.rowCount(), 1);
+  QCOMPARE(inserted.count(), 0);
+  QVERIFY(model.flags(model.index(0)) & Qt::ItemIsEnabled);
+
+  QCOMPARE(model.upsertRow(rowFor(1)), 1);
+  QCOMPARE(inserted.count(), 1);
+
+  QVERIFY(model.removeConversation(conversationIdFor(0)));
+  QVERIFY(model.removeConversation(conversationIdFor(1)));
+  QCOMPARE(model.rowCount(), 1);
+  QCOMPARE(model.index(0).data().toString(), QStringLiteral("暂无会话"));
+}
+
+void ConversationListModelBench::removeKeepsLookupConsistent() {
+  ConversationListModel model;
+  model.resetRows(rows(100));
+  QVERIFY(model.removeConversation(conversationIdFor(10)));
+  QVERIFY(!model.removeConversation(conversationIdFor(10)));
+  QCOMPARE(model.rowCount(), 99);
+  for (int i = 0; i < 100; ++i) {
+    const int row = model.rowForConversationId(conversationIdFor(i));
+    if (i == 10) {
+      QCOMPARE(row, -1);
+      continue;
+    }
+    QCOMPARE(model.index(row).data(ConversationListModel::ConversationIdRole)
+                 .toString(),
+             conversationIdFor(i));
+  }
+}
+
+void ConversationListModelBench::repeatedUpdatesKeepRowsInPlace() {
+  ConversationListModel model;
+  model.resetRows(rows(kRowCount));
+  for (int i = 0; i < kUpdateCount; ++i) {
+    const int index = (i * 7919) % kRowCount;
+    ConversationListRow row = rowFor(index);
+    row.unreadCount = i;
+    QCOMPARE(model.upsertRow(row), index);
+    QCOMPARE(model.index(index).data(ConversationListModel::UnreadCountRole).toInt(),
+             i);
+  }
+  QCOMPARE(model.rowCount(), kRowCount);
+}
+
+void ConversationListModelBench::resetSortsByActivity() {
+  QVector<ConversationListRow> source;
+  for (int i = 99; i >= 0; --i) {
+    source.push_back(activityRowFor(i));
+  }
+  ConversationListModel model;
+  model.setActivityOrdered(true);
+  model.resetRows(source);
+  for (int i = 0; i < 100; ++i) {
+    QCOMPARE(model.rowForConversationId(conversationIdFor(i)), i);
+  }
+}
+
+void ConversationListModelBench::newMessageMovesRowToTop() {
+  ConversationListModel model;
+  model.setActivityOrdered(true);
+  QVector<ConversationListRow> source;
+  for (int i = 0; i < kRowCount; ++i) {
+    source.push_back(activityRowFor(i));
+  }
+  model.resetRows(source);
+  QSignalSpy moved(&model, &QAbstractItemModel::rowsMoved);
+  QSignalSpy changed(&model, &QAbstractItemModel::dataChanged);
+  QSignalSpy reset(&model, &QAbstractItemModel::modelReset);
+
+  ConversationListRow row = activityRowFor(5000);
+  row.lastActivityMs = 2000000;
+  row.unreadCount = 1;
+  QCOMPARE(model.upsertRow(row), 0);
+  QCOMPARE(moved.count(), 1);
+  QCOMPARE(moved.at(0).at(1).toInt(), 5000);
+  QCOMPARE(moved.at(0).at(4).toInt(), 0);
+  QCOMPARE(changed.count(), 1);
+  QCOMPARE(reset.count(), 0);
+  QCOMPARE(model.rowForConversationId(conversationIdFor(0)), 1);
+  QCOMPARE(model.rowForConversationId(conversationIdFor(4999)), 5000);
+  QCOMPARE(model.rowForConversationId(conversationIdFor(5001)), 5001);
+
+  // An update that keeps the key, e.g. a read badge, does not move the row.
+  row.unreadCount = 0;
+  QCOMPARE(model.upsertRow(row), 0);
+  QCOMPARE(moved.count(), 1);
+
+  // Losing recency moves the row down past the rows that are now newer.
+  row.lastActivityMs = activityRowFor(10).lastActivityMs - 1;
+  QCOMPARE(model.upsertRow(row), 11);
+  QCOMPARE(moved.count(), 2);
+  QCOMPARE(moved.at(1).at(4).toInt(), 12);
+  QCOMPARE(model.rowForConversationId(conversationIdFor(10)), 10);
+  QCOMPARE(model.rowForConversationId(conversationIdFor(11)), 12);
+}
+
+void ConversationListModelBench::pinnedRowsStayAboveNewerActivity() {
+  ConversationListModel model;
+  model.setActivityOrdered(true);
+  QVector<ConversationListRow> source;
+  for (int i = 0; i < 10; ++i) {
+    source.push_back(activityRowFor(i));
+  }
+  source[7].pinned = true;
+  model.resetRows(source);
+  QCOMPARE(model.rowForConversationId(conversationIdFor(7)), 0);
+
+  ConversationListRow row = activityRowFor(9);
+  row.lastActivityMs = 2000000;
+  QCOMPARE(model.upsertRow(row), 1);
+  QCOMPARE(model.rowForConversationId(conversationIdFor(7)), 0);
+}
+
+void ConversationListModelBench::orderedInsertLandsInPlace() {
+  ConversationListModel model;
+  model.setPlaceholderText(QStringLiteral("暂无会话"));
+  model.setActivityOrdered(true);
+  QCOMPARE(model.upsertRow(activityRowFor(4)), 0);
+  QCOMPARE(model.upsertRow(activityRowFor(8)), 1);
+  QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+  QCOMPARE(model.upsertRow(activityRowFor(6)), 1);
+  QCOMPARE(inserted.count(), 1);
+  QCOMPARE(inserted.at(0).at(1).toInt(), 1);
+  QCOMPARE(model.rowForConversationId(conversationIdFor(8)), 2);
+  QCOMPARE(model.upsertRow(activityRowFor(1)), 0);
+  QCOMPARE(model.rowForConversationId(conversationIdFor(8)), 3);
+}
+
+void ConversationListModelBench::repeatedBumpsMoveRowsToTop() {
+  ConversationListModel model;
+  model.setActivityOrdered(true);
+  QVector<ConversationListRow> source;
+  for (int i = 0; i < kRowCount; ++i) {
+    source.push_back(activityRowFor(i));
+  }
+  model.resetRows(source);
+  for (int i = 0; i < kUpdateCount; ++i) {
+    const int index = (i * 7919) % kRowCount;
+    ConversationListRow row = activityRowFor(index);
+    row.lastActivityMs = 2000000 + i;
+    QCOMPARE(model.upsertRow(row), 0);
+    QCOMPARE(model.rowForConversationId(conversationIdFor(index)), 0);
+  }
+  QCOMPARE(model.rowCount(), kRowCount);
+}
+
+void ConversationListModelBench::benchmarkResetRows() {
+  const QVector<ConversationListRow> source = rows(kRowCount);
+  ConversationListModel model;
+  QBENCHMARK {
+    model.resetRows(source);
+  }
+}
+
+void ConversationListModelBench::benchmarkUpsertExistingRow() {
+  ConversationListModel model;
+  model.resetRows(rows(kRowCount));
+  QVector<ConversationListRow> updates;
+  updates.reserve(kUpdateCount);
+  for (int i = 0; i < kUpdateCount; ++i) {
+    ConversationListRow row = rowFor((i * 7919) % kRowCount);
+    row.preview = QStringLiteral("new message %1").arg(i);
+    updates.push_back(row);
+  }
+  QBENCHMARK {
+    for (const ConversationListRow &row : updates) {
+      model.upsertRow(row);
+    }
+  }
+}
+
+void ConversationListModelBench::benchmarkBumpToTop() {
+  ConversationListModel model;
+  model.setActivityOrdered(true);
+  QVector<ConversationListRow> source;
+  for (int i = 0; i < kRowCount; ++i) {
+    source.push_back(activityRowFor(i));
+  }
+  model.resetRows(source);
+  qint64 activityMs = 2000000;
+  int i = 0;
+  QBENCHMARK {
+    ConversationListRow row = activityRowFor((i++ * 7919) % kRowCount);
+    row.lastActivityMs = ++activityMs;
+    model.upsertRow(row);
+  }
+}
+
+QTEST_GUILESS_MAIN(ConversationListModelBench)
+#include "conversationlistmodel_bench.moc"
@@ -0,0 +1,197 @@
+#include "conversationstatestore.h"
+
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtTest/QtTest>
+
+namespace {
+const QString kConversation = QStringLiteral("c1");
+const QDateTime kNoon =
+    QDateTime::fromString(QStringLiteral("2026-01-01T12:00:00Z"), Qt::ISODate);
+
+int journalLines(const QString &path) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return -1;
+  }
+  int lines = 0;
+  while (!file.atEnd()) {
+    if (!file.readLine().trimmed().isEmpty()) {
+      ++lines;
+    }
+  }
+  return lines;
+}
+} // namespace
+
+class ConversationStateStoreTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void init();
+  void cleanup();
+  void incomingMessagesCountUntilRead();
+  void readMarkFromOtherDeviceIsRespected();
+  void stateSurvivesReopen();
+  void tornLineIsSkipped();
+  void serverCountOlderThanLocalIsIgnored();
+  void missedMessagesAreCountedWithoutServerCount();
+  void journalIsCompacted();
+  void unchangedStateIsNotRewritten();
+
+private:
+  QString m_path;
+  QTemporaryDir m_dir;
+  ConversationStateStore *m_store = nullptr;
+};
+
+void ConversationStateStoreTest::init() {
+  QVERIFY(m_dir.isValid());
+  m_path = m_dir.filePath(QString::fromLatin1(QTest::currentTestFunction()) +
+                          QStringLiteral(".journal"));
+  m_store = new ConversationStateStore(this);
+  QVERIFY(m_store->openAt(m_path));
+}
+
+void ConversationStateStoreTest::cleanup() {
+  delete m_store;
+  m_store = nullptr;
+}
+
+void ConversationStateStoreTest::incomingMessagesCountUntilRead() {
+  m_store->recordIncoming(kConversation, 1, QStringLiteral("a"), kNoon, false);
+  m_store->recordIncoming(kConversation, 2, QStringLiteral("b"), kNoon, false);
+  QCOMPARE(m_store->unreadCount(kConversation), 2);
+  QCOMPARE(m_store->state(kConversation).lastPreview, QStringLiteral("b"));
+
+  m_store->markRead(kConversation);
+  QCOMPARE(m_store->unreadCount(kConversation), 0);
+  QCOMPARE(m_store->state(kConversation).lastReadSeq, qint64(2));
+
+  // Messages arriving while the window is open never count.
+  m_store->recordIncoming(kConversation, 3, QStringLiteral("c"), kNoon, true);
+  QCOMPARE(m_store->unreadCount(kConversation), 0);
+  m_store->recordOutgoing(kConversation, 0, QStringLiteral("me"), kNoon);
+  QCOMPARE(m_store->state(kConversation).lastPreview, QStringLiteral("me"));
+  QCOMPARE(m_store->state(kConversation).lastSeq, qint64(3));
+}
+
+void ConversationStateStoreTest::readMarkFromOtherDeviceIsRespected() {
+  ServerConversationState server;
+  server.lastSeq = 10;
+  server.lastReadSeq = 10;
+  m_store->reconcile(kConversation, server);
+
+  // A replayed message the user already read elsewhere.
+  m_store->recordIncoming(kConversation, 9, QStringLiteral("old"), kNoon, false);
+  QCOMPARE(m_store->unreadCount(kConversation), 0);
+  m_store->recordIncoming(kConversation, 11, QStringLiteral("new"), kNoon, false);
+  QCOMPARE(m_store->unreadCount(kConversation), 1);
+
+  m_store->acknowledgeOutgoing(kConversation, 12);
+  QCOMPARE(m_store->unreadCount(kConversation), 0);
+  QCOMPARE(m_store->state(kConversation).lastReadSeq, qint64(12));
+}
+
+void ConversationStateStoreTest::stateSurvivesReopen() {
+  m_store->recordIncoming(kConversation, 5, QStringLiteral("hi"), kNoon, false);
+  m_store->recordIncoming(QStringLiteral("c2"), 7, QStringLiteral("yo"), kNoon,
+                          false);
+  m_store->remove(QStringLiteral("c2"));
+  m_store->close();
+  QCOMPARE(m_store->conversationCount(), 0);
+
+  QVERIFY(m_store->openAt(m_path));
+  QCOMPARE(m_store->conversationCount(), 1);
+  const ConversationState state = m_store->state(kConversation);
+  QCOMPARE(state.unreadCount, 1);
+  QCOMPARE(state.lastSeq, qint64(5));
+  QCOMPARE(state.lastPreview, QStringLiteral("hi"));
+  QCOMPARE(state.lastActivityAt, kNoon);
+}
+
+void ConversationStateStoreTest::tornLineIsSkipped() {
+  m_store->recordIncoming(kConversation, 1, QStringLiteral("a"), kNoon, false);
+  QVERIFY(m_store->flush());
+  m_store->close();
+  {
+    QFile file(m_path);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Append));
+    file.write("{\"id\":\"c1\",\"unread\":9");
+  }
+
+  QVERIFY(m_store->openAt(m_path));
+  QCOMPARE(m_store->unreadCount(kConversation), 1);
+  // The damaged line is gone after the rewrite on load.
+  QCOMPARE(journalLines(m_path), 1);
+}
+
+void ConversationStateStoreTest::serverCountOlderThanLocalIsIgnored() {
+  m_store->recordIncoming(kConversation, 20, QStringLiteral("a"), kNoon, false);
+  m_store->recordIncoming(kConversation, 21, QStringLiteral("b"), kNoon, false);
+
+  // A list response produced before the last two pushes.
+  ServerConversationState stale;
+  stale.lastSeq = 19;
+  stale.unreadCount = 0;
+  stale.lastPreview = QStringLiteral("older");
+  stale.lastActivityAt = kNoon.addSecs(-60);
+  m_store->reconcile(kConversation, stale);
+  QCOMPARE(m_store->unreadCount(kConversation), 2);
+  QCOMPARE(m_store->state(kConversation).lastPreview, QStringLiteral("b"));
+
+  ServerConversationState fresh;
+  fresh.lastSeq = 25;
+  fresh.unreadCount = 6;
+  fresh.lastPreview = QStringLiteral("newest");
+  fresh.lastActivityAt = kNoon.addSecs(60);
+  m_store->reconcile(kConversation, fresh);
+  QCOMPARE(m_store->unreadCount(kConversation), 6);
+  QCOMPARE(m_store->state(kConversation).lastSeq, qint64(25));
+  QCOMPARE(m_store->state(kConversation).lastPreview, QStringLiteral("newest"));
+}
+
+void ConversationStateStoreTest::missedMessagesAreCountedWithoutServerCount() {
+  m_store->recordIncoming(kConversation, 4, QStringLiteral("a"), kNoon, false);
+
+  ServerConversationState server;
+  server.lastSeq = 7;
+  m_store->reconcile(kConversation, server);
+  QCOMPARE(m_store->unreadCount(kConversation), 4);
+
+  // The same list again changes nothing.
+  m_store->reconcile(kConversation, server);
+  QCOMPARE(m_store->unreadCount(kConversation), 4);
+
+  // First sight of a conversation: without a count nothing is guessed.
+  m_store->reconcile(QStringLiteral("c2"), server);
+  QCOMPARE(m_store->unreadCount(QStringLiteral("c2")), 0);
+}
+
+void ConversationStateStoreTest::journalIsCompacted() {
+  for (int i = 1; i <= 200; ++i) {
+    m_store->recordIncoming(kConversation, i, QStringLiteral("m"), kNoon, false);
+    QVERIFY(m_store->flush());
+  }
+  QVERIFY(journalLines(m_path) < 64);
+
+  m_store->close();
+  QVERIFY(m_store->openAt(m_path));
+  QCOMPARE(m_store->unreadCount(kConversation), 200);
+}
+
+void ConversationStateStoreTest::unchangedStateIsNotRewritten() {
+  QSignalSpy changed(m_store, &ConversationStateStore::stateChanged);
+  m_store->recordIncoming(kConversation, 1, QStringLiteral("a"), kNoon, true);
+  m_store->markRead(kConversation);
+  m_store->markRead(kConversation);
+  QCOMPARE(changed.count(), 1);
+
+  // Writes are batched until the flush delay passes.
+  QCOMPARE(journalLines(m_path), -1);
+  QTRY_COMPARE(journalLines(m_path), 1);
+}
+
+QTEST_GUILESS_MAIN(ConversationStateStoreTest)
+#include "conversationstatestore_test.moc"
@@ -0,0 +1,267 @@
+#include "messageoutbox.h"
+#include "websocketclient.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QHostAddress>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QWebSocket>
+#include <QWebSocketServer>
+#include <QtTest/QtTest>
+
+namespace {
+const QString kConversation = QStringLiteral("c1");
+
+// Records every MESSAGE/SEND frame. When acking, the content picks the
+// answer: "transient" gets a not-logged-in error, "permanent" a too-large
+// error, anything else an ack.
+class SendStandInServer : public QObject {
+  Q_OBJECT
+
+public:
+  quint16 start() {
+    m_server = new QWebSocketServer(QStringLiteral("send-stand-in"),
+                                    QWebSocketServer::NonSecureMode, this);
+    if (!m_server->listen(QHostAddress::LocalHost, 0)) {
+      return 0;
+    }
+    connect(m_server, &QWebSocketServer::newConnection, this, [this]() {
+      QWebSocket *socket = m_server->nextPendingConnection();
+      connect(socket, &QWebSocket::textMessageReceived, socket,
+              [this, socket](const QString &message) { reply(socket, message); });
+      connect(socket, &QWebSocket::disconnected, socket, &QObject::deleteLater);
+    });
+    return m_server->serverPort();
+  }
+
+  bool ack = false;
+  QStringList received;
+
+private:
+  void reply(QWebSocket *socket, const QString &message) {
+    const QJsonObject request = QJsonDocument::fromJson(message.toUtf8()).object();
+    if (request.value("type").toString() != QLatin1String("MESSAGE") ||
+        request.value("action").toString() != QLatin1String("SEND")) {
+      return;
+    }
+    received.push_back(request.value("request_id").toString());
+    if (!ack) {
+      return;
+    }
+    const QString content = request.value("data").toObject().value("content").toString();
+    int code = 0;
+    if (content == QLatin1String("transient")) {
+      code = 2001;
+    } else if (content == QLatin1String("permanent")) {
+      code = 4002;
+    }
+    QJsonObject data;
+    data.insert("ok", code == 0);
+    QJsonObject response;
+    response.insert("type", "MESSAGE");
+    response.insert("action", "SEND");
+    response.insert("request_id", request.value("request_id"));
+    response.insert("code", code);
+    response.insert("data", data);
+    socket->sendTextMessage(
+        QString::fromUtf8(QJsonDocument(response).toJson(QJsonDocument::Compact)));
+  }
+
+  QWebSocketServer *m_server = nullptr;
+};
+
+OutboxEntry entryFor(const QString &requestId,
+                     const QString &content = QStringLiteral("hello")) {
+  OutboxEntry entry;
+  entry.requestId = requestId;
+  entry.conversationId = kConversation;
+  entry.content = content;
+  entry.createdAt = QStringLiteral("2026-01-01T12:00:00Z");
+  return entry;
+}
+
+QStringList requestIds(const QVector<OutboxEntry> &entries) {
+  QStringList ids;
+  for (const OutboxEntry &entry : entries) {
+    ids.push_back(entry.requestId);
+  }
+  return ids;
+}
+} // namespace
+
+class MessageOutboxTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void cleanupTestCase();
+  void init();
+  void cleanup();
+  void entriesSurviveReload();
+  void onlyAcksAndPermanentErrorsSettle();
+  void replayDoesNotSendTwice();
+  void fullQueueRejectsSubmit();
+  void journalIsCompacted();
+
+private:
+  void reconnect();
+  QString journalPath() const;
+
+  SendStandInServer m_server;
+  QUrl m_url;
+  QString m_userId;
+  MessageOutbox *m_outbox = nullptr;
+};
+
+void MessageOutboxTest::initTestCase() {
+  QStandardPaths::setTestModeEnabled(true);
+  const quint16 port = m_server.start();
+  QVERIFY(port != 0);
+  m_url = QUrl(QStringLiteral("ws://127.0.0.1:%1").arg(port));
+  websocketclient::instance()->open(m_url);
+  QTRY_VERIFY_WITH_TIMEOUT(websocketclient::instance()->isConnected(), 5000);
+}
+
+void MessageOutboxTest::cleanupTestCase() {
+  websocketclient::instance()->close();
+}
+
+void MessageOutboxTest::init() {
+  m_userId = QString::fromLatin1(QTest::currentTestFunction());
+  QFile::remove(journalPath());
+  m_server.ack = false;
+  m_server.received.clear();
+  m_outbox = new MessageOutbox(websocketclient::instance(), this);
+  m_outbox->setFlushDelayMs(0);
+  QVERIFY(m_outbox->loadForUser(m_userId));
+}
+
+void MessageOutboxTest::cleanup() {
+  delete m_outbox;
+  m_outbox = nullptr;
+  // Frames left over from one test must not reach the next.
+  reconnect();
+}
+
+void MessageOutboxTest::reconnect() {
+  websocketclient *client = websocketclient::instance();
+  client->close();
+  QTRY_VERIFY_WITH_TIMEOUT(!client->isConnected(), 5000);
+  client->open(m_url);
+  QTRY_VERIFY_WITH_TIMEOUT(client->isConnected(), 5000);
+}
+
+QString MessageOutboxTest::journalPath() const {
+  return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+         QStringLiteral("/outbox/%1.journal").arg(m_userId);
+}
+
+void MessageOutboxTest::entriesSurviveReload() {
+  for (const QString &id : {QStringLiteral("r1"), QStringLiteral("r2"),
+                            QStringLiteral("r3")}) {
+    QVERIFY(m_outbox->submit(entryFor(id)));
+  }
+  QTRY_COMPARE_WITH_TIMEOUT(m_server.received.size(), 3, 5000);
+  m_outbox->clear();
+  QCOMPARE(m_outbox->pendingCount(), 0);
+
+  // A fresh instance stands in for the next start of the client.
+  MessageOutbox restarted(websocketclient::instance());
+  QVERIFY(restarted.loadForUser(m_userId));
+  QCOMPARE(restarted.pendingCount(), 3);
+  QCOMPARE(requestIds(restarted.entriesForConversation(kConversation)),
+           QStringList({QStringLiteral("r1"), QStringLiteral("r2"),
+                        QStringLiteral("r3")}));
+}
+
+void MessageOutboxTest::onlyAcksAndPermanentErrorsSettle() {
+  m_server.ack = true;
+  QSignalSpy completed(m_outbox, &MessageOutbox::entryCompleted);
+  QVERIFY(m_outbox->submit(entryFor(QStringLiteral("ok"))));
+  QVERIFY(m_outbox->submit(entryFor(QStringLiteral("transient"),
+                                    QStringLiteral("transient"))));
+  QVERIFY(m_outbox->submit(entryFor(QStringLiteral("permanent"),
+                                    QStringLiteral("permanent"))));
+
+  QTRY_COMPARE_WITH_TIMEOUT(completed.count(), 2, 5000);
+  QTRY_COMPARE(m_server.received.size(), 3);
+  QTest::qWait(50);
+  QCOMPARE(m_outbox->pendingCount(), 1);
+  QVERIFY(m_outbox->contains(QStringLiteral("transient")));
+
+  m_outbox->clear();
+  QVERIFY(m_outbox->loadForUser(m_userId));
+  QCOMPARE(requestIds(m_outbox->entriesForConversation(kConversation)),
+           QStringList{QStringLiteral("transient")});
+}
+
+void MessageOutboxTest::replayDoesNotSendTwice() {
+  QVERIFY(m_outbox->submit(entryFor(QStringLiteral("a"))));
+  QVERIFY(m_outbox->submit(entryFor(QStringLiteral("b"))));
+  QTRY_COMPARE_WITH_TIMEOUT(m_server.received.size(), 2, 5000);
+
+  // Already written on this connection: a resume that did not drop the link
+  // sends nothing again.
+  m_outbox->replayPending();
+  m_outbox->replayPending();
+  QTest::qWait(100);
+  QCOMPARE(m_server.received.size(), 2);
+
+  // On a new connection each entry goes out exactly once more.
+  reconnect();
+  m_outbox->replayPending();
+  m_outbox->replayPending();
+  QTRY_COMPARE_WITH_TIMEOUT(m_server.received.size(), 4, 5000);
+  QTest::qWait(100);
+  QCOMPARE(m_server.received.size(), 4);
+  QCOMPARE(m_server.received.count(QStringLiteral("a")), 2);
+  QCOMPARE(m_server.received.count(QStringLiteral("b")), 2);
+}
+
+void MessageOutboxTest::fullQueueRejectsSubmit() {
+  websocketclient *client = websocketclient::instance();
+  client->close();
+  QTRY_VERIFY_WITH_TIMEOUT(!client->isConnected(), 5000);
+
+  // The socket is down, so every frame waits in the outbound queue.
+  int accepted = 0;
+  QString error;
+  while (m_outbox->submit(entryFor(QStringLiteral("q%1").arg(accepted)), &error)) {
+    ++accepted;
+    QVERIFY(accepted <= 10000);
+  }
+  QCOMPARE(error, QStringLiteral("outbound queue is full"));
+  QCOMPARE(client->outboundQueueSize(), accepted);
+  QCOMPARE(m_outbox->pendingCount(), accepted);
+  QVERIFY(!m_outbox->contains(QStringLiteral("q%1").arg(accepted)));
+
+  // Rejected submissions are not persisted either.
+  m_outbox->clear();
+  QVERIFY(m_outbox->loadForUser(m_userId));
+  QCOMPARE(m_outbox->pendingCount(), accepted);
+}
+
+void MessageOutboxTest::journalIsCompacted() {
+  // One flush at the end sees every submit and settle record at once.
+  m_outbox->setFlushDelayMs(60 * 1000);
+  m_server.ack = true;
+  QSignalSpy completed(m_outbox, &MessageOutbox::entryCompleted);
+  constexpr int kMessages = 100;
+  for (int i = 0; i < kMessages; ++i) {
+    QVERIFY(m_outbox->submit(entryFor(QStringLiteral("m%1").arg(i))));
+  }
+  QTRY_COMPARE_WITH_TIMEOUT(completed.count(), kMessages, 5000);
+  QVERIFY(m_outbox->flush());
+
+  // Every entry was settled, so the rewrite leaves nothing behind.
+  QCOMPARE(QFileInfo(journalPath()).size(), qint64(0));
+  m_outbox->clear();
+  QVERIFY(m_outbox->loadForUser(m_userId));
+  QCOMPARE(m_outbox->pendingCount(), 0);
+}
+
+QTEST_MAIN(MessageOutboxTest)
+#include "messageoutbox_test.moc"
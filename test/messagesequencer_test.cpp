@@ -0,0 +1,220 @@
+#include "messagesequencer.h"
+
+#include <QSignalSpy>
+#include <QtTest/QtTest>
+
+#include <memory>
+
+namespace {
+const QString kConversation = QStringLiteral("c1");
+
+StoredMessage messageFor(qint64 seq) {
+  StoredMessage message;
+  message.conversationId = kConversation;
+  message.messageId = QStringLiteral("m-%1").arg(seq);
+  message.seq = seq;
+  message.content = QStringLiteral("message %1").arg(seq);
+  return message;
+}
+
+QList<qint64> deliveredSeqs(const QSignalSpy &spy) {
+  QList<qint64> seqs;
+  for (const QList<QVariant> &args : spy) {
+    const auto messages = args.at(1).value<QVector<StoredMessage>>();
+    for (const StoredMessage &message : messages) {
+      seqs.push_back(message.seq);
+    }
+  }
+  return seqs;
+}
+} // namespace
+
+class MessageSequencerTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void init();
+  void inOrderMessagesPassStraightThrough();
+  void duplicatesAreDropped();
+  void shortReorderNeedsNoFetch();
+  void gapIsFilledBySingleRangedFetch();
+  void unavailableSeqsAreSkipped();
+  void fetchTimeoutReleasesBufferedMessages();
+  void abandonedFetchesAreReported();
+  void extendedFetchOutlivesFirstDeadline();
+  void ownAcksDoNotLookLikeGaps();
+  void seededWatermarkDropsKnownHistory();
+
+private:
+  MessageSequencer *m_sequencer = nullptr;
+  std::unique_ptr<QSignalSpy> m_ready;
+  std::unique_ptr<QSignalSpy> m_fetches;
+};
+
+void MessageSequencerTest::init() {
+  qRegisterMetaType<QVector<StoredMessage>>();
+  m_ready.reset();
+  m_fetches.reset();
+  delete m_sequencer;
+  m_sequencer = new MessageSequencer(this);
+  m_sequencer->setGapGraceMs(20);
+  m_sequencer->setFetchTimeoutMs(200);
+  m_ready = std::make_unique<QSignalSpy>(m_sequencer,
+                                         &MessageSequencer::messagesReady);
+  m_fetches = std::make_unique<QSignalSpy>(m_sequencer,
+                                           &MessageSequencer::fetchRequested);
+}
+
+void MessageSequencerTest::inOrderMessagesPassStraightThrough() {
+  for (qint64 seq = 10; seq < 15; ++seq) {
+    QVERIFY(m_sequencer->accept(messageFor(seq)));
+  }
+  QCOMPARE(m_ready->count(), 5);
+  QCOMPARE(deliveredSeqs(*m_ready), QList<qint64>({10, 11, 12, 13, 14}));
+  QCOMPARE(m_sequencer->deliveredSeq(kConversation), qint64(14));
+}
+
+void MessageSequencerTest::duplicatesAreDropped() {
+  QVERIFY(m_sequencer->accept(messageFor(1)));
+  QVERIFY(m_sequencer->accept(messageFor(3)));
+  QVERIFY(!m_sequencer->accept(messageFor(1)));
+  QVERIFY(!m_sequencer->accept(messageFor(3)));
+  QVERIFY(m_sequencer->accept(messageFor(2)));
+  QVERIFY(!m_sequencer->accept(messageFor(2)));
+  QCOMPARE(deliveredSeqs(*m_ready), QList<qint64>({1, 2, 3}));
+  QCOMPARE(m_sequencer->stats().duplicates, quint64(3));
+}
+
+void MessageSequencerTest::shortReorderNeedsNoFetch() {
+  QVERIFY(m_sequencer->accept(messageFor(1)));
+  QVERIFY(m_sequencer->accept(messageFor(4)));
+  QVERIFY(m_sequencer->accept(messageFor(3)));
+  QCOMPARE(m_sequencer->bufferedCount(kConversation), 2);
+  QVERIFY(m_sequencer->accept(messageFor(2)));
+  QCOMPARE(deliveredSeqs(*m_ready), QList<qint64>({1, 2, 3, 4}));
+  QCOMPARE(m_ready->count(), 2);
+
+  QTest::qWait(60);
+  QCOMPARE(m_fetches->count(), 0);
+}
+
+void MessageSequencerTest::gapIsFilledBySingleRangedFetch() {
+  QVERIFY(m_sequencer->accept(messageFor(1)));
+  // A reconnect lost 2..5 and 7; 6 and 8 arrived.
+  QVERIFY(m_sequencer->accept(messageFor(6)));
+  QVERIFY(m_sequencer->accept(messageFor(8)));
+  QTRY_COMPARE(m_fetches->count(), 1);
+  QCOMPARE(m_fetches->at(0).at(1).toLongLong(), qint64(1));
+  QCOMPARE(m_fetches->at(0).at(2).toLongLong(), qint64(8));
+  QVERIFY(m_sequencer->isFetching(kConversation));
+
+  // Pushes replayed during the fetch still count as duplicates.
+  QVERIFY(!m_sequencer->accept(messageFor(6)));
+
+  m_sequencer->completeFetch(kConversation, {messageFor(2), messageFor(3),
+                                             messageFor(4), messageFor(5),
+                                             messageFor(6), messageFor(7)});
+  QCOMPARE(deliveredSeqs(*m_ready), QList<qint64>({1, 2, 3, 4, 5, 6, 7, 8}));
+  QCOMPARE(m_sequencer->bufferedCount(kConversation), 0);
+  QVERIFY(!m_sequencer->isFetching(kConversation));
+  QTest::qWait(60);
+  QCOMPARE(m_fetches->count(), 1);
+}
+
+void MessageSequencerTest::unavailableSeqsAreSkipped() {
+  QVERIFY(m_sequencer->accept(messageFor(1)));
+  QVERIFY(m_sequencer->accept(messageFor(5)));
+  QTRY_COMPARE(m_fetches->count(), 1);
+
+  // The server only still has seq 3.
+  m_sequencer->completeFetch(kConversation, {messageFor(3)});
+  QCOMPARE(deliveredSeqs(*m_ready), QList<qint64>({1, 3, 5}));
+  QCOMPARE(m_sequencer->stats().skippedSeqs, quint64(2));
+  QVERIFY(m_sequencer->accept(messageFor(6)));
+  QCOMPARE(deliveredSeqs(*m_ready).constLast(), qint64(6));
+}
+
+void MessageSequencerTest::fetchTimeoutReleasesBufferedMessages() {
+  QVERIFY(m_sequencer->accept(messageFor(1)));
+  QVERIFY(m_sequencer->accept(messageFor(3)));
+  QTRY_COMPARE(m_fetches->count(), 1);
+  QTRY_COMPARE(deliveredSeqs(*m_ready), QList<qint64>({1, 3}));
+  QVERIFY(!m_sequencer->isFetching(kConversation));
+}
+
+void MessageSequencerTest::abandonedFetchesAreReported() {
+  QSignalSpy abandoned(m_sequencer, &MessageSequencer::fetchAbandoned);
+  QVERIFY(m_sequencer->accept(messageFor(1)));
+  QVERIFY(m_sequencer->accept(messageFor(3)));
+  QTRY_COMPARE(m_fetches->count(), 1);
+  QTRY_COMPARE(abandoned.count(), 1);
+  QCOMPARE(abandoned.at(0).at(0).toString(), kConversation);
+
+  // An answered fetch is not abandoned; one in flight at clear() is.
+  QVERIFY(m_sequencer->accept(messageFor(5)));
+  QTRY_COMPARE(m_fetches->count(), 2);
+  m_sequencer->completeFetch(kConversation, {messageFor(4)});
+  QVERIFY(m_sequencer->accept(messageFor(7)));
+  QTRY_COMPARE(m_fetches->count(), 3);
+  m_sequencer->clear();
+  QCOMPARE(abandoned.count(), 2);
+  QTest::qWait(250);
+  QCOMPARE(abandoned.count(), 2);
+}
+
+void MessageSequencerTest::extendedFetchOutlivesFirstDeadline() {
+  QSignalSpy abandoned(m_sequencer, &MessageSequencer::fetchAbandoned);
+  QVERIFY(m_sequencer->accept(messageFor(1)));
+  QVERIFY(m_sequencer->accept(messageFor(3)));
+  QTRY_COMPARE(m_fetches->count(), 1);
+
+  // Each page restarts the 200 ms deadline, so paging may run past it.
+  for (int page = 0; page < 3; ++page) {
+    QTest::qWait(120);
+    m_sequencer->extendFetch(kConversation);
+  }
+  QVERIFY(m_sequencer->isFetching(kConversation));
+  QCOMPARE(abandoned.count(), 0);
+  m_sequencer->completeFetch(kConversation, {messageFor(2)});
+  QCOMPARE(deliveredSeqs(*m_ready), QList<qint64>({1, 2, 3}));
+  QCOMPARE(m_sequencer->stats().skippedSeqs, quint64(0));
+
+  // Without another page the deadline still applies.
+  QVERIFY(m_sequencer->accept(messageFor(5)));
+  QTRY_COMPARE(m_fetches->count(), 2);
+  m_sequencer->extendFetch(kConversation);
+  QTRY_COMPARE(abandoned.count(), 1);
+  QVERIFY(!m_sequencer->isFetching(kConversation));
+}
+
+void MessageSequencerTest::ownAcksDoNotLookLikeGaps() {
+  QVERIFY(m_sequencer->accept(messageFor(1)));
+  StoredMessage own = messageFor(2);
+  own.content.clear();
+  QVERIFY(m_sequencer->acceptOwn(own));
+  QVERIFY(m_sequencer->accept(messageFor(3)));
+
+  // An ack overtaken by the next push closes the hole as well.
+  QVERIFY(m_sequencer->accept(messageFor(5)));
+  QVERIFY(m_sequencer->acceptOwn(messageFor(4)));
+
+  QCOMPARE(deliveredSeqs(*m_ready), QList<qint64>({1, 3, 5}));
+  QTest::qWait(60);
+  QCOMPARE(m_fetches->count(), 0);
+}
+
+void MessageSequencerTest::seededWatermarkDropsKnownHistory() {
+  m_sequencer->setDeliveredSeq(kConversation, 40);
+  QVERIFY(m_sequencer->isTracking(kConversation));
+  QVERIFY(!m_sequencer->accept(messageFor(40)));
+  QVERIFY(m_sequencer->accept(messageFor(41)));
+  QCOMPARE(deliveredSeqs(*m_ready), QList<qint64>({41}));
+
+  // Messages without a seq cannot be ordered and pass through.
+  StoredMessage unsequenced = messageFor(0);
+  QVERIFY(m_sequencer->accept(unsequenced));
+  QCOMPARE(m_ready->count(), 2);
+}
+
+QTEST_GUILESS_MAIN(MessageSequencerTest)
+#include "messagesequencer_test.moc"
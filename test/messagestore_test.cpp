@@ -0,0 +1,215 @@
+#include "messagestore.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QtTest/QtTest>
+
+namespace {
+constexpr int kColdOpenMessageCount = 20000;
+constexpr int kPageSize = 50;
+
+StoredMessage messageFor(const QString &conversationId, qint64 seq) {
+  StoredMessage message;
+  message.conversationId = conversationId;
+  message.messageId = QStringLiteral("m-%1").arg(seq);
+  message.seq = seq;
+  message.content = QStringLiteral("message %1").arg(seq);
+  message.sentAt = QStringLiteral("2026-01-01T08:00:00Z");
+  message.senderUserId = QStringLiteral("7");
+  message.senderUsername = QStringLiteral("alice");
+  return message;
+}
+
+QList<qint64> seqsOf(const QVector<StoredMessage> &page) {
+  QList<qint64> seqs;
+  for (const StoredMessage &message : page) {
+    seqs.push_back(message.seq);
+  }
+  return seqs;
+}
+} // namespace
+
+class MessageStoreTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void init();
+  void cleanup();
+  void pagesAreOldestFirst();
+  void duplicatesAreNotWritten();
+  void reopenRebuildsIndexes();
+  void tornTailIsCutOff();
+  void messagesWithoutSeqAreRejected();
+  void coldOpenReadsNewestPage();
+  void benchmarkPageBefore();
+
+private:
+  QString logFile(const QString &conversationId) const;
+  void fillBigConversation();
+
+  QTemporaryDir m_dir;
+  QString m_root;
+};
+
+void MessageStoreTest::init() {
+  QVERIFY(m_dir.isValid());
+  m_root = m_dir.filePath(QString::fromLatin1(QTest::currentTestFunction()));
+  QVERIFY(MessageStore::instance()->openAt(m_root));
+}
+
+void MessageStoreTest::cleanup() { MessageStore::instance()->close(); }
+
+QString MessageStoreTest::logFile(const QString &conversationId) const {
+  return m_root + QStringLiteral("/%1.log").arg(
+                            QString::fromLatin1(conversationId.toUtf8().toHex()));
+}
+
+void MessageStoreTest::pagesAreOldestFirst() {
+  MessageStore *store = MessageStore::instance();
+  for (qint64 seq = 1; seq <= 120; ++seq) {
+    QVERIFY(store->append(messageFor(QStringLiteral("c1"), seq)));
+  }
+  QVERIFY(store->append(messageFor(QStringLiteral("c2"), 1)));
+
+  const QVector<StoredMessage> newest = store->newestPage(QStringLiteral("c1"), 50);
+  QCOMPARE(newest.size(), 50);
+  QCOMPARE(newest.constFirst().seq, qint64(71));
+  QCOMPARE(newest.constLast().seq, qint64(120));
+  QCOMPARE(newest.constLast().content, QStringLiteral("message 120"));
+  QCOMPARE(newest.constLast().senderUsername, QStringLiteral("alice"));
+  QCOMPARE(newest.constLast().conversationId, QStringLiteral("c1"));
+
+  const QVector<StoredMessage> older =
+      store->pageBefore(QStringLiteral("c1"), newest.constFirst().seq, 50);
+  QCOMPARE(older.constFirst().seq, qint64(21));
+  QCOMPARE(older.constLast().seq, qint64(70));
+  const QVector<StoredMessage> oldest =
+      store->pageBefore(QStringLiteral("c1"), older.constFirst().seq, 50);
+  QCOMPARE(oldest.size(), 20);
+  QCOMPARE(oldest.constFirst().seq, qint64(1));
+  QVERIFY(store->pageBefore(QStringLiteral("c1"), 1, 50).isEmpty());
+
+  QCOMPARE(store->messageCount(QStringLiteral("c2")), 1);
+  QCOMPARE(store->newestSeq(QStringLiteral("c1")), qint64(120));
+  StoredMessage found;
+  QVERIFY(store->findByMessageId(QStringLiteral("c1"), QStringLiteral("m-33"), &found));
+  QCOMPARE(found.seq, qint64(33));
+  QVERIFY(!store->findByMessageId(QStringLiteral("c2"), QStringLiteral("m-33"), &found));
+}
+
+void MessageStoreTest::duplicatesAreNotWritten() {
+  MessageStore *store = MessageStore::instance();
+  QVERIFY(store->append(messageFor(QStringLiteral("c1"), 1)));
+  const qint64 size = QFileInfo(logFile(QStringLiteral("c1"))).size();
+
+  // Same message again, and a different message_id reusing the seq.
+  QVERIFY(store->append(messageFor(QStringLiteral("c1"), 1)));
+  StoredMessage sameSeq = messageFor(QStringLiteral("c1"), 1);
+  sameSeq.messageId = QStringLiteral("other");
+  QVERIFY(store->append(sameSeq));
+
+  QCOMPARE(store->messageCount(QStringLiteral("c1")), 1);
+  QCOMPARE(QFileInfo(logFile(QStringLiteral("c1"))).size(), size);
+}
+
+void MessageStoreTest::reopenRebuildsIndexes() {
+  MessageStore *store = MessageStore::instance();
+  // Arrival order is not seq order.
+  for (qint64 seq : {3, 1, 5, 2, 4}) {
+    QVERIFY(store->append(messageFor(QStringLiteral("c1"), seq)));
+  }
+  QCOMPARE(seqsOf(store->newestPage(QStringLiteral("c1"), 10)),
+           QList<qint64>({1, 2, 3, 4, 5}));
+
+  QVERIFY(store->openAt(m_root));
+  QCOMPARE(store->messageCount(QStringLiteral("c1")), 5);
+  QCOMPARE(seqsOf(store->newestPage(QStringLiteral("c1"), 3)),
+           QList<qint64>({3, 4, 5}));
+  QCOMPARE(seqsOf(store->pageBefore(QStringLiteral("c1"), 3, 10)),
+           QList<qint64>({1, 2}));
+  QVERIFY(store->append(messageFor(QStringLiteral("c1"), 4)));
+  QCOMPARE(store->messageCount(QStringLiteral("c1")), 5);
+}
+
+void MessageStoreTest::tornTailIsCutOff() {
+  MessageStore *store = MessageStore::instance();
+  for (qint64 seq = 1; seq <= 3; ++seq) {
+    QVERIFY(store->append(messageFor(QStringLiteral("c1"), seq)));
+  }
+  const qint64 fullSize = QFileInfo(logFile(QStringLiteral("c1"))).size();
+  store->close();
+
+  // Chop the last record in half, as a crash mid-append would.
+  QFile file(logFile(QStringLiteral("c1")));
+  QVERIFY(file.open(QIODevice::ReadWrite));
+  QVERIFY(file.resize(fullSize - 10));
+  file.close();
+
+  QVERIFY(store->openAt(m_root));
+  QCOMPARE(seqsOf(store->newestPage(QStringLiteral("c1"), 10)),
+           QList<qint64>({1, 2}));
+  QVERIFY(store->append(messageFor(QStringLiteral("c1"), 3)));
+  QVERIFY(store->append(messageFor(QStringLiteral("c1"), 4)));
+
+  QVERIFY(store->openAt(m_root));
+  QCOMPARE(seqsOf(store->newestPage(QStringLiteral("c1"), 10)),
+           QList<qint64>({1, 2, 3, 4}));
+}
+
+void MessageStoreTest::messagesWithoutSeqAreRejected() {
+  MessageStore *store = MessageStore::instance();
+  StoredMessage pending = messageFor(QStringLiteral("c1"), 0);
+  QString error;
+  QVERIFY(!store->append(pending, &error));
+  QVERIFY(!error.isEmpty());
+
+  StoredMessage noConversation = messageFor(QString(), 1);
+  QVERIFY(!store->append(noConversation));
+
+  store->close();
+  QVERIFY(!store->append(messageFor(QStringLiteral("c1"), 1), &error));
+  QVERIFY(store->newestPage(QStringLiteral("c1"), 10).isEmpty());
+}
+
+void MessageStoreTest::fillBigConversation() {
+  MessageStore *store = MessageStore::instance();
+  for (qint64 seq = 1; seq <= kColdOpenMessageCount; ++seq) {
+    QVERIFY(store->append(messageFor(QStringLiteral("big"), seq)));
+  }
+}
+
+void MessageStoreTest::coldOpenReadsNewestPage() {
+  fillBigConversation();
+  MessageStore *store = MessageStore::instance();
+
+  // A fresh store has no open logs, like the first window after login.
+  QVERIFY(store->openAt(m_root));
+  const QVector<StoredMessage> page =
+      store->newestPage(QStringLiteral("big"), kPageSize);
+  QCOMPARE(page.size(), kPageSize);
+  QCOMPARE(page.constFirst().seq, qint64(kColdOpenMessageCount - kPageSize + 1));
+  QCOMPARE(page.constLast().seq, qint64(kColdOpenMessageCount));
+
+  QBENCHMARK {
+    store->openAt(m_root);
+    store->newestPage(QStringLiteral("big"), kPageSize);
+  }
+}
+
+void MessageStoreTest::benchmarkPageBefore() {
+  fillBigConversation();
+  MessageStore *store = MessageStore::instance();
+  const QVector<StoredMessage> page = store->pageBefore(
+      QStringLiteral("big"), kColdOpenMessageCount / 2, kPageSize);
+  QCOMPARE(page.size(), kPageSize);
+  QCOMPARE(page.constLast().seq, qint64(kColdOpenMessageCount / 2 - 1));
+
+  QBENCHMARK {
+    store->pageBefore(QStringLiteral("big"), kColdOpenMessageCount / 2, kPageSize);
+  }
+}
+
+QTEST_GUILESS_MAIN(MessageStoreTest)
+#include "messagestore_test.moc"
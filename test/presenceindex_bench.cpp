@@ -0,0 +1,279 @@
+#include "conversationlistmanager.h"
+#include "friendlistmanager.h"
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QString>
+#include <QVector>
+#include <QtTest/QtTest>
+
+namespace {
+constexpr int kEntryCount = 5000;
+constexpr int kPresenceEventCount = 10000;
+// One event in this many names a user that is not in the list.
+constexpr int kUnknownEvery = 10;
+
+struct PresenceEvent {
+  QString userId;
+  QString numericId;
+  bool isOnline = false;
+};
+
+QString userIdFor(int index) {
+  return QStringLiteral("user-%1").arg(index);
+}
+
+QString numericIdFor(int index) {
+  return QString::number(100000 + index);
+}
+
+QJsonObject friendListPayload() {
+  QJsonArray friends;
+  for (int i = 0; i < kEntryCount; ++i) {
+    QJsonObject item;
+    item.insert("user_id", userIdFor(i));
+    item.insert("numeric_id", numericIdFor(i));
+    item.insert("username", QStringLiteral("name%1").arg(i));
+    item.insert("is_online", false);
+    friends.append(item);
+  }
+  QJsonObject data;
+  data.insert("friends", friends);
+  return data;
+}
+
+QJsonObject conversationListPayload() {
+  QJsonArray conversations;
+  for (int i = 0; i < kEntryCount; ++i) {
+    QJsonObject item;
+    item.insert("conversation_id", QStringLiteral("c-%1").arg(i));
+    item.insert("conversation_type", 1);
+    item.insert("peer_user_id", userIdFor(i));
+    item.insert("peer_numeric_id", numericIdFor(i));
+    item.insert("peer_username", QStringLiteral("name%1").arg(i));
+    conversations.append(item);
+  }
+  QJsonObject data;
+  data.insert("conversations", conversations);
+  return data;
+}
+
+QVector<PresenceEvent> presenceEvents() {
+  QVector<PresenceEvent> events;
+  events.reserve(kPresenceEventCount);
+  for (int i = 0; i < kPresenceEventCount; ++i) {
+    // Stride through the list so hits land everywhere, not just at the front.
+    const int index = (i * 7919) % (kEntryCount + kEntryCount / kUnknownEvery);
+    PresenceEvent event;
+    event.userId = userIdFor(index);
+    // Half of the broadcasts only carry one of the two ids.
+    event.numericId = (i % 2 == 0) ? numericIdFor(index) : QString();
+    event.isOnline = (i % 3) != 0;
+    events.push_back(event);
+  }
+  return events;
+}
+
+QList<friendlist::FriendItem> friendItems(
+    const friendlist::FriendListManager &manager) {
+  QList<friendlist::FriendItem> items;
+  for (const friendlist::FriendRecord &record : manager.friends()) {
+    items.push_back(*record);
+  }
+  return items;
+}
+
+// The scan applyPresenceUpdate used before the managers kept indexes.
+bool linearPresenceUpdate(QList<friendlist::FriendItem> *friends,
+                          const PresenceEvent &event) {
+  const QString trimmedUserId = event.userId.trimmed();
+  const QString trimmedNumericId = event.numericId.trimmed();
+  for (friendlist::FriendItem &item : *friends) {
+    const bool userIdMatched =
+        !trimmedUserId.isEmpty() && item.userId == trimmedUserId;
+    const bool numericIdMatched =
+        !trimmedNumericId.isEmpty() && item.numericId == trimmedNumericId;
+    if (!userIdMatched && !numericIdMatched) {
+      continue;
+    }
+    item.isOnline = event.isOnline;
+    return true;
+  }
+  return false;
+}
+} // namespace
+
+// Replays a presence storm (10k broadcasts) against 5k-entry lists.
+class PresenceIndexBench : public QObject {
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void indexedLookupMatchesScan();
+  void indexesFollowResync();
+  void deltaPatchesIndexes();
+  void benchmarkLinearScan();
+  void benchmarkFriendListIndexed();
+  void benchmarkConversationListIndexed();
+  void benchmarkSingleChangeDelta();
+
+private:
+  QVector<PresenceEvent> m_events;
+};
+
+void PresenceIndexBench::initTestCase() {
+  // Both managers log every applied update.
+  QLoggingCategory::setFilterRules(QStringLiteral("default.info=false"));
+  m_events = presenceEvents();
+}
+
+void PresenceIndexBench::indexedLookupMatchesScan() {
+  friendlist::FriendListManager manager;
+  QVERIFY(manager.updateFromResponse(friendListPayload()));
+  QList<friendlist::FriendItem> scanned = friendItems(manager);
+
+  for (const PresenceEvent &event : m_events) {
+    friendlist::FriendRecord updated;
+    const bool indexedHit = manager.applyPresenceUpdate(
+        event.userId, event.numericId, event.isOnline, QString(), &updated);
+    QCOMPARE(indexedHit, linearPresenceUpdate(&scanned, event));
+    if (indexedHit) {
+      QCOMPARE(updated->userId, event.userId);
+    }
+  }
+  for (int i = 0; i < scanned.size(); ++i) {
+    QCOMPARE(manager.friends().at(i)->isOnline, scanned.at(i).isOnline);
+  }
+}
+
+void PresenceIndexBench::indexesFollowResync() {
+  conversationlist::ConversationListManager manager;
+  QVERIFY(manager.updateFromResponse(conversationListPayload()));
+  QVERIFY(manager.applyPeerPresenceUpdate(userIdFor(42), QString(), true, QString()));
+
+  QJsonObject delta;
+  delta.insert("sync_mode", "delta");
+  delta.insert("conversations", QJsonArray());
+  delta.insert("removed_conversation_ids", QJsonArray{QStringLiteral("c-0")});
+  QVERIFY(manager.applySyncResponse(delta));
+  QVERIFY(!manager.applyPeerPresenceUpdate(userIdFor(0), numericIdFor(0), true,
+                                           QString()));
+
+  conversationlist::ConversationRecord updated;
+  QVERIFY(manager.applyPeerPresenceUpdate(QString(), numericIdFor(kEntryCount - 1),
+                                          true, QString(), &updated));
+  QCOMPARE(updated->peerUserId, userIdFor(kEntryCount - 1));
+
+  manager.clear();
+  QVERIFY(!manager.applyPeerPresenceUpdate(userIdFor(42), QString(), true, QString()));
+}
+
+void PresenceIndexBench::deltaPatchesIndexes() {
+  conversationlist::ConversationListManager manager;
+  QVERIFY(manager.updateFromResponse(conversationListPayload()));
+
+  // c-10 moves to the peer of c-20, c-5 goes away and its peer reappears in a
+  // new conversation at the end.
+  QJsonObject moved;
+  moved.insert("conversation_id", QStringLiteral("c-10"));
+  moved.insert("conversation_type", 1);
+  moved.insert("peer_user_id", userIdFor(20));
+  moved.insert("peer_numeric_id", numericIdFor(20));
+  QJsonObject added;
+  added.insert("conversation_id", QStringLiteral("c-new"));
+  added.insert("conversation_type", 1);
+  added.insert("peer_user_id", userIdFor(5));
+  added.insert("peer_numeric_id", numericIdFor(5));
+  QJsonObject delta;
+  delta.insert("sync_mode", "delta");
+  delta.insert("conversations", QJsonArray{moved, added});
+  delta.insert("removed_conversation_ids", QJsonArray{QStringLiteral("c-5")});
+  QVERIFY(manager.applySyncResponse(delta));
+
+  const QList<conversationlist::ConversationRecord> &rows = manager.conversations();
+  QCOMPARE(rows.size(), kEntryCount);
+  for (const conversationlist::ConversationRecord &record : rows) {
+    QCOMPARE(manager.findConversation(record->conversationId), &record.item());
+  }
+  QVERIFY(!manager.findConversation(QStringLiteral("c-5")));
+
+  conversationlist::ConversationRecord updated;
+  QVERIFY(manager.applyPeerPresenceUpdate(userIdFor(20), QString(), true,
+                                          QString(), &updated));
+  QCOMPARE(updated->conversationId, QStringLiteral("c-10"));
+  QVERIFY(!manager.applyPeerPresenceUpdate(userIdFor(10), numericIdFor(10), true,
+                                           QString()));
+  QVERIFY(manager.applyPeerPresenceUpdate(QString(), numericIdFor(5), true,
+                                          QString(), &updated));
+  QCOMPARE(updated->conversationId, QStringLiteral("c-new"));
+  QVERIFY(manager.applyPeerPresenceUpdate(QString(), numericIdFor(kEntryCount - 1),
+                                          true, QString(), &updated));
+  QCOMPARE(updated->conversationId,
+           QStringLiteral("c-%1").arg(kEntryCount - 1));
+
+  // Moving c-10 back hands peer 20 on to c-20.
+  moved.insert("peer_user_id", userIdFor(10));
+  moved.insert("peer_numeric_id", numericIdFor(10));
+  delta.insert("conversations", QJsonArray{moved});
+  delta.insert("removed_conversation_ids", QJsonArray());
+  QVERIFY(manager.applySyncResponse(delta));
+  QVERIFY(manager.applyPeerPresenceUpdate(userIdFor(20), QString(), true,
+                                          QString(), &updated));
+  QCOMPARE(updated->conversationId, QStringLiteral("c-20"));
+}
+
+void PresenceIndexBench::benchmarkLinearScan() {
+  friendlist::FriendListManager manager;
+  QVERIFY(manager.updateFromResponse(friendListPayload()));
+  QList<friendlist::FriendItem> friends = friendItems(manager);
+  QBENCHMARK {
+    for (const PresenceEvent &event : m_events) {
+      linearPresenceUpdate(&friends, event);
+    }
+  }
+}
+
+void PresenceIndexBench::benchmarkFriendListIndexed() {
+  friendlist::FriendListManager manager;
+  QVERIFY(manager.updateFromResponse(friendListPayload()));
+  QBENCHMARK {
+    for (const PresenceEvent &event : m_events) {
+      manager.applyPresenceUpdate(event.userId, event.numericId, event.isOnline,
+                                  QString());
+    }
+  }
+}
+
+void PresenceIndexBench::benchmarkConversationListIndexed() {
+  conversationlist::ConversationListManager manager;
+  QVERIFY(manager.updateFromResponse(conversationListPayload()));
+  QBENCHMARK {
+    for (const PresenceEvent &event : m_events) {
+      manager.applyPeerPresenceUpdate(event.userId, event.numericId,
+                                      event.isOnline, QString());
+    }
+  }
+}
+
+void PresenceIndexBench::benchmarkSingleChangeDelta() {
+  conversationlist::ConversationListManager manager;
+  QVERIFY(manager.updateFromResponse(conversationListPayload()));
+  QJsonObject changed;
+  changed.insert("conversation_id", QStringLiteral("c-%1").arg(kEntryCount / 2));
+  changed.insert("conversation_type", 1);
+  changed.insert("peer_user_id", userIdFor(kEntryCount / 2));
+  changed.insert("peer_numeric_id", numericIdFor(kEntryCount / 2));
+  QJsonObject delta;
+  delta.insert("sync_mode", "delta");
+  delta.insert("removed_conversation_ids", QJsonArray());
+  int seq = 0;
+  QBENCHMARK {
+    changed.insert("last_seq", ++seq);
+    delta.insert("conversations", QJsonArray{changed});
+    manager.applySyncResponse(delta);
+  }
+}
+
+QTEST_GUILESS_MAIN(PresenceIndexBench)
+#include "presenceindex_bench.moc"
@@ -0,0 +1,117 @@
+#include "presenceupdatebuffer.h"
+
+#include <QSignalSpy>
+#include <QString>
+#include <QVector>
+#include <QtTest/QtTest>
+
+namespace {
+constexpr int kTestFlushIntervalMs = 20;
+constexpr int kStormUserCount = 200;
+constexpr int kStormEventsPerUser = 10;
+
+PresenceUpdate presence(const QString &userId, const QString &numericId,
+                        bool isOnline) {
+  PresenceUpdate update;
+  update.userId = userId;
+  update.numericId = numericId;
+  update.isOnline = isOnline;
+  return update;
+}
+
+QVector<PresenceUpdate> flushedUpdates(const QSignalSpy &spy, int flush) {
+  return spy.at(flush).at(0).value<QVector<PresenceUpdate>>();
+}
+} // namespace
+
+class PresenceUpdateBufferTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void foldsPerUserLatestWins();
+  void keepsArrivalOrderAcrossIds();
+  void flushesOncePerTick();
+  void dropsUpdatesWithoutIds();
+  void clearDiscardsPending();
+};
+
+void PresenceUpdateBufferTest::foldsPerUserLatestWins() {
+  PresenceUpdateBuffer buffer(kTestFlushIntervalMs);
+  QSignalSpy ready(&buffer, &PresenceUpdateBuffer::updatesReady);
+  for (int event = 0; event < kStormEventsPerUser; ++event) {
+    for (int user = 0; user < kStormUserCount; ++user) {
+      buffer.enqueue(presence(QStringLiteral("u-%1").arg(user), QString(),
+                              event % 2 == 1));
+    }
+  }
+  QCOMPARE(buffer.pendingCount(), kStormUserCount);
+  QTRY_COMPARE_WITH_TIMEOUT(ready.count(), 1, 2000);
+
+  const QVector<PresenceUpdate> updates = flushedUpdates(ready, 0);
+  QCOMPARE(updates.size(), kStormUserCount);
+  for (int user = 0; user < kStormUserCount; ++user) {
+    QCOMPARE(updates.at(user).userId, QStringLiteral("u-%1").arg(user));
+    QVERIFY(updates.at(user).isOnline);
+  }
+  const PresenceBufferStats stats = buffer.stats();
+  QCOMPARE(stats.received, quint64(kStormUserCount * kStormEventsPerUser));
+  QCOMPARE(stats.applied, quint64(kStormUserCount));
+  QCOMPARE(stats.flushes, quint64(1));
+  QCOMPARE(stats.pending, 0);
+}
+
+void PresenceUpdateBufferTest::keepsArrivalOrderAcrossIds() {
+  PresenceUpdateBuffer buffer(kTestFlushIntervalMs);
+  QSignalSpy ready(&buffer, &PresenceUpdateBuffer::updatesReady);
+  // The same user announced by numeric id only, then by user id, then by
+  // numeric id again: the last event must be applied last.
+  buffer.enqueue(presence(QString(), QStringLiteral("1001"), true));
+  buffer.enqueue(presence(QStringLiteral("u-1"), QString(), false));
+  buffer.enqueue(presence(QString(), QStringLiteral("1001"), true));
+  buffer.flush();
+
+  QCOMPARE(ready.count(), 1);
+  const QVector<PresenceUpdate> updates = flushedUpdates(ready, 0);
+  QCOMPARE(updates.size(), 2);
+  QCOMPARE(updates.at(0).userId, QStringLiteral("u-1"));
+  QCOMPARE(updates.at(1).numericId, QStringLiteral("1001"));
+  QVERIFY(updates.at(1).isOnline);
+}
+
+void PresenceUpdateBufferTest::flushesOncePerTick() {
+  PresenceUpdateBuffer buffer(kTestFlushIntervalMs);
+  QSignalSpy ready(&buffer, &PresenceUpdateBuffer::updatesReady);
+  buffer.enqueue(presence(QStringLiteral("u-1"), QString(), true));
+  QCOMPARE(ready.count(), 0);
+  buffer.enqueue(presence(QStringLiteral("u-2"), QString(), true));
+  QTRY_COMPARE_WITH_TIMEOUT(ready.count(), 1, 2000);
+  QCOMPARE(flushedUpdates(ready, 0).size(), 2);
+
+  // Nothing pending: the tick does not fire again.
+  QTest::qWait(kTestFlushIntervalMs * 3);
+  QCOMPARE(ready.count(), 1);
+
+  buffer.enqueue(presence(QStringLiteral("u-1"), QString(), false));
+  QTRY_COMPARE_WITH_TIMEOUT(ready.count(), 2, 2000);
+  QCOMPARE(buffer.stats().flushes, quint64(2));
+}
+
+void PresenceUpdateBufferTest::dropsUpdatesWithoutIds() {
+  PresenceUpdateBuffer buffer(kTestFlushIntervalMs);
+  buffer.enqueue(presence(QStringLiteral("  "), QString(), true));
+  QCOMPARE(buffer.pendingCount(), 0);
+  QCOMPARE(buffer.stats().received, quint64(0));
+}
+
+void PresenceUpdateBufferTest::clearDiscardsPending() {
+  PresenceUpdateBuffer buffer(kTestFlushIntervalMs);
+  QSignalSpy ready(&buffer, &PresenceUpdateBuffer::updatesReady);
+  buffer.enqueue(presence(QStringLiteral("u-1"), QString(), true));
+  buffer.clear();
+  QTest::qWait(kTestFlushIntervalMs * 3);
+  QCOMPARE(ready.count(), 0);
+  QCOMPARE(buffer.pendingCount(), 0);
+}
+
+QTEST_GUILESS_MAIN(PresenceUpdateBufferTest)
+#include "presenceupdatebuffer_test.moc"
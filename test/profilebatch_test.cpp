@@ -0,0 +1,252 @@
+#include "profileapiclient.h"
+#include "websocketclient.h"
+
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSignalSpy>
+#include <QWebSocket>
+#include <QWebSocketServer>
+#include <QtTest/QtTest>
+
+namespace {
+// Ids divisible by this are unknown to the stand-in server.
+constexpr int kMissingEvery = 7;
+
+QJsonObject profileFor(const QString &numericId) {
+  QJsonObject profile;
+  profile.insert("user_id", QStringLiteral("u-%1").arg(numericId));
+  profile.insert("numeric_id", numericId);
+  profile.insert("username", QStringLiteral("user%1").arg(numericId));
+  profile.insert("email", QString());
+  profile.insert("phone", QString());
+  profile.insert("status", 1);
+  profile.insert("user_uuid", QStringLiteral("uuid-%1").arg(numericId));
+  profile.insert("nickname", QStringLiteral("nick%1").arg(numericId));
+  profile.insert("avatar_url", QString());
+  profile.insert("bio", QString());
+  profile.insert("signature", QString());
+  profile.insert("theme", QStringLiteral("default"));
+  return profile;
+}
+
+QStringList numericIds(int from, int to) {
+  QStringList ids;
+  for (int i = from; i <= to; ++i) {
+    ids.push_back(QString::number(i));
+  }
+  return ids;
+}
+
+// Answers PROFILE/BATCH_GET and PROFILE/GET the way the server does and
+// records the batch sizes and single ids it has seen.
+class ProfileStandInServer : public QObject {
+  Q_OBJECT
+
+public:
+  quint16 start() {
+    m_server = new QWebSocketServer(QStringLiteral("profile-stand-in"),
+                                    QWebSocketServer::NonSecureMode, this);
+    if (!m_server->listen(QHostAddress::LocalHost, 0)) {
+      return 0;
+    }
+    connect(m_server, &QWebSocketServer::newConnection, this, [this]() {
+      QWebSocket *socket = m_server->nextPendingConnection();
+      connect(socket, &QWebSocket::textMessageReceived, socket,
+              [this, socket](const QString &message) { reply(socket, message); });
+      connect(socket, &QWebSocket::disconnected, socket, &QObject::deleteLater);
+    });
+    return m_server->serverPort();
+  }
+
+  QVector<int> batchSizes;
+  QStringList getIds;
+
+private:
+  void reply(QWebSocket *socket, const QString &message) {
+    const QJsonObject request = QJsonDocument::fromJson(message.toUtf8()).object();
+    if (request.value("type").toString() != QLatin1String("PROFILE")) {
+      return;
+    }
+    const QString action = request.value("action").toString();
+    if (action == QLatin1String("GET")) {
+      const QString numericId =
+          request.value("data").toObject().value("numeric_id").toString();
+      getIds.push_back(numericId);
+      QJsonObject data;
+      data.insert("ok", true);
+      data.insert("profile", profileFor(numericId));
+      send(socket, request, data);
+      return;
+    }
+    if (action != QLatin1String("BATCH_GET")) {
+      return;
+    }
+    const QJsonArray ids =
+        request.value("data").toObject().value("numeric_ids").toArray();
+    batchSizes.push_back(ids.size());
+
+    QJsonArray profiles;
+    for (const QJsonValue &id : ids) {
+      if (id.toString().toInt() % kMissingEvery != 0) {
+        profiles.append(profileFor(id.toString()));
+      }
+    }
+    QJsonObject data;
+    data.insert("ok", true);
+    data.insert("profiles", profiles);
+    send(socket, request, data);
+  }
+
+  void send(QWebSocket *socket, const QJsonObject &request,
+            const QJsonObject &data) {
+    QJsonObject response;
+    response.insert("type", "PROFILE");
+    response.insert("action", request.value("action"));
+    response.insert("request_id", request.value("request_id"));
+    response.insert("code", 0);
+    response.insert("data", data);
+    socket->sendTextMessage(
+        QString::fromUtf8(QJsonDocument(response).toJson(QJsonDocument::Compact)));
+  }
+
+  QWebSocketServer *m_server = nullptr;
+};
+} // namespace
+
+class ProfileBatchTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void cleanupTestCase();
+  void splitsOversizedBatches();
+  void servesCachedProfilesLocally();
+  void emptyBatchShouldFail();
+  void invalidBatchFailsAfterReturn();
+  void identicalGetsShareOneRequest();
+
+private:
+  ProfileStandInServer m_server;
+  ProfileApiClient *m_client = nullptr;
+};
+
+void ProfileBatchTest::initTestCase() {
+  const quint16 port = m_server.start();
+  QVERIFY(port != 0);
+  websocketclient::instance()->open(
+      QUrl(QStringLiteral("ws://127.0.0.1:%1").arg(port)));
+  QTRY_VERIFY_WITH_TIMEOUT(websocketclient::instance()->isConnected(), 5000);
+  m_client = new ProfileApiClient(websocketclient::instance(), this);
+}
+
+void ProfileBatchTest::cleanupTestCase() {
+  websocketclient::instance()->close();
+}
+
+void ProfileBatchTest::splitsOversizedBatches() {
+  QSignalSpy items(m_client, &ProfileApiClient::userProfileBatchItem);
+  QSignalSpy finished(m_client, &ProfileApiClient::userProfileBatchFinished);
+
+  const QStringList ids = numericIds(1, 250);
+  const QString batchId = m_client->queryUserProfiles(ids);
+  QTRY_COMPARE_WITH_TIMEOUT(finished.count(), 1, 5000);
+
+  QCOMPARE(m_server.batchSizes, (QVector<int>{100, 100, 50}));
+  QCOMPARE(finished.at(0).at(0).toString(), batchId);
+
+  QStringList expectedMissing;
+  for (const QString &id : ids) {
+    if (id.toInt() % kMissingEvery == 0) {
+      expectedMissing.push_back(id);
+    }
+  }
+  QStringList missing = finished.at(0).at(1).toStringList();
+  missing.sort();
+  expectedMissing.sort();
+  QCOMPARE(missing, expectedMissing);
+  QCOMPARE(items.count(), ids.size() - expectedMissing.size());
+  for (const QList<QVariant> &item : items) {
+    QCOMPARE(item.at(0).toString(), batchId);
+  }
+}
+
+void ProfileBatchTest::servesCachedProfilesLocally() {
+  m_server.batchSizes.clear();
+  QSignalSpy items(m_client, &ProfileApiClient::userProfileBatchItem);
+  QSignalSpy finished(m_client, &ProfileApiClient::userProfileBatchFinished);
+
+  // 1..10 were fetched by the previous test; only the missing 7 is re-sent.
+  m_client->queryUserProfiles(numericIds(1, 10));
+  QTRY_COMPARE_WITH_TIMEOUT(finished.count(), 1, 5000);
+  QCOMPARE(m_server.batchSizes, QVector<int>{1});
+  QCOMPARE(items.count(), 9);
+  QCOMPARE(finished.at(0).at(1).toStringList(), QStringList{QStringLiteral("7")});
+  QVERIFY(m_client->profileCacheStats().hits >= 9);
+}
+
+void ProfileBatchTest::emptyBatchShouldFail() {
+  QSignalSpy failed(m_client, &ProfileApiClient::requestFailed);
+  QSignalSpy finished(m_client, &ProfileApiClient::userProfileBatchFinished);
+  const QString batchId = m_client->queryUserProfiles(QStringList());
+  QCOMPARE(failed.count(), 0);
+  QCOMPARE(finished.count(), 0);
+
+  QTRY_COMPARE(finished.count(), 1);
+  QCOMPARE(failed.count(), 1);
+  QCOMPARE(failed.at(0).at(0).toString(), batchId);
+  QCOMPARE(failed.at(0).at(1).toString(), QStringLiteral("BATCH_GET"));
+  QCOMPARE(finished.at(0).at(0).toString(), batchId);
+  QVERIFY(finished.at(0).at(1).toStringList().isEmpty());
+}
+
+void ProfileBatchTest::invalidBatchFailsAfterReturn() {
+  QSignalSpy failed(m_client, &ProfileApiClient::requestFailed);
+  QSignalSpy finished(m_client, &ProfileApiClient::userProfileBatchFinished);
+  const QString batchId = m_client->queryUserProfiles(
+      {QStringLiteral("10001"), QStringLiteral(" abc "), QStringLiteral("10001")});
+  QCOMPARE(failed.count(), 0);
+
+  QTRY_COMPARE(finished.count(), 1);
+  QCOMPARE(failed.count(), 1);
+  QCOMPARE(failed.at(0).at(0).toString(), batchId);
+  QCOMPARE(finished.at(0).at(0).toString(), batchId);
+  QCOMPARE(finished.at(0).at(1).toStringList(),
+           QStringList({QStringLiteral("10001"), QStringLiteral("abc")}));
+
+  // Nothing else arrives for the rejected batch.
+  QTest::qWait(50);
+  QCOMPARE(finished.count(), 1);
+  QCOMPARE(failed.count(), 1);
+}
+
+void ProfileBatchTest::identicalGetsShareOneRequest() {
+  m_server.getIds.clear();
+  QSignalSpy queried(m_client, &ProfileApiClient::userProfileQueried);
+
+  // Not cached by earlier tests, so both calls need the server.
+  const QString first = m_client->queryUserProfile(QStringLiteral("90001"));
+  const QString second = m_client->queryUserProfile(QStringLiteral(" 90001 "));
+  QVERIFY(first != second);
+  QTRY_COMPARE_WITH_TIMEOUT(queried.count(), 2, 5000);
+
+  QCOMPARE(m_server.getIds, QStringList{QStringLiteral("90001")});
+  QStringList answered{queried.at(0).at(0).toString(),
+                       queried.at(1).at(0).toString()};
+  answered.sort();
+  QStringList expected{first, second};
+  expected.sort();
+  QCOMPARE(answered, expected);
+  for (const QList<QVariant> &call : queried) {
+    QCOMPARE(call.at(1).value<ProfileInfo>().numericId, QStringLiteral("90001"));
+  }
+
+  // Nothing else arrives later for either caller.
+  QTest::qWait(50);
+  QCOMPARE(queried.count(), 2);
+  QCOMPARE(m_server.getIds.size(), 1);
+}
+
+QTEST_MAIN(ProfileBatchTest)
+#include "profilebatch_test.moc"
@@ -0,0 +1,62 @@
+#include "protocol.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QtTest/QtTest>
+
+class ProtocolTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void envelopeNamesMapToEnums();
+  void everyNameRoundTrips();
+  void lookupIsExact();
+};
+
+void ProtocolTest::envelopeNamesMapToEnums() {
+  protocol::Envelope envelope;
+  QVERIFY(protocol::parseEnvelope(
+      QByteArray(R"({"type":"PROFILE","action":"BATCH_GET","request_id":"r1","data":{}})"),
+      &envelope));
+  QCOMPARE(envelope.typeId, protocol::EnvelopeType::Profile);
+  QCOMPARE(envelope.actionId, protocol::EnvelopeAction::BatchGet);
+  QCOMPARE(envelope.action, QStringLiteral("BATCH_GET"));
+
+  // Names the client does not know keep their wire string.
+  QVERIFY(protocol::parseEnvelope(
+      QByteArray(R"({"type":"PROFILE","action":"NEW_THING","request_id":"r2","data":{}})"),
+      &envelope));
+  QCOMPARE(envelope.typeId, protocol::EnvelopeType::Profile);
+  QCOMPARE(envelope.actionId, protocol::EnvelopeAction::Unknown);
+  QCOMPARE(envelope.action, QStringLiteral("NEW_THING"));
+}
+
+void ProtocolTest::everyNameRoundTrips() {
+  for (int i = 1; i <= static_cast<int>(protocol::EnvelopeType::Message); ++i) {
+    const auto type = static_cast<protocol::EnvelopeType>(i);
+    QVERIFY(!protocol::envelopeTypeName(type).isEmpty());
+    QCOMPARE(protocol::envelopeTypeFromString(protocol::envelopeTypeName(type)),
+             type);
+  }
+  for (int i = 1; i <= static_cast<int>(protocol::EnvelopeAction::History); ++i) {
+    const auto action = static_cast<protocol::EnvelopeAction>(i);
+    QVERIFY(!protocol::envelopeActionName(action).isEmpty());
+    QCOMPARE(protocol::envelopeActionFromString(protocol::envelopeActionName(action)),
+             action);
+  }
+}
+
+void ProtocolTest::lookupIsExact() {
+  QCOMPARE(protocol::envelopeTypeFromString(QString()), protocol::EnvelopeType::Unknown);
+  QCOMPARE(protocol::envelopeTypeFromString(u"profile"),
+           protocol::EnvelopeType::Unknown);
+  QCOMPARE(protocol::envelopeActionFromString(u"GET_INFO "),
+           protocol::EnvelopeAction::Unknown);
+  // A view into a larger buffer matches on its own characters only.
+  const QString frame = QStringLiteral("xxLIST_FRIENDSxx");
+  QCOMPARE(protocol::envelopeActionFromString(QStringView(frame).mid(2, 12)),
+           protocol::EnvelopeAction::ListFriends);
+}
+
+QTEST_GUILESS_MAIN(ProtocolTest)
+#include "protocol_test.moc"
@@ -0,0 +1,200 @@
+#include "conversationlistmanager.h"
+#include "conversationrecord.h"
+#include "stringpool.h"
+
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <QtTest/QtTest>
+
+#include <algorithm>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace {
+constexpr int kConversationCount = 10000;
+
+QJsonObject conversationJson(int index) {
+  QJsonObject item;
+  item.insert("conversation_id", QStringLiteral("c-%1").arg(index));
+  item.insert("conversation_uuid",
+              QStringLiteral("8f14e45f-ceea-467f-a0e6-%1").arg(index, 12, 10,
+                                                             QLatin1Char('0')));
+  item.insert("conversation_type", 1);
+  item.insert("peer_user_id", QStringLiteral("user-%1").arg(index));
+  item.insert("peer_numeric_id", QString::number(100000 + index));
+  item.insert("peer_username", QStringLiteral("name%1").arg(index));
+  item.insert("peer_nickname", QStringLiteral("Nickname %1").arg(index));
+  item.insert("peer_avatar_url",
+              QStringLiteral("https://cdn.example.com/avatar/%1.png").arg(index));
+  item.insert("peer_bio", QStringLiteral("bio of user %1").arg(index));
+  item.insert("last_seq", 100 + index);
+  item.insert("last_message_preview",
+              QStringLiteral("last message in conversation %1").arg(index));
+  return item;
+}
+
+QJsonObject conversationListPayload() {
+  QJsonArray conversations;
+  for (int i = 0; i < kConversationCount; ++i) {
+    conversations.append(conversationJson(i));
+  }
+  QJsonObject data;
+  data.insert("conversations", conversations);
+  return data;
+}
+
+// A separately parsed copy, as ProfileApiClient produced before the records.
+conversationlist::ConversationItem parsedItem(const QJsonObject &obj) {
+  conversationlist::ConversationItem item;
+  item.conversationId = obj.value("conversation_id").toString();
+  item.conversationUuid = obj.value("conversation_uuid").toString();
+  item.conversationType = obj.value("conversation_type").toInt();
+  item.peerUserId = obj.value("peer_user_id").toString();
+  item.peerNumericId = obj.value("peer_numeric_id").toString();
+  item.peerUsername = obj.value("peer_username").toString();
+  item.peerNickname = obj.value("peer_nickname").toString();
+  item.name = item.peerNickname;
+  item.peerAvatarUrl = obj.value("peer_avatar_url").toString();
+  item.avatarUrl = item.peerAvatarUrl;
+  item.peerBio = obj.value("peer_bio").toString();
+  item.lastSeq = obj.value("last_seq").toInteger();
+  item.lastMessagePreview = obj.value("last_message_preview").toString();
+  return item;
+}
+
+#if defined(__GLIBC__)
+qint64 heapInUse() { return qint64(mallinfo2().uordblks); }
+#endif
+} // namespace
+
+class RecordMemoryBench : public QObject {
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void unchangedConversationsKeepTheirRecord();
+  void editDetachesSharedRecord();
+  void idsAreInterned();
+  void sharedRecordsUseLessMemory();
+
+private:
+  QJsonObject m_payload;
+};
+
+void RecordMemoryBench::initTestCase() {
+  m_payload = conversationListPayload();
+}
+
+void RecordMemoryBench::unchangedConversationsKeepTheirRecord() {
+  conversationlist::ConversationListManager manager;
+  QVERIFY(manager.applySyncResponse(m_payload));
+  const QList<conversationlist::ConversationRecord> before =
+      manager.conversations();
+
+  conversationlist::ConversationListDiff diff;
+  QVERIFY(manager.applySyncResponse(m_payload, &diff));
+  QVERIFY(diff.isEmpty());
+  QCOMPARE(manager.conversations().size(), before.size());
+  for (int i = 0; i < before.size(); ++i) {
+    QVERIFY(manager.conversations().at(i).sharesDataWith(before.at(i)));
+  }
+}
+
+void RecordMemoryBench::editDetachesSharedRecord() {
+  conversationlist::ConversationRecord record(parsedItem(conversationJson(1)));
+  conversationlist::ConversationRecord shared = record;
+  QVERIFY(shared.sharesDataWith(record));
+
+  shared.edit().peerIsOnline = true;
+  QVERIFY(!shared.sharesDataWith(record));
+  QVERIFY(shared->peerIsOnline);
+  QVERIFY(!record->peerIsOnline);
+
+  // A record nobody else holds is edited in place.
+  conversationlist::ConversationRecord sole = shared;
+  shared = conversationlist::ConversationRecord();
+  const conversationlist::ConversationItem *before = &sole.item();
+  sole.edit().peerIsOnline = false;
+  QCOMPARE(&sole.item(), before);
+}
+
+void RecordMemoryBench::idsAreInterned() {
+  conversationlist::ConversationListManager first;
+  conversationlist::ConversationListManager second;
+  QVERIFY(first.applySyncResponse(m_payload));
+  QVERIFY(second.applySyncResponse(m_payload));
+
+  // Two parses of the same ids share one buffer per id.
+  const conversationlist::ConversationItem &a = *first.conversations().at(3);
+  const conversationlist::ConversationItem &b = *second.conversations().at(3);
+  QCOMPARE(a.peerUserId.constData(), b.peerUserId.constData());
+  QCOMPARE(a.peerNumericId.constData(), b.peerNumericId.constData());
+  QCOMPARE(a.peerAvatarUrl.constData(), b.peerAvatarUrl.constData());
+  QVERIFY(a.peerBio.constData() != b.peerBio.constData());
+
+  first.clear();
+  second.clear();
+  QVERIFY(StringPool::instance()->releaseUnused() > 0);
+  QCOMPARE(StringPool::instance()->size(), 0);
+}
+
+void RecordMemoryBench::sharedRecordsUseLessMemory() {
+#if !defined(__GLIBC__)
+  QSKIP("heap accounting needs glibc mallinfo2");
+#else
+  const QJsonArray conversations = m_payload.value("conversations").toArray();
+
+  // Before: the manager list, the profile client's own parse and the widget's
+  // per-conversation state, each a full ConversationItem.
+  const qint64 copiesStart = heapInUse();
+  qint64 copiesBytes = 0;
+  {
+    QList<conversationlist::ConversationItem> managerItems;
+    QVector<conversationlist::ConversationItem> profileItems;
+    QHash<QString, conversationlist::ConversationItem> widgetItems;
+    managerItems.reserve(kConversationCount);
+    profileItems.reserve(kConversationCount);
+    for (const QJsonValue &value : conversations) {
+      managerItems.push_back(parsedItem(value.toObject()));
+      profileItems.push_back(parsedItem(value.toObject()));
+    }
+    for (const conversationlist::ConversationItem &item : managerItems) {
+      widgetItems.insert(item.conversationId, item);
+    }
+    copiesBytes = heapInUse() - copiesStart;
+  }
+
+  // After: one record per conversation, referenced from the same three places.
+  const qint64 sharedStart = heapInUse();
+  qint64 sharedBytes = 0;
+  {
+    conversationlist::ConversationListManager manager;
+    QVERIFY(manager.applySyncResponse(m_payload));
+    QVector<conversationlist::ConversationRecord> profileRecords;
+    QHash<QString, conversationlist::ConversationRecord> widgetRecords;
+    profileRecords.reserve(kConversationCount);
+    for (const conversationlist::ConversationRecord &record :
+         manager.conversations()) {
+      profileRecords.push_back(record);
+      widgetRecords.insert(record->conversationId, record);
+    }
+    sharedBytes = heapInUse() - sharedStart;
+    QCOMPARE(profileRecords.size(), kConversationCount);
+  }
+
+  qInfo() << "[RecordMemoryBench]" << kConversationCount
+          << "conversations, copies=" << copiesBytes / 1024
+          << "KiB shared=" << sharedBytes / 1024 << "KiB ("
+          << 100 * sharedBytes / std::max<qint64>(1, copiesBytes) << "%)";
+  QVERIFY(sharedBytes < copiesBytes);
+#endif
+}
+
+QTEST_GUILESS_MAIN(RecordMemoryBench)
+#include "recordmemory_bench.moc"
@@ -0,0 +1,122 @@
+#include "requesttimeoutwheel.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+#include <QtTest/QtTest>
+
+#include <memory>
+
+namespace {
+constexpr int kBenchRequestCount = 1000;
+constexpr int kTestTickMs = 5;
+
+QString requestKey(int index) {
+  return QStringLiteral("req-%1").arg(index);
+}
+} // namespace
+
+class RequestTimeoutWheelBench : public QObject {
+  Q_OBJECT
+
+private slots:
+  void expiresAfterTimeout();
+  void cancelledKeyShouldNotFire();
+  void rescheduleReplacesDeadline();
+  void destroyedContextShouldSkipCallback();
+  void benchmarkTimerPerRequest();
+  void benchmarkTimeoutWheel();
+};
+
+void RequestTimeoutWheelBench::expiresAfterTimeout() {
+  RequestTimeoutWheel wheel(kTestTickMs);
+  QElapsedTimer clock;
+  clock.start();
+  qint64 firedAfterMs = -1;
+  wheel.schedule(QStringLiteral("a"), 40, this,
+                 [&](const QString &) { firedAfterMs = clock.elapsed(); });
+  QCOMPARE(wheel.size(), 1);
+  QTRY_VERIFY_WITH_TIMEOUT(firedAfterMs >= 0, 2000);
+  QVERIFY(firedAfterMs >= 40);
+  QCOMPARE(wheel.size(), 0);
+}
+
+void RequestTimeoutWheelBench::cancelledKeyShouldNotFire() {
+  RequestTimeoutWheel wheel(kTestTickMs);
+  int fired = 0;
+  wheel.schedule(QStringLiteral("a"), 20, this, [&](const QString &) { ++fired; });
+  wheel.schedule(QStringLiteral("b"), 20, this, [&](const QString &) { ++fired; });
+  QVERIFY(wheel.cancel(QStringLiteral("a")));
+  QVERIFY(!wheel.cancel(QStringLiteral("a")));
+  QTRY_COMPARE_WITH_TIMEOUT(fired, 1, 2000);
+  QTest::qWait(50);
+  QCOMPARE(fired, 1);
+}
+
+void RequestTimeoutWheelBench::rescheduleReplacesDeadline() {
+  // A 4-slot wheel also exercises deadlines that wrap around several rounds.
+  RequestTimeoutWheel wheel(kTestTickMs, 4);
+  QStringList fired;
+  wheel.schedule(QStringLiteral("a"), 10, this,
+                 [&](const QString &key) { fired << key + QStringLiteral("-old"); });
+  wheel.schedule(QStringLiteral("a"), 60, this,
+                 [&](const QString &key) { fired << key; });
+  QCOMPARE(wheel.size(), 1);
+  QTest::qWait(30);
+  QVERIFY(fired.isEmpty());
+  QTRY_COMPARE_WITH_TIMEOUT(fired, QStringList{QStringLiteral("a")}, 2000);
+}
+
+void RequestTimeoutWheelBench::destroyedContextShouldSkipCallback() {
+  RequestTimeoutWheel wheel(kTestTickMs);
+  int fired = 0;
+  auto context = std::make_unique<QObject>();
+  wheel.schedule(QStringLiteral("a"), 10, context.get(),
+                 [&](const QString &) { ++fired; });
+  context.reset();
+  QTRY_COMPARE_WITH_TIMEOUT(wheel.size(), 0, 2000);
+  QCOMPARE(fired, 0);
+}
+
+// Arm and cancel one deadline per request, the way the API clients did before.
+void RequestTimeoutWheelBench::benchmarkTimerPerRequest() {
+  QBENCHMARK {
+    QVector<QTimer *> timers;
+    timers.reserve(kBenchRequestCount);
+    for (int i = 0; i < kBenchRequestCount; ++i) {
+      auto *timer = new QTimer(this);
+      timer->setSingleShot(true);
+      connect(timer, &QTimer::timeout, this, []() {});
+      timer->start(8000);
+      timers.push_back(timer);
+    }
+    for (QTimer *timer : timers) {
+      timer->stop();
+      delete timer;
+    }
+  }
+}
+
+void RequestTimeoutWheelBench::benchmarkTimeoutWheel() {
+  RequestTimeoutWheel wheel;
+  QVector<QString> keys;
+  keys.reserve(kBenchRequestCount);
+  for (int i = 0; i < kBenchRequestCount; ++i) {
+    keys.push_back(requestKey(i));
+  }
+  QBENCHMARK {
+    for (const QString &key : keys) {
+      wheel.schedule(key, 8000, this, [](const QString &) {});
+    }
+    for (const QString &key : keys) {
+      wheel.cancel(key);
+    }
+  }
+  QCOMPARE(wheel.size(), 0);
+}
+
+QTEST_MAIN(RequestTimeoutWheelBench)
+#include "requesttimeoutwheel_bench.moc"
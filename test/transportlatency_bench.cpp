@@ -0,0 +1,205 @@
+#include "websocketclient.h"
+
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QScopeGuard>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include <QWebSocketServer>
+#include <QtTest/QtTest>
+
+#include <algorithm>
+
+namespace {
+constexpr int kPushIntervalMs = 2;
+constexpr int kSampleWindowMs = 1500;
+constexpr int kGuiBusyPeriodMs = 20;
+constexpr int kGuiBusySliceMs = 15;
+
+QElapsedTimer g_clock;
+
+// Pushes a MESSAGE/SEND frame stamped with the send time every few ms.
+class PushServer : public QObject {
+  Q_OBJECT
+
+public:
+  quint16 start() {
+    m_server = new QWebSocketServer(QStringLiteral("bench"),
+                                    QWebSocketServer::NonSecureMode, this);
+    if (!m_server->listen(QHostAddress::LocalHost, 0)) {
+      return 0;
+    }
+    connect(m_server, &QWebSocketServer::newConnection, this, [this]() {
+      QWebSocket *socket = m_server->nextPendingConnection();
+      auto *timer = new QTimer(socket);
+      connect(timer, &QTimer::timeout, socket, [socket, seq = 0]() mutable {
+        QJsonObject data;
+        data.insert(QStringLiteral("seq"), ++seq);
+        data.insert(QStringLiteral("sent_ns"),
+                    static_cast<double>(g_clock.nsecsElapsed()));
+        QJsonObject frame;
+        frame.insert(QStringLiteral("type"), QStringLiteral("MESSAGE"));
+        frame.insert(QStringLiteral("action"), QStringLiteral("SEND"));
+        frame.insert(QStringLiteral("data"), data);
+        socket->sendTextMessage(QString::fromUtf8(
+            QJsonDocument(frame).toJson(QJsonDocument::Compact)));
+      });
+      connect(socket, &QWebSocket::disconnected, socket, &QObject::deleteLater);
+      timer->start(kPushIntervalMs);
+    });
+    return m_server->serverPort();
+  }
+
+  void stop() {
+    if (m_server) {
+      m_server->close();
+    }
+  }
+
+private:
+  QWebSocketServer *m_server = nullptr;
+};
+
+struct LatencySummary {
+  int samples = 0;
+  double p50Ms = 0;
+  double p99Ms = 0;
+  double maxMs = 0;
+};
+} // namespace
+
+// Measures how long an inbound frame waits before websocketclient has parsed
+// it, while the GUI thread is kept busy 75% of the time.
+class TransportLatencyBench : public QObject {
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void cleanupTestCase();
+  void inboundLatencyOnGuiThread();
+  void inboundLatencyOnNetworkThread();
+
+private:
+  void measure(LatencySummary *summary);
+
+  QThread m_serverThread;
+  PushServer *m_server = nullptr;
+  QUrl m_url;
+  LatencySummary m_guiThreadResult;
+};
+
+void TransportLatencyBench::initTestCase() {
+  g_clock.start();
+  m_server = new PushServer();
+  m_server->moveToThread(&m_serverThread);
+  connect(&m_serverThread, &QThread::finished, m_server, &QObject::deleteLater);
+  m_serverThread.start();
+
+  quint16 port = 0;
+  QMetaObject::invokeMethod(
+      m_server, [this, &port]() { port = m_server->start(); },
+      Qt::BlockingQueuedConnection);
+  QVERIFY(port != 0);
+  m_url = QUrl(QStringLiteral("ws://127.0.0.1:%1").arg(port));
+}
+
+void TransportLatencyBench::cleanupTestCase() {
+  websocketclient::instance()->stopNetworkThread();
+  QMetaObject::invokeMethod(m_server, [this]() { m_server->stop(); },
+                            Qt::BlockingQueuedConnection);
+  m_serverThread.quit();
+  m_serverThread.wait();
+}
+
+void TransportLatencyBench::inboundLatencyOnGuiThread() {
+  measure(&m_guiThreadResult);
+  QVERIFY(m_guiThreadResult.samples > 0);
+}
+
+void TransportLatencyBench::inboundLatencyOnNetworkThread() {
+  websocketclient::instance()->startNetworkThread();
+  LatencySummary result;
+  measure(&result);
+  QVERIFY(result.samples > 0);
+  qInfo().noquote()
+      << QStringLiteral("p99 gui-thread=%1 ms network-thread=%2 ms")
+             .arg(m_guiThreadResult.p99Ms, 0, 'f', 2)
+             .arg(result.p99Ms, 0, 'f', 2);
+}
+
+void TransportLatencyBench::measure(LatencySummary *summary) {
+  websocketclient *client = websocketclient::instance();
+  QMutex samplesMutex;
+  QVector<double> samplesMs;
+  bool collecting = false;
+
+  // Direct connection: runs on whichever thread owns the transport.
+  const QMetaObject::Connection connection = connect(
+      client, &websocketclient::envelopeReceived, client,
+      [&](const protocol::Envelope &envelope) {
+        const qint64 sentNs =
+            static_cast<qint64>(envelope.data.value(QStringLiteral("sent_ns")).toDouble());
+        const double latencyMs = (g_clock.nsecsElapsed() - sentNs) / 1e6;
+        QMutexLocker locker(&samplesMutex);
+        if (collecting) {
+          samplesMs.push_back(latencyMs);
+        }
+      },
+      Qt::DirectConnection);
+  const auto disconnectGuard = qScopeGuard([connection]() { disconnect(connection); });
+
+  client->open(m_url);
+  QTRY_VERIFY_WITH_TIMEOUT(client->isConnected(), 5000);
+
+  QTimer busyTimer;
+  connect(&busyTimer, &QTimer::timeout, this, []() {
+    QElapsedTimer busy;
+    busy.start();
+    while (busy.elapsed() < kGuiBusySliceMs) {
+    }
+  });
+  {
+    QMutexLocker locker(&samplesMutex);
+    collecting = true;
+  }
+  busyTimer.start(kGuiBusyPeriodMs);
+  QTest::qWait(kSampleWindowMs);
+  busyTimer.stop();
+  {
+    QMutexLocker locker(&samplesMutex);
+    collecting = false;
+  }
+
+  client->close();
+  QTRY_VERIFY_WITH_TIMEOUT(!client->isConnected(), 5000);
+
+  QMutexLocker locker(&samplesMutex);
+  summary->samples = static_cast<int>(samplesMs.size());
+  if (samplesMs.isEmpty()) {
+    return;
+  }
+  std::sort(samplesMs.begin(), samplesMs.end());
+  const auto percentile = [&samplesMs, summary](int p) {
+    const int rank = (p * summary->samples + 99) / 100;
+    return samplesMs.at(qBound(0, rank - 1, summary->samples - 1));
+  };
+  summary->p50Ms = percentile(50);
+  summary->p99Ms = percentile(99);
+  summary->maxMs = samplesMs.last();
+  qInfo().noquote()
+      << QStringLiteral("%1: samples=%2 p50=%3 ms p99=%4 ms max=%5 ms")
+             .arg(client->isNetworkThreadRunning() ? QStringLiteral("network-thread")
+                                                   : QStringLiteral("gui-thread"))
+             .arg(summary->samples)
+             .arg(summary->p50Ms, 0, 'f', 2)
+             .arg(summary->p99Ms, 0, 'f', 2)
+             .arg(summary->maxMs, 0, 'f', 2);
+}
+
+QTEST_MAIN(TransportLatencyBench)
+#include "transportlatency_bench.moc"
@@ -0,0 +1,282 @@
+#include "websocketclient.h"
+
+#include <QHostAddress>
+#include <QNetworkInformation>
+#include <QPointer>
+#include <QSignalSpy>
+#include <QThread>
+#include <QVector>
+#include <QWebSocket>
+#include <QWebSocketServer>
+#include <QtTest/QtTest>
+
+namespace {
+constexpr int kFastInitialDelayMs = 20;
+constexpr int kFastMaxDelayMs = 160;
+constexpr int kHeartbeatIntervalMs = 100;
+
+// Listens on a fixed port and can go down and come back on it, dropping
+// every connection like a restarting server. Lives on its own thread.
+class RestartableServer : public QObject {
+  Q_OBJECT
+
+public:
+  quint16 start(quint16 port) {
+    if (!m_server) {
+      m_server = new QWebSocketServer(QStringLiteral("reconnect-stand-in"),
+                                      QWebSocketServer::NonSecureMode, this);
+      connect(m_server, &QWebSocketServer::newConnection, this, [this]() {
+        while (QWebSocket *socket = m_server->nextPendingConnection()) {
+          m_sockets.push_back(socket);
+          connect(socket, &QWebSocket::disconnected, socket, &QObject::deleteLater);
+        }
+      });
+    }
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+      return 0;
+    }
+    return m_server->serverPort();
+  }
+
+  void stop() {
+    m_server->close();
+    for (const QPointer<QWebSocket> &socket : std::as_const(m_sockets)) {
+      if (socket) {
+        socket->abort();
+      }
+    }
+    m_sockets.clear();
+  }
+
+private:
+  QWebSocketServer *m_server = nullptr;
+  QVector<QPointer<QWebSocket>> m_sockets;
+};
+} // namespace
+
+// The reconnect state machine and the heartbeat of websocketclient against a
+// local server that is taken down, brought back or kept from answering.
+class WebSocketClientTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void cleanupTestCase();
+  void init();
+  void cleanup();
+  void reconnectsAfterServerDrop();
+  void backoffDoublesUpToCapWithJitter();
+  void networkChangeSkipsBackoff();
+  void closeStopsReconnecting();
+  void percentilesUseNearestRank();
+  void heartbeatCollectsRttSamples();
+  void silentServerIsDetectedAsStalled();
+
+private:
+  void startServer();
+  void stopServer();
+
+  QThread m_serverThread;
+  RestartableServer *m_server = nullptr;
+  quint16 m_port = 0;
+  bool m_serverRunning = false;
+  QUrl m_url;
+};
+
+void WebSocketClientTest::initTestCase() {
+  m_server = new RestartableServer();
+  m_server->moveToThread(&m_serverThread);
+  connect(&m_serverThread, &QThread::finished, m_server, &QObject::deleteLater);
+  m_serverThread.start();
+  startServer();
+  QVERIFY(m_port != 0);
+  m_url = QUrl(QStringLiteral("ws://127.0.0.1:%1").arg(m_port));
+}
+
+void WebSocketClientTest::cleanupTestCase() {
+  websocketclient::instance()->close();
+  stopServer();
+  m_serverThread.quit();
+  m_serverThread.wait();
+}
+
+void WebSocketClientTest::init() {
+  websocketclient *client = websocketclient::instance();
+  client->setReconnectBackoff(kFastInitialDelayMs, kFastMaxDelayMs);
+  client->setAutoReconnectEnabled(true);
+  // Only the heartbeat tests ping.
+  client->setHeartbeatInterval(0);
+  client->setHeartbeatMaxMissedPongs(2);
+  client->open(m_url);
+  QTRY_VERIFY_WITH_TIMEOUT(client->isConnected(), 5000);
+}
+
+void WebSocketClientTest::cleanup() {
+  websocketclient *client = websocketclient::instance();
+  client->setAutoReconnectEnabled(false);
+  client->close();
+  QTRY_VERIFY_WITH_TIMEOUT(!client->isConnected(), 5000);
+  if (!m_serverRunning) {
+    startServer();
+  }
+}
+
+void WebSocketClientTest::startServer() {
+  quint16 port = 0;
+  QMetaObject::invokeMethod(
+      m_server, [this, &port]() { port = m_server->start(m_port); },
+      Qt::BlockingQueuedConnection);
+  QVERIFY(port != 0);
+  m_port = port;
+  m_serverRunning = true;
+}
+
+void WebSocketClientTest::stopServer() {
+  QMetaObject::invokeMethod(m_server, [this]() { m_server->stop(); },
+                            Qt::BlockingQueuedConnection);
+  m_serverRunning = false;
+}
+
+void WebSocketClientTest::reconnectsAfterServerDrop() {
+  websocketclient *client = websocketclient::instance();
+  QSignalSpy scheduled(client, &websocketclient::reconnectScheduled);
+  QSignalSpy reconnected(client, &websocketclient::reconnected);
+
+  stopServer();
+  QTRY_VERIFY_WITH_TIMEOUT(scheduled.count() >= 1, 5000);
+  QVERIFY(client->isReconnecting());
+  QCOMPARE(reconnected.count(), 0);
+
+  startServer();
+  QTRY_COMPARE_WITH_TIMEOUT(reconnected.count(), 1, 5000);
+  QVERIFY(client->isConnected());
+  QVERIFY(!client->isReconnecting());
+  // Held until the session is resumed.
+  QVERIFY(client->queueTextMessage(QStringLiteral("{}")));
+  QCOMPARE(client->outboundQueueSize(), 1);
+  client->releaseOutboundQueue();
+  QTRY_COMPARE(client->outboundQueueSize(), 0);
+}
+
+void WebSocketClientTest::backoffDoublesUpToCapWithJitter() {
+  websocketclient *client = websocketclient::instance();
+  QSignalSpy scheduled(client, &websocketclient::reconnectScheduled);
+
+  // 20, 40, 80, then capped at 160: the cap is reached and held.
+  constexpr int kAttempts = 7;
+  stopServer();
+  QTRY_VERIFY_WITH_TIMEOUT(scheduled.count() >= kAttempts, 10000);
+  for (int i = 0; i < kAttempts; ++i) {
+    const int attempt = scheduled.at(i).at(0).toInt();
+    const int delayMs = scheduled.at(i).at(1).toInt();
+    const int baseDelay = qMin(kFastInitialDelayMs << i, kFastMaxDelayMs);
+    QCOMPARE(attempt, i + 1);
+    QVERIFY2(delayMs >= baseDelay - baseDelay / 5 &&
+                 delayMs <= qMin(baseDelay + baseDelay / 5, kFastMaxDelayMs),
+             qPrintable(QStringLiteral("attempt %1 delay %2 ms, base %3 ms")
+                            .arg(attempt)
+                            .arg(delayMs)
+                            .arg(baseDelay)));
+  }
+}
+
+void WebSocketClientTest::networkChangeSkipsBackoff() {
+  websocketclient *client = websocketclient::instance();
+  client->setReconnectBackoff(10000, 30000);
+  QSignalSpy scheduled(client, &websocketclient::reconnectScheduled);
+  QSignalSpy reconnected(client, &websocketclient::reconnected);
+
+  stopServer();
+  QTRY_COMPARE_WITH_TIMEOUT(scheduled.count(), 1, 5000);
+  startServer();
+  QTest::qWait(200);
+  QVERIFY(!client->isConnected());
+
+  // At least 8 s of backoff are left; the network coming back skips them.
+  QVERIFY(QMetaObject::invokeMethod(
+      client, "onReachabilityChanged",
+      Q_ARG(QNetworkInformation::Reachability,
+            QNetworkInformation::Reachability::Online)));
+  QTRY_COMPARE_WITH_TIMEOUT(reconnected.count(), 1, 3000);
+  QCOMPARE(scheduled.count(), 1);
+}
+
+void WebSocketClientTest::closeStopsReconnecting() {
+  websocketclient *client = websocketclient::instance();
+  QSignalSpy scheduled(client, &websocketclient::reconnectScheduled);
+  QSignalSpy reconnected(client, &websocketclient::reconnected);
+
+  stopServer();
+  QTRY_VERIFY_WITH_TIMEOUT(scheduled.count() >= 2, 5000);
+  client->close();
+  QVERIFY(!client->isReconnecting());
+  const int scheduledAtClose = scheduled.count();
+
+  // Several backoff periods pass with the server back up; nothing happens.
+  startServer();
+  QTest::qWait(4 * kFastMaxDelayMs);
+  QCOMPARE(scheduled.count(), scheduledAtClose);
+  QCOMPARE(reconnected.count(), 0);
+  QVERIFY(!client->isConnected());
+}
+
+void WebSocketClientTest::percentilesUseNearestRank() {
+  QVector<quint64> hundred;
+  for (quint64 rtt = 1; rtt <= 100; ++rtt) {
+    hundred.push_back(rtt);
+  }
+  QCOMPARE(websocketclient::nearestRankPercentile(hundred, 50), quint64(50));
+  QCOMPARE(websocketclient::nearestRankPercentile(hundred, 95), quint64(95));
+  QCOMPARE(websocketclient::nearestRankPercentile(hundred, 99), quint64(99));
+
+  // With ten samples p95 and p99 both round up to the largest one.
+  const QVector<quint64> ten{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  QCOMPARE(websocketclient::nearestRankPercentile(ten, 50), quint64(5));
+  QCOMPARE(websocketclient::nearestRankPercentile(ten, 95), quint64(10));
+  QCOMPARE(websocketclient::nearestRankPercentile(ten, 99), quint64(10));
+
+  QCOMPARE(websocketclient::nearestRankPercentile({7}, 50), quint64(7));
+  QCOMPARE(websocketclient::nearestRankPercentile({7}, 99), quint64(7));
+  QCOMPARE(websocketclient::nearestRankPercentile({}, 50), quint64(0));
+}
+
+void WebSocketClientTest::heartbeatCollectsRttSamples() {
+  websocketclient *client = websocketclient::instance();
+  QSignalSpy statsUpdated(client, &websocketclient::heartbeatStatsUpdated);
+  client->setHeartbeatInterval(kHeartbeatIntervalMs / 2);
+
+  QTRY_VERIFY_WITH_TIMEOUT(statsUpdated.count() >= 3, 5000);
+  const HeartbeatStats stats = client->heartbeatStats();
+  QVERIFY(stats.sampleCount >= 3);
+  QVERIFY(stats.p50RttMs <= stats.p95RttMs);
+  QVERIFY(stats.p95RttMs <= stats.p99RttMs);
+  QCOMPARE(stats.missedPongs, 0);
+}
+
+void WebSocketClientTest::silentServerIsDetectedAsStalled() {
+  websocketclient *client = websocketclient::instance();
+  QSignalSpy pongs(client, &websocketclient::pongReceived);
+  QSignalSpy stalled(client, &websocketclient::connectionStalled);
+  QSignalSpy reconnected(client, &websocketclient::reconnected);
+  const int staleBefore = client->heartbeatStats().staleConnectionCount;
+  client->setHeartbeatInterval(kHeartbeatIntervalMs);
+  QTRY_VERIFY_WITH_TIMEOUT(pongs.count() >= 1, 5000);
+
+  // The server thread stops reading, so pings go unanswered. The first
+  // unanswered ping is counted one interval after it was sent, so two misses
+  // take at least two intervals.
+  QMetaObject::invokeMethod(m_server, []() { QThread::msleep(1500); });
+  QTest::qWait(kHeartbeatIntervalMs);
+  QCOMPARE(stalled.count(), 0);
+  QTRY_COMPARE_WITH_TIMEOUT(stalled.count(), 1, 3000);
+  QCOMPARE(stalled.at(0).at(0).toInt(), 2);
+  QCOMPARE(client->heartbeatStats().staleConnectionCount, staleBefore + 1);
+
+  // The aborted link is handed to reconnect, which succeeds once the server
+  // reads again.
+  QTRY_COMPARE_WITH_TIMEOUT(reconnected.count(), 1, 5000);
+  QVERIFY(client->isConnected());
+}
+
+QTEST_MAIN(WebSocketClientTest)
+#include "websocketclient_test.moc"